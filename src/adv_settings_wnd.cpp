@@ -26,6 +26,7 @@ File description:
 #include <wx/checkbox.h>
 #include <wx/dialog.h>
 #include <wx/sizer.h>
+#include <wx/spinctrl.h>
 #include <wx/stattext.h>
 
 constexpr int BORDER = 5; ///< Border size (in pixels between) controls
@@ -37,6 +38,9 @@ class c_AdvancedSettingsDialog: public wxDialog
     struct
     {
         wxCheckBox* normalizeFits{nullptr};
+        wxCheckBox* unsharpMaskBlurPyramid{nullptr};
+        wxSpinCtrl* scriptWorkers{nullptr};
+        wxSpinCtrl* scriptMemoryLimit{nullptr};
     } m_Ctrls;
 
 public:
@@ -61,6 +65,9 @@ c_AdvancedSettingsDialog::c_AdvancedSettingsDialog(wxWindow* parent)
 void c_AdvancedSettingsDialog::SaveSettings()
 {
     Configuration::NormalizeFITSValues = m_Ctrls.normalizeFits->GetValue();
+    Configuration::UnsharpMaskBlurPyramid = m_Ctrls.unsharpMaskBlurPyramid->GetValue();
+    Configuration::ScriptProcessingWorkers = static_cast<unsigned>(m_Ctrls.scriptWorkers->GetValue());
+    Configuration::ScriptProcessingMemoryLimitMiB = static_cast<unsigned>(m_Ctrls.scriptMemoryLimit->GetValue());
 }
 
 void c_AdvancedSettingsDialog::InitControls()
@@ -75,6 +82,34 @@ void c_AdvancedSettingsDialog::InitControls()
         0, wxALIGN_CENTER_VERTICAL | wxALL, BORDER
     );
 
+    m_Ctrls.unsharpMaskBlurPyramid = new wxCheckBox(this, wxID_ANY, _("Fast unsharp masking with large sigma"));
+    m_Ctrls.unsharpMaskBlurPyramid->SetValue(Configuration::UnsharpMaskBlurPyramid);
+    szTop->Add(m_Ctrls.unsharpMaskBlurPyramid, 0, wxALIGN_CENTER_VERTICAL | wxALL, BORDER);
+    szTop->Add(new wxStaticText(this, wxID_ANY,
+        _("CPU mode only: computes unsharp masks with large sigma on downsampled images. Takes effect after restarting ImPPG or switching the processing mode.")),
+        0, wxALIGN_CENTER_VERTICAL | wxALL, BORDER
+    );
+
+    wxSizer* szScriptWorkers = new wxBoxSizer(wxHORIZONTAL);
+    szScriptWorkers->Add(new wxStaticText(this, wxID_ANY, _("Images processed in parallel by scripts:")),
+        0, wxALIGN_CENTER_VERTICAL | wxALL, BORDER);
+    m_Ctrls.scriptWorkers = new wxSpinCtrl(this, wxID_ANY, wxEmptyString, wxDefaultPosition, wxDefaultSize,
+        wxSP_ARROW_KEYS, 1, 64, static_cast<int>(Configuration::ScriptProcessingWorkers));
+    szScriptWorkers->Add(m_Ctrls.scriptWorkers, 0, wxALIGN_CENTER_VERTICAL | wxALL, BORDER);
+    szTop->Add(szScriptWorkers, 0, wxALIGN_LEFT | wxALL, BORDER);
+
+    wxSizer* szScriptMemory = new wxBoxSizer(wxHORIZONTAL);
+    szScriptMemory->Add(new wxStaticText(this, wxID_ANY, _("Memory limit for parallel script processing (MiB):")),
+        0, wxALIGN_CENTER_VERTICAL | wxALL, BORDER);
+    m_Ctrls.scriptMemoryLimit = new wxSpinCtrl(this, wxID_ANY, wxEmptyString, wxDefaultPosition, wxDefaultSize,
+        wxSP_ARROW_KEYS, 0, 1024 * 1024, static_cast<int>(Configuration::ScriptProcessingMemoryLimitMiB));
+    szScriptMemory->Add(m_Ctrls.scriptMemoryLimit, 0, wxALIGN_CENTER_VERTICAL | wxALL, BORDER);
+    szTop->Add(szScriptMemory, 0, wxALIGN_LEFT | wxALL, BORDER);
+    szTop->Add(new wxStaticText(this, wxID_ANY,
+        _("CPU mode only; 0 means no limit. Takes effect when the script dialog is opened next time.")),
+        0, wxALIGN_CENTER_VERTICAL | wxALL, BORDER
+    );
+
     szTop->AddStretchSpacer();
 
     szTop->Add(CreateSeparatedButtonSizer(wxOK | wxCANCEL), 0, wxGROW | wxALL, BORDER);
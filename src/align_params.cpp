@@ -53,6 +53,8 @@ enum
     ID_FileList,
     ID_OutputDir,
     ID_SubpixelAlignment,
+    ID_LanczosInterpolation,
+    ID_UseCache,
     ID_Sort,
     ID_RemoveAll,
     ID_Crop,
@@ -92,6 +94,7 @@ class c_ImageAlignmentParams: public c_ScrollableDialog
     void DoInitControls() override;
 
     AlignmentParameters_t m_Parameters;
+    bool m_LanczosInterpolation{false};
 
     wxDirPickerCtrl* m_OutputDirCtrl{nullptr};
     wxEditableListBox m_FileList;
@@ -128,6 +131,7 @@ void c_ImageAlignmentParams::GetAlignmentParameters(AlignmentParameters_t& param
     params.inputs = std::move(newInputs);
     params.outputDir = m_Parameters.outputDir = m_OutputDirCtrl->GetPath();
     params.outputFNameSuffix = "_aligned";
+    params.interpolation = m_LanczosInterpolation ? ShiftInterpolation::LANCZOS3 : ShiftInterpolation::CUBIC;
 }
 
 void c_ImageAlignmentParams::OnOutputDirChanged(wxFileDirPickerEvent& event)
@@ -230,6 +234,8 @@ void c_ImageAlignmentParams::DoInitControls()
     m_Parameters.subpixelAlignment = true;
     m_Parameters.alignmentMethod = AlignmentMethod::PHASE_CORRELATION;
     m_Parameters.normalizeFitsValues = Configuration::NormalizeFITSValues;
+    m_Parameters.useCache = Configuration::AlignUseCache;
+    m_LanczosInterpolation = Configuration::AlignLanczosInterpolation;
 
     m_CropBitmaps[static_cast<size_t>(CropMode::CROP_TO_INTERSECTION)] = LoadBitmap("crop");
     m_CropBitmaps[static_cast<size_t>(CropMode::PAD_TO_BOUNDING_BOX)] = LoadBitmap("pad");
@@ -253,6 +259,16 @@ void c_ImageAlignmentParams::DoInitControls()
         cb->SetToolTip(_("Enable sub-pixel alignment for smoother motion and less drift. Saving of output files will be somewhat slower; sharp, 1-pixel details (if present) may get very slightly blurred"));
         cb->SetValidator(wxGenericValidator(&m_Parameters.subpixelAlignment));
         szProcSettings->Add(cb, 0, wxALIGN_CENTER_VERTICAL | wxALL, BORDER);
+
+        cb = new wxCheckBox(GetContainer(), ID_LanczosInterpolation, _("Lanczos interpolation"));
+        cb->SetToolTip(_("Use Lanczos instead of cubic interpolation for sub-pixel alignment. Preserves fine details better, but may cause slight ringing around high-contrast edges"));
+        cb->SetValidator(wxGenericValidator(&m_LanczosInterpolation));
+        szProcSettings->Add(cb, 0, wxALIGN_CENTER_VERTICAL | wxALL, BORDER);
+
+        cb = new wxCheckBox(GetContainer(), ID_UseCache, _("Cache measurements"));
+        cb->SetToolTip(_("Store the measurements of each image in a file (.imppg-alignment-cache) in the input images' folder, so that aligning the same images again (e.g. with a different crop mode or output folder) is faster"));
+        cb->SetValidator(wxGenericValidator(&m_Parameters.useCache));
+        szProcSettings->Add(cb, 0, wxALIGN_CENTER_VERTICAL | wxALL, BORDER);
         szContents->Add(szProcSettings, 0, wxALIGN_LEFT | wxALL, BORDER);
 
         wxSizer* szCrop = new wxBoxSizer(wxHORIZONTAL);
@@ -315,6 +331,8 @@ bool GetAlignmentParameters(wxWindow* parent,
     {
         dlg.GetAlignmentParameters(params);
         Configuration::AlignOutputPath = params.outputDir;
+        Configuration::AlignUseCache = params.useCache;
+        Configuration::AlignLanczosInterpolation = (params.interpolation == ShiftInterpolation::LANCZOS3);
     }
     Configuration::AlignParamsDialogPosSize = wxRect(dlg.GetPosition(), dlg.GetSize());
 
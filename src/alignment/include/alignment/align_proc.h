@@ -24,14 +24,18 @@ File description:
 #ifndef IMPPG_IMAGE_ALIGNMENT_THREAD_HEADER
 #define IMPPG_IMAGE_ALIGNMENT_THREAD_HEADER
 
+#include <functional>
 #include <memory>
+#include <optional>
 #include <variant>
 #include <vector>
 #include <wx/arrstr.h>
 #include <wx/thread.h>
 
+#include "alignment/stacking.h"
 #include "common/common.h"
 #include "image/image.h"
+#include "math_utils/cancellation.h"
 
 enum class CropMode: int
 {
@@ -57,10 +61,20 @@ struct AlignmentParameters_t
     AlignmentInputs inputs; //TODO: rename type and member
     AlignmentMethod alignmentMethod;
     bool subpixelAlignment;
+    /// Used for sub-pixel translation of the output images.
+    ShiftInterpolation interpolation{ShiftInterpolation::CUBIC};
     CropMode cropMode;
     wxString outputDir;
     bool normalizeFitsValues;
     std::optional<std::string> outputFNameSuffix;
+    /// If stacking is enabled, the aligned images are stacked instead of being saved.
+    StackingParameters stacking;
+    /// Max. amount of memory (in bytes) used by the output images translated and saved concurrently;
+    /// determines how many of them are processed at a time (at least 1, at most the number of logical CPUs).
+    std::size_t outputMemoryLimit{512 * 1024 * 1024};
+    /// If enabled (and the inputs are files), per-image measurements are stored in (and reused from)
+    /// a cache file in the input folder; see `c_AlignmentCache`.
+    bool useCache{false};
 
     std::size_t GetNumInputs() const
     {
@@ -98,11 +112,15 @@ enum
     /// Sent before `EID_COMPLETED` if `AlignmentParameters_t::inputs` was `InputImageList`.
     /// Event payload contains `std::shared_ptr<std::vector<FloatPoint_t>>`, one value for each image (the first is (0.0, 0.0)).
     EID_TRANSLATIONS,
+    EID_STACKING_PROGRESS,      ///< Overall stacking progress in percent: event.GetInt()
+    /// Sent before `EID_COMPLETED` if stacking was enabled. Event payload contains `std::shared_ptr<c_Image>` (the stack).
+    EID_STACKED,
     EID_COMPLETED,              ///< Processing completed
     EID_ABORTED                 ///< Processing aborted; abort reason (AlignmentAbortReason_t): event.getId(); abort message: event.GetString()
 };
 
 class wxEvtHandler;
+class c_AlignmentCache;
 
 class c_ImageAlignmentWorkerThread: public wxThread
 {
@@ -111,6 +129,9 @@ class c_ImageAlignmentWorkerThread: public wxThread
     /// The parent can perform Post() on this semaphore (via AbortProcessing())
     wxSemaphore m_AbortReq;
 
+    /// Cancelled by AbortProcessing(); checked by the FFT loops, so that a long transform is interrupted.
+    c_CancellationToken m_Cancellation;
+
     bool m_ProcessingCompleted; ///< 'true' if processing has completed
     bool m_ThreadAborted; ///< 'true' if IsAbortRequested() has been called and has returned 'true'
     std::string m_ErrorMessage;
@@ -121,7 +142,21 @@ class c_ImageAlignmentWorkerThread: public wxThread
     bool IsAbortRequested();
     void SendMessageToParent(int id, int value = 0, wxString msg = wxEmptyString, AlignmentEventPayload_t* payload = nullptr);
 
-    bool SaveTranslatedOutputImage(const wxString& inputFileName, const c_Image& image);
+    /// Can be called concurrently from multiple threads.
+    bool SaveTranslatedOutputImage(const wxString& inputFileName, const c_Image& image, std::string& errorMsg) const;
+
+    /// Saves the translated images (or stacks them, if enabled); returns 'true' on success.
+    ///
+    /// When saving, several images are translated and saved concurrently; `EID_SAVED_OUTPUT_IMAGE` is still sent
+    /// in order of image indices.
+    ///
+    bool OutputTranslatedImages(
+        /// Returns the translated n-th image or an empty optional on error (setting the 2nd argument).
+        /// Can be called concurrently from multiple threads.
+        const std::function<std::optional<c_Image>(std::size_t, std::string&)>& getTranslatedImage,
+        /// Estimated memory (in bytes) needed to translate and save a single image.
+        std::size_t imageMemory
+    );
 
     void PhaseCorrelationAlignment(); ///< Aligns the images by keeping the high-contrast features stationary
     void LimbAlignment(); ///< Aligns the images by keeping the limb stationary
@@ -132,7 +167,8 @@ class c_ImageAlignmentWorkerThread: public wxThread
         std::vector<std::vector<FloatPoint_t>>& limbPoints, ///< Receives limb points found in n-th image
         std::vector<float>& radii, ///< Receives disc radii determined for each image
         std::vector<Point_t>& imgSizes, ///< Receives input image sizes
-        std::vector<Point_t>& centroids ///< Receives image centroids
+        std::vector<Point_t>& centroids, ///< Receives image centroids
+        c_AlignmentCache* cache ///< If not null, used to skip already measured images
     );
 
     /// Performs the final stabilization phase of limb alignment; returns 'true' on success
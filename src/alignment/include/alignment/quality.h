@@ -0,0 +1,91 @@
+/*
+ImPPG (Image Post-Processor) - common operations for astronomical stacks and other images
+Copyright (C) 2016-2022 Filip Szczerek <ga.software@yahoo.com>
+
+This file is part of ImPPG.
+
+ImPPG is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ImPPG is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with ImPPG.  If not, see <http://www.gnu.org/licenses/>.
+
+File description:
+    Image quality estimation header.
+*/
+
+#ifndef IMPPG_IMAGE_QUALITY_HEADER
+#define IMPPG_IMAGE_QUALITY_HEADER
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <wx/thread.h>
+
+#include "alignment/align_proc.h"
+#include "common/common.h"
+#include "image/image.h"
+
+enum class QualityMetric: int
+{
+    GRADIENT = 0,          ///< Mean squared gradient.
+    LAPLACIAN_VARIANCE = 1, ///< Variance of the Laplacian (less sensitive to noise and large-scale brightness gradients).
+
+    NUM // this has to be the last element
+};
+
+/// Returns the quality of the specified area of a PIX_MONO32F image: the sum of squared gradients.
+float GetQuality(const c_Image& img, const Rectangle_t& area);
+
+/// Returns the quality (sharpness) of an image; the greater, the better. Values are only comparable
+/// between images of similar contents.
+float GetImageQuality(const c_Image& img, QualityMetric metric);
+
+/// Returns indices (in ascending order) of the best `fraction` (from 0 to 1) of images, but at least one.
+std::vector<std::size_t> SelectBestImages(const std::vector<float>& qualities, double fraction);
+
+/// IDs of events sent from the quality estimation worker thread.
+enum
+{
+    EID_QUALITY_IMAGE_DONE = wxID_HIGHEST + 100, ///< Number of images scored so far: event.GetInt()
+    /// Event payload contains `std::shared_ptr<std::vector<float>>`, the quality of each image.
+    EID_QUALITY_COMPLETED,
+    EID_QUALITY_ABORTED ///< Error message: event.GetString()
+};
+
+class wxEvtHandler;
+
+/// Determines the quality of all images of a sequence. Several images are scored in parallel.
+class c_QualityEstimationWorkerThread: public wxThread
+{
+public:
+    c_QualityEstimationWorkerThread(
+        wxEvtHandler& parent,         ///< Object to receive notification messages from this worker thread
+        AlignmentInputs inputs,
+        QualityMetric metric,
+        bool normalizeFitsValues
+    );
+
+    ExitCode Entry() override;
+
+    /// Signals the thread to finish processing ASAP.
+    void AbortProcessing();
+
+private:
+    wxEvtHandler& m_Parent;
+    wxSemaphore m_AbortReq;
+    AlignmentInputs m_Inputs;
+    QualityMetric m_Metric;
+    bool m_NormalizeFitsValues;
+
+    bool IsAbortRequested();
+};
+
+#endif // IMPPG_IMAGE_QUALITY_HEADER
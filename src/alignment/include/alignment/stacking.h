@@ -0,0 +1,152 @@
+/*
+ImPPG (Image Post-Processor) - common operations for astronomical stacks and other images
+Copyright (C) 2016-2022 Filip Szczerek <ga.software@yahoo.com>
+
+This file is part of ImPPG.
+
+ImPPG is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ImPPG is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with ImPPG.  If not, see <http://www.gnu.org/licenses/>.
+
+File description:
+    Image stacking header.
+*/
+
+#ifndef IMPPG_IMAGE_STACKING_HEADER
+#define IMPPG_IMAGE_STACKING_HEADER
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "image/image.h"
+
+enum class StackingMode: int
+{
+    NONE = 0,
+    MEAN = 1,
+    SIGMA_CLIPPED_MEAN = 2,
+    MEDIAN = 3,
+
+    NUM // this has to be the last element
+};
+
+struct StackingParameters
+{
+    StackingMode mode{StackingMode::NONE};
+
+    /// Sigma-clipped mean: values further than `sigmaClippingKappa` standard deviations from the mean are rejected.
+    float sigmaClippingKappa{2.5f};
+
+    /// Max. amount of frame data (in bytes) kept in memory at a time: median's band of rows of all frames,
+    /// and the frames kept for the subsequent passes (if they do not fit, they are stored in a temporary file).
+    std::size_t memoryLimit{512 * 1024 * 1024};
+};
+
+/// Stacks a sequence of images (frames) of the same size.
+///
+/// Frames are fed once, one by one, so that only the accumulators (and, for median, a band of rows of all frames)
+/// are kept in memory. Some modes need more than one pass over the sequence; for these, the frames (converted
+/// to floating-point) are stored in temporary storage as they are added, and the remaining passes are performed
+/// by `Finish`:
+///
+///   - mean: 1 pass (running sum)
+///   - sigma-clipped mean: 2 passes (mean and standard deviation; sum of non-rejected values)
+///   - median: 1 pass per band of rows which fits in `StackingParameters::memoryLimit`
+///
+class c_ImageStacker
+{
+public:
+    enum class Error
+    {
+        NONE,
+        FRAME_MISMATCH, ///< Frames differ in dimensions or number of channels.
+        TEMP_STORAGE    ///< Failed to write or read the temporary storage of frames.
+    };
+
+    c_ImageStacker(StackingParameters params, std::size_t numFrames);
+
+    ~c_ImageStacker();
+
+    /// Adds the next frame; it is converted to PIX_MONO32F or PIX_RGB32F if needed.
+    /** Returns `false` on error (see `GetError`). */
+    bool AddFrame(const c_Image& frame);
+
+    /// Performs the remaining passes (if any) once all frames have been added.
+    /** Returns `false` on error (see `GetError`) or if `checkAbort` returned `true`.
+        `progress` is called after each frame is processed, see `GetPercentageComplete`. */
+    bool Finish(const std::function<void(int)>& progress, const std::function<bool()>& checkAbort);
+
+    bool IsComplete() const { return m_Complete; }
+
+    Error GetError() const { return m_Error; }
+
+    std::size_t GetNumPasses() const { return m_NumPasses; }
+
+    /// Returns the completed part of all passes (in percent); known after the first frame is added.
+    int GetPercentageComplete() const;
+
+    /// Can only be called after stacking completes.
+    const c_Image& GetResult() const { IMPPG_ASSERT(m_Complete); return m_Result.value(); }
+
+private:
+    class c_FrameStore;
+
+    /// Returns a pointer to row `y` of the frame being accumulated (only rows of the current median band are used).
+    using RowGetter = std::function<const float*(unsigned)>;
+
+    void Initialize(const c_Image& firstFrame);
+
+    void AccumulateFrame(const RowGetter& getRow);
+
+    /// Called after a frame has been accumulated.
+    void NextFrame();
+
+    void FinishPass();
+
+    void FinishMedianBand();
+
+    StackingParameters m_Params;
+    std::size_t m_NumFrames{0};
+
+    unsigned m_Width{0};
+    unsigned m_Height{0};
+    PixelFormat m_PixelFormat{PixelFormat::PIX_MONO32F};
+    std::size_t m_ValuesPerRow{0};
+
+    std::size_t m_Pass{0};
+    std::size_t m_NumPasses{1};
+    std::size_t m_FrameIdx{0}; ///< Index of the next frame in the current pass.
+
+    /// Mean: sum of values. Sigma-clipped mean: sum of values (1st pass), sum of non-rejected values (2nd pass).
+    std::vector<double> m_Sum;
+    /// Sigma-clipped mean: sum of squared values (1st pass), number of non-rejected values (2nd pass).
+    std::vector<double> m_Aux;
+    /// Sigma-clipped mean: mean and standard deviation of values (determined in the 1st pass).
+    std::vector<float> m_Mean, m_StdDev;
+
+    /// Median: number of rows processed in one pass.
+    unsigned m_BandHeight{0};
+    /// Median: values of all frames in the current band; values of a pixel are contiguous (index: `value * m_NumFrames + frame`).
+    std::vector<float> m_BandValues;
+
+    /// Frames stored for the passes after the 1st one.
+    std::unique_ptr<c_FrameStore> m_FrameStore;
+
+    std::optional<c_Image> m_Result;
+    bool m_Complete{false};
+    Error m_Error{Error::NONE};
+};
+
+#endif // IMPPG_IMAGE_STACKING_HEADER
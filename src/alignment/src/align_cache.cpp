@@ -0,0 +1,372 @@
+/*
+ImPPG (Image Post-Processor) - common operations for astronomical stacks and other images
+Copyright (C) 2016-2022 Filip Szczerek <ga.software@yahoo.com>
+
+This file is part of ImPPG.
+
+ImPPG is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ImPPG is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with ImPPG.  If not, see <http://www.gnu.org/licenses/>.
+
+File description:
+    Alignment measurements cache implementation.
+*/
+
+#include <filesystem>
+#include <limits>
+#include <locale>
+#include <sstream>
+#include <system_error>
+
+#include "../../imppg_assert.h"
+#include "align_cache.h"
+#include "logging/logging.h"
+
+namespace fs = std::filesystem;
+
+// private definitions
+namespace
+{
+
+const char* CACHE_FILE_NAME = ".imppg-alignment-cache";
+
+// Entry format (one per line, fields separated by tabs):
+//
+//   T  <previous file key> <file key> <FFT width> <FFT height> <subpixel> <normalize FITS>  <tx> <ty>
+//   L  <file key> <normalize FITS>  <width> <height> <centroid x> <centroid y> <radius> <num. points> <x1> <y1> <x2> <y2>...
+//
+// where a file key is: <absolute path> <size> <modification time>.
+
+const char SEPARATOR = '\t';
+constexpr std::size_t NUM_FILE_KEY_FIELDS = 3;
+constexpr std::size_t NUM_TRANSLATION_KEY_FIELDS = 2 * NUM_FILE_KEY_FIELDS + 4;
+constexpr std::size_t NUM_LIMB_KEY_FIELDS = NUM_FILE_KEY_FIELDS + 1;
+
+std::optional<std::string> GetFileKey(const fs::path& fileName)
+{
+    std::error_code ec;
+    const fs::path path = fs::absolute(fileName, ec);
+    if (ec) { return std::nullopt; }
+
+    const auto size = fs::file_size(path, ec);
+    if (ec) { return std::nullopt; }
+
+    const auto modificationTime = fs::last_write_time(path, ec);
+    if (ec) { return std::nullopt; }
+
+    const std::string pathStr = path.string();
+    if (pathStr.find_first_of("\t\r\n") != std::string::npos) { return std::nullopt; }
+
+    std::ostringstream key;
+    key.imbue(std::locale::classic());
+    key << pathStr << SEPARATOR << size << SEPARATOR << modificationTime.time_since_epoch().count();
+    return key.str();
+}
+
+std::vector<std::string> SplitFields(const std::string& line)
+{
+    std::vector<std::string> fields;
+    std::size_t start = 0;
+    while (true)
+    {
+        const std::size_t end = line.find(SEPARATOR, start);
+        fields.push_back(line.substr(start, end - start));
+        if (end == std::string::npos) { break; }
+        start = end + 1;
+    }
+    return fields;
+}
+
+std::string JoinFields(const std::vector<std::string>& fields, std::size_t first, std::size_t count)
+{
+    std::string result;
+    for (std::size_t i = first; i < first + count; ++i)
+    {
+        if (i > first) { result += SEPARATOR; }
+        result += fields[i];
+    }
+    return result;
+}
+
+/// Returns true if `fields` (starting from `first`) contain the current key of the file they refer to.
+/** `currentKeys` caches the keys of the files checked so far. */
+bool IsFileKeyCurrent(
+    const std::vector<std::string>& fields,
+    std::size_t first,
+    std::map<std::string, std::optional<std::string>>& currentKeys
+)
+{
+    const std::string& path = fields[first];
+    auto it = currentKeys.find(path);
+    if (it == currentKeys.end())
+    {
+        it = currentKeys.emplace(path, GetFileKey(fs::path{path})).first;
+    }
+    return it->second.has_value() && *it->second == JoinFields(fields, first, NUM_FILE_KEY_FIELDS);
+}
+
+std::string FormatTranslationEntry(const std::string& key, const FloatPoint_t& translation)
+{
+    std::ostringstream entry;
+    entry.imbue(std::locale::classic());
+    entry.precision(std::numeric_limits<float>::max_digits10);
+    entry << "T" << SEPARATOR << key << SEPARATOR << translation.x << SEPARATOR << translation.y;
+    return entry.str();
+}
+
+std::string FormatLimbEntry(const std::string& key, const LimbMeasurement& measurement)
+{
+    std::ostringstream entry;
+    entry.imbue(std::locale::classic());
+    entry.precision(std::numeric_limits<float>::max_digits10);
+    entry << "L" << SEPARATOR << key
+        << SEPARATOR << measurement.imgSize.x << SEPARATOR << measurement.imgSize.y
+        << SEPARATOR << measurement.centroid.x << SEPARATOR << measurement.centroid.y
+        << SEPARATOR << measurement.radius
+        << SEPARATOR << measurement.limbPoints.size();
+    for (const auto& point: measurement.limbPoints)
+    {
+        entry << SEPARATOR << point.x << SEPARATOR << point.y;
+    }
+    return entry.str();
+}
+
+/// Parses all fields starting from `first`; returns an empty vector if any of them is not a number.
+std::vector<float> ParseValues(const std::vector<std::string>& fields, std::size_t first)
+{
+    std::vector<float> values;
+    for (std::size_t i = first; i < fields.size(); ++i)
+    {
+        std::istringstream stream{fields[i]};
+        stream.imbue(std::locale::classic());
+        float value{};
+        stream >> value;
+        if (stream.fail() || !stream.eof()) { return {}; }
+        values.push_back(value);
+    }
+    return values;
+}
+
+}
+
+c_AlignmentCache::c_AlignmentCache(const wxArrayString& inputFiles)
+{
+    for (const auto& fname: inputFiles)
+    {
+        m_FileKeys.push_back(GetFileKey(fs::path{fname.ToStdString()}));
+    }
+
+    if (!inputFiles.IsEmpty())
+    {
+        std::error_code ec;
+        const fs::path dir = fs::absolute(fs::path{inputFiles[0].ToStdString()}, ec).parent_path();
+        if (!ec)
+        {
+            m_CacheFileName = (dir / CACHE_FILE_NAME).string();
+            Load();
+        }
+    }
+}
+
+void c_AlignmentCache::Load()
+{
+    std::ifstream file(m_CacheFileName);
+    if (!file) { return; }
+
+    std::map<std::string, std::optional<std::string>> currentFileKeys;
+    std::size_t numLines = 0;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        numLines += 1;
+
+        // malformed entries (e.g. the last one if the previous run has crashed while writing it) are skipped
+        const auto fields = SplitFields(line);
+
+        if (fields[0] == "T" && fields.size() == 1 + NUM_TRANSLATION_KEY_FIELDS + 2)
+        {
+            if (!IsFileKeyCurrent(fields, 1, currentFileKeys) ||
+                !IsFileKeyCurrent(fields, 1 + NUM_FILE_KEY_FIELDS, currentFileKeys))
+            {
+                continue;
+            }
+
+            const auto values = ParseValues(fields, 1 + NUM_TRANSLATION_KEY_FIELDS);
+            if (values.size() == 2)
+            {
+                m_Translations[JoinFields(fields, 1, NUM_TRANSLATION_KEY_FIELDS)] = FloatPoint_t(values[0], values[1]);
+            }
+        }
+        else if (fields[0] == "L" && fields.size() >= 1 + NUM_LIMB_KEY_FIELDS + 6)
+        {
+            if (!IsFileKeyCurrent(fields, 1, currentFileKeys)) { continue; }
+
+            const auto values = ParseValues(fields, 1 + NUM_LIMB_KEY_FIELDS);
+            if (values.size() < 6) { continue; }
+
+            const auto numPoints = static_cast<std::size_t>(values[5]);
+            if (values.size() != 6 + 2 * numPoints) { continue; }
+
+            LimbMeasurement measurement;
+            measurement.imgSize = Point_t(static_cast<int>(values[0]), static_cast<int>(values[1]));
+            measurement.centroid = Point_t(static_cast<int>(values[2]), static_cast<int>(values[3]));
+            measurement.radius = values[4];
+            for (std::size_t i = 0; i < numPoints; ++i)
+            {
+                measurement.limbPoints.push_back(FloatPoint_t(values[6 + 2 * i], values[6 + 2 * i + 1]));
+            }
+            m_LimbMeasurements[JoinFields(fields, 1, NUM_LIMB_KEY_FIELDS)] = std::move(measurement);
+        }
+    }
+
+    Log::Print(wxString::Format(
+        "Loaded %zu translation(s) and %zu limb measurement(s) from %s.\n",
+        m_Translations.size(), m_LimbMeasurements.size(), m_CacheFileName
+    ));
+
+    file.close();
+    if (numLines > m_Translations.size() + m_LimbMeasurements.size())
+    {
+        Rewrite();
+    }
+}
+
+void c_AlignmentCache::Rewrite()
+{
+    // write to a temporary file first, so that the cache is not lost if writing fails
+    const std::string tempFileName = m_CacheFileName + ".tmp";
+    {
+        std::ofstream file(tempFileName, std::ios::trunc);
+        for (const auto& [key, translation]: m_Translations)
+        {
+            file << FormatTranslationEntry(key, translation) << '\n';
+        }
+        for (const auto& [key, measurement]: m_LimbMeasurements)
+        {
+            file << FormatLimbEntry(key, measurement) << '\n';
+        }
+        file.close();
+        if (!file)
+        {
+            Log::Print(wxString::Format("Could not write alignment cache %s.\n", tempFileName));
+            std::error_code ec;
+            fs::remove(tempFileName, ec);
+            return;
+        }
+    }
+
+    std::error_code ec;
+    fs::rename(tempFileName, m_CacheFileName, ec);
+    if (ec)
+    {
+        Log::Print(wxString::Format("Could not replace alignment cache %s.\n", m_CacheFileName));
+        fs::remove(tempFileName, ec);
+    }
+}
+
+void c_AlignmentCache::AppendEntry(const std::string& entry)
+{
+    if (m_CacheFileName.empty()) { return; }
+
+    if (!m_CacheFile.is_open())
+    {
+        m_CacheFile.open(m_CacheFileName, std::ios::app);
+        if (!m_CacheFile)
+        {
+            Log::Print(wxString::Format("Could not open alignment cache %s for writing.\n", m_CacheFileName));
+            m_CacheFileName.clear();
+            return;
+        }
+    }
+
+    // flush immediately, so that the entry is not lost if the alignment is interrupted
+    m_CacheFile << entry << std::endl;
+}
+
+std::optional<std::string> c_AlignmentCache::GetTranslationKey(
+    std::size_t idx,
+    unsigned fftWidth,
+    unsigned fftHeight,
+    bool subpixelAlignment,
+    bool normalizeFitsValues
+) const
+{
+    IMPPG_ASSERT(idx > 0 && idx < m_FileKeys.size());
+    if (!m_FileKeys[idx - 1].has_value() || !m_FileKeys[idx].has_value()) { return std::nullopt; }
+
+    std::ostringstream key;
+    key.imbue(std::locale::classic());
+    key << *m_FileKeys[idx - 1] << SEPARATOR << *m_FileKeys[idx] << SEPARATOR
+        << fftWidth << SEPARATOR << fftHeight << SEPARATOR << subpixelAlignment << SEPARATOR << normalizeFitsValues;
+    return key.str();
+}
+
+std::optional<std::string> c_AlignmentCache::GetLimbMeasurementKey(std::size_t idx, bool normalizeFitsValues) const
+{
+    IMPPG_ASSERT(idx < m_FileKeys.size());
+    if (!m_FileKeys[idx].has_value()) { return std::nullopt; }
+
+    return *m_FileKeys[idx] + SEPARATOR + (normalizeFitsValues ? "1" : "0");
+}
+
+std::optional<FloatPoint_t> c_AlignmentCache::GetTranslation(
+    std::size_t idx,
+    unsigned fftWidth,
+    unsigned fftHeight,
+    bool subpixelAlignment,
+    bool normalizeFitsValues
+) const
+{
+    const auto key = GetTranslationKey(idx, fftWidth, fftHeight, subpixelAlignment, normalizeFitsValues);
+    if (!key.has_value()) { return std::nullopt; }
+
+    const auto it = m_Translations.find(*key);
+    if (it == m_Translations.end()) { return std::nullopt; }
+
+    return it->second;
+}
+
+void c_AlignmentCache::StoreTranslation(
+    std::size_t idx,
+    unsigned fftWidth,
+    unsigned fftHeight,
+    bool subpixelAlignment,
+    bool normalizeFitsValues,
+    FloatPoint_t translation
+)
+{
+    const auto key = GetTranslationKey(idx, fftWidth, fftHeight, subpixelAlignment, normalizeFitsValues);
+    if (!key.has_value()) { return; }
+
+    m_Translations[*key] = translation;
+    AppendEntry(FormatTranslationEntry(*key, translation));
+}
+
+std::optional<LimbMeasurement> c_AlignmentCache::GetLimbMeasurement(std::size_t idx, bool normalizeFitsValues) const
+{
+    const auto key = GetLimbMeasurementKey(idx, normalizeFitsValues);
+    if (!key.has_value()) { return std::nullopt; }
+
+    const auto it = m_LimbMeasurements.find(*key);
+    if (it == m_LimbMeasurements.end()) { return std::nullopt; }
+
+    return it->second;
+}
+
+void c_AlignmentCache::StoreLimbMeasurement(std::size_t idx, bool normalizeFitsValues, const LimbMeasurement& measurement)
+{
+    const auto key = GetLimbMeasurementKey(idx, normalizeFitsValues);
+    if (!key.has_value()) { return; }
+
+    m_LimbMeasurements[*key] = measurement;
+    AppendEntry(FormatLimbEntry(*key, measurement));
+}
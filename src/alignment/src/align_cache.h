@@ -0,0 +1,96 @@
+/*
+ImPPG (Image Post-Processor) - common operations for astronomical stacks and other images
+Copyright (C) 2016-2022 Filip Szczerek <ga.software@yahoo.com>
+
+This file is part of ImPPG.
+
+ImPPG is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ImPPG is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with ImPPG.  If not, see <http://www.gnu.org/licenses/>.
+
+File description:
+    Alignment measurements cache header.
+*/
+
+#ifndef IMPPG_ALIGNMENT_CACHE_HEADER
+#define IMPPG_ALIGNMENT_CACHE_HEADER
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+#include <wx/arrstr.h>
+
+#include "common/common.h"
+
+/// Per-image results of the limb alignment's first phase (see `c_ImageAlignmentWorkerThread::FindRadii`).
+struct LimbMeasurement
+{
+    Point_t imgSize;
+    Point_t centroid;
+    float radius;
+    std::vector<FloatPoint_t> limbPoints;
+};
+
+/// Stores per-image alignment measurements in a sidecar file in the input images' folder.
+///
+/// Entries are keyed by input file path, size and modification time (and the parameters which affect
+/// the measurements), so a modified file is measured again. Each entry is appended to the file as soon as
+/// it is stored, so that the measurements survive an aborted or crashed alignment run; a rerun (e.g. with
+/// a different crop mode or output folder) only needs to translate and save the images.
+///
+/// When loading, entries which are malformed, duplicated or stale (referring to a file which has been modified
+/// or no longer exists) are discarded; if there were any, the file is rewritten with the remaining entries,
+/// so that it does not grow indefinitely.
+///
+/// The cache is optional: if the file cannot be read or written, the cache silently stays empty.
+///
+class c_AlignmentCache
+{
+public:
+    explicit c_AlignmentCache(const wxArrayString& inputFiles);
+
+    /// Returns the translation of n-th image relative to its predecessor (phase correlation alignment).
+    std::optional<FloatPoint_t> GetTranslation(std::size_t idx, unsigned fftWidth, unsigned fftHeight, bool subpixelAlignment, bool normalizeFitsValues) const;
+
+    void StoreTranslation(std::size_t idx, unsigned fftWidth, unsigned fftHeight, bool subpixelAlignment, bool normalizeFitsValues, FloatPoint_t translation);
+
+    std::optional<LimbMeasurement> GetLimbMeasurement(std::size_t idx, bool normalizeFitsValues) const;
+
+    void StoreLimbMeasurement(std::size_t idx, bool normalizeFitsValues, const LimbMeasurement& measurement);
+
+private:
+    /// Identifies the contents of n-th input file; empty if the file's size or time cannot be obtained.
+    std::vector<std::optional<std::string>> m_FileKeys;
+
+    std::map<std::string, FloatPoint_t> m_Translations;
+    std::map<std::string, LimbMeasurement> m_LimbMeasurements;
+
+    std::string m_CacheFileName;
+    std::ofstream m_CacheFile; ///< Opened (for appending) on the first store.
+
+    std::optional<std::string> GetTranslationKey(std::size_t idx, unsigned fftWidth, unsigned fftHeight, bool subpixelAlignment, bool normalizeFitsValues) const;
+
+    std::optional<std::string> GetLimbMeasurementKey(std::size_t idx, bool normalizeFitsValues) const;
+
+    void Load();
+
+    /// Replaces the cache file's contents with the currently stored entries.
+    void Rewrite();
+
+    void AppendEntry(const std::string& entry);
+};
+
+#endif // IMPPG_ALIGNMENT_CACHE_HEADER
@@ -239,6 +239,7 @@ bool DetermineTranslationVectors(
         unsigned Nwidth, ///< FFT width
         unsigned Nheight, ///< FFT height
         const AlignmentInputs& inputFiles,
+        const std::vector<Point_t>& imgSizes, ///< Sizes of images in 'inputFiles'
         /// Receives list of translation vectors between files in 'inputFiles'; each vector is a translation relative to the first image
         std::vector<FloatPoint_t>& translation,
         /// Receives the bounding box (within the Nwidth x Nheight working area) of all images after alignment
@@ -249,13 +250,14 @@ bool DetermineTranslationVectors(
         bool subpixelAlignment,
         std::function<void (int, float, float)> progressCallback, ///< Called after determining translation of an image; arguments: image index, trans. vector
         std::function<bool ()> checkAbort, ///< Called periodically to check if there was an "abort processing" request
-        bool normalizeFitsValues
+        bool normalizeFitsValues,
+        std::function<std::optional<FloatPoint_t> (std::size_t)> getKnownTranslation,
+        std::function<void (std::size_t, FloatPoint_t)> translationDetermined,
+        const c_CancellationToken* cancellation
 )
 {
     bool result = true;
 
-    int imgWidth, imgHeight; // Dimensions of the recently read image (before padding to Nwidth*Nheight)
-
     c_Image windowFunc = CalcWindowFunction(Nwidth, Nheight);
     // Window function smoothly varies from 0 at the array boundaries to 1 at the center and is used to
     // "blunt" the image, starting from the edges. Without it they would produce prominent
@@ -278,7 +280,7 @@ bool DetermineTranslationVectors(
 
     const auto loadFileByIndex = [&](const wxArrayString& fnames, std::size_t idx) -> std::optional<c_Image> {
         IMPPG_ASSERT(fnames.Count() > idx);
-        Log::Print(wxString::Format("Loading %s... ", fnames[idx]));
+        Log::PrintF("Loading %s... ", fnames[idx]);
         std::string localErrorMsg;
         const auto loadResult = LoadImageFileAsMono32f(
             fnames[idx].ToStdString(),
@@ -296,36 +298,47 @@ bool DetermineTranslationVectors(
         return loadResult;
     };
 
-    std::optional<ImageAccessor> src = std::visit(Overload{
-        [&](const wxArrayString& fnames) -> std::optional<ImageAccessor> {
-            auto loadResult = loadFileByIndex(fnames, 0);
-            if (!loadResult.has_value())
-            {
-                return std::nullopt;
-            }
-            else
-            {
-                return ImageAccessor{std::move(*loadResult)};
-            }
-        },
+    const auto getFileByIdx = [&](const AlignmentInputs& inputs, std::size_t idx) {
+        return std::visit(Overload{
+            [&](const wxArrayString& fnames) -> std::optional<ImageAccessor> {
+                auto loadResult = loadFileByIndex(fnames, idx);
+                if (!loadResult.has_value())
+                {
+                    return std::nullopt;
+                }
+                else
+                {
+                    return ImageAccessor{std::move(*loadResult)};
+                }
+            },
 
-        [](const InputImageList& images) -> std::optional<ImageAccessor> { return ImageAccessor{images.at(0).get()}; },
-    }, inputFiles);
+            [&](const InputImageList& images) -> std::optional<ImageAccessor> { return ImageAccessor{images[idx].get()}; }
+        }, inputs);
+    };
 
-    if (!src.has_value()) { return false; }
+    // Loads an image, pads it to Nwidth*Nheight, applies the window function and calculates the FFT
+    const auto calcPaddedImageFFT = [&](std::size_t idx, c_Image& paddedImg, std::complex<float>* fft) {
+        const auto src = getFileByIdx(inputFiles, idx);
+        if (!src.has_value()) { return false; }
 
-    imgWidth = src->Get()->GetWidth();
-    imgHeight = src->Get()->GetHeight();
+        c_Image::ResizeAndTranslate(src->Get()->GetBuffer(), paddedImg.GetBuffer(),
+                0, 0, src->Get()->GetWidth()-1, src->Get()->GetHeight()-1,
+                (Nwidth - src->Get()->GetWidth())/2, (Nheight - src->Get()->GetHeight())/2, true);
 
-    c_Image::ResizeAndTranslate(src->Get()->GetBuffer(), prevImg->GetBuffer(),
-            0, 0, src->Get()->GetWidth()-1, src->Get()->GetHeight()-1,
-            (Nwidth - src->Get()->GetWidth())/2, (Nheight - src->Get()->GetHeight())/2, true);
+        paddedImg.Multiply(windowFunc);
 
-    prevImg->Multiply(windowFunc);
+        Log::Print("Calculating FFT... ");
+        CalcFFT2D(paddedImg.GetRowAs<float>(0), paddedImg.GetHeight(), paddedImg.GetWidth(), paddedImg.GetBuffer().GetBytesPerRow(), fft, cancellation);
+        if (IsCancelled(cancellation))
+        {
+            // the FFT is incomplete; let the caller's abort check record the abort
+            checkAbort();
+            return false;
+        }
+        Log::Print("done.\n");
 
-    Log::Print("Calculating FFT... ");
-    CalcFFT2D(prevImg->GetRowAs<float>(0), prevImg->GetHeight(), prevImg->GetWidth(), prevImg->GetBuffer().GetBytesPerRow(), prevFFT.get());
-    Log::Print("done.");
+        return true;
+    };
 
     // Iterate over the remaining images and detect their translation
 
@@ -337,58 +350,52 @@ bool DetermineTranslationVectors(
     // starts at (Nwidth - imgWidth)/2, (Nheight - imgHeight)/2).
     //
     // Initially corresponds to dimensions and position of the first image.
-    bBox.x = (Nwidth - imgWidth)/2;
-    bBox.y = (Nheight - imgHeight)/2;
+    bBox.x = (Nwidth - imgSizes[0].x)/2;
+    bBox.y = (Nheight - imgSizes[0].y)/2;
 
-    int xmax = bBox.x + imgWidth - 1;
-    int ymax = bBox.y + imgHeight - 1;
+    int xmax = bBox.x + imgSizes[0].x - 1;
+    int ymax = bBox.y + imgSizes[0].y - 1;
 
     const std::size_t numImages = std::visit(Overload{
         [](const wxArrayString& fnames) { return fnames.Count(); },
         [](const InputImageList& images) { return images.size(); }
     }, inputFiles);
 
-    const auto getFileByIdx = [&](const AlignmentInputs& inputs, std::size_t idx) {
-        return std::visit(Overload{
-            [&](const wxArrayString& fnames) -> std::optional<ImageAccessor> {
-                auto loadResult = loadFileByIndex(fnames, idx);
-                if (!loadResult.has_value())
-                {
-                    return std::nullopt;
-                }
-                else
-                {
-                    return ImageAccessor{std::move(*loadResult)};
-                }
-            },
-
-            [&](const InputImageList& images) -> std::optional<ImageAccessor> { return ImageAccessor{images[idx].get()}; }
-        }, inputs);
-    };
+    // Index of the image whose FFT is currently in 'prevFFT'. Images with already known translations
+    // are not loaded at all, so it may lag behind.
+    std::optional<std::size_t> prevFFTIdx;
 
     for (std::size_t i = 1; i < numImages; ++i)
     {
-        const auto src = getFileByIdx(inputFiles, i);
-        if (!src.has_value()) { return false; }
-
-        imgWidth = src->Get()->GetWidth();
-        imgHeight = src->Get()->GetHeight();
+        std::optional<FloatPoint_t> T = getKnownTranslation ? getKnownTranslation(i) : std::nullopt;
+        if (T.has_value())
+        {
+            Log::PrintF("Using cached translation of image %zu.\n", i);
+        }
+        else
+        {
+            if (prevFFTIdx != i - 1)
+            {
+                if (!calcPaddedImageFFT(i - 1, *prevImg, prevFFT.get())) { return false; }
+            }
 
-        c_Image::ResizeAndTranslate(src->Get()->GetBuffer(), currImg->GetBuffer(),
-                0, 0, src->Get()->GetWidth()-1, src->Get()->GetHeight()-1,
-                (Nwidth - src->Get()->GetWidth())/2, (Nheight - src->Get()->GetHeight())/2, true);
+            // Calculate the current image's FFT
+            if (!calcPaddedImageFFT(i, *currImg, currFFT.get())) { return false; }
 
-        currImg->Multiply(windowFunc);
+            T = DetermineImageTranslation(Nwidth, Nheight, prevFFT.get(), currFFT.get(), subpixelAlignment);
+            if (translationDetermined) { translationDetermined(i, *T); }
 
-        // Calculate the current image's FFT
-        Log::Print("Calculating FFT... ");
-        CalcFFT2D(currImg->GetRowAs<float>(0), currImg->GetHeight(), currImg->GetWidth(), currImg->GetBuffer().GetBytesPerRow(), currFFT.get());
-        Log::Print("done.\n");
+            // Swap pointers for the next iteration
+            currImg.swap(prevImg);
+            prevFFT.swap(currFFT);
+            prevFFTIdx = i;
+        }
 
-        FloatPoint_t T = DetermineImageTranslation(Nwidth, Nheight, prevFFT.get(), currFFT.get(), subpixelAlignment);
+        const int imgWidth = imgSizes[i].x;
+        const int imgHeight = imgSizes[i].y;
 
         FloatPoint_t Tprev = translation.back();
-        translation.push_back(FloatPoint_t(Tprev.x + T.x, Tprev.y + T.y));
+        translation.push_back(FloatPoint_t(Tprev.x + T->x, Tprev.y + T->y));
 
         float intTx, intTy;
         std::modf(translation.back().x, &intTx);
@@ -403,10 +410,6 @@ bool DetermineTranslationVectors(
         if (newXmax > xmax) xmax = newXmax;
         if (newYmax > ymax) ymax = newYmax;
 
-        // Swap pointers for the next iteration
-        currImg.swap(prevImg);
-        prevFFT.swap(currFFT);
-
         progressCallback(i, translation.back().x, translation.back().y);
         if (checkAbort())
         {
@@ -26,6 +26,7 @@ File description:
 
 #include <functional>
 #include <memory>
+#include <optional>
 #include <vector>
 #include <wx/arrstr.h>
 #include <wx/string.h>
@@ -43,6 +44,7 @@ bool DetermineTranslationVectors(
         unsigned Nwidth, ///< FFT width
         unsigned Nheight, ///< FFT height
         const AlignmentInputs& inputFiles,
+        const std::vector<Point_t>& imgSizes, ///< Sizes of images in 'inputFiles'
         /// Receives list of translation vectors between files in 'inputFiles'; each vector is a translation relative to the first image
         std::vector<FloatPoint_t>& translation,
         /// Receives the bounding box (within the NxN working area) of all images after alignment
@@ -53,7 +55,14 @@ bool DetermineTranslationVectors(
         bool subpixelAlignment,
         std::function<void (int, float, float)> progressCallback, ///< Called after determining translation of an image; arguments: image index, trans. vector
         std::function<bool ()> checkAbort, ///< Called periodically to check if there was an "abort processing" request
-        bool normalizeFitsValues
+        bool normalizeFitsValues,
+        /// If set, returns the translation of n-th image relative to its predecessor, if it is already known
+        /// (then the images are not compared again).
+        std::function<std::optional<FloatPoint_t> (std::size_t)> getKnownTranslation = {},
+        /// If set, called after determining translation of n-th image relative to its predecessor.
+        std::function<void (std::size_t, FloatPoint_t)> translationDetermined = {},
+        /// If set, also checked while calculating each FFT, so that an abort request interrupts it.
+        const c_CancellationToken* cancellation = nullptr
 );
 
 /// Returns the set-theoretic intersection, i.e. the largest shared area, of specified images
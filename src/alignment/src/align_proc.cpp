@@ -22,22 +22,28 @@ File description:
 */
 
 #include <algorithm>
+#include <atomic>
 #include <boost/math/special_functions/round.hpp>
 #include <climits>
 #include <cmath>
+#include <functional>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
+#include <thread>
 #include <tuple>
 #include <vector>
 #include <wx/filename.h>
 
 #include "../../imppg_assert.h"
+#include "align_cache.h"
 #include "align_common.h"
 #include "align_disc.h"
 #include "align_phasecorr.h"
 #include "alignment/align_proc.h"
+#include "alignment/quality.h"
 #include "common/common.h"
 #include "image/image.h"
 #include "logging/logging.h"
@@ -54,7 +60,14 @@ File description:
 namespace
 {
 
-c_Image CreateTranslatedOutput(const c_Image& source, unsigned outWidth, unsigned outHeight, float tx, float ty)
+c_Image CreateTranslatedOutput(
+    const c_Image& source,
+    unsigned outWidth,
+    unsigned outHeight,
+    float tx,
+    float ty,
+    ShiftInterpolation interpolation
+)
 {
     std::optional<c_Image> converted;
     const auto* actualSource = &source;
@@ -74,7 +87,8 @@ c_Image CreateTranslatedOutput(const c_Image& source, unsigned outWidth, unsigne
         actualSource->GetWidth() - 1,
         actualSource->GetHeight() - 1,
         tx, ty,
-        true
+        true,
+        interpolation
     );
 
     return output;
@@ -108,6 +122,28 @@ std::size_t GetNumInputs(const AlignmentInputs& inputs)
     }, inputs);
 }
 
+/// Upper bound of the number of bytes per pixel of a loaded image (RGB, 32-bit floating-point).
+constexpr std::size_t MAX_BYTES_PER_PIXEL = 3 * sizeof(float);
+
+/// Returns the estimated memory needed to translate and save a single image (see `OutputTranslatedImages`).
+std::size_t EstimateTranslationMemory(
+    const std::vector<Point_t>& inputSizes,
+    bool inputsLoadedFromFiles,
+    int outputWidth,
+    int outputHeight
+)
+{
+    std::size_t maxInputPixels = 0;
+    if (inputsLoadedFromFiles)
+    {
+        for (const auto& size: inputSizes)
+        {
+            maxInputPixels = std::max(maxInputPixels, static_cast<std::size_t>(size.x) * size.y);
+        }
+    }
+    return MAX_BYTES_PER_PIXEL * (maxInputPixels + static_cast<std::size_t>(outputWidth) * outputHeight);
+}
+
 }
 
 /// Arguments: image index and its determined translation vector.
@@ -143,7 +179,11 @@ std::optional<std::tuple<c_Image, c_Image>> PrepareInputAndOutputImages(
     return std::make_tuple(std::move(srcImage), std::move(destImage));
 }
 
-bool c_ImageAlignmentWorkerThread::SaveTranslatedOutputImage(const wxString& inputFileName, const c_Image& image)
+bool c_ImageAlignmentWorkerThread::SaveTranslatedOutputImage(
+    const wxString& inputFileName,
+    const c_Image& image,
+    std::string& errorMsg
+) const
 {
     //-----------------------
 
@@ -169,10 +209,123 @@ bool c_ImageAlignmentWorkerThread::SaveTranslatedOutputImage(const wxString& inp
 
     if (!saved)
     {
-        m_ErrorMessage = wxString::Format(_("Failed to save output file: %s"), outputFileName.GetFullPath());
+        errorMsg = wxString::Format(_("Failed to save output file: %s"), outputFileName.GetFullPath());
+        return false;
+    }
+
+    return true;
+}
+
+bool c_ImageAlignmentWorkerThread::OutputTranslatedImages(
+    const std::function<std::optional<c_Image>(std::size_t, std::string&)>& getTranslatedImage,
+    std::size_t imageMemory
+)
+{
+    const std::size_t numInputs = m_Parameters.GetNumInputs();
+
+    if (m_Parameters.stacking.mode == StackingMode::NONE)
+    {
+        // Each thread translates and saves one image at a time, so at most `numThreads` images are kept in memory.
+        // Images may finish out of order; `EID_SAVED_OUTPUT_IMAGE` is sent for the longest completed prefix
+        // of the sequence.
+        const int numThreads = static_cast<int>(std::clamp<std::size_t>(
+            m_Parameters.outputMemoryLimit / std::max<std::size_t>(imageMemory, 1),
+            1,
+            std::max(1u, std::thread::hardware_concurrency())
+        ));
+        Log::Print(wxString::Format("Translating and saving %d image(s) concurrently.\n", numThreads));
+
+        std::vector<bool> imageSaved(numInputs, false);
+        std::size_t numReported = 0;
+        std::mutex progressMutex; // guards `imageSaved`, `numReported` and `m_ErrorMessage`
+        std::atomic<bool> failed{false};
+
+        #pragma omp parallel for schedule(dynamic) num_threads(numThreads)
+        for (int i = 0; i < static_cast<int>(numInputs); ++i)
+        {
+            // OpenMP does not allow leaving the loop early; skip the remaining images instead.
+            // `IsAbortRequested` may only be called from this (the worker) thread, so the other threads check
+            // the cancellation token (the abort is registered after the loop).
+            if (failed || m_Cancellation.IsCancellationRequested()) { continue; }
+
+            std::string errorMsg;
+            bool success = false;
+            if (const auto output = getTranslatedImage(static_cast<std::size_t>(i), errorMsg))
+            {
+                const auto* fnames = std::get_if<wxArrayString>(&m_Parameters.inputs);
+                success = !fnames || SaveTranslatedOutputImage((*fnames)[i], *output, errorMsg);
+            }
+
+            std::lock_guard lock{progressMutex};
+            if (!success)
+            {
+                if (!failed) { m_ErrorMessage = errorMsg; }
+                failed = true;
+                continue;
+            }
+
+            imageSaved[i] = true;
+            while (numReported < numInputs && imageSaved[numReported])
+            {
+                SendMessageToParent(EID_SAVED_OUTPUT_IMAGE, static_cast<int>(numReported));
+                ++numReported;
+            }
+        }
+
+        if (IsAbortRequested()) { return false; }
+
+        return !failed;
+    }
+
+    // The translated images are fed straight to the stacker, without intermediate files; each image is loaded
+    // and translated once (the stacker keeps what it needs for its subsequent passes).
+    c_ImageStacker stacker(m_Parameters.stacking, numInputs);
+    const auto checkStackerError = [&]() {
+        switch (stacker.GetError())
+        {
+        case c_ImageStacker::Error::FRAME_MISMATCH:
+            m_ErrorMessage = _("Images to stack differ in size or number of channels.");
+            break;
+
+        case c_ImageStacker::Error::TEMP_STORAGE:
+            m_ErrorMessage = _("Failed to store images in a temporary file for stacking.");
+            break;
+
+        default: break;
+        }
+    };
+
+    for (std::size_t i = 0; i < numInputs; ++i)
+    {
+        if (IsAbortRequested()) { return false; }
+
+        const auto output = getTranslatedImage(i, m_ErrorMessage);
+        if (!output) { return false; }
+
+        if (!stacker.AddFrame(*output))
+        {
+            checkStackerError();
+            return false;
+        }
+
+        SendMessageToParent(EID_STACKING_PROGRESS, stacker.GetPercentageComplete());
+    }
+
+    if (!stacker.Finish(
+        [&](int percentage) { SendMessageToParent(EID_STACKING_PROGRESS, percentage); },
+        [&]() { return IsAbortRequested(); }
+    ))
+    {
+        checkStackerError();
         return false;
     }
 
+    Log::Print(wxString::Format("Stacked %zu images in %zu pass(es).\n", numInputs, stacker.GetNumPasses()));
+
+    wxThreadEvent* event = new wxThreadEvent(wxEVT_THREAD, EID_STACKED);
+    event->SetPayload(std::make_shared<c_Image>(stacker.GetResult()));
+    m_Parent.QueueEvent(event);
+
     return true;
 }
 
@@ -236,17 +389,41 @@ void c_ImageAlignmentWorkerThread::PhaseCorrelationAlignment()
     std::vector<FloatPoint_t> translation;
     Rectangle_t bbox; // bounding box of all images after alignment
 
-    if (!DetermineTranslationVectors(Nwidth, Nheight, m_Parameters.inputs,
+    std::optional<c_AlignmentCache> cache;
+    if (const auto* fnames = std::get_if<wxArrayString>(&m_Parameters.inputs); fnames && m_Parameters.useCache)
+    {
+        cache.emplace(*fnames);
+    }
+
+    const bool subpixel = m_Parameters.subpixelAlignment;
+    const bool normalizeFits = m_Parameters.normalizeFitsValues;
+
+    std::function<std::optional<FloatPoint_t>(std::size_t)> getKnownTranslation;
+    std::function<void(std::size_t, FloatPoint_t)> translationDetermined;
+    if (cache.has_value())
+    {
+        getKnownTranslation = [&](std::size_t i) {
+            return cache->GetTranslation(i, Nwidth, Nheight, subpixel, normalizeFits);
+        };
+        translationDetermined = [&](std::size_t i, FloatPoint_t t) {
+            cache->StoreTranslation(i, Nwidth, Nheight, subpixel, normalizeFits, t);
+        };
+    }
+
+    if (!DetermineTranslationVectors(Nwidth, Nheight, m_Parameters.inputs, imgSize,
         translation, bbox, &m_ErrorMessage, m_Parameters.subpixelAlignment,
         [this](int imgIdx, float tX, float tY) { PhaseCorrImgTranslationCallback(imgIdx, tX, tY); },
         [this]() { return IsAbortRequested(); },
-        m_Parameters.normalizeFitsValues
+        m_Parameters.normalizeFitsValues,
+        getKnownTranslation,
+        translationDetermined,
+        &m_Cancellation
     ))
     {
         return;
     }
 
-    if (std::holds_alternative<InputImageList>(m_Parameters.inputs))
+    if (std::holds_alternative<InputImageList>(m_Parameters.inputs) && m_Parameters.stacking.mode == StackingMode::NONE)
     {
         wxThreadEvent* event = new wxThreadEvent(wxEVT_THREAD, EID_TRANSLATIONS);
         event->SetPayload(std::make_shared<std::vector<FloatPoint_t>>(std::move(translation)));
@@ -257,74 +434,40 @@ void c_ImageAlignmentWorkerThread::PhaseCorrelationAlignment()
 
     Rectangle_t imgIntersection = DetermineImageIntersection(Nwidth, Nheight, translation, imgSize);
 
-    // Iterate again over all images, load, pad to the bounding box size or crop to intersection, translate and save
+    // Iterate again over all images, load, pad to the bounding box size or crop to intersection, translate and save (or stack)
 
     int outputWidth = m_Parameters.cropMode == CropMode::CROP_TO_INTERSECTION ? imgIntersection.width : bbox.width;
     int outputHeight = m_Parameters.cropMode == CropMode::CROP_TO_INTERSECTION ? imgIntersection.height : bbox.height;
 
-    for (size_t i = 0; i < GetNumInputs(m_Parameters.inputs); i++)
+    Point_t translationOrigin;
+    if (m_Parameters.cropMode == CropMode::CROP_TO_INTERSECTION)
     {
-        if (IsAbortRequested())
-            return;
-
-        Point_t translationOrigin;
-        if (m_Parameters.cropMode == CropMode::CROP_TO_INTERSECTION)
-        {
-            translationOrigin.x = imgIntersection.x;
-            translationOrigin.y = imgIntersection.y;
-        }
-        else
-        {
-            translationOrigin.x = bbox.x;
-            translationOrigin.y = bbox.y;
-        }
+        translationOrigin.x = imgIntersection.x;
+        translationOrigin.y = imgIntersection.y;
+    }
+    else
+    {
+        translationOrigin.x = bbox.x;
+        translationOrigin.y = bbox.y;
+    }
 
-        const auto source = GetInputImageByIndex(m_Parameters.inputs, i, &m_ErrorMessage);
-        if (source.Empty()) { return; }
+    const bool result = OutputTranslatedImages([&](std::size_t i, std::string& errorMsg) -> std::optional<c_Image> {
+        const auto source = GetInputImageByIndex(m_Parameters.inputs, i, &errorMsg);
+        if (source.Empty()) { return std::nullopt; }
 
-        auto output = CreateTranslatedOutput(
+        return CreateTranslatedOutput(
             *source.Get(),
             outputWidth,
             outputHeight,
             (Nwidth - imgSize[i].x)/2 - translation[i].x - translationOrigin.x,
-            (Nheight - imgSize[i].y)/2 - translation[i].y - translationOrigin.y
+            (Nheight - imgSize[i].y)/2 - translation[i].y - translationOrigin.y,
+            m_Parameters.interpolation
         );
+    }, EstimateTranslationMemory(
+        imgSize, std::holds_alternative<wxArrayString>(m_Parameters.inputs), outputWidth, outputHeight
+    ));
 
-        if (const auto* fnames = std::get_if<wxArrayString>(&m_Parameters.inputs))
-        {
-            if (!SaveTranslatedOutputImage((*fnames)[i], output))
-            {
-                return;
-            }
-        }
-
-        SendMessageToParent(EID_SAVED_OUTPUT_IMAGE, i);
-    }
-
-    m_ProcessingCompleted = true;
-}
-
-/// Returns the quality of the specified image area: the sum of squared gradients
-float GetQuality(const c_Image& img, const Rectangle_t& area)
-{
-    IMPPG_ASSERT(img.GetPixelFormat() == PixelFormat::PIX_MONO32F);
-
-    float result = 0;
-
-    // Skip the border pixels in case there is a bright leftover from wavelet sharpening
-    const int BORDER_SKIP = 3;
-
-    for (int y = BORDER_SKIP; y < area.height - BORDER_SKIP - 1; y++)
-        for (int x = BORDER_SKIP; x < area.width - BORDER_SKIP - 1; x++)
-        {
-            float val00 = img.GetRowAs<float>(area.y + y)[area.x + x];
-            float val10 = img.GetRowAs<float>(area.y + y)[area.x + x+1];
-            float val01 = img.GetRowAs<float>(area.y + y+1)[area.x + x];
-
-            result += sqr(val10 - val00) + sqr(val01 - val00);
-        }
-
-    return result;
+    m_ProcessingCompleted = result;
 }
 
 c_Image GetBlurredImage(const c_Image& srcImg, float gaussianSigma)
@@ -624,7 +767,8 @@ bool c_ImageAlignmentWorkerThread::FindRadii(
     std::vector<std::vector<FloatPoint_t>>& limbPoints, ///< Receives limb points found in n-th image
     std::vector<float>& radii, ///< Receives disc radii determined for each image
     std::vector<Point_t>& imgSizes, ///< Receives input image sizes
-    std::vector<Point_t>& centroids ///< Receives image centroids
+    std::vector<Point_t>& centroids, ///< Receives image centroids
+    c_AlignmentCache* cache ///< If not null, used to skip already measured images
 )
 {
     AlignmentEventPayload_t payload;
@@ -634,6 +778,19 @@ bool c_ImageAlignmentWorkerThread::FindRadii(
         if (IsAbortRequested())
             return false;
 
+        if (auto cached = cache ? cache->GetLimbMeasurement(i, m_Parameters.normalizeFitsValues) : std::nullopt)
+        {
+            Log::PrintF("Using cached limb measurement of %s.\n", fnames[i]);
+            imgSizes.push_back(cached->imgSize);
+            centroids.push_back(cached->centroid);
+            radii.push_back(cached->radius);
+            limbPoints[i] = std::move(cached->limbPoints);
+
+            payload.radius = radii.back();
+            SendMessageToParent(EID_LIMB_FOUND_DISC_RADIUS, i, wxEmptyString, &payload);
+            continue;
+        }
+
         const auto loadResult = LoadImageFileAsMono8(
             fnames[i].ToStdString(),
             m_Parameters.normalizeFitsValues
@@ -743,10 +900,10 @@ bool c_ImageAlignmentWorkerThread::FindRadii(
                     limbPoints[i].erase(limbPoints[i].begin() + j);
         }
 
-        Log::Print(wxString::Format("Found %d limb point candidates, used %d (%d%%).\n",
+        Log::PrintF("Found %d limb point candidates, used %d (%d%%).\n",
             static_cast<int>(limbPointsCandidates.size()),
             static_cast<int>(limbPoints[i].size()),
-            static_cast<int>(100*limbPoints[i].size()/limbPointsCandidates.size()))
+            static_cast<int>(100*limbPoints[i].size()/limbPointsCandidates.size())
         );
 
         if (limbPoints[i].size() < 3)
@@ -766,6 +923,12 @@ bool c_ImageAlignmentWorkerThread::FindRadii(
         }
         radii.push_back(radius);
 
+        if (cache)
+        {
+            cache->StoreLimbMeasurement(
+                i, m_Parameters.normalizeFitsValues, LimbMeasurement{imgSizes.back(), centroid, radius, limbPoints[i]}
+            );
+        }
 
         payload.radius = radius;
         SendMessageToParent(EID_LIMB_FOUND_DISC_RADIUS, i, wxEmptyString, &payload);
@@ -791,7 +954,13 @@ void c_ImageAlignmentWorkerThread::LimbAlignment()
 
     // 1. Determine disc radius in each image
 
-    if (!FindRadii(*fnames, limbPoints, radii, imgSizes, centroids))
+    std::optional<c_AlignmentCache> cache;
+    if (m_Parameters.useCache)
+    {
+        cache.emplace(*fnames);
+    }
+
+    if (!FindRadii(*fnames, limbPoints, radii, imgSizes, centroids, cache.has_value() ? &cache.value() : nullptr))
         return;
 
     // 2. Calculate average radius and use it to fit discs to the limb points again
@@ -891,7 +1060,7 @@ void c_ImageAlignmentWorkerThread::LimbAlignment()
         SendMessageToParent(EID_LIMB_STABILIZATION_FAILURE, 0, stabilizationErrorMsg);
     }
 
-    // 5. Load images again, pad them to bounding box or crop to intersection and save
+    // 5. Load images again, pad them to bounding box or crop to intersection and save (or stack)
 
     int outputWidth, outputHeight;
     if (m_Parameters.cropMode == CropMode::PAD_TO_BOUNDING_BOX)
@@ -905,11 +1074,7 @@ void c_ImageAlignmentWorkerThread::LimbAlignment()
         outputHeight = intersection.ymax - intersection.ymin + 1;
     }
 
-    for (size_t i = 0; i < fnames->Count(); i++)
-    {
-        if (IsAbortRequested())
-            return;
-
+    const bool result = OutputTranslatedImages([&](std::size_t i, std::string& errorMsg) -> std::optional<c_Image> {
         float Tx, Ty;
         if (m_Parameters.cropMode == CropMode::PAD_TO_BOUNDING_BOX)
         {
@@ -928,20 +1093,13 @@ void c_ImageAlignmentWorkerThread::LimbAlignment()
             Ty = boost::math::round(Ty);
         }
 
-        auto loadResult = LoadImage((*fnames)[i].ToStdString(), std::nullopt, &m_ErrorMessage, false);
-        if (!loadResult) { return; }
-
-        const c_Image output = CreateTranslatedOutput(loadResult.value(), outputWidth, outputHeight, Tx, Ty);
-
-        if (!SaveTranslatedOutputImage((*fnames)[i], output))
-        {
-             return;
-        }
+        auto loadResult = LoadImage((*fnames)[i].ToStdString(), std::nullopt, &errorMsg, false);
+        if (!loadResult) { return std::nullopt; }
 
-        SendMessageToParent(EID_SAVED_OUTPUT_IMAGE, i);
-    }
+        return CreateTranslatedOutput(loadResult.value(), outputWidth, outputHeight, Tx, Ty, m_Parameters.interpolation);
+    }, EstimateTranslationMemory(imgSizes, true, outputWidth, outputHeight));
 
-    m_ProcessingCompleted = true;
+    m_ProcessingCompleted = result;
 }
 
 wxThread::ExitCode c_ImageAlignmentWorkerThread::Entry()
@@ -990,6 +1148,7 @@ void c_ImageAlignmentWorkerThread::SendMessageToParent(int id, int value, wxStri
 /// Signals the thread to finish processing ASAP
 void c_ImageAlignmentWorkerThread::AbortProcessing()
 {
+    m_Cancellation.Cancel();
     m_AbortReq.Post();
 }
 
@@ -998,6 +1157,7 @@ bool c_ImageAlignmentWorkerThread::IsAbortRequested()
     if (m_ThreadAborted)
         return true;
     else if (TestDestroy() ||
+        m_Cancellation.IsCancellationRequested() ||
         (wxSEMA_NO_ERROR == m_AbortReq.TryWait())) // Check if the parent has called Post() on the semaphore
     {
         m_ThreadAborted = true;
@@ -117,7 +117,9 @@ void CalcFFT2D(
     unsigned rows, ///< Number of rows, has to be a power of two
     unsigned cols, ///< Number of columns, has to be a power of two
     int stride,    ///< Number of bytes per row in 'input'
-    std::complex<float> output[] ///< Output array containing rows*cols elements
+    std::complex<float> output[], ///< Output array containing rows*cols elements
+    /// If set, checked before transforming each row and column; the output is incomplete if cancelled
+    const c_CancellationToken* cancellation
 )
 {
     unsigned maxDim = std::max(rows, cols);
@@ -136,6 +138,9 @@ void CalcFFT2D(
 
     #pragma omp parallel for
     for (unsigned k = 0; k < rows; k++)
+    {
+        if (IsCancelled(cancellation)) { continue; }
+
         fft1d<float>(
             reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(input) + k*stride),
             cols,
@@ -143,11 +148,18 @@ void CalcFFT2D(
             1 * sizeof(float),
             1 * sizeof(complex<float>), twiddleFactors.get() + quickLog2(cols)
         );
+    }
+
+    if (IsCancelled(cancellation)) { return; }
 
     // Calculate 1-dimensional transforms of all columns in 'fftrows' to get the final result
     #pragma omp parallel for
     for (unsigned k = 0; k < cols; k++)
+    {
+        if (IsCancelled(cancellation)) { continue; }
+
         fft1d<complex<float>>(fftrows.get() + k, rows, output + k, cols * sizeof(complex<float>), cols * sizeof(complex<float>), twiddleFactors.get() + quickLog2(rows));
+    }
 }
 
 /// Calculates 2-dimensional inverse discrete Fourier transform
@@ -25,6 +25,8 @@ File description:
 
 #include <complex>
 
+#include "math_utils/cancellation.h"
+
 /// Calculates 2-dimensional discrete Fourier transform
 /** Uses the row-column algorithm. */
 void CalcFFT2D(
@@ -32,7 +34,9 @@ void CalcFFT2D(
     unsigned rows, ///< Number of rows, has to be a power of two
     unsigned cols, ///< Number of columns, has to be a power of two
     int stride,    ///< Number of bytes per row in 'input'
-    std::complex<float> output[] ///< Output array containing rows*cols elements
+    std::complex<float> output[], ///< Output array containing rows*cols elements
+    /// If set, checked before transforming each row and column; the output is incomplete if cancelled
+    const c_CancellationToken* cancellation = nullptr
 );
 
 /// Calculates 2-dimensional inverse discrete Fourier transform
@@ -0,0 +1,253 @@
+/*
+ImPPG (Image Post-Processor) - common operations for astronomical stacks and other images
+Copyright (C) 2016-2022 Filip Szczerek <ga.software@yahoo.com>
+
+This file is part of ImPPG.
+
+ImPPG is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ImPPG is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with ImPPG.  If not, see <http://www.gnu.org/licenses/>.
+
+File description:
+    Image quality estimation implementation.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <vector>
+#include <wx/event.h>
+
+#include "../../imppg_assert.h"
+#include "alignment/quality.h"
+#include "common/scheduler.h"
+#include "logging/logging.h"
+#include "math_utils/math_utils.h"
+
+// private definitions
+namespace
+{
+
+/// Skip the border pixels in case there is a bright leftover from wavelet sharpening.
+constexpr int BORDER_SKIP = 3;
+
+double GetLaplacianVariance(const c_Image& img)
+{
+    const int width = static_cast<int>(img.GetWidth());
+    const int height = static_cast<int>(img.GetHeight());
+    if (width <= 2 * BORDER_SKIP + 2 || height <= 2 * BORDER_SKIP + 2) { return 0.0; }
+
+    // per-row sums added up in a fixed order, so that the result does not depend on the number of threads
+    const int firstRow = BORDER_SKIP + 1;
+    std::vector<double> rowSums(height - 2 * firstRow, 0.0);
+    std::vector<double> rowSumsSq(height - 2 * firstRow, 0.0);
+
+    #pragma omp parallel for
+    for (int y = firstRow; y < height - firstRow; ++y)
+    {
+        const float* rowPrev = img.GetRowAs<float>(y - 1);
+        const float* row = img.GetRowAs<float>(y);
+        const float* rowNext = img.GetRowAs<float>(y + 1);
+        double sum = 0.0;
+        double sumSq = 0.0;
+        for (int x = firstRow; x < width - firstRow; ++x)
+        {
+            const float laplacian = rowPrev[x] + rowNext[x] + row[x - 1] + row[x + 1] - 4 * row[x];
+            sum += laplacian;
+            sumSq += sqr(laplacian);
+        }
+        rowSums[y - firstRow] = sum;
+        rowSumsSq[y - firstRow] = sumSq;
+    }
+    const double sum = std::accumulate(rowSums.begin(), rowSums.end(), 0.0);
+    const double sumSq = std::accumulate(rowSumsSq.begin(), rowSumsSq.end(), 0.0);
+
+    const double numValues = static_cast<double>(width - 2 * BORDER_SKIP - 2) * (height - 2 * BORDER_SKIP - 2);
+    const double mean = sum / numValues;
+    return sumSq / numValues - mean * mean;
+}
+
+std::optional<c_Image> LoadInputAsMono32f(const AlignmentInputs& inputs, std::size_t index, bool normalizeFitsValues)
+{
+    return std::visit(Overload{
+        [&](const wxArrayString& fnames) {
+            return LoadImageFileAsMono32f(fnames[index].ToStdString(), normalizeFitsValues);
+        },
+
+        [&](const InputImageList& images) -> std::optional<c_Image> {
+            const c_Image& image = *images[index];
+            if (image.GetPixelFormat() == PixelFormat::PIX_MONO32F)
+            {
+                return image;
+            }
+            else
+            {
+                return image.ConvertPixelFormat(PixelFormat::PIX_MONO32F);
+            }
+        }
+    }, inputs);
+}
+
+std::size_t GetNumInputs(const AlignmentInputs& inputs)
+{
+    return std::visit(Overload{
+        [&](const wxArrayString& fnames) { return fnames.Count(); },
+        [&](const InputImageList& images) { return images.size(); }
+    }, inputs);
+}
+
+}
+
+/// Returns the quality of the specified area of a PIX_MONO32F image: the sum of squared gradients.
+float GetQuality(const c_Image& img, const Rectangle_t& area)
+{
+    IMPPG_ASSERT(img.GetPixelFormat() == PixelFormat::PIX_MONO32F);
+
+    const int numRows = std::max(0, area.height - 2 * BORDER_SKIP - 1);
+    // per-row sums added up in a fixed order, so that the result does not depend on the number of threads
+    std::vector<double> rowSums(numRows, 0.0);
+
+    #pragma omp parallel for
+    for (int y = BORDER_SKIP; y < area.height - BORDER_SKIP - 1; y++)
+    {
+        double rowSum = 0.0;
+        for (int x = BORDER_SKIP; x < area.width - BORDER_SKIP - 1; x++)
+        {
+            float val00 = img.GetRowAs<float>(area.y + y)[area.x + x];
+            float val10 = img.GetRowAs<float>(area.y + y)[area.x + x+1];
+            float val01 = img.GetRowAs<float>(area.y + y+1)[area.x + x];
+
+            rowSum += sqr(val10 - val00) + sqr(val01 - val00);
+        }
+        rowSums[y - BORDER_SKIP] = rowSum;
+    }
+
+    return static_cast<float>(std::accumulate(rowSums.begin(), rowSums.end(), 0.0));
+}
+
+float GetImageQuality(const c_Image& img, QualityMetric metric)
+{
+    IMPPG_ASSERT(img.GetPixelFormat() == PixelFormat::PIX_MONO32F);
+
+    switch (metric)
+    {
+    case QualityMetric::GRADIENT: {
+        const Rectangle_t area{0, 0, static_cast<int>(img.GetWidth()), static_cast<int>(img.GetHeight())};
+        // normalize to the number of pixels, so that the values do not depend on the image size
+        return GetQuality(img, area) / std::max(1u, img.GetNumPixels());
+    }
+
+    case QualityMetric::LAPLACIAN_VARIANCE:
+        return static_cast<float>(GetLaplacianVariance(img));
+
+    default: IMPPG_ABORT();
+    }
+}
+
+std::vector<std::size_t> SelectBestImages(const std::vector<float>& qualities, double fraction)
+{
+    IMPPG_ASSERT(fraction >= 0.0 && fraction <= 1.0);
+    if (qualities.empty()) { return {}; }
+
+    const std::size_t numSelected = std::clamp<std::size_t>(
+        static_cast<std::size_t>(std::ceil(fraction * qualities.size())), 1, qualities.size()
+    );
+
+    std::vector<std::size_t> indices(qualities.size());
+    std::iota(indices.begin(), indices.end(), 0);
+    std::nth_element(
+        indices.begin(), indices.begin() + (numSelected - 1), indices.end(),
+        [&](std::size_t i1, std::size_t i2) { return qualities[i1] > qualities[i2]; }
+    );
+    indices.resize(numSelected);
+    // keep the sequence order
+    std::sort(indices.begin(), indices.end());
+
+    return indices;
+}
+
+c_QualityEstimationWorkerThread::c_QualityEstimationWorkerThread(
+    wxEvtHandler& parent,
+    AlignmentInputs inputs,
+    QualityMetric metric,
+    bool normalizeFitsValues
+)
+: wxThread(wxTHREAD_JOINABLE),
+  m_Parent(parent),
+  m_Inputs(std::move(inputs)),
+  m_Metric(metric),
+  m_NormalizeFitsValues(normalizeFitsValues)
+{}
+
+wxThread::ExitCode c_QualityEstimationWorkerThread::Entry()
+{
+    const std::size_t numInputs = GetNumInputs(m_Inputs);
+    auto qualities = std::make_shared<std::vector<float>>(numInputs, 0.0f);
+
+    // Images are loaded in batches (file loading is sequential) and the images of each batch are scored
+    // in parallel by the task scheduler; this keeps at most one image per thread in memory.
+    const std::size_t batchSize = c_TaskScheduler::Get().GetNumThreads();
+    std::vector<std::optional<c_Image>> batch;
+
+    for (std::size_t batchStart = 0; batchStart < numInputs; batchStart += batchSize)
+    {
+        if (IsAbortRequested())
+        {
+            auto* event = new wxThreadEvent(wxEVT_THREAD, EID_QUALITY_ABORTED);
+            event->SetString(_("Aborted per user request."));
+            m_Parent.QueueEvent(event);
+            return 0;
+        }
+
+        const std::size_t batchEnd = std::min(batchStart + batchSize, numInputs);
+        batch.clear();
+        for (std::size_t i = batchStart; i < batchEnd; ++i)
+        {
+            batch.emplace_back(LoadInputAsMono32f(m_Inputs, i, m_NormalizeFitsValues));
+            if (!batch.back().has_value())
+            {
+                auto* event = new wxThreadEvent(wxEVT_THREAD, EID_QUALITY_ABORTED);
+                event->SetString(wxString::Format(_("Could not read %s."), std::get<wxArrayString>(m_Inputs)[i]));
+                m_Parent.QueueEvent(event);
+                return 0;
+            }
+        }
+
+        c_TaskScheduler::Get().ParallelFor(0, static_cast<int>(batch.size()), [&](int i) {
+            (*qualities)[batchStart + i] = GetImageQuality(batch[i].value(), m_Metric);
+        });
+
+        auto* event = new wxThreadEvent(wxEVT_THREAD, EID_QUALITY_IMAGE_DONE);
+        event->SetInt(static_cast<int>(batchEnd));
+        m_Parent.QueueEvent(event);
+    }
+
+    Log::Print(wxString::Format("Determined quality of %zu images.\n", numInputs));
+
+    auto* event = new wxThreadEvent(wxEVT_THREAD, EID_QUALITY_COMPLETED);
+    event->SetPayload(qualities);
+    m_Parent.QueueEvent(event);
+
+    return 0;
+}
+
+void c_QualityEstimationWorkerThread::AbortProcessing()
+{
+    m_AbortReq.Post();
+}
+
+bool c_QualityEstimationWorkerThread::IsAbortRequested()
+{
+    return TestDestroy() || wxSEMA_NO_ERROR == m_AbortReq.TryWait();
+}
@@ -0,0 +1,521 @@
+/*
+ImPPG (Image Post-Processor) - common operations for astronomical stacks and other images
+Copyright (C) 2016-2022 Filip Szczerek <ga.software@yahoo.com>
+
+This file is part of ImPPG.
+
+ImPPG is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ImPPG is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with ImPPG.  If not, see <http://www.gnu.org/licenses/>.
+
+File description:
+    Image stacking implementation.
+*/
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <system_error>
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#include <share.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "../../imppg_assert.h"
+#include "alignment/stacking.h"
+
+namespace fs = std::filesystem;
+
+// private definitions
+namespace
+{
+
+PixelFormat GetStackPixelFormat(PixelFormat framePixFmt)
+{
+    return IsMono(framePixFmt) ? PixelFormat::PIX_MONO32F : PixelFormat::PIX_RGB32F;
+}
+
+/// Maximum number of random file names tried by `CreateUniqueTempFile`.
+constexpr int MAX_TEMP_FILE_ATTEMPTS = 100;
+
+/// Creates a new empty file in `dir`, accessible only to the current user, and returns its path.
+/** The file is created exclusively, i.e., an existing file (or a symbolic link) of the same name is never
+    opened, so neither another ImPPG process nor a planted file can be clobbered; a random name is tried again
+    if it is already taken. Returns an empty path on failure. */
+fs::path CreateUniqueTempFile(const fs::path& dir)
+{
+    std::mt19937_64 rng(
+        std::random_device{}() ^ static_cast<std::uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count())
+    );
+
+    for (int attempt = 0; attempt < MAX_TEMP_FILE_ATTEMPTS; ++attempt)
+    {
+        std::ostringstream name;
+        name << "imppg-stacking-" << std::hex << rng() << ".tmp";
+        const fs::path path = dir / name.str();
+
+#if defined(_WIN32)
+        int fd = -1;
+        _wsopen_s(&fd, path.c_str(), _O_CREAT | _O_EXCL | _O_RDWR | _O_BINARY, _SH_DENYNO, _S_IREAD | _S_IWRITE);
+        if (fd >= 0)
+        {
+            _close(fd);
+            return path;
+        }
+#else
+        const int fd = open(path.c_str(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, S_IRUSR | S_IWUSR);
+        if (fd >= 0)
+        {
+            close(fd);
+            return path;
+        }
+#endif
+        if (errno != EEXIST) { break; }
+    }
+
+    return {};
+}
+
+}
+
+/// Stores floating-point frames in memory or (if they do not fit in the memory limit) in a temporary file.
+class c_ImageStacker::c_FrameStore
+{
+public:
+    c_FrameStore(std::size_t valuesPerFrame, std::size_t numFrames, std::size_t memoryLimit)
+    : m_ValuesPerFrame(valuesPerFrame)
+    {
+        if (valuesPerFrame * numFrames * sizeof(float) <= memoryLimit)
+        {
+            m_Memory.resize(valuesPerFrame * numFrames);
+        }
+        else
+        {
+            std::error_code ec;
+            const fs::path tempDir = fs::temp_directory_path(ec);
+            if (ec) { return; }
+
+            // if not created, `IsValid` returns false, which is reported as `Error::TEMP_STORAGE`
+            m_FileName = CreateUniqueTempFile(tempDir);
+            if (m_FileName.empty()) { return; }
+
+            // the file has just been created (empty) by us; the temporary directory is expected to prevent
+            // other users from replacing it
+            m_File.open(m_FileName, std::ios::in | std::ios::out | std::ios::binary);
+        }
+    }
+
+    c_FrameStore(const c_FrameStore&) = delete;
+    c_FrameStore& operator=(const c_FrameStore&) = delete;
+
+    ~c_FrameStore()
+    {
+        if (!m_FileName.empty())
+        {
+            m_File.close();
+            std::error_code ec;
+            fs::remove(m_FileName, ec);
+        }
+    }
+
+    bool IsValid() const { return m_FileName.empty() ? !m_Memory.empty() : m_File.is_open(); }
+
+    /// Stores `numValues` values of frame `frameIdx`, starting at value `offset` of the frame.
+    bool Write(std::size_t frameIdx, std::size_t offset, const float* values, std::size_t numValues)
+    {
+        const std::size_t position = frameIdx * m_ValuesPerFrame + offset;
+        if (m_FileName.empty())
+        {
+            std::copy(values, values + numValues, m_Memory.begin() + position);
+            return true;
+        }
+
+        // frames are written sequentially; avoid seeking, which would flush the stream's buffer each time
+        if (position != m_WritePosition)
+        {
+            m_File.seekp(static_cast<std::streamoff>(position * sizeof(float)));
+        }
+        m_File.write(reinterpret_cast<const char*>(values), static_cast<std::streamsize>(numValues * sizeof(float)));
+        m_WritePosition = position + numValues;
+        return static_cast<bool>(m_File);
+    }
+
+    /// Reads `numValues` values of frame `frameIdx`, starting at value `offset` of the frame.
+    bool Read(std::size_t frameIdx, std::size_t offset, float* values, std::size_t numValues)
+    {
+        const std::size_t position = frameIdx * m_ValuesPerFrame + offset;
+        if (m_FileName.empty())
+        {
+            std::copy(m_Memory.begin() + position, m_Memory.begin() + position + numValues, values);
+            return true;
+        }
+
+        m_File.seekg(static_cast<std::streamoff>(position * sizeof(float)));
+        m_File.read(reinterpret_cast<char*>(values), static_cast<std::streamsize>(numValues * sizeof(float)));
+        m_WritePosition = static_cast<std::size_t>(-1);
+        return static_cast<bool>(m_File);
+    }
+
+private:
+    std::size_t m_ValuesPerFrame;
+    std::vector<float> m_Memory;
+    fs::path m_FileName;
+    std::fstream m_File;
+    std::size_t m_WritePosition{0}; ///< Position (in values) following the last write.
+};
+
+c_ImageStacker::c_ImageStacker(StackingParameters params, std::size_t numFrames)
+: m_Params(params), m_NumFrames(numFrames)
+{
+    IMPPG_ASSERT(m_Params.mode != StackingMode::NONE && m_Params.mode != StackingMode::NUM);
+    IMPPG_ASSERT(numFrames > 0);
+}
+
+c_ImageStacker::~c_ImageStacker() = default;
+
+void c_ImageStacker::Initialize(const c_Image& firstFrame)
+{
+    m_Width = firstFrame.GetWidth();
+    m_Height = firstFrame.GetHeight();
+    m_PixelFormat = GetStackPixelFormat(firstFrame.GetPixelFormat());
+    m_ValuesPerRow = m_Width * NumChannels[static_cast<std::size_t>(m_PixelFormat)];
+
+    const std::size_t numValues = m_ValuesPerRow * m_Height;
+
+    switch (m_Params.mode)
+    {
+    case StackingMode::MEAN:
+        m_Sum.assign(numValues, 0.0);
+        m_NumPasses = 1;
+        break;
+
+    case StackingMode::SIGMA_CLIPPED_MEAN:
+        m_Sum.assign(numValues, 0.0);
+        m_Aux.assign(numValues, 0.0);
+        m_NumPasses = 2;
+        break;
+
+    case StackingMode::MEDIAN: {
+        const std::size_t bytesPerRow = m_NumFrames * m_ValuesPerRow * sizeof(float);
+        m_BandHeight = static_cast<unsigned>(std::clamp<std::size_t>(m_Params.memoryLimit / bytesPerRow, 1, m_Height));
+        m_BandValues.resize(m_BandHeight * m_ValuesPerRow * m_NumFrames);
+        m_NumPasses = (m_Height + m_BandHeight - 1) / m_BandHeight;
+        } break;
+
+    default: IMPPG_ABORT();
+    }
+
+    if (m_NumPasses > 1)
+    {
+        m_FrameStore = std::make_unique<c_FrameStore>(numValues, m_NumFrames, m_Params.memoryLimit);
+    }
+
+    m_Result = c_Image(m_Width, m_Height, m_PixelFormat);
+}
+
+bool c_ImageStacker::AddFrame(const c_Image& frame)
+{
+    // all frames are added in the 1st pass, the subsequent ones are performed by `Finish`
+    IMPPG_ASSERT(m_Pass == 0 && !m_Complete);
+
+    if (m_FrameIdx == 0)
+    {
+        Initialize(frame);
+        if (m_FrameStore && !m_FrameStore->IsValid())
+        {
+            m_Error = Error::TEMP_STORAGE;
+            return false;
+        }
+    }
+    else if (frame.GetWidth() != m_Width ||
+             frame.GetHeight() != m_Height ||
+             GetStackPixelFormat(frame.GetPixelFormat()) != m_PixelFormat)
+    {
+        m_Error = Error::FRAME_MISMATCH;
+        return false;
+    }
+
+    std::optional<c_Image> converted;
+    if (frame.GetPixelFormat() != m_PixelFormat)
+    {
+        converted = frame.ConvertPixelFormat(m_PixelFormat);
+    }
+    const c_Image& src = converted.has_value() ? converted.value() : frame;
+
+    if (m_FrameStore)
+    {
+        for (unsigned y = 0; y < m_Height; ++y)
+        {
+            if (!m_FrameStore->Write(m_FrameIdx, y * m_ValuesPerRow, src.GetRowAs<float>(y), m_ValuesPerRow))
+            {
+                m_Error = Error::TEMP_STORAGE;
+                return false;
+            }
+        }
+    }
+
+    AccumulateFrame([&src](unsigned y) { return src.GetRowAs<float>(y); });
+    NextFrame();
+
+    return true;
+}
+
+bool c_ImageStacker::Finish(const std::function<void(int)>& progress, const std::function<bool()>& checkAbort)
+{
+    IMPPG_ASSERT(m_Pass > 0 || m_Complete);
+
+    std::vector<float> rows;
+    while (!m_Complete)
+    {
+        // median needs only the current band of each frame
+        const bool isMedian = (m_Params.mode == StackingMode::MEDIAN);
+        const unsigned firstRow = isMedian ? static_cast<unsigned>(m_Pass) * m_BandHeight : 0;
+        const unsigned numRows = isMedian ? std::min(m_BandHeight, m_Height - firstRow) : m_Height;
+        rows.resize(numRows * m_ValuesPerRow);
+
+        for (std::size_t i = 0; i < m_NumFrames; ++i)
+        {
+            if (checkAbort()) { return false; }
+
+            if (!m_FrameStore->Read(m_FrameIdx, firstRow * m_ValuesPerRow, rows.data(), rows.size()))
+            {
+                m_Error = Error::TEMP_STORAGE;
+                return false;
+            }
+            AccumulateFrame([&](unsigned y) { return rows.data() + (y - firstRow) * m_ValuesPerRow; });
+            NextFrame();
+
+            progress(GetPercentageComplete());
+        }
+    }
+    m_FrameStore.reset();
+
+    return true;
+}
+
+int c_ImageStacker::GetPercentageComplete() const
+{
+    return static_cast<int>(100 * (m_Pass * m_NumFrames + m_FrameIdx) / (m_NumPasses * m_NumFrames));
+}
+
+void c_ImageStacker::NextFrame()
+{
+    m_FrameIdx += 1;
+    if (m_FrameIdx == m_NumFrames)
+    {
+        FinishPass();
+        m_FrameIdx = 0;
+        m_Pass += 1;
+        m_Complete = (m_Pass == m_NumPasses);
+    }
+}
+
+void c_ImageStacker::AccumulateFrame(const RowGetter& getRow)
+{
+    const std::size_t valuesPerRow = m_ValuesPerRow;
+
+    switch (m_Params.mode)
+    {
+    case StackingMode::MEAN:
+        #pragma omp parallel for
+        for (int y = 0; y < static_cast<int>(m_Height); ++y)
+        {
+            const float* src = getRow(y);
+            double* sum = m_Sum.data() + y * valuesPerRow;
+            for (std::size_t i = 0; i < valuesPerRow; ++i)
+            {
+                sum[i] += src[i];
+            }
+        }
+        break;
+
+    case StackingMode::SIGMA_CLIPPED_MEAN:
+        if (m_Pass == 0)
+        {
+            #pragma omp parallel for
+            for (int y = 0; y < static_cast<int>(m_Height); ++y)
+            {
+                const float* src = getRow(y);
+                double* sum = m_Sum.data() + y * valuesPerRow;
+                double* sumSq = m_Aux.data() + y * valuesPerRow;
+                for (std::size_t i = 0; i < valuesPerRow; ++i)
+                {
+                    sum[i] += src[i];
+                    sumSq[i] += static_cast<double>(src[i]) * src[i];
+                }
+            }
+        }
+        else
+        {
+            const float kappa = m_Params.sigmaClippingKappa;
+
+            #pragma omp parallel for
+            for (int y = 0; y < static_cast<int>(m_Height); ++y)
+            {
+                const float* src = getRow(y);
+                const float* mean = m_Mean.data() + y * valuesPerRow;
+                const float* stdDev = m_StdDev.data() + y * valuesPerRow;
+                double* sum = m_Sum.data() + y * valuesPerRow;
+                double* count = m_Aux.data() + y * valuesPerRow;
+                for (std::size_t i = 0; i < valuesPerRow; ++i)
+                {
+                    const bool accepted = std::abs(src[i] - mean[i]) <= kappa * stdDev[i];
+                    sum[i] += accepted ? src[i] : 0.0f;
+                    count[i] += accepted ? 1.0 : 0.0;
+                }
+            }
+        }
+        break;
+
+    case StackingMode::MEDIAN: {
+        const unsigned bandStart = m_Pass * m_BandHeight;
+        const unsigned bandHeight = std::min(m_BandHeight, m_Height - bandStart);
+        const std::size_t numFrames = m_NumFrames;
+        const std::size_t frameIdx = m_FrameIdx;
+
+        #pragma omp parallel for
+        for (int y = 0; y < static_cast<int>(bandHeight); ++y)
+        {
+            const float* src = getRow(bandStart + y);
+            float* dest = m_BandValues.data() + y * valuesPerRow * numFrames + frameIdx;
+            for (std::size_t i = 0; i < valuesPerRow; ++i)
+            {
+                dest[i * numFrames] = src[i];
+            }
+        }
+        } break;
+
+    default: IMPPG_ABORT();
+    }
+}
+
+void c_ImageStacker::FinishPass()
+{
+    const std::size_t valuesPerRow = m_ValuesPerRow;
+    c_Image& result = m_Result.value();
+
+    switch (m_Params.mode)
+    {
+    case StackingMode::MEAN: {
+        const double numFrames = static_cast<double>(m_NumFrames);
+
+        #pragma omp parallel for
+        for (int y = 0; y < static_cast<int>(m_Height); ++y)
+        {
+            const double* sum = m_Sum.data() + y * valuesPerRow;
+            float* dest = result.GetRowAs<float>(y);
+            for (std::size_t i = 0; i < valuesPerRow; ++i)
+            {
+                dest[i] = static_cast<float>(sum[i] / numFrames);
+            }
+        }
+        m_Sum = {};
+        } break;
+
+    case StackingMode::SIGMA_CLIPPED_MEAN:
+        if (m_Pass == 0)
+        {
+            const double numFrames = static_cast<double>(m_NumFrames);
+            m_Mean.resize(m_Sum.size());
+            m_StdDev.resize(m_Sum.size());
+
+            #pragma omp parallel for
+            for (int y = 0; y < static_cast<int>(m_Height); ++y)
+            {
+                const std::size_t ofs = y * valuesPerRow;
+                for (std::size_t i = ofs; i < ofs + valuesPerRow; ++i)
+                {
+                    const double mean = m_Sum[i] / numFrames;
+                    const double variance = std::max(0.0, m_Aux[i] / numFrames - mean * mean);
+                    m_Mean[i] = static_cast<float>(mean);
+                    m_StdDev[i] = static_cast<float>(std::sqrt(variance));
+                    m_Sum[i] = 0.0;
+                    m_Aux[i] = 0.0;
+                }
+            }
+        }
+        else
+        {
+            #pragma omp parallel for
+            for (int y = 0; y < static_cast<int>(m_Height); ++y)
+            {
+                const std::size_t ofs = y * valuesPerRow;
+                float* dest = result.GetRowAs<float>(y);
+                for (std::size_t i = 0; i < valuesPerRow; ++i)
+                {
+                    const double count = m_Aux[ofs + i];
+                    // if all values have been rejected (possible for a small kappa), fall back to the plain mean
+                    dest[i] = count > 0.0 ? static_cast<float>(m_Sum[ofs + i] / count) : m_Mean[ofs + i];
+                }
+            }
+            m_Sum = {};
+            m_Aux = {};
+            m_Mean = {};
+            m_StdDev = {};
+        }
+        break;
+
+    case StackingMode::MEDIAN:
+        FinishMedianBand();
+        if (m_Pass + 1 == m_NumPasses)
+        {
+            m_BandValues = {};
+        }
+        break;
+
+    default: IMPPG_ABORT();
+    }
+}
+
+void c_ImageStacker::FinishMedianBand()
+{
+    const unsigned bandStart = m_Pass * m_BandHeight;
+    const unsigned bandHeight = std::min(m_BandHeight, m_Height - bandStart);
+    const std::size_t numFrames = m_NumFrames;
+    const std::size_t middle = numFrames / 2;
+    const std::size_t valuesPerRow = m_ValuesPerRow;
+    c_Image& result = m_Result.value();
+
+    #pragma omp parallel for
+    for (int y = 0; y < static_cast<int>(bandHeight); ++y)
+    {
+        float* dest = result.GetRowAs<float>(bandStart + y);
+        for (std::size_t i = 0; i < valuesPerRow; ++i)
+        {
+            float* values = m_BandValues.data() + (y * valuesPerRow + i) * numFrames;
+            std::nth_element(values, values + middle, values + numFrames);
+            if (numFrames % 2 == 1)
+            {
+                dest[i] = values[middle];
+            }
+            else
+            {
+                // the lower middle value is the largest one in the first half
+                const float lowerMiddle = *std::max_element(values, values + middle);
+                dest[i] = 0.5f * (lowerMiddle + values[middle]);
+            }
+        }
+    }
+}
@@ -0,0 +1,200 @@
+#include "align_cache.h"
+
+#include <boost/test/unit_test.hpp>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+constexpr const char* CACHE_FILE_NAME = ".imppg-alignment-cache";
+
+constexpr unsigned FFT_WIDTH = 256;
+constexpr unsigned FFT_HEIGHT = 128;
+
+/// Creates a folder with `numFiles` input files (their contents are irrelevant to the cache) and removes it afterwards.
+class c_InputFolder
+{
+public:
+    explicit c_InputFolder(std::size_t numFiles)
+    : m_Dir(fs::temp_directory_path() / ("imppg_align_cache_tests_" + std::to_string(std::random_device{}())))
+    {
+        fs::create_directories(m_Dir);
+        for (std::size_t i = 0; i < numFiles; ++i)
+        {
+            const fs::path path = m_Dir / ("input_" + std::to_string(i) + ".tif");
+            std::ofstream(path) << "image " << i;
+            m_Files.Add(path.string());
+        }
+    }
+
+    ~c_InputFolder()
+    {
+        std::error_code ec;
+        fs::remove_all(m_Dir, ec);
+    }
+
+    const wxArrayString& GetFiles() const { return m_Files; }
+
+    fs::path GetCacheFile() const { return m_Dir / CACHE_FILE_NAME; }
+
+    std::vector<std::string> ReadCacheLines() const
+    {
+        std::vector<std::string> lines;
+        std::ifstream file(GetCacheFile());
+        std::string line;
+        while (std::getline(file, line)) { lines.push_back(line); }
+        return lines;
+    }
+
+    /// Changes the file's size (and thus its key).
+    void ModifyFile(std::size_t idx) const
+    {
+        std::ofstream(m_Files[idx].ToStdString(), std::ios::app) << " modified";
+    }
+
+private:
+    fs::path m_Dir;
+    wxArrayString m_Files;
+};
+
+LimbMeasurement CreateLimbMeasurement()
+{
+    LimbMeasurement measurement;
+    measurement.imgSize = Point_t(640, 480);
+    measurement.centroid = Point_t(320, 241);
+    measurement.radius = 200.125f;
+    measurement.limbPoints = { FloatPoint_t(120.5f, 240.25f), FloatPoint_t(520.75f, 239.0f), FloatPoint_t(0.1f, 1.0e-3f) };
+    return measurement;
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(MeasurementsSurviveReload)
+{
+    const c_InputFolder folder(3);
+    const auto limbMeasurement = CreateLimbMeasurement();
+    {
+        c_AlignmentCache cache(folder.GetFiles());
+        BOOST_CHECK(!cache.GetTranslation(1, FFT_WIDTH, FFT_HEIGHT, true, false).has_value());
+        cache.StoreTranslation(1, FFT_WIDTH, FFT_HEIGHT, true, false, FloatPoint_t(1.5f, -2.0625f));
+        cache.StoreTranslation(2, FFT_WIDTH, FFT_HEIGHT, true, false, FloatPoint_t(0.1f, 1.0e-7f));
+        cache.StoreLimbMeasurement(0, true, limbMeasurement);
+    }
+
+    const c_AlignmentCache cache(folder.GetFiles());
+
+    const auto t1 = cache.GetTranslation(1, FFT_WIDTH, FFT_HEIGHT, true, false);
+    BOOST_REQUIRE(t1.has_value());
+    BOOST_CHECK_EQUAL(1.5f, t1->x);
+    BOOST_CHECK_EQUAL(-2.0625f, t1->y);
+
+    const auto t2 = cache.GetTranslation(2, FFT_WIDTH, FFT_HEIGHT, true, false);
+    BOOST_REQUIRE(t2.has_value());
+    BOOST_CHECK_EQUAL(0.1f, t2->x);
+    BOOST_CHECK_EQUAL(1.0e-7f, t2->y);
+
+    // the parameters are a part of the key
+    BOOST_CHECK(!cache.GetTranslation(1, FFT_WIDTH, FFT_HEIGHT, false, false).has_value());
+    BOOST_CHECK(!cache.GetTranslation(1, FFT_WIDTH, 2 * FFT_HEIGHT, true, false).has_value());
+    BOOST_CHECK(!cache.GetLimbMeasurement(0, false).has_value());
+
+    const auto limb = cache.GetLimbMeasurement(0, true);
+    BOOST_REQUIRE(limb.has_value());
+    BOOST_CHECK(limb->imgSize == limbMeasurement.imgSize);
+    BOOST_CHECK(limb->centroid == limbMeasurement.centroid);
+    BOOST_CHECK_EQUAL(limbMeasurement.radius, limb->radius);
+    BOOST_REQUIRE_EQUAL(limbMeasurement.limbPoints.size(), limb->limbPoints.size());
+    for (std::size_t i = 0; i < limb->limbPoints.size(); ++i)
+    {
+        BOOST_CHECK_EQUAL(limbMeasurement.limbPoints[i].x, limb->limbPoints[i].x);
+        BOOST_CHECK_EQUAL(limbMeasurement.limbPoints[i].y, limb->limbPoints[i].y);
+    }
+
+    // nothing to discard, so the file is not rewritten
+    BOOST_CHECK_EQUAL(3, folder.ReadCacheLines().size());
+}
+
+BOOST_AUTO_TEST_CASE(MalformedEntriesAreSkippedAndRemoved)
+{
+    const c_InputFolder folder(2);
+    {
+        c_AlignmentCache cache(folder.GetFiles());
+        cache.StoreTranslation(1, FFT_WIDTH, FFT_HEIGHT, true, false, FloatPoint_t(3.0f, 4.0f));
+        cache.StoreLimbMeasurement(1, false, CreateLimbMeasurement());
+    }
+    const auto validLines = folder.ReadCacheLines();
+    BOOST_REQUIRE_EQUAL(2, validLines.size());
+    {
+        std::ofstream file(folder.GetCacheFile(), std::ios::app);
+        file << "\n";
+        file << "garbage\n";
+        file << "X\t1\t2\n";
+        // not a number
+        file << validLines[0].substr(0, validLines[0].rfind('\t')) << "\tabc\n";
+        // number of limb points inconsistent with the values
+        file << validLines[1] << "\t1.0\n";
+        // truncated (as if the previous run crashed while writing it)
+        file << validLines[1].substr(0, validLines[1].size() / 2);
+    }
+
+    {
+        const c_AlignmentCache cache(folder.GetFiles());
+
+        const auto translation = cache.GetTranslation(1, FFT_WIDTH, FFT_HEIGHT, true, false);
+        BOOST_REQUIRE(translation.has_value());
+        BOOST_CHECK_EQUAL(3.0f, translation->x);
+        BOOST_CHECK_EQUAL(4.0f, translation->y);
+        BOOST_CHECK(cache.GetLimbMeasurement(1, false).has_value());
+    }
+
+    const auto lines = folder.ReadCacheLines();
+    BOOST_CHECK_EQUAL(2, lines.size());
+    for (const auto& line: lines)
+    {
+        BOOST_CHECK(line == validLines[0] || line == validLines[1]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(StaleEntriesAreIgnoredAndRemoved)
+{
+    const c_InputFolder folder(3);
+    {
+        c_AlignmentCache cache(folder.GetFiles());
+        cache.StoreTranslation(1, FFT_WIDTH, FFT_HEIGHT, true, false, FloatPoint_t(1.0f, 1.0f));
+        cache.StoreTranslation(2, FFT_WIDTH, FFT_HEIGHT, true, false, FloatPoint_t(2.0f, 2.0f));
+        cache.StoreLimbMeasurement(0, false, CreateLimbMeasurement());
+        cache.StoreLimbMeasurement(2, false, CreateLimbMeasurement());
+        // overwritten; the file has a duplicate entry until compacted
+        cache.StoreTranslation(1, FFT_WIDTH, FFT_HEIGHT, true, false, FloatPoint_t(5.0f, 5.0f));
+    }
+    BOOST_REQUIRE_EQUAL(5, folder.ReadCacheLines().size());
+
+    // invalidates the translation of image 2 (relative to image 1) and the limb measurement of image 2
+    folder.ModifyFile(2);
+
+    {
+        const c_AlignmentCache cache(folder.GetFiles());
+
+        const auto translation = cache.GetTranslation(1, FFT_WIDTH, FFT_HEIGHT, true, false);
+        BOOST_REQUIRE(translation.has_value());
+        BOOST_CHECK_EQUAL(5.0f, translation->x);
+        BOOST_CHECK(!cache.GetTranslation(2, FFT_WIDTH, FFT_HEIGHT, true, false).has_value());
+        BOOST_CHECK(cache.GetLimbMeasurement(0, false).has_value());
+        BOOST_CHECK(!cache.GetLimbMeasurement(2, false).has_value());
+    }
+    BOOST_CHECK_EQUAL(2, folder.ReadCacheLines().size());
+
+    // entries of files which no longer exist are removed too
+    fs::remove(folder.GetFiles()[0].ToStdString());
+    {
+        const c_AlignmentCache cache(folder.GetFiles());
+        BOOST_CHECK(!cache.GetTranslation(1, FFT_WIDTH, FFT_HEIGHT, true, false).has_value());
+    }
+    BOOST_CHECK(folder.ReadCacheLines().empty());
+}
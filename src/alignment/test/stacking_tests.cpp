@@ -0,0 +1,103 @@
+#include "alignment/stacking.h"
+
+#include <algorithm>
+#include <boost/test/unit_test.hpp>
+#include <vector>
+
+namespace
+{
+
+constexpr unsigned WIDTH = 16;
+constexpr unsigned HEIGHT = 12;
+constexpr std::size_t NUM_FRAMES = 5;
+
+/// Returns a frame whose values depend on the position and the frame index; frame 2 has an outlier at (3, 4).
+c_Image CreateFrame(std::size_t frameIdx)
+{
+    c_Image frame(WIDTH, HEIGHT, PixelFormat::PIX_MONO32F);
+    for (unsigned y = 0; y < HEIGHT; ++y)
+    {
+        float* row = frame.GetRowAs<float>(y);
+        for (unsigned x = 0; x < WIDTH; ++x)
+        {
+            row[x] = 0.01f * (x + y) + 0.05f * ((frameIdx * 3) % NUM_FRAMES);
+        }
+    }
+    if (frameIdx == 2) { frame.GetRowAs<float>(4)[3] = 100.0f; }
+    return frame;
+}
+
+c_Image Stack(StackingMode mode, std::size_t memoryLimit, std::size_t* numPasses = nullptr)
+{
+    StackingParameters params;
+    params.mode = mode;
+    params.sigmaClippingKappa = 1.5f;
+    params.memoryLimit = memoryLimit;
+
+    c_ImageStacker stacker(params, NUM_FRAMES);
+    for (std::size_t i = 0; i < NUM_FRAMES; ++i)
+    {
+        BOOST_REQUIRE(stacker.AddFrame(CreateFrame(i)));
+    }
+    std::vector<int> progress;
+    BOOST_REQUIRE(stacker.Finish([&](int percentage) { progress.push_back(percentage); }, []() { return false; }));
+    BOOST_REQUIRE(stacker.IsComplete());
+    BOOST_CHECK(std::is_sorted(progress.begin(), progress.end()));
+    BOOST_CHECK_EQUAL(100, stacker.GetPercentageComplete());
+    if (numPasses) { *numPasses = stacker.GetNumPasses(); }
+
+    return stacker.GetResult();
+}
+
+void CheckEqual(const c_Image& expected, const c_Image& actual)
+{
+    for (unsigned y = 0; y < HEIGHT; ++y)
+    {
+        for (unsigned x = 0; x < WIDTH; ++x)
+        {
+            BOOST_CHECK_EQUAL(expected.GetRowAs<float>(y)[x], actual.GetRowAs<float>(y)[x]);
+        }
+    }
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(MedianInBandsEqualsMedianInOnePass)
+{
+    std::size_t numPasses = 0;
+    const c_Image onePass = Stack(StackingMode::MEDIAN, 1024 * 1024, &numPasses);
+    BOOST_REQUIRE_EQUAL(1u, numPasses);
+
+    // 3 rows per band; the frames are kept in a temporary file
+    const c_Image inBands = Stack(StackingMode::MEDIAN, 3 * WIDTH * NUM_FRAMES * sizeof(float), &numPasses);
+    BOOST_REQUIRE_EQUAL(4u, numPasses);
+    CheckEqual(onePass, inBands);
+
+    // values of the frames are the pixel's base value + 0.05 * {0, 3, 1, 4, 2}; the median adds 0.1
+    BOOST_CHECK_CLOSE(0.01f * (1 + 1) + 0.1f, inBands.GetRowAs<float>(1)[1], 1.0e-3);
+    // frame 2's offset is replaced by the outlier
+    BOOST_CHECK_CLOSE(0.01f * (3 + 4) + 0.15f, inBands.GetRowAs<float>(4)[3], 1.0e-3);
+}
+
+BOOST_AUTO_TEST_CASE(SigmaClippedMeanRejectsOutlierRegardlessOfFrameStorage)
+{
+    std::size_t numPasses = 0;
+    const c_Image inMemory = Stack(StackingMode::SIGMA_CLIPPED_MEAN, 1024 * 1024, &numPasses);
+    BOOST_REQUIRE_EQUAL(2u, numPasses);
+    const c_Image inFile = Stack(StackingMode::SIGMA_CLIPPED_MEAN, 1);
+    CheckEqual(inMemory, inFile);
+
+    // without the outlier, the mean of the remaining frames' offsets {0, 0.15, 0.2, 0.1} is 0.1125
+    BOOST_CHECK_CLOSE(0.01f * (3 + 4) + 0.1125f, inFile.GetRowAs<float>(4)[3], 1.0e-3);
+    BOOST_CHECK_CLOSE(0.01f * (1 + 1) + 0.1f, inFile.GetRowAs<float>(1)[1], 1.0e-3);
+}
+
+BOOST_AUTO_TEST_CASE(FramesOfDifferentSizeAreRejected)
+{
+    StackingParameters params;
+    params.mode = StackingMode::MEAN;
+    c_ImageStacker stacker(params, 2);
+    BOOST_REQUIRE(stacker.AddFrame(CreateFrame(0)));
+    BOOST_CHECK(!stacker.AddFrame(c_Image(WIDTH + 1, HEIGHT, PixelFormat::PIX_MONO32F)));
+    BOOST_CHECK(c_ImageStacker::Error::FRAME_MISMATCH == stacker.GetError());
+}
@@ -0,0 +1,148 @@
+#include "image/image.h"
+
+#include <algorithm>
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include <functional>
+#include <utility>
+
+namespace
+{
+
+constexpr unsigned WIDTH = 150;
+constexpr unsigned HEIGHT = 90;
+
+constexpr float PI = 3.14159265358979f;
+
+c_Image CreateImage(const std::function<float(float, float)>& func)
+{
+    c_Image image(WIDTH, HEIGHT, PixelFormat::PIX_MONO32F);
+    for (unsigned y = 0; y < HEIGHT; ++y)
+    {
+        for (unsigned x = 0; x < WIDTH; ++x)
+        {
+            image.GetRowAs<float>(y)[x] = func(static_cast<float>(x), static_cast<float>(y));
+        }
+    }
+    return image;
+}
+
+float Wave(float x, float y, float period)
+{
+    return 0.5f + 0.2f * std::sin(2 * PI * x / period) * std::cos(2 * PI * y / (1.3f * period));
+}
+
+c_Image Translate(const c_Image& src, float xOfs, float yOfs, ShiftInterpolation interpolation)
+{
+    c_Image dest(WIDTH, HEIGHT, PixelFormat::PIX_MONO32F);
+    c_Image::ResizeAndTranslate(src.GetBuffer(), dest.GetBuffer(), 0, 0, WIDTH - 1, HEIGHT - 1, xOfs, yOfs, true, interpolation);
+    return dest;
+}
+
+float InterpolateCubic(float t, float fm1, float f0, float f1, float f2)
+{
+    const float delta_k = f1 - f0;
+    const float dk = (f1 - fm1) * 0.5f, dk1 = (f2 - f0) * 0.5f;
+    const float a0 = f0, a1 = dk, a2 = 3.0f * delta_k - 2.0f * dk - dk1, a3 = dk + dk1 - 2.0f * delta_k;
+    return t * (t * (a3 * t + a2) + a1) + a0;
+}
+
+/// Returns the value of the destination pixel (`col`, `row`) as computed by the per-pixel cubic interpolation
+/// used before the separable kernels were introduced (the whole `src` translated by (`xOfs`, `yOfs`)).
+float TranslateCubicReference(const c_Image& src, int col, int row, float xOfs, float yOfs)
+{
+    float temp;
+    float yOfsFrac = std::modf(yOfs, &temp); const int yOfsInt = static_cast<int>(temp);
+    float xOfsFrac = std::modf(xOfs, &temp); const int xOfsInt = static_cast<int>(temp);
+
+    const int idx = xOfsFrac < 0.0f ? 1 : -1;
+    const int idy = yOfsFrac < 0.0f ? 1 : -1;
+    xOfsFrac = std::fabs(xOfsFrac);
+    yOfsFrac = std::fabs(yOfsFrac);
+
+    float yvals[4];
+    int srcY = row - idy - yOfsInt;
+    const int srcX = col - xOfsInt;
+    for (float& yval: yvals)
+    {
+        const float* srcRow = src.GetRowAs<float>(srcY);
+        yval = InterpolateCubic(xOfsFrac, srcRow[srcX - idx], srcRow[srcX], srcRow[srcX + idx], srcRow[srcX + 2 * idx]);
+        srcY += idy;
+    }
+
+    return std::clamp(InterpolateCubic(yOfsFrac, yvals[0], yvals[1], yvals[2], yvals[3]), 0.0f, 1.0f);
+}
+
+/// Returns the maximum difference between the interior (`margin` pixels from the translated area's edges)
+/// of `translated` and `expected`.
+float GetMaxInteriorError(
+    const c_Image& translated,
+    float xOfs,
+    float yOfs,
+    int margin,
+    const std::function<float(int, int)>& expected
+)
+{
+    const int xStart = std::max(0, static_cast<int>(xOfs)) + margin;
+    const int yStart = std::max(0, static_cast<int>(yOfs)) + margin;
+    const int xEnd = std::min(static_cast<int>(WIDTH) - 1, static_cast<int>(WIDTH) - 1 + static_cast<int>(xOfs)) - margin;
+    const int yEnd = std::min(static_cast<int>(HEIGHT) - 1, static_cast<int>(HEIGHT) - 1 + static_cast<int>(yOfs)) - margin;
+    BOOST_REQUIRE(xEnd > xStart && yEnd > yStart);
+
+    float maxError = 0.0f;
+    for (int y = yStart; y <= yEnd; ++y)
+    {
+        for (int x = xStart; x <= xEnd; ++x)
+        {
+            maxError = std::max(maxError, std::abs(translated.GetRowAs<float>(y)[x] - expected(x, y)));
+        }
+    }
+    return maxError;
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(CubicTranslationMatchesPerPixelInterpolation)
+{
+    const c_Image src = CreateImage([](float x, float y) { return Wave(x, y, 7.0f) + 0.1f * std::sin(x * y); });
+
+    for (const auto& offset: { std::pair{0.25f, 0.5f}, {-3.7f, 2.1f}, {5.5f, -0.9f}, {-1.3f, -4.6f}, {0.0f, 1.75f} })
+    {
+        const float xOfs = offset.first, yOfs = offset.second;
+        const c_Image translated = Translate(src, xOfs, yOfs, ShiftInterpolation::CUBIC);
+        const float maxError = GetMaxInteriorError(translated, xOfs, yOfs, 2, [&](int x, int y) {
+            return TranslateCubicReference(src, x, y, xOfs, yOfs);
+        });
+        BOOST_CHECK_SMALL(maxError, 1.0e-5f);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(LanczosSubpixelTranslationReproducesShiftedSignal)
+{
+    // fine details, which Lanczos preserves better than cubic interpolation
+    const float period = 5.0f;
+    const c_Image src = CreateImage([&](float x, float y) { return Wave(x, y, period); });
+
+    for (const auto& offset: { std::pair{0.5f, 0.5f}, {2.3f, -1.6f}, {-4.25f, 3.75f} })
+    {
+        const float xOfs = offset.first, yOfs = offset.second;
+        const auto expected = [&](int x, int y) { return Wave(x - xOfs, y - yOfs, period); };
+
+        const float lanczosError = GetMaxInteriorError(
+            Translate(src, xOfs, yOfs, ShiftInterpolation::LANCZOS3), xOfs, yOfs, 3, expected
+        );
+        const float cubicError = GetMaxInteriorError(
+            Translate(src, xOfs, yOfs, ShiftInterpolation::CUBIC), xOfs, yOfs, 3, expected
+        );
+        BOOST_CHECK_SMALL(lanczosError, 1.0e-2f);
+        BOOST_CHECK_LT(lanczosError, cubicError);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(LanczosTranslationPreservesFlatAreas)
+{
+    const c_Image src = CreateImage([](float, float) { return 0.37f; });
+    const c_Image translated = Translate(src, 1.4f, -2.8f, ShiftInterpolation::LANCZOS3);
+    const float maxError = GetMaxInteriorError(translated, 1.4f, -2.8f, 0, [](int, int) { return 0.37f; });
+    BOOST_CHECK_SMALL(maxError, 1.0e-6f);
+}
@@ -96,6 +96,8 @@ namespace Keys
     const char* AlignOutputPath             = UserInterfaceGroup"/AlignOutputPath";
     const char* AlignProgressDialogPosSize  = UserInterfaceGroup"/AlignProgressDlgPosSize";
     const char* AlignParamsDialogPosSize    = UserInterfaceGroup"/AlignParamsDlgPosSize";
+    const char* AlignUseCache               = UserInterfaceGroup"/AlignUseCache";
+    const char* AlignLanczosInterpolation   = UserInterfaceGroup"/AlignLanczosInterpolation";
 
     /// Indicates maximum frequency (in Hz) of issuing new processing requests by tone curve editor and numerical control sliders
     const char* MAX_PROCESSING_REQUESTS_PER_SEC =  UserInterfaceGroup"/MaxProcessingRequestsPerSecond";
@@ -118,12 +120,16 @@ namespace Keys
 
     const char* ScriptOpenPath = UserInterfaceGroup"/ScriptOpenPath";
 
+    const char* ScriptProcessingWorkers = "/ScriptProcessingWorkers";
+    const char* ScriptProcessingMemoryLimitMiB = "/ScriptProcessingMemoryLimitMiB";
+
 #define OpenGLGroup "/OpenGL"
 
     const char* LRCmdBatchSizeMpixIters = OpenGLGroup"/LRCommandBatchSizeMpixIters";
     const char* OpenGLInitIncomplete = OpenGLGroup"/OpenGLInitIncomplete";
 
     const char* NormalizeFITSValues = "/NormalizeFITSValues";
+    const char* UnsharpMaskBlurPyramid = "/UnsharpMaskBlurPyramid";
 }
 
 void Initialize(wxFileConfig* _appConfig)
@@ -174,6 +180,8 @@ PROPERTY_STRING(UiLanguage);
 PROPERTY_BOOL(MainWindowMaximized, true);
 PROPERTY_BOOL(ToneCurveEditorVisible, true);
 PROPERTY_BOOL(LogHistogram, true);
+PROPERTY_BOOL(AlignUseCache, false);
+PROPERTY_BOOL(AlignLanczosInterpolation, false);
 
 PROPERTY_BOOL(OpenGLInitIncomplete, false);
 
@@ -337,6 +345,12 @@ c_Property<ScalingMethod> DisplayScalingMethod(
 
 PROPERTY_BOOL(NormalizeFITSValues, true);
 
+PROPERTY_BOOL(UnsharpMaskBlurPyramid, false);
+
 PROPERTY_STRING(ScriptOpenPath);
 
+PROPERTY_UNSIGNED(ScriptProcessingWorkers, 2);
+
+PROPERTY_UNSIGNED(ScriptProcessingMemoryLimitMiB, 0);
+
 }  // namespace Configuration
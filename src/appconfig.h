@@ -75,6 +75,10 @@ namespace Configuration
     extern c_Property<wxString>              AlignInputPath;
     extern c_Property<wxString>              AlignOutputPath;
     extern c_Property<wxRect>                AlignParamsDialogPosSize;
+    /// If true, image alignment stores per-image measurements in a file in the input images' folder and reuses them.
+    extern c_Property<bool>                  AlignUseCache;
+    /// If true, image alignment uses Lanczos (instead of cubic) interpolation for sub-pixel translation.
+    extern c_Property<bool>                  AlignLanczosInterpolation;
     /// Code of UI language to use or an empty string (then the system default will used)
     extern c_Property<wxString>              UiLanguage;
     extern c_Property<bool>                  LogHistogram;
@@ -97,6 +101,8 @@ namespace Configuration
     extern c_Property<bool>                  OpenGLInitIncomplete;
     /// If true, floating-points values read from a FITS file are normalized, so that the highest becomes 1.0.
     extern c_Property<bool>                  NormalizeFITSValues;
+    /// If true, the CPU back end computes unsharp masks with large sigma on decimated images (faster, but approximate).
+    extern c_Property<bool>                  UnsharpMaskBlurPyramid;
     /// If zero, draw 1 segment per pixel
     /** NOTE: drawing 1 segment per pixel may be slow for large widths of the tone curve editor window
         (e.g. on a 3840x2160 display). */
@@ -111,6 +117,10 @@ namespace Configuration
     extern c_Property<unsigned>              LRCmdBatchSizeMpixIters;
     extern c_Property<wxRect>                ScriptDialogPosSize;
     extern c_Property<wxString>              ScriptOpenPath;
+    /// Max number of images processed in parallel by a script (CPU mode only).
+    extern c_Property<unsigned>              ScriptProcessingWorkers;
+    /// Max estimated memory (in MiB) used by images processed in parallel by a script; 0 means no limit.
+    extern c_Property<unsigned>              ScriptProcessingMemoryLimitMiB;
 }
 
 #endif
@@ -29,6 +29,7 @@ File description:
 #include "image/image.h"
 
 #include <functional>
+#include <memory>
 #include <optional>
 #include <wx/scrolwin.h>
 
@@ -112,9 +113,20 @@ class IProcessingBackEnd
 public:
     virtual void StartProcessing(c_Image img, ProcessingSettings procSettings) = 0;
 
+    /// Starts processing of an image which may be shared with the caller (who must not modify it
+    /// until processing completes). Back ends which can read the input in place avoid copying it.
+    virtual void StartProcessing(std::shared_ptr<const c_Image> img, ProcessingSettings procSettings)
+    {
+        StartProcessing(c_Image(*img), std::move(procSettings));
+    }
+
     /// Can only be called after processing completes.
     virtual const c_Image& GetProcessedOutput() = 0;
 
+    /// Can only be called after processing completes. Moves out the processing output (if the back end
+    /// supports it); `GetProcessedOutput` cannot be called afterwards until the next processing completes.
+    virtual c_Image TakeProcessedOutput() { return GetProcessedOutput(); }
+
     virtual void SetProcessingCompletedHandler(std::function<void(CompletionStatus)> handler) = 0;
 
     /// Provides a function to be called when progress text of back end's operations changes.
@@ -128,8 +140,9 @@ public:
     virtual ~IProcessingBackEnd() = default;
 };
 
-std::unique_ptr<IDisplayBackEnd> CreateCpuBmpDisplayBackend(c_ScrolledView& imgView);
-std::unique_ptr<IProcessingBackEnd> CreateCpuBmpProcessingBackend();
+/// If `useBlurPyramid` is true, unsharp masks with large sigma are computed on decimated levels (faster, but approximate).
+std::unique_ptr<IDisplayBackEnd> CreateCpuBmpDisplayBackend(c_ScrolledView& imgView, bool useBlurPyramid);
+std::unique_ptr<IProcessingBackEnd> CreateCpuBmpProcessingBackend(bool useBlurPyramid);
 
 #if USE_OPENGL_BACKEND
 std::unique_ptr<IDisplayBackEnd> CreateOpenGLDisplayBackend(c_ScrolledView& imgView, unsigned lRCmdBatchSizeMpixIters);
@@ -24,8 +24,10 @@ File description:
 #ifndef IMPPG_CPU_BMP_HEADER
 #define IMPPG_CPU_BMP_HEADER
 
+#include <cstdint>
 #include <functional>
 #include <optional>
+#include <vector>
 #include <wx/bitmap.h>
 #include <wx/event.h>
 #include <wx/timer.h>
@@ -39,7 +41,7 @@ namespace imppg::backend {
 class c_CpuAndBitmaps: public IDisplayBackEnd
 {
 public:
-    c_CpuAndBitmaps(c_ScrolledView& imgView);
+    c_CpuAndBitmaps(c_ScrolledView& imgView, bool useBlurPyramid);
 
     c_CpuAndBitmaps(const c_CpuAndBitmaps&) = delete;
 
@@ -95,12 +97,54 @@ private:
 
     c_CpuAndBitmapsProcessing m_Processor;
 
+    /// Processes a reduced copy of the selection (see `m_ProxyLevel`), so that an approximate result
+    /// can be shown before `m_Processor` finishes.
+    c_CpuAndBitmapsProcessing m_ProxyProcessor;
+
+    /// The proxy image processed by `m_ProxyProcessor` is the selection reduced 2^`m_ProxyLevel` times;
+    /// if 0, the selection is small enough not to need a proxy.
+    int m_ProxyLevel{0};
+
+    /// Processes the visible part of a large selection (with a margin), so that it can be shown before `m_Processor`
+    /// finishes processing the whole selection.
+    c_CpuAndBitmapsProcessing m_ViewportProcessor;
+
+    /// Visible part of the selection (in `m_Img` coords) whose processing result `m_ViewportProcessor` provides;
+    /// empty if not used.
+    wxRect m_ViewportArea;
+
+    /// Fragment of `m_Img` processed by `m_ViewportProcessor`: `m_ViewportArea` with a margin.
+    wxRect m_ViewportJobArea;
+
+    /// The most accurate processing result shown since the processing was last scheduled;
+    /// a less accurate one (completed later) must not replace it.
+    enum class ShownResult
+    {
+        NONE,
+        PROXY,    ///< Upscaled result of `m_ProxyProcessor`.
+        VIEWPORT, ///< Result of `m_ViewportProcessor` (for the visible part of selection).
+        FULL      ///< Result of `m_Processor`.
+    } m_ShownResult{ShownResult::NONE};
+
+    /// Incremented by each `ScheduleProcessing`. The proxy and viewport results are shown only if they were scheduled
+    /// by the most recent request (e.g. after a tone curve-only request, a result still being processed
+    /// with the previous tone curve is outdated).
+    std::uint64_t m_RequestId{0};
+    std::uint64_t m_ProxyRequestId{0}; ///< Value of `m_RequestId` when `m_ProxyProcessor` was last scheduled.
+    std::uint64_t m_ViewportRequestId{0}; ///< Value of `m_RequestId` when `m_ViewportProcessor` was last scheduled.
+
+    ProcessingSettings m_ProcSettings; ///< Last settings passed to `m_Processor`.
+
     c_ScrolledView& m_ImgView;
 
     std::optional<c_Image> m_Img;
 
     std::optional<wxBitmap> m_ImgBmp; ///< Bitmap which wraps `m_Img` for displaying on `m_ImgView`.
 
+    /// Downscaled copies (PIX_RGB8) of `m_ImgBmp` at 1/2, 1/4, 1/8 of its size; used for creating scaled previews
+    /// at low zoom factors.
+    std::vector<c_Image> m_PreviewPyramid;
+
     float m_ZoomFactor{ZOOM_NONE};
 
     float m_NewZoomFactor{ZOOM_NONE};
@@ -134,7 +178,43 @@ private:
 
     void CreateScaledPreview(float zoomFactor);
 
+    /// Builds `m_PreviewPyramid` from a PIX_RGB8 image with the same contents as `m_ImgBmp`.
+    void BuildPreviewPyramid(const c_Image& rgbImage);
+
+    /// Updates `m_PreviewPyramid` after `area` (in `m_ImgBmp` coords) of `m_ImgBmp` has changed.
+    void UpdatePreviewPyramid(const wxRect& area);
+
+    /// Returns the `area` (in `m_ImgBmp` coords) of `m_ImgBmp` scaled to `destSize`; when reducing, scales
+    /// the nearest (not smaller) level of `m_PreviewPyramid` instead.
+    wxBitmap CreateScaledFragment(const wxRect& area, const wxSize& destSize) const;
+
+    /// Copies `contents` to `area` (within the selection) of `m_ImgBmp` and refreshes the view.
+    void UpdateSelection(wxBitmap contents, const wxRect& area);
+
     void UpdateSelectionAfterProcessing();
+
+    /// Shows the upscaled result of `m_ProxyProcessor` in the selection.
+    void UpdateSelectionWithProxyResult();
+
+    /// Shows the result of `m_ViewportProcessor` in `m_ViewportArea`.
+    void UpdateSelectionWithViewportResult();
+
+    /// Returns the area of `m_Img` currently visible in `m_ImgView`.
+    wxRect GetVisibleImageArea(float zoomFactor);
+
+    /// Determines the visible part of the selection and (if it is worth processing first) the fragment of `m_Img`
+    /// processed by `m_ViewportProcessor`; returns true if the latter has changed.
+    bool SetViewportImage(float zoomFactor);
+
+    /// If the full-resolution result is not ready yet, makes sure the part of the selection visible after scrolling
+    /// or zooming is processed first (without restarting processing of the whole selection).
+    void ReprioritizeViewport(float zoomFactor);
+
+    /// Creates the proxy image of the current selection (if it is large enough to need one).
+    void SetProxyImage();
+
+    /// Schedules processing of the selection, and also of its proxy (if present).
+    void ScheduleProcessing(ProcessingRequest request);
 };
 
 } // namespace imppg::backend
@@ -21,9 +21,16 @@ File description:
     CPU & bitmaps back end core implementation.
 */
 
+#include <algorithm>
 #include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
 #include <wx/dcclient.h>
 #include <wx/dcmemory.h>
+#include <wx/rawbmp.h>
 
 //#include "ctrl_ids.h"
 #include "logging/logging.h"
@@ -34,9 +41,26 @@ namespace imppg::backend {
 /// Delay after a scroll or resize event before refreshing the display if zoom level <> 100%.
 constexpr int IMAGE_SCALING_DELAY_MS = 150;
 
-std::unique_ptr<IDisplayBackEnd> CreateCpuBmpDisplayBackend(c_ScrolledView& imgView)
+/// Number of levels of `c_CpuAndBitmaps::m_PreviewPyramid`; n-th level is 2^n times smaller than the image.
+constexpr int NUM_PYRAMID_LEVELS = 3;
+
+/// Selections with more pixels are first processed as a reduced proxy image (of at most as many pixels),
+/// whose upscaled result is shown until the full-resolution processing completes.
+constexpr int MAX_PROXY_PIXELS = 512 * 512;
+
+/// Smallest Gaussian sigma used when processing the proxy image (the same as the minimum L-R sigma in the GUI).
+constexpr float MIN_PROXY_SIGMA = 0.5f;
+
+/// The visible part of a large selection is processed separately first if it is at most this fraction of the selection.
+constexpr float MAX_VIEWPORT_FRACTION = 0.5f;
+
+/// The visible part is processed concurrently with the whole selection (and the proxy image) using at most
+/// 1/`VIEWPORT_THREADS_DIVISOR` of the logical CPUs, so that it does not delay the full-resolution result much.
+constexpr unsigned VIEWPORT_THREADS_DIVISOR = 4;
+
+std::unique_ptr<IDisplayBackEnd> CreateCpuBmpDisplayBackend(c_ScrolledView& imgView, bool useBlurPyramid)
 {
-    return std::make_unique<c_CpuAndBitmaps>(imgView);
+    return std::make_unique<c_CpuAndBitmaps>(imgView, useBlurPyramid);
 }
 
 static wxImageResizeQuality GetResizeQuality(ScalingMethod smethod)
@@ -79,22 +103,325 @@ static void MarkSelection(const wxRect& physSelection, wxDC& dc)
 #endif
 }
 
-/// Converts the specified fragment of `src` to a 24-bit RGB bitmap.
+/// Converts `count` values from [0; 1] to [0; 255] (truncating, like `c_Image::ConvertPixelFormat`).
+/** Unlike `c_Image::ConvertPixelFormat`, values outside [0; 1] are clamped first; converting them directly
+    to an 8-bit integer is undefined behaviour (and in practice wraps around, showing e.g. slightly negative
+    values as white). For values within [0; 1] the results are the same. */
+static void FloatToUint8(const float* src, std::uint8_t* dest, int count)
+{
+    #pragma omp simd
+    for (int i = 0; i < count; i++)
+    {
+        dest[i] = static_cast<std::uint8_t>(std::clamp(src[i], 0.0f, 1.0f) * 0xFF);
+    }
+}
+
+/// Writes a fragment of `src` (PIX_MONO32F or PIX_RGB32F) of the same size as `dest` directly to `dest`'s
+/// native pixel data; returns false if the pixel data is not accessible.
+static bool WriteToNativePixelData(const c_Image& src, int x0, int y0, wxBitmap& dest)
+{
+    wxNativePixelData pixelData(dest);
+    if (!pixelData)
+        return false;
+
+    const int width = dest.GetWidth();
+    const int height = dest.GetHeight();
+    const bool isMono = (src.GetPixelFormat() == PixelFormat::PIX_MONO32F);
+    const int numChannels = isMono ? 1 : 3;
+    constexpr bool nativeIsRgb24 =
+        wxNativePixelFormat::SizePixel == 3 &&
+        wxNativePixelFormat::RED == 0 && wxNativePixelFormat::GREEN == 1 && wxNativePixelFormat::BLUE == 2;
+
+    #pragma omp parallel
+    {
+        std::vector<std::uint8_t> rowValues(numChannels * width);
+
+        #pragma omp for
+        for (int y = 0; y < height; y++)
+        {
+            FloatToUint8(src.GetRowAs<float>(y0 + y) + numChannels * x0, rowValues.data(), numChannels * width);
+
+            wxNativePixelData::Iterator destPix(pixelData);
+            destPix.MoveTo(pixelData, 0, y);
+            if (!isMono && nativeIsRgb24)
+            {
+                std::memcpy(&destPix.Data(), rowValues.data(), 3 * width);
+            }
+            else
+            {
+                for (int x = 0; x < width; x++, ++destPix)
+                {
+                    const std::uint8_t* value = rowValues.data() + numChannels * x;
+                    destPix.Red() = value[0];
+                    destPix.Green() = value[isMono ? 0 : 1];
+                    destPix.Blue() = value[isMono ? 0 : 2];
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+/// Converts the specified fragment of `src` (PIX_MONO32F or PIX_RGB32F) to a 24-bit RGB bitmap.
+///
+/// The values are written directly to the bitmap's native pixel data (without intermediate RGB8
+/// and `wxImage` copies), unless it is not accessible. Only the direct path clamps values outside [0; 1]
+/// (see `FloatToUint8`); the processing steps normally clamp their outputs anyway.
+///
 static wxBitmap ImageToRgbBitmap(const c_Image& src, int x0, int y0, int width, int height)
 {
+    IMPPG_ASSERT(
+        src.GetPixelFormat() == PixelFormat::PIX_MONO32F ||
+        src.GetPixelFormat() == PixelFormat::PIX_RGB32F
+    );
+
+    wxBitmap result(width, height, 24);
+    if (WriteToNativePixelData(src, x0, y0, result))
+    {
+        return result;
+    }
+
     c_Image rgbImage = src.GetConvertedPixelFormatSubImage(PixelFormat::PIX_RGB8, x0, y0, width, height);
     // for storage, `rgbImage` uses `c_SimpleBuffer`, which has no row padding, so we can pass it directly to wxImage's constructor
     wxImage wximg(width, height, rgbImage.GetRowAs<unsigned char>(0), true);
     return wxBitmap(wximg);
 }
 
+/// Reduces an RGB8 image fragment 2 times by averaging 2x2 blocks of pixels (at the right and bottom edge
+/// of an odd-sized fragment: 2x1, 1x2 or 1x1 blocks).
+static void DownsampleRgb8(
+    const std::uint8_t* src,
+    std::size_t srcStride,
+    int srcWidth,
+    int srcHeight,
+    std::uint8_t* dest,
+    std::size_t destStride
+)
+{
+    const int destWidth = (srcWidth + 1) / 2;
+    const int destHeight = (srcHeight + 1) / 2;
+
+    #pragma omp parallel for
+    for (int y = 0; y < destHeight; y++)
+    {
+        const std::uint8_t* srcRow0 = src + 2 * y * srcStride;
+        const std::uint8_t* srcRow1 = (2 * y + 1 < srcHeight) ? srcRow0 + srcStride : srcRow0;
+        std::uint8_t* destRow = dest + y * destStride;
+        for (int x = 0; x < destWidth; x++)
+        {
+            const int x0 = 2 * x;
+            const int x1 = (x0 + 1 < srcWidth) ? x0 + 1 : x0;
+            for (int ch = 0; ch < 3; ch++)
+            {
+                const unsigned sum = srcRow0[3*x0 + ch] + srcRow0[3*x1 + ch] + srcRow1[3*x0 + ch] + srcRow1[3*x1 + ch];
+                destRow[3*x + ch] = static_cast<std::uint8_t>((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+/// Reduces `area` of a PIX_MONO32F or PIX_RGB32F image 2^`level` times by averaging blocks of pixels
+/// (at the right and bottom edge: partial blocks).
+static c_Image CreateReducedImage(const c_Image& src, const wxRect& area, int level)
+{
+    const int factor = 1 << level;
+    const int numChannels = NumChannels[static_cast<std::size_t>(src.GetPixelFormat())];
+    const int destWidth = (area.width + factor - 1) / factor;
+    const int destHeight = (area.height + factor - 1) / factor;
+    c_Image result(destWidth, destHeight, src.GetPixelFormat());
+
+    #pragma omp parallel for
+    for (int y = 0; y < destHeight; y++)
+    {
+        const int srcY0 = area.y + y * factor;
+        const int srcY1 = std::min(srcY0 + factor, area.y + area.height);
+        float* destRow = result.GetRowAs<float>(y);
+        for (int x = 0; x < destWidth; x++)
+        {
+            const int srcX0 = area.x + x * factor;
+            const int srcX1 = std::min(srcX0 + factor, area.x + area.width);
+            for (int ch = 0; ch < numChannels; ch++)
+            {
+                float sum = 0.0f;
+                for (int srcY = srcY0; srcY < srcY1; srcY++)
+                {
+                    const float* srcRow = src.GetRowAs<float>(srcY);
+                    for (int srcX = srcX0; srcX < srcX1; srcX++)
+                        sum += srcRow[numChannels * srcX + ch];
+                }
+                destRow[numChannels * x + ch] = sum / ((srcY1 - srcY0) * (srcX1 - srcX0));
+            }
+        }
+    }
+
+    return result;
+}
+
+/// Returns settings for processing an image reduced 2^`level` times.
+static ProcessingSettings GetProxySettings(ProcessingSettings settings, int level)
+{
+    const float scale = 1.0f / (1 << level);
+
+    // At corresponding (reduced) frequencies, a Gaussian with the reduced sigma has the same response, so the same
+    // number of L-R iterations gives the same result. If the sigma has to be clamped, the kernel is too wide
+    // and each iteration sharpens more; reduce the iterations in proportion to the kernel's variance.
+    const float lrSigma = settings.LucyRichardson.sigma * scale;
+    if (lrSigma < MIN_PROXY_SIGMA && settings.LucyRichardson.iterations > 0)
+    {
+        const float varianceRatio = (lrSigma * lrSigma) / (MIN_PROXY_SIGMA * MIN_PROXY_SIGMA);
+        settings.LucyRichardson.iterations = std::max(1, static_cast<int>(std::lround(settings.LucyRichardson.iterations * varianceRatio)));
+    }
+    settings.LucyRichardson.sigma = std::max(MIN_PROXY_SIGMA, lrSigma);
+    for (auto& umask: settings.unsharpMask)
+    {
+        umask.sigma = std::max(MIN_PROXY_SIGMA, umask.sigma * scale);
+    }
+    return settings;
+}
+
+/// Returns the width of the margin around an image fragment which (approximately) affects
+/// the fragment's processing result.
+static int GetProcessingMargin(const ProcessingSettings& settings)
+{
+    // Gaussian kernels are assumed to have a radius of 3 sigma
+    float margin = 0.0f;
+    if (settings.LucyRichardson.iterations > 0)
+    {
+        // each iteration performs 2 convolutions; their combined kernel widens with the square root of their number
+        margin += 3.0f * settings.LucyRichardson.sigma * std::sqrt(2.0f * settings.LucyRichardson.iterations);
+    }
+    for (const auto& umask: settings.unsharpMask)
+    {
+        if (umask.IsEffective())
+            margin += 3.0f * umask.sigma;
+    }
+    return static_cast<int>(std::ceil(margin));
+}
+
+/// Returns the source coordinate (clamped to [0, `srcSize` - 1]) of each destination pixel; if `interpolate` is true,
+/// returns 2 neighboring coordinates and the weight of the 2nd one.
+static void GetResamplingCoords(
+    float srcStart, ///< Source coordinate of the left/top edge of destination area
+    float srcStep,  ///< Destination pixel size in source pixels
+    int srcSize,
+    bool interpolate,
+    std::vector<int>& coord0,
+    std::vector<int>& coord1,
+    std::vector<float>& weight1
+)
+{
+    for (std::size_t i = 0; i < coord0.size(); i++)
+    {
+        // source coordinate of the destination pixel's center (source pixels' centers are at integer + 0.5)
+        const float pos = srcStart + (i + 0.5f) * srcStep - 0.5f;
+        if (interpolate)
+        {
+            const float posFloor = std::floor(pos);
+            coord0[i] = std::clamp(static_cast<int>(posFloor), 0, srcSize - 1);
+            coord1[i] = std::clamp(static_cast<int>(posFloor) + 1, 0, srcSize - 1);
+            weight1[i] = pos - posFloor;
+        }
+        else
+        {
+            coord0[i] = coord1[i] = std::clamp(static_cast<int>(std::lround(pos)), 0, srcSize - 1);
+            weight1[i] = 0.0f;
+        }
+    }
+}
+
+/// Scales `area` (in full-resolution coordinates) of a PIX_RGB8 image reduced 2^`level` times to `destSize`.
+///
+/// Uses nearest neighbor or bilinear interpolation; the caller chooses the level so that the remaining
+/// reduction factor is less than 2 (unless zoomed out below the smallest level), where bilinear interpolation
+/// causes little aliasing.
+///
+/// Each destination row is produced by interpolating vertically the whole span of source values it needs
+/// (contiguous R, G, B values of 2 source rows) and then horizontally, with precomputed offsets and weights
+/// of each destination value; both loops are vectorizable.
+///
+static wxImage ScaleReducedRgb8(
+    const c_Image& reducedImg,
+    int level,
+    const wxRect& area,
+    const wxSize& destSize,
+    ScalingMethod scalingMethod
+)
+{
+    const float levelScale = 1.0f / (1 << level);
+    const bool interpolate = (scalingMethod != ScalingMethod::NEAREST);
+
+    // Source coordinates and weights are the same for each row (or column); determine them once.
+    std::vector<int> x0(destSize.x), x1(destSize.x), y0(destSize.y), y1(destSize.y);
+    std::vector<float> wx(destSize.x), wy(destSize.y);
+    GetResamplingCoords(area.x * levelScale, area.width * levelScale / destSize.x, reducedImg.GetWidth(), interpolate, x0, x1, wx);
+    GetResamplingCoords(area.y * levelScale, area.height * levelScale / destSize.y, reducedImg.GetHeight(), interpolate, y0, y1, wy);
+
+    wxImage result(destSize.x, destSize.y, false);
+    std::uint8_t* dest = result.GetData();
+    if (destSize.x <= 0 || destSize.y <= 0) { return result; }
+
+    // The source coordinates are non-decreasing, so each row needs the values between these columns.
+    const int spanStart = 3 * x0.front();
+    const int spanLength = 3 * (x1.back() + 1) - spanStart;
+
+    // offsets (in the span) and weights for each destination value
+    const int numDestValues = 3 * destSize.x;
+    std::vector<int> ofs0(numDestValues), ofs1(numDestValues);
+    std::vector<float> weight1(numDestValues);
+    for (int x = 0; x < destSize.x; x++)
+    {
+        for (int ch = 0; ch < 3; ch++)
+        {
+            ofs0[3*x + ch] = 3*x0[x] + ch - spanStart;
+            ofs1[3*x + ch] = 3*x1[x] + ch - spanStart;
+            weight1[3*x + ch] = wx[x];
+        }
+    }
+
+    #pragma omp parallel
+    {
+        std::vector<float> span(spanLength);
+
+        #pragma omp for
+        for (int y = 0; y < destSize.y; y++)
+        {
+            const std::uint8_t* srcRow0 = reducedImg.GetRowAs<std::uint8_t>(y0[y]) + spanStart;
+            const std::uint8_t* srcRow1 = reducedImg.GetRowAs<std::uint8_t>(y1[y]) + spanStart;
+            const float wy1 = wy[y];
+            float* spanValues = span.data();
+
+            #pragma omp simd
+            for (int i = 0; i < spanLength; i++)
+            {
+                const float v0 = srcRow0[i];
+                spanValues[i] = v0 + wy1 * (srcRow1[i] - v0);
+            }
+
+            std::uint8_t* destRow = dest + static_cast<std::size_t>(y) * numDestValues;
+            const int* o0 = ofs0.data();
+            const int* o1 = ofs1.data();
+            const float* w1 = weight1.data();
+
+            #pragma omp simd
+            for (int i = 0; i < numDestValues; i++)
+            {
+                const float v0 = spanValues[o0[i]];
+                destRow[i] = static_cast<std::uint8_t>(v0 + w1[i] * (spanValues[o1[i]] - v0) + 0.5f);
+            }
+        }
+    }
+
+    return result;
+}
+
 void c_CpuAndBitmaps::RefreshRect(const wxRect& rect)
 {
     m_ImgView.GetContentsPanel().RefreshRect(rect, false);
 }
 
-c_CpuAndBitmaps::c_CpuAndBitmaps(c_ScrolledView& imgView)
-: m_ImgView(imgView)
+c_CpuAndBitmaps::c_CpuAndBitmaps(c_ScrolledView& imgView, bool useBlurPyramid)
+: m_Processor(useBlurPyramid), m_ProxyProcessor(useBlurPyramid), m_ViewportProcessor(useBlurPyramid), m_ImgView(imgView)
 {
     imgView.EnableContentsScrolling();
 
@@ -109,9 +436,15 @@ c_CpuAndBitmaps::c_CpuAndBitmaps(c_ScrolledView& imgView)
         }
     });
 
+    // only the full-resolution processor is worth (and can afford) keeping results for neighbouring settings
+    m_Processor.SetSpeculationEnabled(true);
+
+    m_ViewportProcessor.SetMaxThreads(static_cast<int>(std::max(1u, std::thread::hardware_concurrency() / VIEWPORT_THREADS_DIVISOR)));
+
     m_Processor.SetProcessingCompletedHandler([this](CompletionStatus status) {
         if (status == CompletionStatus::COMPLETED)
         {
+            m_ShownResult = ShownResult::FULL;
             UpdateSelectionAfterProcessing();
         }
         if (m_OnProcessingCompleted)
@@ -119,6 +452,23 @@ c_CpuAndBitmaps::c_CpuAndBitmaps(c_ScrolledView& imgView)
             m_OnProcessingCompleted(status);
         }
     });
+
+    m_ProxyProcessor.SetProcessingCompletedHandler([this](CompletionStatus status) {
+        // the proxy's result may arrive after the full-resolution one (e.g. if only the tone curve was changed)
+        if (status == CompletionStatus::COMPLETED && m_ShownResult == ShownResult::NONE && m_ProxyRequestId == m_RequestId)
+        {
+            m_ShownResult = ShownResult::PROXY;
+            UpdateSelectionWithProxyResult();
+        }
+    });
+
+    m_ViewportProcessor.SetProcessingCompletedHandler([this](CompletionStatus status) {
+        if (status == CompletionStatus::COMPLETED && m_ShownResult != ShownResult::FULL && m_ViewportRequestId == m_RequestId)
+        {
+            m_ShownResult = ShownResult::VIEWPORT;
+            UpdateSelectionWithViewportResult();
+        }
+    });
 }
 
 void c_CpuAndBitmaps::ImageViewScrolledOrResized(float zoomFactor)
@@ -126,6 +476,8 @@ void c_CpuAndBitmaps::ImageViewScrolledOrResized(float zoomFactor)
     m_NewZoomFactor = zoomFactor;
     if (m_Img && m_NewZoomFactor != ZOOM_NONE)
         m_ScalingTimer.StartOnce(IMAGE_SCALING_DELAY_MS);
+
+    ReprioritizeViewport(zoomFactor);
 }
 
 void c_CpuAndBitmaps::ImageViewZoomChanged(float zoomFactor)
@@ -135,6 +487,8 @@ void c_CpuAndBitmaps::ImageViewZoomChanged(float zoomFactor)
     {
         CreateScaledPreview(m_ZoomFactor);
     }
+
+    ReprioritizeViewport(zoomFactor);
 }
 
 void c_CpuAndBitmaps::SetImage(c_Image&& img, std::optional<wxRect> newSelection)
@@ -146,13 +500,12 @@ void c_CpuAndBitmaps::SetImage(c_Image&& img, std::optional<wxRect> newSelection
 
     m_Img = std::move(img);
 
-    m_ImgBmp = ImageToRgbBitmap(
-        *m_Img,
-        0,
-        0,
-        m_Img->GetWidth(),
-        m_Img->GetHeight()
-    );
+    {
+        c_Image rgbImage = m_Img->GetConvertedPixelFormatSubImage(PixelFormat::PIX_RGB8, 0, 0, m_Img->GetWidth(), m_Img->GetHeight());
+        // for storage, `rgbImage` uses `c_SimpleBuffer`, which has no row padding, so we can pass it directly to wxImage's constructor
+        m_ImgBmp = wxBitmap(wxImage(m_Img->GetWidth(), m_Img->GetHeight(), rgbImage.GetRowAs<unsigned char>(0), true));
+        BuildPreviewPyramid(rgbImage);
+    }
 
     if (m_ZoomFactor != ZOOM_NONE)
         CreateScaledPreview(m_ZoomFactor);
@@ -165,7 +518,121 @@ void c_CpuAndBitmaps::SetImage(c_Image&& img, std::optional<wxRect> newSelection
     {
         m_Processor.SetSelection(newSelection.value());
     }
-    m_Processor.ScheduleProcessing(req_type::Sharpening{});
+    SetProxyImage();
+    m_ViewportJobArea = wxRect{}; // the visible part will be copied anew
+    ScheduleProcessing(req_type::Sharpening{});
+}
+
+void c_CpuAndBitmaps::SetProxyImage()
+{
+    m_ProxyLevel = 0;
+    while (static_cast<std::int64_t>(m_Selection.width >> m_ProxyLevel) * (m_Selection.height >> m_ProxyLevel) > MAX_PROXY_PIXELS)
+    {
+        m_ProxyLevel++;
+    }
+
+    if (m_ProxyLevel > 0)
+    {
+        m_ProxyProcessor.AbortProcessing();
+        c_Image proxy = CreateReducedImage(m_Img.value(), m_Selection, m_ProxyLevel);
+        const wxRect proxyRect(0, 0, proxy.GetWidth(), proxy.GetHeight());
+        m_ProxyProcessor.SetProcessingSettings(GetProxySettings(m_ProcSettings, m_ProxyLevel));
+        m_ProxyProcessor.SetImage(std::move(proxy));
+        m_ProxyProcessor.SetSelection(proxyRect);
+    }
+}
+
+wxRect c_CpuAndBitmaps::GetVisibleImageArea(float zoomFactor)
+{
+    const wxPoint scrollPos = m_ImgView.CalcUnscrolledPosition(wxPoint(0, 0));
+    const wxSize viewSize = m_ImgView.GetContentsPanel().GetSize();
+    return wxRect(
+        static_cast<int>(scrollPos.x / zoomFactor),
+        static_cast<int>(scrollPos.y / zoomFactor),
+        static_cast<int>(std::ceil(viewSize.GetWidth() / zoomFactor)) + 1,
+        static_cast<int>(std::ceil(viewSize.GetHeight() / zoomFactor)) + 1
+    );
+}
+
+bool c_CpuAndBitmaps::SetViewportImage(float zoomFactor)
+{
+    const wxRect visible = GetVisibleImageArea(zoomFactor).Intersect(m_Selection);
+
+    // only large selections (the same which need a proxy) benefit from processing the visible part first
+    if (m_ProxyLevel == 0 || visible.IsEmpty() ||
+        static_cast<float>(visible.width) * visible.height > MAX_VIEWPORT_FRACTION * m_Selection.width * m_Selection.height)
+    {
+        if (!m_ViewportJobArea.IsEmpty())
+            m_ViewportProcessor.AbortProcessing();
+
+        m_ViewportArea = wxRect{};
+        m_ViewportJobArea = wxRect{};
+        return false;
+    }
+
+    const int margin = GetProcessingMargin(m_ProcSettings);
+    wxRect jobArea = visible;
+    jobArea.Inflate(margin, margin);
+    jobArea.Intersect(m_Selection);
+
+    m_ViewportArea = visible;
+    if (jobArea == m_ViewportJobArea)
+        return false;
+
+    m_ViewportJobArea = jobArea;
+    m_ViewportProcessor.AbortProcessing();
+    c_Image fragment(jobArea.width, jobArea.height, m_Img->GetPixelFormat());
+    c_Image::Copy(*m_Img, fragment, jobArea.x, jobArea.y, jobArea.width, jobArea.height, 0, 0);
+    m_ViewportProcessor.SetProcessingSettings(m_ProcSettings);
+    m_ViewportProcessor.SetImage(std::move(fragment));
+    m_ViewportProcessor.SetSelection(wxRect(0, 0, jobArea.width, jobArea.height));
+
+    return true;
+}
+
+void c_CpuAndBitmaps::ReprioritizeViewport(float zoomFactor)
+{
+    if (!m_Img.has_value() || m_ProxyLevel == 0 || m_ShownResult == ShownResult::FULL)
+        return;
+
+    const wxRect visible = GetVisibleImageArea(zoomFactor).Intersect(m_Selection);
+    if (visible.IsEmpty() || m_ViewportArea.Contains(visible))
+        return;
+
+    // `m_Processor` keeps processing the whole selection; only the (small) visible part is started anew
+    if (SetViewportImage(zoomFactor))
+    {
+        Log::Print("Visible part of selection changed, processing it first\n");
+        m_ViewportRequestId = m_RequestId;
+        m_ViewportProcessor.ScheduleProcessing(req_type::Sharpening{});
+    }
+}
+
+void c_CpuAndBitmaps::ScheduleProcessing(ProcessingRequest request)
+{
+    m_ShownResult = ShownResult::NONE;
+    m_RequestId += 1;
+    m_Processor.ScheduleProcessing(request);
+
+    // Applying only the tone curve is fast anyway; showing partial results first would just cause flicker.
+    if (std::holds_alternative<req_type::ToneCurve>(request))
+        return;
+
+    if (m_ProxyLevel > 0)
+    {
+        m_ProxyProcessor.SetProcessingSettings(GetProxySettings(m_ProcSettings, m_ProxyLevel));
+        m_ProxyRequestId = m_RequestId;
+        m_ProxyProcessor.ScheduleProcessing(request);
+    }
+
+    // if the processed fragment has changed, all processing steps are needed
+    const bool newViewportImage = SetViewportImage(m_ZoomFactor);
+    if (!m_ViewportJobArea.IsEmpty())
+    {
+        m_ViewportProcessor.SetProcessingSettings(m_ProcSettings);
+        m_ViewportRequestId = m_RequestId;
+        m_ViewportProcessor.ScheduleProcessing(newViewportImage ? ProcessingRequest{req_type::Sharpening{}} : request);
+    }
 }
 
 void c_CpuAndBitmaps::OnPaint(wxPaintEvent&)
@@ -286,12 +753,88 @@ void c_CpuAndBitmaps::CreateScaledPreview(float zoomFactor)
     if (m_ScaledArea.GetBottom() >= m_ImgBmp.value().GetHeight())
         m_ScaledArea.SetBottom(m_ImgBmp.value().GetHeight() - 1);
 
-    wxBitmap srcBmp = m_ImgBmp.value().GetSubBitmap(m_ScaledArea);
-    m_BmpScaled = wxBitmap(srcBmp.ConvertToImage().Scale(
-        srcBmp.GetWidth() * zoomFactor,
-        srcBmp.GetHeight() * zoomFactor,
-        GetResizeQuality(m_ScalingMethod))
-    );
+    m_BmpScaled = CreateScaledFragment(m_ScaledArea, wxSize(
+        static_cast<int>(m_ScaledArea.width * zoomFactor),
+        static_cast<int>(m_ScaledArea.height * zoomFactor)
+    ));
+}
+
+void c_CpuAndBitmaps::BuildPreviewPyramid(const c_Image& rgbImage)
+{
+    IMPPG_ASSERT(rgbImage.GetPixelFormat() == PixelFormat::PIX_RGB8);
+
+    m_PreviewPyramid.clear();
+    m_PreviewPyramid.reserve(NUM_PYRAMID_LEVELS);
+    for (int level = 1; level <= NUM_PYRAMID_LEVELS; level++)
+    {
+        const c_Image& src = (level == 1) ? rgbImage : m_PreviewPyramid.back();
+        c_Image reduced((src.GetWidth() + 1) / 2, (src.GetHeight() + 1) / 2, PixelFormat::PIX_RGB8);
+        DownsampleRgb8(
+            src.GetRowAs<std::uint8_t>(0), src.GetBuffer().GetBytesPerRow(), src.GetWidth(), src.GetHeight(),
+            reduced.GetRowAs<std::uint8_t>(0), reduced.GetBuffer().GetBytesPerRow()
+        );
+        m_PreviewPyramid.push_back(std::move(reduced));
+    }
+}
+
+void c_CpuAndBitmaps::UpdatePreviewPyramid(const wxRect& area)
+{
+    if (m_PreviewPyramid.empty())
+        return;
+
+    // Align the area to the largest block size, so that the updated blocks of each level are complete.
+    constexpr int BLOCK = 1 << NUM_PYRAMID_LEVELS;
+    const wxSize imgSize = m_ImgBmp.value().GetSize();
+    const int xmin = area.GetLeft() / BLOCK * BLOCK;
+    const int ymin = area.GetTop() / BLOCK * BLOCK;
+    const int xmax = std::min(imgSize.GetWidth(), (area.GetRight() + BLOCK) / BLOCK * BLOCK) - 1;
+    const int ymax = std::min(imgSize.GetHeight(), (area.GetBottom() + BLOCK) / BLOCK * BLOCK) - 1;
+    if (xmin < 0 || ymin < 0 || xmax < xmin || ymax < ymin)
+        return;
+
+    wxImage changed = m_ImgBmp.value().GetSubBitmap(wxRect(wxPoint(xmin, ymin), wxPoint(xmax, ymax))).ConvertToImage();
+
+    const std::uint8_t* src = changed.GetData();
+    std::size_t srcStride = 3 * changed.GetWidth();
+    int srcWidth = changed.GetWidth();
+    int srcHeight = changed.GetHeight();
+    for (int level = 1; level <= NUM_PYRAMID_LEVELS; level++)
+    {
+        c_Image& reduced = m_PreviewPyramid[level - 1];
+        std::uint8_t* dest = reduced.GetRowAs<std::uint8_t>(ymin >> level) + 3 * (xmin >> level);
+        DownsampleRgb8(src, srcStride, srcWidth, srcHeight, dest, reduced.GetBuffer().GetBytesPerRow());
+
+        src = dest;
+        srcStride = reduced.GetBuffer().GetBytesPerRow();
+        srcWidth = (srcWidth + 1) / 2;
+        srcHeight = (srcHeight + 1) / 2;
+    }
+}
+
+wxBitmap c_CpuAndBitmaps::CreateScaledFragment(const wxRect& area, const wxSize& destSize) const
+{
+    if (destSize.x <= 0 || destSize.y <= 0)
+        return wxBitmap(std::max(destSize.x, 1), std::max(destSize.y, 1));
+
+    // the smallest level which is still not smaller than the destination
+    int level = 0;
+    while (level < static_cast<int>(m_PreviewPyramid.size()) &&
+           (2 << level) * destSize.x <= area.width &&
+           (2 << level) * destSize.y <= area.height)
+    {
+        level++;
+    }
+
+    if (level == 0)
+    {
+        return wxBitmap(m_ImgBmp.value().GetSubBitmap(area).ConvertToImage().Scale(
+            destSize.x, destSize.y, GetResizeQuality(m_ScalingMethod)
+        ));
+    }
+    else
+    {
+        return wxBitmap(ScaleReducedRgb8(m_PreviewPyramid[level - 1], level, area, destSize, m_ScalingMethod));
+    }
 }
 
 Histogram c_CpuAndBitmaps::GetHistogram()
@@ -318,6 +861,7 @@ void c_CpuAndBitmaps::NewSelection(
     wxBitmap restored = ImageToRgbBitmap(*m_Img, m_Selection.x, m_Selection.y, m_Selection.width, m_Selection.height);
     wxMemoryDC restoredDc(restored);
     wxMemoryDC(m_ImgBmp.value()).Blit(m_Selection.GetTopLeft(), m_Selection.GetSize(), &restoredDc, wxPoint(0, 0));
+    UpdatePreviewPyramid(m_Selection);
 
     if (m_ZoomFactor == ZOOM_NONE)
     {
@@ -358,9 +902,7 @@ void c_CpuAndBitmaps::NewSelection(
         scaledSelectionRst.Inflate(scaledSelectionDelta, scaledSelectionDelta);
 
         // create the scaled image fragment to restore
-        wxBitmap restoredScaled(m_ImgBmp.value().GetSubBitmap(selectionRst).ConvertToImage().Scale(
-            scaledSelectionRst.GetWidth(), scaledSelectionRst.GetHeight(),
-            GetResizeQuality(m_ScalingMethod)));
+        wxBitmap restoredScaled = CreateScaledFragment(selectionRst, scaledSelectionRst.GetSize());
 
         wxMemoryDC dcRestoredScaled(restoredScaled), dcScaled(m_BmpScaled.value());
 
@@ -394,35 +936,43 @@ void c_CpuAndBitmaps::NewSelection(
 
     m_Selection = selection;
     m_Processor.SetSelection(selection);
-    m_Processor.ScheduleProcessing(req_type::Sharpening{});
+    SetProxyImage();
+    m_ViewportJobArea = wxRect{}; // the visible part will be copied anew
+    ScheduleProcessing(req_type::Sharpening{});
 }
 
 void c_CpuAndBitmaps::NewProcessingSettings(const ProcessingSettings& procSettings)
 {
+    m_ProcSettings = procSettings;
     m_Processor.SetProcessingSettings(procSettings);
-    m_Processor.ScheduleProcessing(req_type::Sharpening{});
+    ScheduleProcessing(req_type::Sharpening{});
 }
 
 void c_CpuAndBitmaps::LRSettingsChanged(const ProcessingSettings& procSettings)
 {
+    m_ProcSettings = procSettings;
     m_Processor.SetProcessingSettings(procSettings);
-    m_Processor.ScheduleProcessing(req_type::Sharpening{});
+    ScheduleProcessing(req_type::Sharpening{});
 }
 
 void c_CpuAndBitmaps::UnshMaskSettingsChanged(const ProcessingSettings& procSettings, std::size_t maskIdx)
 {
+    m_ProcSettings = procSettings;
     m_Processor.SetProcessingSettings(procSettings);
-    m_Processor.ScheduleProcessing(req_type::UnsharpMasking{maskIdx});
+    ScheduleProcessing(req_type::UnsharpMasking{maskIdx});
 }
 
 void c_CpuAndBitmaps::ToneCurveChanged(const ProcessingSettings& procSettings)
 {
+    m_ProcSettings = procSettings;
     m_Processor.SetProcessingSettings(procSettings);
-    m_Processor.ScheduleProcessing(req_type::ToneCurve{});
+    ScheduleProcessing(req_type::ToneCurve{});
 }
 
 void c_CpuAndBitmaps::AbortProcessing()
 {
+    m_ViewportProcessor.AbortProcessing();
+    m_ProxyProcessor.AbortProcessing();
     m_Processor.AbortProcessing();
 }
 
@@ -431,29 +981,67 @@ void c_CpuAndBitmaps::UpdateSelectionAfterProcessing()
     Log::Print("Updating selection after processing\n");
 
     const c_Image& toneMappingOutput = m_Processor.GetProcessedOutput();
-    wxBitmap updatedArea = ImageToRgbBitmap(toneMappingOutput, 0, 0,
+    UpdateSelection(ImageToRgbBitmap(toneMappingOutput, 0, 0,
         toneMappingOutput.GetWidth(),
-        toneMappingOutput.GetHeight());
+        toneMappingOutput.GetHeight()), m_Selection);
+}
 
-    wxMemoryDC dcUpdated(updatedArea), dcMain(m_ImgBmp.value());
-    dcMain.Blit(m_Selection.GetTopLeft(), m_Selection.GetSize(), &dcUpdated, wxPoint(0, 0));
-    // `updatedArea` needs to be deselected from DC before we can call GetSubBitmap() on it (see below)
-    dcUpdated.SelectObject(wxNullBitmap);
+void c_CpuAndBitmaps::UpdateSelectionWithProxyResult()
+{
+    const c_Image& proxyOutput = m_ProxyProcessor.GetProcessedOutput();
+    const c_Image rgbProxy = proxyOutput.GetConvertedPixelFormatSubImage(
+        PixelFormat::PIX_RGB8, 0, 0, proxyOutput.GetWidth(), proxyOutput.GetHeight()
+    );
+    UpdateSelection(wxBitmap(ScaleReducedRgb8(
+        rgbProxy, m_ProxyLevel, wxRect(wxPoint(0, 0), m_Selection.GetSize()), m_Selection.GetSize(), ScalingMethod::LINEAR
+    )), m_Selection);
+}
+
+void c_CpuAndBitmaps::UpdateSelectionWithViewportResult()
+{
+    const c_Image& viewportOutput = m_ViewportProcessor.GetProcessedOutput();
+    UpdateSelection(ImageToRgbBitmap(viewportOutput,
+        m_ViewportArea.x - m_ViewportJobArea.x,
+        m_ViewportArea.y - m_ViewportJobArea.y,
+        m_ViewportArea.width,
+        m_ViewportArea.height), m_ViewportArea);
+}
+
+void c_CpuAndBitmaps::UpdateSelection(wxBitmap contents, const wxRect& area)
+{
+    {
+        wxMemoryDC dcUpdated(contents), dcMain(m_ImgBmp.value());
+        dcMain.Blit(area.GetTopLeft(), area.GetSize(), &dcUpdated, wxPoint(0, 0));
+        // `m_ImgBmp` needs to be deselected from DC before we can call GetSubBitmap() on it (see below)
+    }
+    UpdatePreviewPyramid(area);
 
     if (m_ZoomFactor == ZOOM_NONE)
     {
         m_ImgView.GetContentsPanel().RefreshRect(wxRect(
-            m_ImgView.CalcScrolledPosition(m_Selection.GetTopLeft()),
-            m_ImgView.CalcScrolledPosition(m_Selection.GetBottomRight())),
+            m_ImgView.CalcScrolledPosition(area.GetTopLeft()),
+            m_ImgView.CalcScrolledPosition(area.GetBottomRight())),
             false
         );
     }
     else if (m_BmpScaled)
     {
-        // area in `updatedArea` to use; based on `scaledSelection`, but limited to what is currently visible
+        // area in `m_ImgBmp` to use; based on `scaledSelection`, but limited to what is currently visible
         wxRect selectionRst;
-        // first, take the scaled selection and limit it to visible area
-        selectionRst = m_ScaledLogicalSelectionGetter();
+        // first, take the scaled selection (or its updated part) and limit it to visible area
+        if (area == m_Selection)
+        {
+            selectionRst = m_ScaledLogicalSelectionGetter();
+        }
+        else
+        {
+            selectionRst = wxRect(
+                static_cast<int>(area.x * m_ZoomFactor),
+                static_cast<int>(area.y * m_ZoomFactor),
+                static_cast<int>(area.width * m_ZoomFactor),
+                static_cast<int>(area.height * m_ZoomFactor)
+            );
+        }
         const wxPoint scrollPos = m_ImgView.GetScrollPosition();
         const wxSize viewSize = m_ImgView.GetContentsPanel().GetSize();
 
@@ -467,19 +1055,14 @@ void c_CpuAndBitmaps::UpdateSelectionAfterProcessing()
         selectionRst.width /= m_ZoomFactor;
         selectionRst.height /= m_ZoomFactor;
 
-        // third, translate it from `m_ImgBmp` to `updatedArea` coordinates
-        selectionRst.SetPosition(selectionRst.GetPosition() - m_Selection.GetPosition());
-
-        // limit `selectionRst` to fall within `updatedArea`
-        selectionRst.Intersect(wxRect(wxPoint(0, 0), updatedArea.GetSize()));
+        // limit `selectionRst` to fall within the updated area (already copied to `m_ImgBmp`)
+        selectionRst.Intersect(area);
 
         // the user could have scrolled the view during processing, check if anything is visible
         if (selectionRst.GetWidth() == 0 || selectionRst.GetHeight() == 0)
             return;
 
-        wxBitmap updatedAreaScaled(((updatedArea.GetSubBitmap(selectionRst).ConvertToImage().Scale(
-            scaledSelectionRst.GetWidth(), scaledSelectionRst.GetHeight(),
-            GetResizeQuality(m_ScalingMethod)))));
+        wxBitmap updatedAreaScaled = CreateScaledFragment(selectionRst, scaledSelectionRst.GetSize());
 
         wxMemoryDC dcUpdatedScaled(updatedAreaScaled), dcScaled(m_BmpScaled.value());
 
@@ -23,16 +23,29 @@ File description:
 
 #include "../../imppg_assert.h"
 #include "common/common.h"
+#include "common/scheduler.h"
 #include "cpu_bmp_proc.h"
+#include "cpu_bmp/lrdeconv.h"
 #include "cpu_bmp/message_ids.h"
+#include "logging/instrumentation.h"
 #include "logging/logging.h"
 #include "math_utils/convolution.h"
 #include "w_lrdeconv.h"
 #include "w_tcurve.h"
 #include "w_unshmask.h"
 
+#include <cmath>
+#include <cstdlib>
+#include <new>
+
 namespace imppg::backend {
 
+/// Changes of the number of L-R iterations by more than this are not followed by speculative precomputation.
+constexpr int MAX_SPECULATIVE_LR_ITERATIONS_STEP = 10;
+
+/// Smallest sigma supported by Gaussian convolution.
+constexpr float MIN_BLUR_SIGMA = 0.5f;
+
 c_Image CreateBlurredMonoImage(const c_Image& source)
 {
     IMPPG_ASSERT(source.GetPixelFormat() == PixelFormat::PIX_MONO32F);
@@ -50,44 +63,21 @@ c_Image CreateBlurredMonoImage(const c_Image& source)
     return blurred;
 }
 
-std::unique_ptr<IProcessingBackEnd> CreateCpuBmpProcessingBackend()
+std::unique_ptr<IProcessingBackEnd> CreateCpuBmpProcessingBackend(bool useBlurPyramid)
 {
-    return std::make_unique<c_CpuAndBitmapsProcessing>();
+    return std::make_unique<c_CpuAndBitmapsProcessing>(useBlurPyramid);
 }
 
 void c_CpuAndBitmapsProcessing::StartProcessing(c_Image img, ProcessingSettings procSettings)
 {
-    IMPPG_ASSERT(
-        img.GetPixelFormat() == PixelFormat::PIX_MONO32F ||
-        img.GetPixelFormat() == PixelFormat::PIX_RGB32F
-    );
-
-    m_Img.clear();
-
-    if (img.GetPixelFormat() == PixelFormat::PIX_MONO32F)
-    {
-        if (procSettings.unsharpMask.at(0).adaptive)
-        {
-            m_ImgMonoBlurred = CreateBlurredMonoImage(img);
-        }
-        m_Img.emplace_back(std::move(img));
-    }
-    else
-    {
-        if (procSettings.unsharpMask.at(0).adaptive)
-        {
-            const auto mono = img.ConvertPixelFormat(PixelFormat::PIX_MONO32F);
-            m_ImgMonoBlurred = CreateBlurredMonoImage(mono);
-        }
-
-        auto [r, g, b] = img.SplitRGB();
-        m_Img.emplace_back(std::move(r));
-        m_Img.emplace_back(std::move(g));
-        m_Img.emplace_back(std::move(b));
-    }
+    StartProcessing(std::make_shared<const c_Image>(std::move(img)), std::move(procSettings));
+}
 
-    SetSelection(m_Img.at(0).GetImageRect());
-    m_ProcSettings = procSettings;
+void c_CpuAndBitmapsProcessing::StartProcessing(std::shared_ptr<const c_Image> img, ProcessingSettings procSettings)
+{
+    m_ProcSettings = std::move(procSettings);
+    SetImage(std::move(img));
+    SetSelection(m_Img.at(0)->GetImageRect());
     m_UsePreciseToneCurveValues = true;
 
     ScheduleProcessing(req_type::Sharpening{});
@@ -121,7 +111,47 @@ const c_Image& c_CpuAndBitmapsProcessing::GetProcessedOutput()
     }
 }
 
-c_CpuAndBitmapsProcessing::c_CpuAndBitmapsProcessing()
+c_Image c_CpuAndBitmapsProcessing::TakeProcessedOutput()
+{
+    if (m_Worker)
+    {
+        m_Worker->Wait();
+    }
+    IMPPG_ASSERT(m_Output.toneCurve.valid);
+
+    c_Image result = [&]() {
+        if (m_Img.size() == 1)
+        {
+            c_Image output = std::move(m_Output.toneCurve.img.at(0));
+            m_Output.toneCurve.img.clear();
+            return output;
+        }
+        else
+        {
+            c_Image output = std::move(m_Output.toneCurve.combined.value());
+            m_Output.toneCurve.combined.reset();
+            return output;
+        }
+    }();
+
+    // the output buffers have been handed over, they will be reallocated by the next run
+    m_Output.toneCurve.valid = false;
+    m_Output.toneCurve.preciseValuesApplied = false;
+
+    // the caller does not need the input anymore; keeping a reference to it (possibly shared with the caller)
+    // would keep it in memory until the next image is set
+    StopSpeculation();
+    m_InputGeneration += 1;
+    m_Img.clear();
+    m_ImgMonoBlurred.reset();
+    m_LumaChroma = {};
+    m_Output.recombined = {};
+
+    return result;
+}
+
+c_CpuAndBitmapsProcessing::c_CpuAndBitmapsProcessing(bool useBlurPyramid)
+: m_UseBlurPyramid(useBlurPyramid)
 {
     m_EvtHandler.Bind(wxEVT_THREAD, &c_CpuAndBitmapsProcessing::OnThreadEvent, this);
 }
@@ -133,8 +163,8 @@ void c_CpuAndBitmapsProcessing::OnThreadEvent(wxThreadEvent& event)
     // In such case, ignore the event.
     if (event.GetInt() != m_CurrentThreadId)
     {
-        Log::Print(wxString::Format("Received an outdated event (%s) with threadId = %d\n",
-                event.GetId() == ID_PROCESSING_PROGRESS ? "progress" : "completion", event.GetInt()));
+        Log::PrintF("Received an outdated event (%s) with threadId = %d\n",
+                event.GetId() == ID_PROCESSING_PROGRESS ? "progress" : "completion", event.GetInt());
         return;
     }
 
@@ -142,8 +172,8 @@ void c_CpuAndBitmapsProcessing::OnThreadEvent(wxThreadEvent& event)
     {
         case ID_PROCESSING_PROGRESS:
         {
-            Log::Print(wxString::Format("Received a processing progress (%d%%) event from threadId = %d\n",
-                    event.GetPayload<WorkerEventPayload>().percentageComplete, event.GetInt()));
+            Log::PrintF("Received a processing progress (%d%%) event from threadId = %d\n",
+                    event.GetPayload<WorkerEventPayload>().percentageComplete, event.GetInt());
 
             if (m_ProcessingRequest.has_value())
             {
@@ -167,8 +197,8 @@ void c_CpuAndBitmapsProcessing::OnThreadEvent(wxThreadEvent& event)
         {
             const WorkerEventPayload &p = event.GetPayload<WorkerEventPayload>();
 
-            Log::Print(wxString::Format("Received a processing completion event from threadId = %d, status = %s\n",
-                    event.GetInt(), p.completionStatus == CompletionStatus::COMPLETED ? "COMPLETED" : "ABORTED"));
+            Log::PrintF("Received a processing completion event from threadId = %d, status = %s\n",
+                    event.GetInt(), p.completionStatus == CompletionStatus::COMPLETED ? "COMPLETED" : "ABORTED");
 
             OnProcessingStepCompleted(p.completionStatus);
 
@@ -189,7 +219,7 @@ void c_CpuAndBitmapsProcessing::OnThreadEvent(wxThreadEvent& event)
 
 bool c_CpuAndBitmapsProcessing::IsProcessingInProgress()
 {
-    return m_Worker && m_Worker->IsAlive();
+    return m_Worker && m_Worker->IsRunning();
 }
 
 void c_CpuAndBitmapsProcessing::ScheduleProcessing(ProcessingRequest request)
@@ -235,7 +265,7 @@ void c_CpuAndBitmapsProcessing::ScheduleProcessing(ProcessingRequest request)
     else
     {
         // Signal the worker thread to finish ASAP.
-        if (m_Worker) { m_Worker->Delete(); }
+        if (m_Worker) { m_Worker->Abort(); }
 
         // Set a flag so that we immediately restart the worker thread
         // after receiving the "processing finished" message.
@@ -277,15 +307,8 @@ void c_CpuAndBitmapsProcessing::OnProcessingStepCompleted(CompletionStatus statu
             [&](const req_type::ToneCurve&)
             {
                 m_Output.toneCurve.valid = true;
-
-                if (m_Img.size() == 3)
-                {
-                    m_Output.toneCurve.combined = c_Image::CombineRGB(
-                        m_Output.toneCurve.img.at(0),
-                        m_Output.toneCurve.img.at(1),
-                        m_Output.toneCurve.img.at(2)
-                    );
-                }
+                CombineToneCurveOutput();
+                StartSpeculation();
 
                 if (m_OnProcessingCompleted)
                 {
@@ -302,34 +325,58 @@ void c_CpuAndBitmapsProcessing::OnProcessingStepCompleted(CompletionStatus statu
 
 void c_CpuAndBitmapsProcessing::StartLRDeconvolution()
 {
+    const auto& channels = GetProcessingChannels();
+
     auto& img = m_Output.sharpening.img;
-    if (img.empty() ||
+    if (img.size() != channels.size() ||
         static_cast<int>(img.at(0).GetWidth()) != m_Selection.width ||
         static_cast<int>(img.at(0).GetHeight()) != m_Selection.height)
     {
         img.clear();
-        for (std::size_t i = 0; i < m_Img.size(); ++i)
+        for (std::size_t i = 0; i < channels.size(); ++i)
         {
             img.emplace_back(m_Selection.width, m_Selection.height, PixelFormat::PIX_MONO32F);
         }
+        m_Speculation.lrServedIterations = std::nullopt;
     }
 
-    // invalidate the current output and those of subsequent steps
+    const int iterations = m_ProcSettings.LucyRichardson.iterations;
+    const auto lrIteratesValidFor = std::make_tuple(
+        m_InputGeneration, m_ProcSettings.LucyRichardson.sigma, m_ProcSettings.LucyRichardson.deringing.enabled
+    );
+    if (m_Speculation.lrIteratesValidFor != lrIteratesValidFor)
+    {
+        m_Speculation.lrIterates.Clear();
+        m_Speculation.lrIteratesValidFor = lrIteratesValidFor;
+        m_Speculation.lrServedIterations = std::nullopt;
+    }
+    const std::size_t cacheCapacity = GetNeighbourCacheCapacity();
+    m_Speculation.lrIterates.Trim(iterations, cacheCapacity);
+
+    const auto cachedResult = (iterations > 0) ? m_Speculation.lrIterates.Find(iterations) : nullptr;
+
+    // invalidate the current output and those of subsequent steps; the version stays the same if the output
+    // is going to be the same cached result again (so that the unsharp mask blurs cached for it remain valid)
     m_Output.sharpening.valid = false;
+    if (!cachedResult || m_Speculation.lrServedIterations != iterations)
+    {
+        m_Output.sharpening.version = ++m_LastOutputVersion;
+    }
+    m_Speculation.lrServedIterations = cachedResult ? std::optional{iterations} : std::nullopt;
     for (auto& umres: m_Output.unsharpMask) { umres.valid = false; }
     m_Output.toneCurve.valid = false;
 
-    if (m_ProcSettings.LucyRichardson.iterations == 0)
+    if (iterations == 0)
     {
         Log::Print("Sharpening disabled, no work needed\n");
 
         // No processing required, just copy the selection into `output.sharpening.img`,
         // as it will be used by the subsequent processing steps.
 
-        for (std::size_t i = 0; i < m_Img.size(); ++i)
+        for (std::size_t i = 0; i < channels.size(); ++i)
         {
             c_Image::Copy(
-                m_Img.at(i),
+                *channels.at(i),
                 m_Output.sharpening.img.at(i),
                 m_Selection.x,
                 m_Selection.y,
@@ -341,18 +388,30 @@ void c_CpuAndBitmapsProcessing::StartLRDeconvolution()
         }
         OnProcessingStepCompleted(CompletionStatus::COMPLETED);
     }
+    else if (cachedResult)
+    {
+        Log::PrintF("Using cached result of %d L-R iteration(s)\n", iterations);
+
+        for (std::size_t ch = 0; ch < channels.size(); ++ch)
+        {
+            c_Image::Copy(cachedResult->at(ch), img.at(ch), 0, 0, m_Selection.width, m_Selection.height, 0, 0);
+            auto output = c_View<IImageBuffer>(img.at(ch).GetBuffer());
+            Clamp(output);
+        }
+        OnProcessingStepCompleted(CompletionStatus::COMPLETED);
+    }
     else
     {
-        Log::Print(wxString::Format("Launching L-R deconvolution worker thread (id = %d)\n",
-                m_CurrentThreadId));
+        Log::PrintF("Launching L-R deconvolution worker thread (id = %d)\n",
+                m_CurrentThreadId);
 
         // sharpening thread takes the currently selected fragment of the original image as input
 
         std::vector<c_View<const IImageBuffer>> input;
         std::vector<c_View<IImageBuffer>> output;
-        for (std::size_t ch = 0; ch < m_Img.size(); ++ch)
+        for (std::size_t ch = 0; ch < channels.size(); ++ch)
         {
-            input.emplace_back(m_Img.at(ch).GetBuffer(), m_Selection.x, m_Selection.y, m_Selection.width, m_Selection.height);
+            input.emplace_back(channels.at(ch)->GetBuffer(), m_Selection.x, m_Selection.y, m_Selection.width, m_Selection.height);
             output.emplace_back(m_Output.sharpening.img.at(ch).GetBuffer());
         }
 
@@ -362,13 +421,15 @@ void c_CpuAndBitmapsProcessing::StartLRDeconvolution()
                 0, // in the future we will pass the index of the currently open image
                 std::move(input),
                 std::move(output),
-                m_CurrentThreadId
+                m_CurrentThreadId,
+                m_MaxThreads
             },
             m_ProcSettings.LucyRichardson.sigma,
             m_ProcSettings.LucyRichardson.iterations,
             m_ProcSettings.LucyRichardson.deringing.enabled,
             DERINGING_BRIGHTNESS_THRESHOLD, m_ProcSettings.LucyRichardson.sigma,
-            m_DeringingWorkBuf
+            m_DeringingWorkBuf,
+            GetLRIterates(iterations, cacheCapacity)
         );
 
         if (m_ProgressTextHandler)
@@ -382,14 +443,16 @@ void c_CpuAndBitmapsProcessing::StartLRDeconvolution()
 
 void c_CpuAndBitmapsProcessing::StartUnsharpMasking(std::size_t maskIdx)
 {
+    const auto numChannels = GetProcessingChannels().size();
+
     auto& img = m_Output.unsharpMask.at(maskIdx).img;
-    if (img.empty() ||
+    if (img.size() != numChannels ||
         static_cast<int>(img.at(0).GetWidth()) != m_Selection.width ||
         static_cast<int>(img.at(0).GetHeight()) != m_Selection.height)
     {
         // create a new empty image to hold the unsharp masking result
         img.clear();
-        for (std::size_t ch = 0; ch < m_Img.size(); ++ch)
+        for (std::size_t ch = 0; ch < numChannels; ++ch)
         {
             img.emplace_back(m_Selection.width, m_Selection.height, PixelFormat::PIX_MONO32F);
         }
@@ -400,6 +463,7 @@ void c_CpuAndBitmapsProcessing::StartUnsharpMasking(std::size_t maskIdx)
     {
         m_Output.unsharpMask.at(i).valid = false;
     }
+    m_Output.unsharpMask.at(maskIdx).version = ++m_LastOutputVersion;
     m_Output.toneCurve.valid = false;
 
     const auto& prevStepOutput = [&]() -> auto& {
@@ -413,10 +477,13 @@ void c_CpuAndBitmapsProcessing::StartUnsharpMasking(std::size_t maskIdx)
         }
     }();
 
+    auto& blurCache = GetUnsharpMaskBlurs(maskIdx);
+    const std::size_t cacheCapacity = GetNeighbourCacheCapacity();
+    blurCache.Trim(m_ProcSettings.unsharpMask.at(maskIdx).sigma, cacheCapacity);
+
     if (!m_ProcSettings.unsharpMask.at(maskIdx).IsEffective())
     {
         // no processing required, just take the previous step's output
-        const auto numChannels = m_Img.size();
         for (std::size_t ch = 0; ch < numChannels; ++ch)
         {
             c_Image::Copy(
@@ -429,11 +496,11 @@ void c_CpuAndBitmapsProcessing::StartUnsharpMasking(std::size_t maskIdx)
     }
     else
     {
-        Log::Print(wxString::Format("Launching unsharp masking worker thread (id = %d)\n", m_CurrentThreadId));
+        Log::PrintF("Launching unsharp masking worker thread (id = %d)\n", m_CurrentThreadId);
 
         std::vector<c_View<const IImageBuffer>> input;
         std::vector<c_View<IImageBuffer>> output;
-        for (std::size_t ch = 0; ch < m_Img.size(); ++ch)
+        for (std::size_t ch = 0; ch < numChannels; ++ch)
         {
             input.emplace_back(prevStepOutput.at(ch).GetBuffer());
             output.emplace_back(m_Output.unsharpMask.at(maskIdx).img.at(ch).GetBuffer());
@@ -449,10 +516,13 @@ void c_CpuAndBitmapsProcessing::StartUnsharpMasking(std::size_t maskIdx)
                 0,
                 std::move(input),
                 std::move(output),
-                m_CurrentThreadId
+                m_CurrentThreadId,
+                m_MaxThreads
             },
             std::move(blurred),
-            m_ProcSettings.unsharpMask.at(maskIdx)
+            m_ProcSettings.unsharpMask.at(maskIdx),
+            m_UseBlurPyramid,
+            (cacheCapacity > 0) ? &blurCache : nullptr
         );
 
         if (m_ProgressTextHandler)
@@ -466,13 +536,16 @@ void c_CpuAndBitmapsProcessing::StartUnsharpMasking(std::size_t maskIdx)
 
 void c_CpuAndBitmapsProcessing::StartToneCurve()
 {
+    const auto& toneCurveInput = GetToneCurveInput();
+    const auto numChannels = toneCurveInput.size();
+
     auto& img = m_Output.toneCurve.img;
-    if (img.empty() ||
+    if (img.size() != numChannels ||
         static_cast<int>(img.at(0).GetWidth()) != m_Selection.width ||
         static_cast<int>(img.at(0).GetHeight()) != m_Selection.height)
     {
         img.clear();
-        for (std::size_t i = 0; i < m_Img.size(); ++i)
+        for (std::size_t i = 0; i < numChannels; ++i)
         {
             img.emplace_back(m_Selection.width, m_Selection.height, PixelFormat::PIX_MONO32F);
         }
@@ -487,10 +560,10 @@ void c_CpuAndBitmapsProcessing::StartToneCurve()
     {
         Log::Print("Tone curve is an identity map, no work needed\n");
 
-        for (std::size_t ch = 0; ch < m_Img.size(); ++ch)
+        for (std::size_t ch = 0; ch < numChannels; ++ch)
         {
             c_Image::Copy(
-                checked_back(m_Output.unsharpMask).img.at(ch),
+                toneCurveInput.at(ch),
                 m_Output.toneCurve.img.at(ch),
                 0,
                 0,
@@ -505,16 +578,16 @@ void c_CpuAndBitmapsProcessing::StartToneCurve()
     }
     else
     {
-        Log::Print(wxString::Format("Launching tone curve worker thread (id = %d)\n",
-                m_CurrentThreadId));
+        Log::PrintF("Launching tone curve worker thread (id = %d)\n",
+                m_CurrentThreadId);
 
         // tone curve thread takes the output of unsharp masking as input
 
         std::vector<c_View<const IImageBuffer>> input;
         std::vector<c_View<IImageBuffer>> output;
-        for (std::size_t ch = 0; ch < m_Img.size(); ++ch)
+        for (std::size_t ch = 0; ch < numChannels; ++ch)
         {
-            input.emplace_back(checked_back(m_Output.unsharpMask).img.at(ch).GetBuffer());
+            input.emplace_back(toneCurveInput.at(ch).GetBuffer());
             output.emplace_back(m_Output.toneCurve.img.at(ch).GetBuffer());
         }
 
@@ -524,7 +597,8 @@ void c_CpuAndBitmapsProcessing::StartToneCurve()
                 0, // in the future we will pass the index of currently open image
                 std::move(input),
                 std::move(output),
-                m_CurrentThreadId
+                m_CurrentThreadId,
+                m_MaxThreads
             },
             m_ProcSettings.toneCurve,
             m_UsePreciseToneCurveValues
@@ -554,6 +628,8 @@ void c_CpuAndBitmapsProcessing::StartProcessing()
 
     m_ProcessingScheduled = false;
 
+    StopSpeculation();
+
     // Make sure that if there are outdated thread events out there, they will be recognized
     // as such and discarded (`currentThreadId` will be sent from worker in event.GetInt()).
     // See also: OnThreadEvent().
@@ -570,19 +646,21 @@ void c_CpuAndBitmapsProcessing::StartProcessing()
 
 c_CpuAndBitmapsProcessing::~c_CpuAndBitmapsProcessing()
 {
+    StopSpeculation();
     if (m_Worker)
     {
-        m_Worker->Delete();
+        m_Worker->Abort();
         m_Worker->Wait();
     }
 }
 
 void c_CpuAndBitmapsProcessing::AbortProcessing()
 {
+    StopSpeculation();
     if (m_Worker)
     {
         Log::Print("Sending abort request to the worker thread\n");
-        m_Worker->Delete();
+        m_Worker->Abort();
         m_Worker->Wait();
     }
 }
@@ -596,21 +674,26 @@ void c_CpuAndBitmapsProcessing::ApplyPreciseToneCurveValues()
         return;
     }
 
+    StopSpeculation();
+
+    const auto& channels = GetProcessingChannels();
+    const auto numChannels = channels.size();
+
     if (!checked_back(m_Output.unsharpMask).valid)
     {
         for (auto& umOutput: m_Output.unsharpMask)
         {
+            umOutput.version = ++m_LastOutputVersion;
             umOutput.img.clear();
-            for (std::size_t i = 0; i < m_Img.size(); ++i)
+            for (std::size_t i = 0; i < numChannels; ++i)
             {
                 umOutput.img.emplace_back(m_Selection.width, m_Selection.height, PixelFormat::PIX_MONO32F);
             }
 
-            const auto numChannels = m_Img.size();
             for (std::size_t ch = 0; ch < numChannels; ++ch)
             {
                 c_Image::Copy(
-                    m_Img.at(ch),
+                    *channels.at(ch),
                     umOutput.img.at(ch),
                     m_Selection.x,
                     m_Selection.y,
@@ -623,18 +706,20 @@ void c_CpuAndBitmapsProcessing::ApplyPreciseToneCurveValues()
         }
     }
 
+    const auto& toneCurveInput = GetToneCurveInput();
+
     if (!m_Output.toneCurve.valid)
     {
         m_Output.toneCurve.img.clear();
-        for (std::size_t i = 0; i < m_Img.size(); ++i)
+        for (std::size_t i = 0; i < toneCurveInput.size(); ++i)
         {
             m_Output.toneCurve.img.emplace_back(m_Selection.width, m_Selection.height, PixelFormat::PIX_MONO32F);
         }
 
-        for (std::size_t i = 0; i < m_Img.size(); ++i)
+        for (std::size_t i = 0; i < toneCurveInput.size(); ++i)
         {
             c_Image::Copy(
-                checked_back(m_Output.unsharpMask).img.at(i),
+                toneCurveInput.at(i),
                 m_Output.toneCurve.img.at(i),
                 0,
                 0,
@@ -646,57 +731,153 @@ void c_CpuAndBitmapsProcessing::ApplyPreciseToneCurveValues()
         }
     }
 
-    IMPPG_ASSERT(checked_back(m_Output.unsharpMask).img.at(0).GetImageRect() == m_Output.toneCurve.img.at(0).GetImageRect());
+    IMPPG_ASSERT(toneCurveInput.at(0).GetImageRect() == m_Output.toneCurve.img.at(0).GetImageRect());
 
-    c_Image& src = checked_back(m_Output.unsharpMask).img.at(0);
-    c_Image& dest = m_Output.toneCurve.img.at(0);
-    for (unsigned y = 0; y < src.GetHeight(); ++y)
+    for (std::size_t ch = 0; ch < toneCurveInput.size(); ++ch)
     {
-        m_ProcSettings.toneCurve.ApplyPreciseToneCurve(
-            src.GetRowAs<float>(y),
-            dest.GetRowAs<float>(y),
-            src.GetWidth()
-        );
+        const c_Image& src = toneCurveInput.at(ch);
+        c_Image& dest = m_Output.toneCurve.img.at(ch);
+        for (unsigned y = 0; y < src.GetHeight(); ++y)
+        {
+            m_ProcSettings.toneCurve.ApplyPreciseToneCurve(
+                src.GetRowAs<float>(y),
+                dest.GetRowAs<float>(y),
+                src.GetWidth()
+            );
+        }
     }
+    CombineToneCurveOutput();
 
     m_Output.toneCurve.preciseValuesApplied = true;
 }
 
+const std::vector<std::shared_ptr<const c_Image>>& c_CpuAndBitmapsProcessing::GetProcessingChannels()
+{
+    if (!IsLuminanceOnly())
+    {
+        return m_Img;
+    }
+
+    if (m_LumaChroma.luma.empty())
+    {
+        auto [luma, chromaBlue, chromaRed] = c_Image::CombineRGB(*m_Img.at(0), *m_Img.at(1), *m_Img.at(2)).SplitLumaChroma();
+
+        if (m_ProcSettings.color.chromaDenoise)
+        {
+            for (c_Image* chroma: { &chromaBlue, &chromaRed })
+            {
+                c_Image denoised(chroma->GetWidth(), chroma->GetHeight(), PixelFormat::PIX_MONO32F);
+                ConvolveSeparable(
+                    c_PaddedArrayPtr(chroma->GetRowAs<const float>(0), chroma->GetWidth(), chroma->GetHeight(), chroma->GetBuffer().GetBytesPerRow()),
+                    c_PaddedArrayPtr(denoised.GetRowAs<float>(0), denoised.GetWidth(), denoised.GetHeight(), denoised.GetBuffer().GetBytesPerRow()),
+                    Default::CHROMA_DENOISE_SIGMA
+                );
+                *chroma = std::move(denoised);
+            }
+        }
+
+        m_LumaChroma.luma.emplace_back(std::make_shared<const c_Image>(std::move(luma)));
+        m_LumaChroma.chromaBlue = std::move(chromaBlue);
+        m_LumaChroma.chromaRed = std::move(chromaRed);
+    }
+
+    return m_LumaChroma.luma;
+}
+
+const std::vector<c_Image>& c_CpuAndBitmapsProcessing::GetToneCurveInput()
+{
+    const UnsharpMaskResult& umOutput = checked_back(m_Output.unsharpMask);
+    if (!IsLuminanceOnly())
+    {
+        return umOutput.img;
+    }
+
+    auto& recombined = m_Output.recombined;
+    if (recombined.img.empty() || recombined.version != umOutput.version)
+    {
+        // chrominance is not processed; take the selected fragment as it is
+        const auto selectionChroma = [&](const c_Image& chroma) {
+            c_Image result(m_Selection.width, m_Selection.height, PixelFormat::PIX_MONO32F);
+            c_Image::Copy(chroma, result, m_Selection.x, m_Selection.y, m_Selection.width, m_Selection.height, 0, 0);
+            return result;
+        };
+
+        auto [red, green, blue] = c_Image::CombineLumaChroma(
+            umOutput.img.at(0),
+            selectionChroma(m_LumaChroma.chromaBlue.value()),
+            selectionChroma(m_LumaChroma.chromaRed.value())
+        ).SplitRGB();
+
+        recombined.img.clear();
+        recombined.img.push_back(std::move(red));
+        recombined.img.push_back(std::move(green));
+        recombined.img.push_back(std::move(blue));
+        recombined.version = umOutput.version;
+    }
+
+    return recombined.img;
+}
+
+void c_CpuAndBitmapsProcessing::CombineToneCurveOutput()
+{
+    if (m_Img.size() == 3)
+    {
+        m_Output.toneCurve.combined = c_Image::CombineRGB(
+            m_Output.toneCurve.img.at(0),
+            m_Output.toneCurve.img.at(1),
+            m_Output.toneCurve.img.at(2)
+        );
+    }
+}
+
 void c_CpuAndBitmapsProcessing::SetSelection(wxRect selection)
 {
+    StopSpeculation();
+    m_InputGeneration += 1;
     m_Selection = selection;
     m_DeringingWorkBuf.resize(selection.width * selection.height);
 }
 
 void c_CpuAndBitmapsProcessing::SetImage(c_Image img)
+{
+    SetImage(std::make_shared<const c_Image>(std::move(img)));
+}
+
+void c_CpuAndBitmapsProcessing::SetImage(std::shared_ptr<const c_Image> img)
 {
     IMPPG_ASSERT(
-        img.GetPixelFormat() == PixelFormat::PIX_MONO32F ||
-        img.GetPixelFormat() == PixelFormat::PIX_RGB32F
+        img->GetPixelFormat() == PixelFormat::PIX_MONO32F ||
+        img->GetPixelFormat() == PixelFormat::PIX_RGB32F
     );
 
+    StopSpeculation();
+    m_InputGeneration += 1;
+
     m_Img.clear();
+    m_LumaChroma = {};
+    m_Output.recombined = {};
 
-    if (img.GetPixelFormat() == PixelFormat::PIX_MONO32F)
+    if (img->GetPixelFormat() == PixelFormat::PIX_MONO32F)
     {
         if (m_ProcSettings.unsharpMask.at(0).adaptive)
         {
-            m_ImgMonoBlurred = CreateBlurredMonoImage(img);
+            m_ImgMonoBlurred = CreateBlurredMonoImage(*img);
         }
+        // the caller's image is only read from, so it can be shared instead of copied
         m_Img.emplace_back(std::move(img));
     }
     else
     {
         if (m_ProcSettings.unsharpMask.at(0).adaptive)
         {
-            const auto mono = img.ConvertPixelFormat(PixelFormat::PIX_MONO32F);
+            const auto mono = img->ConvertPixelFormat(PixelFormat::PIX_MONO32F);
             m_ImgMonoBlurred = CreateBlurredMonoImage(mono);
         }
 
-        auto [r, g, b] = img.SplitRGB();
-        m_Img.emplace_back(std::move(r));
-        m_Img.emplace_back(std::move(g));
-        m_Img.emplace_back(std::move(b));
+        auto [r, g, b] = img->SplitRGB();
+        m_Img.emplace_back(std::make_shared<const c_Image>(std::move(r)));
+        m_Img.emplace_back(std::make_shared<const c_Image>(std::move(g)));
+        m_Img.emplace_back(std::make_shared<const c_Image>(std::move(b)));
     }
 }
 
@@ -717,22 +898,57 @@ void c_CpuAndBitmapsProcessing::SetProcessingSettings(ProcessingSettings procSet
 {
     IMPPG_ASSERT(procSettings.unsharpMask.size() >= 1);
 
+    StopSpeculation();
+
     const bool adaptiveUnshMaskSwitchedOn =
         procSettings.AdaptiveUnshMaskEnabled() && ! m_ProcSettings.AdaptiveUnshMaskEnabled();
 
     const bool unshMaskCountChanged = (procSettings.unsharpMask.size() != m_ProcSettings.unsharpMask.size());
 
+    const bool colorModeChanged =
+        procSettings.color.luminanceOnly != m_ProcSettings.color.luminanceOnly ||
+        procSettings.color.chromaDenoise != m_ProcSettings.color.chromaDenoise;
+
+    m_Speculation.lastChange = [&]() -> decltype(m_Speculation.lastChange) {
+        if (unshMaskCountChanged) { return std::monostate{}; }
+
+        const int iterationsStep = procSettings.LucyRichardson.iterations - m_ProcSettings.LucyRichardson.iterations;
+        if (iterationsStep != 0)
+        {
+            if (std::abs(iterationsStep) <= MAX_SPECULATIVE_LR_ITERATIONS_STEP)
+            {
+                return LRIterationsChange{iterationsStep};
+            }
+            else
+            {
+                return std::monostate{};
+            }
+        }
+
+        for (std::size_t i = 0; i < procSettings.unsharpMask.size(); ++i)
+        {
+            const float sigmaStep = procSettings.unsharpMask[i].sigma - m_ProcSettings.unsharpMask[i].sigma;
+            if (sigmaStep != 0.0f)
+            {
+                return UnsharpMaskSigmaChange{i, sigmaStep};
+            }
+        }
+
+        // other parameters (e.g. the tone curve) do not affect the neighbouring values' results
+        return m_Speculation.lastChange;
+    }();
+
     m_ProcSettings = std::move(procSettings);
 
     if (adaptiveUnshMaskSwitchedOn && !m_Img.empty())
     {
-        if (m_Img.at(0).GetPixelFormat() == PixelFormat::PIX_MONO32F)
+        if (m_Img.size() == 1)
         {
-            m_ImgMonoBlurred = CreateBlurredMonoImage(m_Img.at(0));
+            m_ImgMonoBlurred = CreateBlurredMonoImage(*m_Img.at(0));
         }
         else
         {
-            const auto mono = c_Image::CombineRGB(m_Img.at(0), m_Img.at(1), m_Img.at(2));
+            const auto mono = c_Image::CombineRGB(*m_Img.at(0), *m_Img.at(1), *m_Img.at(2)).ConvertPixelFormat(PixelFormat::PIX_MONO32F);
             m_ImgMonoBlurred = CreateBlurredMonoImage(mono);
         }
     }
@@ -741,6 +957,247 @@ void c_CpuAndBitmapsProcessing::SetProcessingSettings(ProcessingSettings procSet
     {
         m_Output.unsharpMask = std::vector(m_ProcSettings.unsharpMask.size(), UnsharpMaskResult{});
     }
+
+    if (colorModeChanged)
+    {
+        // the worker thread may be using the luminance image
+        AbortProcessing();
+        m_LumaChroma = {};
+        m_Output.recombined = {};
+        m_InputGeneration += 1;
+
+        // outputs of all steps have a different number of channels now
+        m_Output.sharpening.valid = false;
+        for (auto& umres: m_Output.unsharpMask) { umres.valid = false; }
+        m_Output.toneCurve.valid = false;
+    }
+}
+
+std::size_t c_CpuAndBitmapsProcessing::GetNeighbourCacheCapacity()
+{
+    if (!m_SpeculationEnabled || m_Img.empty()) { return 0; }
+
+    return backend::GetNeighbourCacheCapacity(m_Selection.width, m_Selection.height, GetProcessingChannels().size());
+}
+
+LRIterates c_CpuAndBitmapsProcessing::GetLRIterates(int iterations, std::size_t cacheCapacity)
+{
+    LRIterates iterates;
+    if (cacheCapacity == 0) { return iterates; }
+
+    if (const auto preceding = m_Speculation.lrIterates.FindPreceding(iterations))
+    {
+        iterates.initialIteration = preceding->first;
+        iterates.initialEstimate = preceding->second;
+    }
+
+    iterates.cache = &m_Speculation.lrIterates;
+    // the estimates which will be reached on the way to `iterations` are the neighbours in the direction of
+    // the last change (when continuing from a smaller number of iterations)
+    const int step = std::holds_alternative<LRIterationsChange>(m_Speculation.lastChange)
+        ? std::get<LRIterationsChange>(m_Speculation.lastChange).step
+        : 1;
+    for (const int toKeep: { iterations, iterations - std::abs(step), iterations + std::abs(step) })
+    {
+        if (iterates.toKeep.size() < cacheCapacity) { iterates.toKeep.push_back(toKeep); }
+    }
+
+    return iterates;
+}
+
+c_NeighbourCache<float>& c_CpuAndBitmapsProcessing::GetUnsharpMaskBlurs(std::size_t maskIdx)
+{
+    m_Speculation.unsharpMaskBlurs.resize(m_Output.unsharpMask.size());
+
+    const std::uint64_t inputVersion = (0 == maskIdx)
+        ? m_Output.sharpening.version
+        : m_Output.unsharpMask.at(maskIdx - 1).version;
+
+    auto& blurs = m_Speculation.unsharpMaskBlurs.at(maskIdx);
+    if (blurs.inputVersion != inputVersion)
+    {
+        blurs.blurs.Clear();
+        blurs.inputVersion = inputVersion;
+    }
+
+    return blurs.blurs;
+}
+
+void c_CpuAndBitmapsProcessing::StopSpeculation()
+{
+    if (m_Speculation.task.valid())
+    {
+        m_Speculation.cancellation.Cancel();
+        m_Speculation.task.get();
+    }
+}
+
+void c_CpuAndBitmapsProcessing::StartSpeculation()
+{
+    StopSpeculation();
+
+    const std::size_t capacity = GetNeighbourCacheCapacity();
+    if (capacity == 0) { return; }
+
+    // the worker threads may have stored more entries than the capacity allows
+    m_Speculation.lrIterates.Trim(m_ProcSettings.LucyRichardson.iterations, capacity);
+    for (std::size_t i = 0; i < m_Speculation.unsharpMaskBlurs.size() && i < m_ProcSettings.unsharpMask.size(); ++i)
+    {
+        m_Speculation.unsharpMaskBlurs[i].blurs.Trim(m_ProcSettings.unsharpMask[i].sigma, capacity);
+    }
+
+    auto task = std::visit(Overload{
+        [&](const std::monostate&) -> std::function<void(const c_CancellationToken&)> { return {}; },
+
+        [&](const LRIterationsChange& change)
+        {
+            return GetLRSpeculation(m_ProcSettings.LucyRichardson.iterations, change.step);
+        },
+
+        [&](const UnsharpMaskSigmaChange& change)
+        {
+            return GetUnsharpMaskSpeculation(change.maskIdx, change.step);
+        }
+    }, m_Speculation.lastChange);
+
+    if (!task) { return; }
+
+    const double megapixels = static_cast<double>(m_Selection.width) * m_Selection.height / 1.0e6;
+
+    m_Speculation.cancellation = c_CancellationToken{};
+    m_Speculation.task = c_TaskScheduler::Get().Submit(
+        [task = std::move(task), cancellation = m_Speculation.cancellation, megapixels]() {
+            Log::c_StageTimer timer("Speculative precomputation", megapixels);
+            try
+            {
+                task(cancellation);
+            }
+            catch (const std::bad_alloc&)
+            {
+                // precomputation is optional; the cache keeps whatever has been completed
+                Log::Print("Not enough memory for speculative precomputation\n");
+            }
+        }
+    );
+}
+
+std::function<void(const c_CancellationToken&)> c_CpuAndBitmapsProcessing::GetLRSpeculation(int iterations, int step)
+{
+    const std::size_t capacity = GetNeighbourCacheCapacity();
+    // besides the speculated one, the cache must be able to keep the estimate the worker continues from
+    if (iterations == 0 || !m_Output.sharpening.valid || capacity < 2) { return {}; }
+
+    std::vector<int> targets;
+    // the next value is more likely to continue the last change than to reverse it, so it goes first;
+    // one cache entry is left for the current value
+    for (const int target: { iterations + step, iterations - step })
+    {
+        // the result of 1 iteration is the input itself
+        if (target >= 2 && !m_Speculation.lrIterates.Find(target) && targets.size() + 1 < capacity)
+        {
+            targets.push_back(target);
+        }
+    }
+    if (targets.empty()) { return {}; }
+
+    const auto& channels = GetProcessingChannels();
+    std::vector<c_View<const IImageBuffer>> input;
+    for (const auto& channel: channels)
+    {
+        input.emplace_back(channel->GetBuffer(), m_Selection.x, m_Selection.y, m_Selection.width, m_Selection.height);
+    }
+
+    // `StopSpeculation` is called before any change of the members used below
+    return [
+        this,
+        input = std::move(input),
+        targets = std::move(targets),
+        iterations,
+        capacity,
+        sigma = m_ProcSettings.LucyRichardson.sigma,
+        deringing = m_ProcSettings.LucyRichardson.deringing.enabled
+    ](const c_CancellationToken& cancellation) {
+        std::vector<c_View<IImageBuffer>> noOutput;
+        for (const int target: targets)
+        {
+            LRIterates iterates;
+            if (const auto preceding = m_Speculation.lrIterates.FindPreceding(target))
+            {
+                iterates.initialIteration = preceding->first;
+                iterates.initialEstimate = preceding->second;
+            }
+            iterates.cache = &m_Speculation.lrIterates;
+            iterates.toKeep = { target };
+
+            // the result of `target` is passed to the cache after `target` - 1 iterations (see `RunLucyRichardson`)
+            RunLucyRichardson(
+                input,
+                noOutput,
+                sigma,
+                target - 1,
+                LRDeringing{deringing, DERINGING_BRIGHTNESS_THRESHOLD, sigma, m_DeringingWorkBuf},
+                iterates,
+                [](int, int) {},
+                [&cancellation]() { return cancellation.IsCancellationRequested(); },
+                &cancellation
+            );
+            m_Speculation.lrIterates.Trim(iterations, capacity);
+
+            if (cancellation.IsCancellationRequested()) { return; }
+        }
+    };
+}
+
+std::function<void(const c_CancellationToken&)> c_CpuAndBitmapsProcessing::GetUnsharpMaskSpeculation(std::size_t maskIdx, float step)
+{
+    const std::size_t capacity = GetNeighbourCacheCapacity();
+    if (maskIdx >= m_Output.unsharpMask.size() ||
+        maskIdx >= m_Speculation.unsharpMaskBlurs.size() ||
+        !m_Output.unsharpMask.at(maskIdx).valid ||
+        !m_ProcSettings.unsharpMask.at(maskIdx).IsEffective() ||
+        capacity < 2)
+    {
+        return {};
+    }
+
+    auto& blurs = GetUnsharpMaskBlurs(maskIdx);
+    const float sigma = m_ProcSettings.unsharpMask.at(maskIdx).sigma;
+
+    std::vector<float> targets;
+    for (const float target: { sigma + step, sigma - step })
+    {
+        if (target >= MIN_BLUR_SIGMA && target <= MAX_GAUSSIAN_SIGMA && !blurs.Find(target) && targets.size() + 1 < capacity)
+        {
+            targets.push_back(target);
+        }
+    }
+    if (targets.empty()) { return {}; }
+
+    const auto& prevStepOutput = (0 == maskIdx) ? m_Output.sharpening.img : m_Output.unsharpMask.at(maskIdx - 1).img;
+    std::vector<c_View<const IImageBuffer>> input;
+    for (const auto& channel: prevStepOutput)
+    {
+        input.emplace_back(channel.GetBuffer());
+    }
+
+    // `StopSpeculation` is called before any change of the members used below
+    return [
+        &blurs,
+        input = std::move(input),
+        targets = std::move(targets),
+        sigma,
+        capacity,
+        useBlurPyramid = m_UseBlurPyramid
+    ](const c_CancellationToken& cancellation) {
+        for (const float target: targets)
+        {
+            auto blurred = BlurUnsharpMaskInput(input, target, useBlurPyramid, &cancellation);
+            if (cancellation.IsCancellationRequested()) { return; }
+
+            blurs.Store(target, std::move(blurred));
+            blurs.Trim(sigma, capacity);
+        }
+    };
 }
 
 } // namespace imppg::backend
@@ -25,14 +25,22 @@ File description:
 #define IMPPG_CPU_BMP_PROC_HEADER
 
 #include "backend/backend.h"
+#include "cpu_bmp/speculation.h"
 #include "cpu_bmp/worker.h"
 
+#include <cstdint>
 #include <functional>
+#include <future>
+#include <memory>
 #include <optional>
+#include <tuple>
+#include <variant>
 #include <vector>
 
 namespace imppg::backend {
 
+struct LRIterates;
+
 class c_CpuAndBitmapsProcessing: public IProcessingBackEnd
 {
 public:
@@ -41,17 +49,25 @@ public:
 
     void StartProcessing(c_Image img, ProcessingSettings procSettings) override;
 
+    void StartProcessing(std::shared_ptr<const c_Image> img, ProcessingSettings procSettings) override;
+
     void SetProcessingCompletedHandler(std::function<void(CompletionStatus)> handler) override;
 
     void SetProgressTextHandler(std::function<void(wxString)> handler) override;
 
     const c_Image& GetProcessedOutput() override;
 
+    /// Also releases the input image and the data derived from it (meant for one-off processing, e.g. by scripts);
+    /// an image has to be set again (see `SetImage` and `StartProcessing`) before further processing.
+    c_Image TakeProcessedOutput() override;
+
     void AbortProcessing() override;
 
     // --------------------------------------------------------------------------------------------
 
-    c_CpuAndBitmapsProcessing();
+    /// If `useBlurPyramid` is true, unsharp masks with large sigma are computed on decimated levels
+    /// (faster, but approximate; see ConvolveSeparablePyramid()).
+    explicit c_CpuAndBitmapsProcessing(bool useBlurPyramid = false);
 
     c_CpuAndBitmapsProcessing(const c_CpuAndBitmapsProcessing&) = delete;
 
@@ -65,6 +81,9 @@ public:
 
     void SetImage(c_Image img);
 
+    /// Sets the image to process; a mono image is shared with the caller instead of being copied.
+    void SetImage(std::shared_ptr<const c_Image> img);
+
     void SetSelection(wxRect selection);
 
     void SetProcessingSettings(ProcessingSettings procSettings);
@@ -82,6 +101,14 @@ public:
     /// Returns `true` if the processing thread is running.
     bool IsProcessingInProgress();
 
+    /// Enables keeping of the results for parameter values neighbouring the current ones and their speculative
+    /// precomputation at idle (see `StartSpeculation`). Meant for interactive use, as it needs additional memory.
+    void SetSpeculationEnabled(bool enabled) { m_SpeculationEnabled = enabled; }
+
+    /// If positive, limits the number of threads used by each processing step (e.g. for a preview
+    /// which must not slow down other processing much).
+    void SetMaxThreads(int maxThreads) { m_MaxThreads = maxThreads; }
+
 private:
 
     /// Creates and starts a background processing thread.
@@ -97,14 +124,71 @@ private:
 
     void OnThreadEvent(wxThreadEvent& event);
 
+    /// Returns `true` if only the luminance of an RGB image is to be processed.
+    bool IsLuminanceOnly() const { return m_ProcSettings.color.luminanceOnly && m_Img.size() == 3; }
+
+    /// Returns the channels to be processed: `m_Img` or its luminance (creating it if needed).
+    const std::vector<std::shared_ptr<const c_Image>>& GetProcessingChannels();
+
+    /// Returns the input of the tone curve step: the output of the last unsharp mask or, if only luminance
+    /// is processed, its recombination with chrominance into R, G, B channels (creating it if needed).
+    ///
+    /// The tone curve is applied to R, G, B rather than to luminance, as with unchanged chrominance a non-linear
+    /// curve would change the hue and saturation.
+    ///
+    const std::vector<c_Image>& GetToneCurveInput();
+
+    /// Combines the tone curve output channels (if there is more than one) into `m_Output.toneCurve.combined`.
+    void CombineToneCurveOutput();
+
+    /// Starts a background task which precomputes the results for the values neighbouring the current one
+    /// of the most recently changed parameter (see `m_Speculation.lastChange`); called when processing completes.
+    void StartSpeculation();
+
+    /// Cancels the speculative task (if running) and waits until it finishes; must be called before
+    /// changing anything it uses (input images, outputs of processing steps, `m_Speculation`).
+    void StopSpeculation();
+
+    /// Returns the capacity of `c_NeighbourCache` for results of the current selection.
+    std::size_t GetNeighbourCacheCapacity();
+
+    /// Returns the cached L-R estimates to be used and kept by the L-R worker thread.
+    LRIterates GetLRIterates(int iterations, std::size_t cacheCapacity);
+
+    /// Returns the blur cache of unsharp mask `maskIdx`; clears it first if the mask's input has changed.
+    c_NeighbourCache<float>& GetUnsharpMaskBlurs(std::size_t maskIdx);
+
+    /// Returns a task which stores in `m_Speculation.lrIterates` the results of `iterations` + `step`
+    /// and `iterations` - `step` L-R iterations; returns an empty function if there is nothing to do.
+    std::function<void(const c_CancellationToken&)> GetLRSpeculation(int iterations, int step);
+
+    /// Returns a task which stores in `m_Speculation.unsharpMaskBlurs` the blurred input of unsharp mask `maskIdx`
+    /// for its current sigma + `step` and sigma - `step`; returns an empty function if there is nothing to do.
+    std::function<void(const c_CancellationToken&)> GetUnsharpMaskSpeculation(std::size_t maskIdx, float step);
+
     /// Image being processed; if not empty, contains 1 element (mono luminance) or 3 (R, G, B channels).
-    std::vector<c_Image> m_Img;
+    /// Elements are never modified (a mono image may be shared with the caller of `StartProcessing`).
+    std::vector<std::shared_ptr<const c_Image>> m_Img;
 
     /// Mono version of `m_Img` used for adaptive unsharp masking.
     std::optional<c_Image> m_ImgMonoBlurred;
 
+    /// Luminance/chrominance representation of RGB `m_Img`; created on demand if luminance-only processing is enabled.
+    struct
+    {
+        std::vector<std::shared_ptr<const c_Image>> luma; ///< Empty or 1 element (luminance).
+        std::optional<c_Image> chromaBlue;
+        std::optional<c_Image> chromaRed;
+    } m_LumaChroma;
+
     wxRect m_Selection; ///< Fragment of `m_Img` selected for processing (in logical image coords).
 
+    /// Increased whenever the processed input (image, selection or colour mode) changes.
+    std::uint64_t m_InputGeneration{0};
+
+    /// Last value assigned to a processing step output's `version`.
+    std::uint64_t m_LastOutputVersion{0};
+
     wxEvtHandler m_EvtHandler;
 
     std::function<void(wxString)> m_ProgressTextHandler;
@@ -137,6 +221,7 @@ private:
     {
         std::vector<c_Image> img; ///< 1 or 3 elements: luminance or R, G, B channels.
         bool valid{false}; ///< `true` if the last unsharp masking request completed.
+        std::uint64_t version{0}; ///< Identifies the contents of `img`; changed whenever the step is started.
     };
 
     /// Incremental results of processing of the current selection.
@@ -148,17 +233,27 @@ private:
         {
             std::vector<c_Image> img; ///< 1 or 3 elements: luminance or R, G, B channels.
             bool valid{false}; ///< `true` if the last sharpening request completed.
+            /// Identifies the contents of `img`; changed whenever the step is started, unless it copies
+            /// the same cached L-R result again (see `m_Speculation.lrServedIterations`).
+            std::uint64_t version{0};
         } sharpening;
 
         /// Results of sharpening and unsharp masking. By convention, there is always at least one element,
         /// even if unsharp masking is a no-op (i.e., amount = 1.0).
         std::vector<UnsharpMaskResult> unsharpMask{UnsharpMaskResult{}};
 
+        /// Luminance-only processing: output of the last unsharp mask combined with chrominance (see `GetToneCurveInput`).
+        struct
+        {
+            std::vector<c_Image> img; ///< Empty or 3 elements: R, G, B channels.
+            std::uint64_t version{0}; ///< `version` of the unsharp mask output `img` has been created from.
+        } recombined;
+
         /// Results of sharpening, unsharp masking and applying of tone curve.
         struct
         {
             std::vector<c_Image> img; ///< 1 or 3 elements: luminance or R, G, B channels.
-            std::optional<c_Image> combined; ///< Luminance or combined R, G, B channels.
+            std::optional<c_Image> combined; ///< Combined R, G, B channels.
             bool valid{false}; ///< `true` if the last tone curve application request completed.
             bool preciseValuesApplied{false}; ///< 'true' if precise values of tone curve have been applied; happens only when saving output file.
         } toneCurve;
@@ -167,6 +262,50 @@ private:
     std::function<void(CompletionStatus)> m_OnProcessingCompleted;
 
     bool m_UsePreciseToneCurveValues{false};
+
+    bool m_UseBlurPyramid{false};
+
+    bool m_SpeculationEnabled{false};
+
+    int m_MaxThreads{0}; ///< See `SetMaxThreads`.
+
+    /// Change of the number of L-R iterations.
+    struct LRIterationsChange { int step; };
+
+    /// Change of an unsharp mask's sigma.
+    struct UnsharpMaskSigmaChange { std::size_t maskIdx; float step; };
+
+    struct UnsharpMaskBlurs
+    {
+        c_NeighbourCache<float> blurs; ///< Key: sigma.
+        std::uint64_t inputVersion{0}; ///< Version of the unsharp mask's input for which `blurs` are valid.
+    };
+
+    /// Results kept for reuse by subsequent processing requests which change a single parameter by a small step
+    /// (e.g. by dragging a slider). Filled by the processing steps and, at idle, by the speculative task.
+    /** Must not be accessed when the worker thread or the speculative task is running. */
+    struct
+    {
+        /// Unclamped L-R estimates; key: number of iterations (see `LRIterates`).
+        c_NeighbourCache<int> lrIterates;
+
+        /// Input generation, L-R sigma and deringing for which `lrIterates` are valid.
+        std::optional<std::tuple<std::uint64_t, float, bool>> lrIteratesValidFor;
+
+        /// Number of L-R iterations whose cached result has been copied to `m_Output.sharpening.img`;
+        /// empty if the output has been computed otherwise since.
+        std::optional<int> lrServedIterations;
+
+        /// Element [i] corresponds to unsharp mask `i`.
+        std::vector<UnsharpMaskBlurs> unsharpMaskBlurs;
+
+        /// The most recent change of a parameter whose next value is speculated about.
+        std::variant<std::monostate, LRIterationsChange, UnsharpMaskSigmaChange> lastChange;
+
+        c_CancellationToken cancellation;
+
+        std::future<void> task;
+    } m_Speculation;
 };
 
 }  // namespace imppg::backend
@@ -22,12 +22,12 @@ File description:
 */
 
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <cmath>
 #include <cstdint>
 #include <cstring>
 #include <memory>
-#include <tuple>
 #include <vector>
 
 //#include "imppg_assert.h"
@@ -42,7 +42,8 @@ File description:
 void Clamp(c_View<IImageBuffer>& buf)
 {
     IMPPG_ASSERT(buf.GetPixelFormat() == PixelFormat::PIX_MONO32F);
-    for (unsigned j = 0; j < buf.GetHeight(); j++)
+    #pragma omp parallel for
+    for (int j = 0; j < static_cast<int>(buf.GetHeight()); j++)
     {
         float* row = buf.GetRowAs<float>(j);
         for (unsigned i = 0; i < buf.GetWidth(); i++)
@@ -55,10 +56,10 @@ void Clamp(c_View<IImageBuffer>& buf)
     }
 }
 
-/// Reproduces original image from image in 'input' convolved with Gaussian kernel and writes it to 'output'.
+/// Reproduces original images from images in 'inputs' convolved with Gaussian kernel and writes them to 'outputs'.
 void LucyRichardsonGaussian(
-    c_View<const IImageBuffer>& input, ///< Contains a single 'float' value per pixel; size the same as 'output'
-    c_View<IImageBuffer>& output, ///< Contains a single 'float' value per pixel; size the same as 'input'
+    const std::vector<c_View<const IImageBuffer>>& inputs, ///< Contain a single 'float' value per pixel; all of the same size as 'outputs'
+    std::vector<c_View<IImageBuffer>>& outputs, ///< Contain a single 'float' value per pixel; all of the same size as 'inputs'
     int numIters,  ///< Number of iterations
     float sigma,   ///< sigma of the Gaussian kernel
     ConvolutionMethod convMethod,
@@ -67,87 +68,209 @@ void LucyRichardsonGaussian(
     std::function<void (int, int)> progressCallback,
 
     /// Called periodically to check if there was an "abort processing" request
-    std::function<bool ()> checkAbort
+    std::function<bool ()> checkAbort,
+
+    /// If set, the convolutions stop as soon as cancellation is requested (the outputs are then incomplete)
+    const c_CancellationToken* cancellation,
+
+    /// If set, the iterations start from these estimates instead of 'inputs'; same sizes as 'inputs'
+    const std::vector<c_View<const IImageBuffer>>* initialEstimates,
+
+    /// If set, called after every iteration
+    LRIterateCallback iterateCallback
 )
 {
-    IMPPG_ASSERT(input.GetPixelFormat() == PixelFormat::PIX_MONO32F);
-    int width = input.GetWidth(), height = input.GetHeight();
+    IMPPG_ASSERT(!inputs.empty() && (outputs.empty() || inputs.size() == outputs.size()));
+    IMPPG_ASSERT(initialEstimates == nullptr || initialEstimates->size() == inputs.size());
+    for (const auto& input: inputs)
+    {
+        IMPPG_ASSERT(input.GetPixelFormat() == PixelFormat::PIX_MONO32F);
+        IMPPG_ASSERT(input.GetWidth() == inputs[0].GetWidth() && input.GetHeight() == inputs[0].GetHeight());
+    }
 
-    auto prev = std::unique_ptr<float[]>(new float[width * height]);
-    auto next = std::unique_ptr<float[]>(new float[width * height]);
+    const int numChannels = static_cast<int>(inputs.size());
+    const int width = inputs[0].GetWidth(), height = inputs[0].GetHeight();
+    const std::size_t numPixels = static_cast<std::size_t>(width) * height;
+    const std::size_t totalPixels = numChannels * numPixels;
 
-    auto inputConvolvedDivT = std::unique_ptr<float[]>(new float[input.GetHeight() * input.GetWidth()]); // a transposed array
-    auto estimateConvolvedT = std::unique_ptr<float[]>(new float[input.GetHeight() * input.GetWidth()]); // a transposed array
-    auto conv2 = std::unique_ptr<float[]>(new float[input.GetWidth() * input.GetHeight()]);
+    int kernelRadius = static_cast<int>(ceil(sigma * 3.0f));
+    const bool useStandardConvolution = convMethod == ConvolutionMethod::STANDARD ||
+        convMethod == ConvolutionMethod::AUTO && kernelRadius < YOUNG_VAN_VLIET_MIN_KERNEL_RADIUS;
 
-    auto inputT = std::unique_ptr<float[]>(new float[input.GetHeight() * input.GetWidth()]); // a transposed array
+    // All the arrays below contain all channels, one after another ('numPixels' elements each).
 
-    Transpose(input.GetRowAs<const float>(0), inputT.get(), input.GetWidth(), input.GetHeight(),
-        input.GetBytesPerRow(), input.GetHeight() * sizeof(float), TRANSPOSITION_BLOCK_SIZE);
+    auto prev = std::unique_ptr<float[]>(new float[totalPixels]);
+    auto next = std::unique_ptr<float[]>(new float[totalPixels]);
 
-    auto tempBuf1 = std::unique_ptr<float[]>(new float[input.GetWidth() * input.GetHeight()]);
-    auto tempBuf2 = std::unique_ptr<float[]>(new float[input.GetWidth() * input.GetHeight()]);
+    auto inputConvolvedDivT = std::unique_ptr<float[]>(new float[totalPixels]); // a transposed array
+    // Holds the (transposed) convolved estimate, and then the convolved 'inputConvolvedDivT';
+    // their lifetimes do not overlap, so they share storage.
+    auto convolved = std::unique_ptr<float[]>(new float[totalPixels]);
+
+    auto inputT = std::unique_ptr<float[]>(new float[totalPixels]); // a transposed array
+
+    #pragma omp parallel for
+    for (int ch = 0; ch < numChannels; ch++)
+    {
+        auto input = inputs[ch];
+
+        Transpose(input.GetRowAs<const float>(0), inputT.get() + ch * numPixels, width, height,
+            input.GetBytesPerRow(), height * sizeof(float), TRANSPOSITION_BLOCK_SIZE);
+
+        auto initial = initialEstimates ? (*initialEstimates)[ch] : input;
+        for (int i = 0; i < height; i++)
+            memcpy(prev.get() + ch * numPixels + static_cast<std::size_t>(i) * width, initial.GetRow(i), width * sizeof(float));
+    }
+
+    // The standard convolution processes channels one by one, so it needs temporary buffers for a single channel only.
+    const std::size_t tempBufLength = useStandardConvolution ? numPixels : totalPixels;
+    auto tempBuf1 = std::unique_ptr<float[]>(new float[tempBufLength]);
+    auto tempBuf2 = std::unique_ptr<float[]>(new float[tempBufLength]);
 
-    int kernelRadius = static_cast<int>(ceil(sigma * 3.0f));
     auto kernel = std::unique_ptr<float[]>(new float[2 * kernelRadius - 1]);
     CalculateGaussianKernelProjection(kernel.get(), kernelRadius, sigma, true);
 
-    for (unsigned i = 0; i < input.GetHeight(); i++)
-        memcpy(prev.get() + i * input.GetWidth(), input.GetRow(i), input.GetWidth() * sizeof(float));
+    /// Convolves all channels of 'src' (each 'srcWidth' x 'srcHeight') and writes them transposed to 'dest'.
+    const auto convolveTranspose = [&](const float* src, float* dest, int srcWidth, int srcHeight)
+    {
+        if (useStandardConvolution)
+        {
+            for (int ch = 0; ch < numChannels; ch++)
+            {
+                ConvolveSeparableTranspose(
+                    c_PaddedArrayPtr<const float>(src + ch * numPixels, srcWidth, srcHeight),
+                    c_PaddedArrayPtr<float>(dest + ch * numPixels, srcHeight, srcWidth),
+                    kernel.get(), kernelRadius, tempBuf1.get(), tempBuf2.get(), cancellation);
+            }
+        }
+        else
+        {
+            std::vector<c_PaddedArrayPtr<const float>> srcChannels;
+            std::vector<c_PaddedArrayPtr<float>> destChannels;
+            for (int ch = 0; ch < numChannels; ch++)
+            {
+                srcChannels.emplace_back(src + ch * numPixels, srcWidth, srcHeight);
+                destChannels.emplace_back(dest + ch * numPixels, srcHeight, srcWidth);
+            }
+            ConvolveGaussianRecursiveTranspose(srcChannels, destChannels, sigma, tempBuf1.get(), tempBuf2.get(), cancellation);
+        }
+    };
 
     for (int i = 0; i < numIters; i++)
     {
-        if (convMethod == ConvolutionMethod::STANDARD ||
-            convMethod == ConvolutionMethod::AUTO && kernelRadius < YOUNG_VAN_VLIET_MIN_KERNEL_RADIUS)
+        convolveTranspose(prev.get(), convolved.get(), width, height);
+        if (IsCancelled(cancellation))
         {
-            ConvolveSeparableTranspose(
-                    c_PaddedArrayPtr<const float>(prev.get(), width, height),
-                    c_PaddedArrayPtr<float>(estimateConvolvedT.get(), height, width),
-                    kernel.get(), kernelRadius, tempBuf1.get(), tempBuf2.get());
+            checkAbort(); // lets the caller register the abort (the estimate is incomplete)
+            break;
         }
-        else
-            ConvolveGaussianRecursiveTranspose(
-                    c_PaddedArrayPtr<const float>(prev.get(), width, height),
-                    c_PaddedArrayPtr<float>(estimateConvolvedT.get(), height, width),
-                    sigma, tempBuf1.get(), tempBuf2.get());
 
         #pragma omp parallel for
-        for (unsigned j = 0; j < input.GetHeight() * input.GetWidth(); j++)
-            inputConvolvedDivT[j] = inputT[j] / (estimateConvolvedT[j] + 1.0e-8f); // add a small epsilon to prevent division by 0 and propagation of NaNs across output pixels
+        for (std::size_t j = 0; j < totalPixels; j++)
+            inputConvolvedDivT[j] = inputT[j] / (convolved[j] + 1.0e-8f); // add a small epsilon to prevent division by 0 and propagation of NaNs across output pixels
 
-        // Note that 'height' and 'width' are switched in the below calls, as we use transposed arrays for input
-        if (convMethod == ConvolutionMethod::STANDARD ||
-            convMethod == ConvolutionMethod::AUTO && kernelRadius < YOUNG_VAN_VLIET_MIN_KERNEL_RADIUS)
+        // Note that 'height' and 'width' are switched, as we use transposed arrays for input
+        convolveTranspose(inputConvolvedDivT.get(), convolved.get(), height, width);
+        if (IsCancelled(cancellation))
         {
-            ConvolveSeparableTranspose(
-                    c_PaddedArrayPtr<const float>(inputConvolvedDivT.get(), height, width),
-                    c_PaddedArrayPtr<float>(conv2.get(), width, height),
-                    kernel.get(), kernelRadius, tempBuf1.get(), tempBuf2.get());
+            checkAbort();
+            break;
         }
-        else
-            ConvolveGaussianRecursiveTranspose(
-                    c_PaddedArrayPtr<const float>(inputConvolvedDivT.get(), height, width),
-                    c_PaddedArrayPtr<float>(conv2.get(), width, width),
-                    sigma, tempBuf1.get(), tempBuf2.get());
 
         #pragma omp parallel for
-        for (unsigned j = 0; j < input.GetWidth() * input.GetHeight(); j++)
-            next[j] = prev[j] * conv2[j];
+        for (std::size_t j = 0; j < totalPixels; j++)
+            next[j] = prev[j] * convolved[j];
 
         std::swap(prev, next);
 
+        if (iterateCallback)
+        {
+            std::vector<c_PaddedArrayPtr<const float>> estimates;
+            for (int ch = 0; ch < numChannels; ch++)
+                estimates.emplace_back(prev.get() + ch * numPixels, width, height);
+            iterateCallback(i + 1, estimates);
+        }
+
         progressCallback(i, numIters);
         if (checkAbort())
             break;
     }
 
-    for (unsigned i = 0; i < input.GetHeight(); i++)
-        memcpy(output.GetRow(i), next.get() + i*input.GetWidth(), input.GetWidth() * sizeof(float));
+    for (std::size_t ch = 0; ch < outputs.size(); ch++)
+        for (int i = 0; i < height; i++)
+            memcpy(outputs[ch].GetRow(i), next.get() + ch * numPixels + static_cast<std::size_t>(i) * width, width * sizeof(float));
 }
 
-// Functions to encode/decode (x,y) pairs into a 64-bit integer.
-inline uint64_t encodeXY(uint32_t x, uint32_t y) { return x + (static_cast<uint64_t>(y) << 32); }
-inline std::tuple<uint32_t, uint32_t> decodeXY(uint64_t encoded) { return { encoded & 0xFFFF'FFFF, encoded >> 32 }; }
+/// Number of mask columns dilated vertically by a single thread.
+constexpr int DILATION_COLUMN_BLOCK = 64;
+
+/// Sets each element of 'output' to 1 if there is a non-zero element of 'input' within 'radius' elements
+/// in the same row (horizontal == true) or column; otherwise, sets it to 0.
+/** Uses the distance to the nearest preceding and following non-zero element, so the cost
+    per element does not depend on 'radius'. */
+static void DilateMask1D(const uint8_t* input, uint8_t* output, int width, int height, int radius, bool horizontal)
+{
+    if (horizontal)
+    {
+        #pragma omp parallel for
+        for (int y = 0; y < height; y++)
+        {
+            const uint8_t* srcRow = &input[y * width];
+            uint8_t* destRow = &output[y * width];
+
+            int prevNonZero = -radius - 1;
+            for (int x = 0; x < width; x++)
+            {
+                if (srcRow[x]) { prevNonZero = x; }
+                destRow[x] = (x - prevNonZero <= radius);
+            }
+
+            int nextNonZero = width + radius;
+            for (int x = width - 1; x >= 0; x--)
+            {
+                if (srcRow[x]) { nextNonZero = x; }
+                destRow[x] |= (nextNonZero - x <= radius);
+            }
+        }
+    }
+    else
+    {
+        // Process blocks of columns row by row, so that memory is accessed sequentially.
+        const int numBlocks = (width + DILATION_COLUMN_BLOCK - 1) / DILATION_COLUMN_BLOCK;
+
+        #pragma omp parallel for
+        for (int block = 0; block < numBlocks; block++)
+        {
+            const int xStart = block * DILATION_COLUMN_BLOCK;
+            const int blockWidth = std::min(DILATION_COLUMN_BLOCK, width - xStart);
+            std::array<int, DILATION_COLUMN_BLOCK> nearestNonZero;
+
+            nearestNonZero.fill(-radius - 1);
+            for (int y = 0; y < height; y++)
+            {
+                const uint8_t* srcRow = &input[y * width + xStart];
+                uint8_t* destRow = &output[y * width + xStart];
+                for (int i = 0; i < blockWidth; i++)
+                {
+                    if (srcRow[i]) { nearestNonZero[i] = y; }
+                    destRow[i] = (y - nearestNonZero[i] <= radius);
+                }
+            }
+
+            nearestNonZero.fill(height + radius);
+            for (int y = height - 1; y >= 0; y--)
+            {
+                const uint8_t* srcRow = &input[y * width + xStart];
+                uint8_t* destRow = &output[y * width + xStart];
+                for (int i = 0; i < blockWidth; i++)
+                {
+                    if (srcRow[i]) { nearestNonZero[i] = y; }
+                    destRow[i] |= (nearestNonZero[i] - y <= radius);
+                }
+            }
+        }
+    }
+}
 
 void FillTresholdVicinityMask(
     c_View<const IImageBuffer> input,
@@ -159,60 +282,48 @@ void FillTresholdVicinityMask(
     IMPPG_ASSERT(input.GetPixelFormat() == PixelFormat::PIX_MONO32F);
     IMPPG_ASSERT(mask.size() == input.GetWidth() * input.GetHeight());
 
-    std::fill(mask.begin(), mask.end(), 0);
+    const int width = input.GetWidth();
+    const int height = input.GetHeight();
 
-    std::vector<uint64_t> borderPixels;
+    // Identify all border pixels, i.e., pixels above threshold which have
+    // a (diagonal) neighbor below threshold; store them in 'mask'.
 
-    // Identify all pixels above threshold and create a list of border pixels
-    // that are their neighbors, but themselves are below threshold.
-
-    for (int y = 0; y < static_cast<int>(input.GetHeight()); y++)
+    #pragma omp parallel for
+    for (int y = 0; y < height; y++)
     {
-        for (int x = 0; x < static_cast<int>(input.GetWidth()); x++)
+        const float* prevRow = (y > 0) ? input.GetRowAs<const float>(y - 1) : nullptr;
+        const float* row = input.GetRowAs<const float>(y);
+        const float* nextRow = (y < height - 1) ? input.GetRowAs<const float>(y + 1) : nullptr;
+        uint8_t* maskRow = &mask[y * width];
+
+        for (int x = 0; x < width; x++)
         {
-            float valXY = input.GetRowAs<const float>(y)[x];
-            if (valXY < threshold)
+            bool hasNeighborBelowThreshold = false;
+            for (const float* neighborRow: { prevRow, nextRow })
             {
-                for (int j = -1; j <= 1; j++)
+                if (neighborRow)
                 {
-                    for (int i = -1; i <= 1; i++)
-                    {
-                        if (i != 0 && j != 0 &&
-                            x + i >= 0 && x + i < static_cast<int>(input.GetWidth()) &&
-                            y + j >= 0 && y + j < static_cast<int>(input.GetHeight()))
-                        {
-                            if (input.GetRowAs<const float>(y + j)[x + i] >= threshold)
-                            {
-                                borderPixels.push_back(encodeXY(x + i, y + j));
-                            }
-                        }
-                    }
+                    hasNeighborBelowThreshold |= (x > 0 && neighborRow[x - 1] < threshold);
+                    hasNeighborBelowThreshold |= (x < width - 1 && neighborRow[x + 1] < threshold);
                 }
             }
+            maskRow[x] = (row[x] >= threshold && hasNeighborBelowThreshold);
         }
     }
 
-    // Iterate over border pixels, identify all their neighbors to the specified distance
-    // and mark both sets in the mask.
+    // Mark all pixels within a square of side 2*influenceDist-1 centered on each border pixel.
+    // A square is separable, so perform a horizontal and then a vertical dilation.
 
     const int influenceDist = static_cast<int>(ceilf(sigma * 2.0f));
-
-    for (const auto bpix: borderPixels)
+    if (influenceDist < 1)
     {
-        const auto [x, y] = decodeXY(bpix);
-
-        for (int i = -(influenceDist - 1); i <= influenceDist - 1; i++)
-        {
-            for (int j = -(influenceDist - 1); j <= influenceDist - 1; j++)
-            {
-                if (static_cast<int>(x) + i >= 0 && static_cast<int>(x) + i < static_cast<int>(input.GetWidth()) &&
-                    static_cast<int>(y) + j >= 0 && static_cast<int>(y) + j < static_cast<int>(input.GetHeight()))
-                {
-                    mask[(y + j) * input.GetWidth() + (x + i)] = 1;
-                }
-            }
-        }
+        std::fill(mask.begin(), mask.end(), 0);
+        return;
     }
+
+    std::vector<uint8_t> dilatedRows(mask.size());
+    DilateMask1D(mask.data(), dilatedRows.data(), width, height, influenceDist - 1, true);
+    DilateMask1D(dilatedRows.data(), mask.data(), width, height, influenceDist - 1, false);
 }
 
 void BlurThresholdVicinity(
@@ -237,7 +348,8 @@ void BlurThresholdVicinity(
         sigma
     );
 
-    for (unsigned y = 0; y < input.GetHeight(); ++y)
+    #pragma omp parallel for
+    for (int y = 0; y < static_cast<int>(input.GetHeight()); ++y)
     {
         const float* srcRow = input.GetRowAs<const float>(y);
         const uint8_t* maskRow = &workBuf[y * input.GetWidth()];
@@ -249,3 +361,101 @@ void BlurThresholdVicinity(
         }
     }
 }
+
+/// Number of rows blended between successive abort checks.
+constexpr int BLEND_STRIP_HEIGHT = 256;
+
+void UnsharpMaskBlend(
+    c_View<const IImageBuffer> input,
+    const float* blurred,
+    c_View<IImageBuffer> output,
+    float amount,
+    std::function<bool ()> checkAbort
+)
+{
+    IMPPG_ASSERT(input.GetPixelFormat() == PixelFormat::PIX_MONO32F);
+    IMPPG_ASSERT(output.GetPixelFormat() == PixelFormat::PIX_MONO32F);
+
+    const int width = input.GetWidth();
+    const int height = input.GetHeight();
+
+    for (int stripStart = 0; stripStart < height; stripStart += BLEND_STRIP_HEIGHT)
+    {
+        const int stripEnd = std::min(stripStart + BLEND_STRIP_HEIGHT, height);
+
+        #pragma omp parallel for
+        for (int row = stripStart; row < stripEnd; row++)
+        {
+            const float* srcRow = input.GetRowAs<const float>(row);
+            const float* gaussianRow = &blurred[row * width];
+            float* destRow = output.GetRowAs<float>(row);
+
+            // no branches inside, so that the compiler can vectorize the loop
+            for (int col = 0; col < width; col++)
+            {
+                const float value = gaussianRow[col] + amount * (srcRow[col] - gaussianRow[col]);
+                destRow[col] = std::min(std::max(value, 0.0f), 1.0f);
+            }
+        }
+
+        if (checkAbort())
+            break;
+    }
+}
+
+void AdaptiveUnsharpMaskBlend(
+    c_View<const IImageBuffer> input,
+    const float* blurred,
+    c_View<const IImageBuffer> lum,
+    c_View<IImageBuffer> output,
+    const UnsharpMask& unsharpMask,
+    std::function<bool ()> checkAbort
+)
+{
+    IMPPG_ASSERT(input.GetPixelFormat() == PixelFormat::PIX_MONO32F);
+    IMPPG_ASSERT(lum.GetPixelFormat() == PixelFormat::PIX_MONO32F);
+    IMPPG_ASSERT(output.GetPixelFormat() == PixelFormat::PIX_MONO32F);
+
+    const int width = input.GetWidth();
+    const int height = input.GetHeight();
+
+    // not using a structured binding, as these cannot be referenced in OpenMP regions by some compilers
+    const std::array<float, 4> coeffs = GetAdaptiveUnshMaskTransitionCurve(unsharpMask);
+    const float a = coeffs[0], b = coeffs[1], c = coeffs[2], d = coeffs[3];
+
+    // The transition curve reaches `amountMin` and `amountMax` (with zero slope) at the ends of the transition
+    // interval, so instead of branching on brightness, we can clamp it to the interval and always evaluate the curve.
+    const float lumLo = unsharpMask.threshold - unsharpMask.width;
+    const float lumHi = unsharpMask.threshold + unsharpMask.width;
+    // with zero width (allowed in settings) there is no transition interval, just a step at the threshold
+    const bool isStep = unsharpMask.width <= 0.0f;
+    const float threshold = unsharpMask.threshold;
+    const float amountMin = unsharpMask.amountMin;
+
+    for (int stripStart = 0; stripStart < height; stripStart += BLEND_STRIP_HEIGHT)
+    {
+        const int stripEnd = std::min(stripStart + BLEND_STRIP_HEIGHT, height);
+
+        #pragma omp parallel for
+        for (int row = stripStart; row < stripEnd; row++)
+        {
+            const float* srcRow = input.GetRowAs<const float>(row);
+            const float* lumRow = lum.GetRowAs<const float>(row);
+            const float* gaussianRow = &blurred[row * width];
+            float* destRow = output.GetRowAs<float>(row);
+
+            for (int col = 0; col < width; col++)
+            {
+                const float l = std::min(std::max(lumRow[col], lumLo), lumHi);
+                const float amount = isStep
+                    ? (lumRow[col] < threshold ? amountMin : d)
+                    : l * (l * (a * l + b) + c) + d;
+                const float value = gaussianRow[col] + amount * (srcRow[col] - gaussianRow[col]);
+                destRow[col] = std::min(std::max(value, 0.0f), 1.0f);
+            }
+        }
+
+        if (checkAbort())
+            break;
+    }
+}
@@ -24,37 +24,51 @@ File description:
 #ifndef IMPP_LRDECONV_H
 #define IMPP_LRDECONV_H
 
+#include "common/proc_settings.h"
 #include "image/image.h"
 #include "math_utils/convolution.h"
 
 #include <cstdint>
 #include <functional>
+#include <vector>
 
 /// Clamps the values of the specified PIX_MONO32F buffer to [0.0, 1.0]
 void Clamp(c_View<IImageBuffer>& buf);
 
-/// Calculates convolution of 'input' with a Gaussian kernel
-void ConvolveSeparable(
-        c_PaddedArrayPtr<const float> input, ///< Input array
-        c_PaddedArrayPtr<float> output,      ///< Output array having as much rows and columns as 'input' does
-        float sigma                           ///< Gaussian sigma
-);
+/// Receives the current (unclamped) estimates of all channels; arguments: number of iterations performed, estimates.
+using LRIterateCallback = std::function<void (int, const std::vector<c_PaddedArrayPtr<const float>>&)>;
+
+/// Reproduces original images from images in 'inputs' convolved with Gaussian kernel and writes them to 'outputs'.
+/** All channels are processed together in each iteration (sharing temporary buffers, parallel regions
+    and, for the recursive convolution, a single filtering sweep). The temporary buffers hold all channels
+    at once, so the peak memory use is proportional to the number of channels (3 times that of
+    a mono image for RGB).
 
-/// Reproduces original image from image in 'input' convolved with Gaussian kernel and writes it to 'output'.
+    Each iteration refines the estimate produced by the previous one, so a deconvolution can be continued
+    from an estimate obtained earlier (see 'initialEstimates'). Note that 'outputs' receive the estimate
+    preceding the last one, i.e. the estimate passed to 'iterateCallback' with 'numIters' - 1 iterations
+    (or 'initialEstimates' if 'numIters' is 1). */
 void LucyRichardsonGaussian(
-        c_View<const IImageBuffer>& input, ///< Contains a single 'float' value per pixel; size the same as 'output'
-        c_View<IImageBuffer>& output, ///< Contains a single 'float' value per pixel; size the same as 'input'
+        const std::vector<c_View<const IImageBuffer>>& inputs, ///< Contain a single 'float' value per pixel; all of the same size as 'outputs'
+        std::vector<c_View<IImageBuffer>>& outputs, ///< Contain a single 'float' value per pixel; all of the same size as 'inputs'; may be empty
         int numIters,  ///< Number of iterations
         float sigma,   ///< sigma of the Gaussian kernel
         ConvolutionMethod convMethod,
 
         /// Called after every iteration; arguments: current iteration, total iterations
-        //boost::function<void(int, int)> progressCallback,
         std::function<void (int, int)> progressCallback,
 
         /// Called periodically to check if there was an "abort processing" request
-        //boost::function<bool()> checkAbort
-        std::function<bool ()> checkAbort
+        std::function<bool ()> checkAbort,
+
+        /// If set, the convolutions stop as soon as cancellation is requested (the outputs are then incomplete)
+        const c_CancellationToken* cancellation = nullptr,
+
+        /// If set, the iterations start from these estimates instead of 'inputs'; same sizes as 'inputs'
+        const std::vector<c_View<const IImageBuffer>>* initialEstimates = nullptr,
+
+        /// If set, called after every iteration
+        LRIterateCallback iterateCallback = {}
 );
 
 // c_Image GetTresholdVicinityMask(
@@ -64,6 +78,16 @@ void LucyRichardsonGaussian(
 // );
 
 
+/// Sets to 1 the elements of 'mask' within a square of side 2*ceil(2*sigma)-1 centered on each border pixel
+/// of brightness areas defined by 'threshold' (i.e., a pixel >= 'threshold' with a diagonal neighbor below it);
+/// sets the remaining elements to 0.
+void FillTresholdVicinityMask(
+    c_View<const IImageBuffer> input,
+    std::vector<uint8_t>& mask, ///< Must have as many elements as there are 'input' pixels.
+    float threshold,
+    float sigma
+);
+
 /// Blurs pixels around borders of brightness areas defined by 'threshold'
 void BlurThresholdVicinity(
     c_View<const IImageBuffer> input,
@@ -73,4 +97,26 @@ void BlurThresholdVicinity(
     float sigma
 );
 
+/// Performs standard unsharp masking: output = amount * input + (1 - amount) * blurred, clamped to [0.0, 1.0].
+void UnsharpMaskBlend(
+    c_View<const IImageBuffer> input,
+    const float* blurred, ///< Gaussian-blurred `input`; as many elements as `input` pixels, no row padding.
+    c_View<IImageBuffer> output,
+    float amount,
+    /// Called periodically to check if there was an "abort processing" request
+    std::function<bool ()> checkAbort
+);
+
+/// Performs adaptive unsharp masking; the amount depends on the local brightness `lum`
+/// (see `GetAdaptiveUnshMaskTransitionCurve`). The output is clamped to [0.0, 1.0].
+void AdaptiveUnsharpMaskBlend(
+    c_View<const IImageBuffer> input,
+    const float* blurred, ///< Gaussian-blurred `input`; as many elements as `input` pixels, no row padding.
+    c_View<const IImageBuffer> lum, ///< Smoothed raw input image; same size as `input`.
+    c_View<IImageBuffer> output,
+    const UnsharpMask& unsharpMask,
+    /// Called periodically to check if there was an "abort processing" request
+    std::function<bool ()> checkAbort
+);
+
 #endif // IMPP_LRDECONV_H
@@ -0,0 +1,119 @@
+/*
+ImPPG (Image Post-Processor) - common operations for astronomical stacks and other images
+Copyright (C) 2016-2022 Filip Szczerek <ga.software@yahoo.com>
+
+This file is part of ImPPG.
+
+ImPPG is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ImPPG is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with ImPPG.  If not, see <http://www.gnu.org/licenses/>.
+
+File description:
+    Speculative precomputation cache header.
+*/
+
+#ifndef IMPPG_CPU_BMP_SPECULATION_H
+#define IMPPG_CPU_BMP_SPECULATION_H
+
+#include "image/image.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace imppg::backend {
+
+/// Maximum total size of images kept by a single `c_NeighbourCache`.
+constexpr std::size_t MAX_NEIGHBOUR_CACHE_BYTES = 256 * 1024 * 1024;
+
+/// Maximum number of entries kept by a single `c_NeighbourCache` (the current value and its neighbours on both sides).
+constexpr std::size_t MAX_NEIGHBOUR_CACHE_ENTRIES = 4;
+
+/// Returns the number of entries (each with `numChannels` images of `width` x `height` floats)
+/// which can be kept by a `c_NeighbourCache`.
+inline std::size_t GetNeighbourCacheCapacity(int width, int height, std::size_t numChannels)
+{
+    const std::size_t entryBytes = static_cast<std::size_t>(width) * height * numChannels * sizeof(float);
+    return (entryBytes > 0) ? std::min(MAX_NEIGHBOUR_CACHE_ENTRIES, MAX_NEIGHBOUR_CACHE_BYTES / entryBytes) : 0;
+}
+
+/// Processing results (1 or 3 channels) for several values of a single parameter (e.g. the number of L-R iterations).
+/** Keeps the results for the current value and its nearest neighbours (computed speculatively at idle),
+    so that a small change of the parameter does not require a full recomputation. Not thread-safe. */
+template<typename Key>
+class c_NeighbourCache
+{
+public:
+    using Value = std::shared_ptr<const std::vector<c_Image>>;
+
+    /// Returns null if there is no entry for `key`.
+    Value Find(Key key) const
+    {
+        const auto it = FindEntry(key);
+        return (it != m_Entries.end()) ? it->second : nullptr;
+    }
+
+    /// Returns the entry with the greatest key not exceeding `key`.
+    std::optional<std::pair<Key, Value>> FindPreceding(Key key) const
+    {
+        auto it = m_Entries.upper_bound(key);
+        if (it == m_Entries.begin()) { return std::nullopt; }
+        --it;
+        return *it;
+    }
+
+    void Store(Key key, Value value)
+    {
+        const auto it = FindEntry(key);
+        if (it != m_Entries.end()) { m_Entries.erase(it); }
+        m_Entries.emplace(key, std::move(value));
+    }
+
+    /// Removes the entries farthest from `current`, so that at most `maxEntries` remain.
+    void Trim(Key current, std::size_t maxEntries)
+    {
+        while (m_Entries.size() > maxEntries)
+        {
+            const auto farthest = std::max_element(m_Entries.begin(), m_Entries.end(),
+                [current](const auto& e1, const auto& e2) {
+                    return std::abs(e1.first - current) < std::abs(e2.first - current);
+                });
+            m_Entries.erase(farthest);
+        }
+    }
+
+    void Clear() { m_Entries.clear(); }
+
+private:
+    /// Floating-point keys closer than this are considered equal (e.g. sigma computed as a sum of slider steps
+    /// may differ from the one set directly by rounding errors).
+    static constexpr Key KEY_TOLERANCE = std::is_floating_point_v<Key> ? static_cast<Key>(1.0e-4) : Key{0};
+
+    std::map<Key, Value> m_Entries;
+
+    typename std::map<Key, Value>::const_iterator FindEntry(Key key) const
+    {
+        const auto it = m_Entries.lower_bound(key - KEY_TOLERANCE);
+        return (it != m_Entries.end() && std::abs(it->first - key) <= KEY_TOLERANCE) ? it : m_Entries.end();
+    }
+};
+
+} // namespace imppg::backend
+
+#endif // IMPPG_CPU_BMP_SPECULATION_H
@@ -21,6 +21,8 @@ File description:
     Lucy-Richardson deconvolution worker thread implementation.
 */
 
+#include <algorithm>
+#include <cstring>
 #include <wx/datetime.h>
 #include "cpu_bmp/w_lrdeconv.h"
 #include "lrdeconv.h"
@@ -29,6 +31,91 @@ File description:
 
 namespace imppg::backend {
 
+void RunLucyRichardson(
+    const std::vector<c_View<const IImageBuffer>>& input,
+    std::vector<c_View<IImageBuffer>>& output,
+    float sigma,
+    int numIterations,
+    const LRDeringing& deringing,
+    const LRIterates& iterates,
+    std::function<void (int, int)> progressCallback,
+    std::function<bool ()> checkAbort,
+    const c_CancellationToken* cancellation
+)
+{
+    std::vector<c_View<const IImageBuffer>> preprocessedInput;
+    for (const auto& inputChannel: input)
+    {
+        preprocessedInput.emplace_back(inputChannel);
+    }
+
+    const std::size_t numChannels = input.size();
+
+    std::vector<c_Image> preprocessedInputImg;
+    if (deringing.enabled)
+    {
+        for (const auto& inputChannel: input)
+        {
+            preprocessedInputImg.emplace_back(inputChannel.GetWidth(), inputChannel.GetHeight(), PixelFormat::PIX_MONO32F);
+        }
+
+        for (std::size_t ch = 0; ch < numChannels; ++ch)
+        {
+            auto preprocView = c_View(preprocessedInputImg.at(ch).GetBuffer());
+            BlurThresholdVicinity(input.at(ch), preprocView, deringing.workBuf, deringing.threshold, deringing.sigma);
+            preprocessedInput[ch] = c_View<const IImageBuffer>(preprocessedInputImg.at(ch).GetBuffer());
+        }
+    }
+
+    // the input itself is the result of 1 iteration (see LucyRichardsonGaussian())
+    const int initialIteration = iterates.initialEstimate ? iterates.initialIteration : 1;
+    IMPPG_ASSERT(initialIteration >= 1 && initialIteration <= numIterations);
+
+    std::vector<c_View<const IImageBuffer>> initialEstimate;
+    if (iterates.initialEstimate)
+    {
+        for (const auto& channel: *iterates.initialEstimate)
+        {
+            initialEstimate.emplace_back(channel.GetBuffer());
+        }
+    }
+
+    LRIterateCallback keepIterate;
+    if (iterates.cache)
+    {
+        keepIterate = [&](int iteration, const std::vector<c_PaddedArrayPtr<const float>>& estimates) {
+            // the estimate passed after `iteration` iterations performed here is the result of
+            // `initialIteration + iteration` iterations
+            const int totalIterations = initialIteration + iteration;
+            if (std::find(iterates.toKeep.begin(), iterates.toKeep.end(), totalIterations) == iterates.toKeep.end()) { return; }
+
+            auto kept = std::make_shared<std::vector<c_Image>>();
+            for (const auto& estimate: estimates)
+            {
+                auto& img = kept->emplace_back(estimate.width(), estimate.height(), PixelFormat::PIX_MONO32F);
+                for (int y = 0; y < estimate.height(); ++y)
+                {
+                    memcpy(img.GetRow(y), estimate.row_const(y), estimate.width() * sizeof(float));
+                }
+            }
+            iterates.cache->Store(totalIterations, std::move(kept));
+        };
+    }
+
+    LucyRichardsonGaussian(
+        preprocessedInput,
+        output,
+        numIterations - initialIteration + 1,
+        sigma,
+        ConvolutionMethod::AUTO,
+        progressCallback,
+        checkAbort,
+        cancellation,
+        iterates.initialEstimate ? &initialEstimate : nullptr,
+        keepIterate
+    );
+}
+
 c_LucyRichardsonThread::c_LucyRichardsonThread(
     WorkerParameters&& params,
     float lrSigma,
@@ -36,11 +123,13 @@ c_LucyRichardsonThread::c_LucyRichardsonThread(
     bool deringing,
     float deringingThreshold,
     float deringingSigma,
-    std::vector<uint8_t>& deringingWorkBuf
+    std::vector<uint8_t>& deringingWorkBuf,
+    LRIterates iterates
 ): IWorkerThread(std::move(params)),
    lrSigma(lrSigma),
    numIterations(numIterations),
-   m_Deringing{deringing, deringingThreshold, deringingSigma, deringingWorkBuf}
+   m_Deringing{deringing, deringingThreshold, deringingSigma, deringingWorkBuf},
+   m_Iterates(std::move(iterates))
 {
 }
 
@@ -61,39 +150,16 @@ void c_LucyRichardsonThread::DoWork()
 {
     wxDateTime tstart = wxDateTime::UNow();
 
-    std::vector<c_View<const IImageBuffer>> preprocessedInput;
-    for (const auto& input: m_Params.input)
+    if (m_Iterates.initialEstimate)
     {
-        preprocessedInput.emplace_back(input);
+        Log::PrintF("Continuing L-R deconvolution from the result of %d iteration(s)\n", m_Iterates.initialIteration);
     }
 
-    const std::size_t numChannels = m_Params.input.size();
-
-    std::vector<c_Image> preprocessedInputImg;
-    if (m_Deringing.enabled)
-    {
-        for (const auto& input: m_Params.input)
-        {
-            preprocessedInputImg.emplace_back(input.GetWidth(), input.GetHeight(), PixelFormat::PIX_MONO32F);
-        }
-
-        for (std::size_t ch = 0; ch < numChannels; ++ch)
-        {
-            auto preprocView = c_View(preprocessedInputImg.at(ch).GetBuffer());
-            BlurThresholdVicinity(m_Params.input.at(ch), preprocView, m_Deringing.workBuf, m_Deringing.threshold, m_Deringing.sigma);
-            preprocessedInput[ch] = c_View<const IImageBuffer>(preprocessedInputImg.at(ch).GetBuffer());
-        }
-    }
-
-    for (std::size_t ch = 0; ch < numChannels; ++ch)
-    {
-        LucyRichardsonGaussian(preprocessedInput.at(ch), m_Params.output.at(ch), numIterations, lrSigma, ConvolutionMethod::AUTO,
-            [this, ch, numChannels](int currentIter, int totalIters) {
-                IterationNotification(ch * totalIters + currentIter, totalIters * numChannels);
-            },
-            [this]() { return IsAbortRequested(); }
-        );
-    }
+    RunLucyRichardson(m_Params.input, m_Params.output, lrSigma, numIterations, m_Deringing, m_Iterates,
+        [this](int currentIter, int totalIters) { IterationNotification(currentIter, totalIters); },
+        [this]() { return IsAbortRequested(); },
+        GetCancellationToken()
+    );
 
     Log::Print(wxString::Format("L-R deconvolution finished in %s s\n", (wxDateTime::UNow() - tstart).Format("%S.%l")));
     for (auto& channel: m_Params.output)
@@ -24,23 +24,62 @@ File description:
 #ifndef IMPPG_LR_DECONV_WORKER_THREAD_H
 #define IMPPG_LR_DECONV_WORKER_THREAD_H
 
+#include "cpu_bmp/speculation.h"
 #include "cpu_bmp/worker.h"
 
+#include <functional>
+
 namespace imppg::backend {
 
+struct LRDeringing
+{
+    bool enabled; ///< If 'true', ringing around a specified threshold of brightness will be reduced.
+    float threshold;
+    float sigma;
+    std::vector<uint8_t>& workBuf; ///< Must have as many elements as there are input pixels.
+};
+
+/// Intermediate L-R estimates reused between runs with different numbers of iterations.
+/** An estimate is identified by the number of iterations (as in `ProcessingSettings`) whose result it is. */
+struct LRIterates
+{
+    /// If set, the deconvolution continues from this estimate instead of starting from the input.
+    c_NeighbourCache<int>::Value initialEstimate;
+    /// Number of iterations whose result is `initialEstimate`.
+    int initialIteration{0};
+    /// If set, receives the estimates after the numbers of iterations listed in `toKeep`.
+    c_NeighbourCache<int>* cache{nullptr};
+    std::vector<int> toKeep;
+};
+
+/// Performs L-R deconvolution of `input` (with optional deringing); the result is not clamped.
+/** `numIterations` counts also the iterations which produced `iterates.initialEstimate` (there must not be more of them).
+    Besides the requested ones, `iterates.cache` may receive the result of `numIterations` + 1 iterations,
+    which is obtained at no extra cost. `output` may be empty if only the cached estimates are needed. */
+void RunLucyRichardson(
+    const std::vector<c_View<const IImageBuffer>>& input,
+    std::vector<c_View<IImageBuffer>>& output,
+    float sigma,
+    int numIterations,
+    const LRDeringing& deringing,
+    const LRIterates& iterates,
+    /// Called after every iteration; arguments: current iteration, total iterations (both excluding `iterates.initialIteration`)
+    std::function<void (int, int)> progressCallback,
+    /// Called periodically to check if there was an "abort processing" request
+    std::function<bool ()> checkAbort,
+    const c_CancellationToken* cancellation
+);
+
 class c_LucyRichardsonThread : public IWorkerThread
 {
     void DoWork() override;
 
+    const char* GetStageName() const override { return "Lucy-Richardson deconvolution"; }
+
     float lrSigma;
     int numIterations;
-    struct
-    {
-        bool enabled;
-        float threshold;
-        float sigma;
-        std::vector<uint8_t>& workBuf; ///< Must have as many elements as there are input pixels.
-    } m_Deringing;
+    LRDeringing m_Deringing;
+    LRIterates m_Iterates;
 
     void IterationNotification(int iter, int totalIters);
 
@@ -54,7 +93,8 @@ public:
         bool deringing,            ///< If 'true', ringing around a specified threshold of brightness will be reduced.
         float deringingThreshold,
         float deringingSigma,
-        std::vector<uint8_t>& deringingWorkBuf ///< Must have as many elements as there are input pixels.
+        std::vector<uint8_t>& deringingWorkBuf, ///< Must have as many elements as there are input pixels.
+        LRIterates iterates
     );
 };
 
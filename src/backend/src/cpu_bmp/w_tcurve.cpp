@@ -21,6 +21,7 @@ File description:
     Tone curve worker thread implementation.
 */
 
+#include <algorithm>
 #include <wx/datetime.h>
 
 #include "cpu_bmp/w_tcurve.h"
@@ -29,6 +30,9 @@ File description:
 
 namespace imppg::backend {
 
+/// Number of rows processed between successive progress notifications and abort checks.
+constexpr int TONE_CURVE_STRIP_HEIGHT = 128;
+
 c_ToneCurveThread::c_ToneCurveThread(
     WorkerParameters&& params,
     const c_ToneCurve& toneCurve,   ///< Tone curve to apply to 'output'; an internal copy will be created
@@ -52,27 +56,28 @@ void c_ToneCurveThread::DoWork()
     int lastPercentageReported = 0;
     for (std::size_t ch = 0; ch < numChannels; ++ch)
     {
-        for (unsigned y = 0; y < height; y++)
+        auto& input = m_Params.input.at(ch);
+        auto& output = m_Params.output.at(ch);
+
+        for (int stripStart = 0; stripStart < static_cast<int>(height); stripStart += TONE_CURVE_STRIP_HEIGHT)
         {
-            if (m_UsePreciseValues)
-            {
-                toneCurve.ApplyPreciseToneCurve(
-                    m_Params.input.at(ch).GetRowAs<const float>(y),
-                    m_Params.output.at(ch).GetRowAs<float>(y),
-                    width
-                );
-            }
-            else
+            const int stripEnd = std::min(stripStart + TONE_CURVE_STRIP_HEIGHT, static_cast<int>(height));
+
+            #pragma omp parallel for
+            for (int y = stripStart; y < stripEnd; y++)
             {
-                toneCurve.ApplyApproximatedToneCurve(
-                    m_Params.input.at(ch).GetRowAs<const float>(y),
-                    m_Params.output.at(ch).GetRowAs<float>(y),
-                    width
-                );
+                if (m_UsePreciseValues)
+                {
+                    toneCurve.ApplyPreciseToneCurve(input.GetRowAs<const float>(y), output.GetRowAs<float>(y), width);
+                }
+                else
+                {
+                    toneCurve.ApplyApproximatedToneCurve(input.GetRowAs<const float>(y), output.GetRowAs<float>(y), width);
+                }
             }
 
             // Notify the main thread after every 5% of progress
-            int percentage = 100 * (y + ch * height) / (numChannels * height);
+            int percentage = 100 * (stripEnd + ch * height) / (numChannels * height);
             if (percentage > lastPercentageReported + 5)
             {
                 WorkerEventPayload payload;
@@ -33,6 +33,8 @@ class c_ToneCurveThread: public IWorkerThread
 {
     void DoWork() override;
 
+    const char* GetStageName() const override { return "Tone curve"; }
+
     c_ToneCurve toneCurve;
     bool m_UsePreciseValues;
 
@@ -23,17 +23,60 @@ File description:
 
 #include "cpu_bmp/lrdeconv.h"
 #include "cpu_bmp/w_unshmask.h"
+#include "logging/logging.h"
 
 namespace imppg::backend {
 
+c_NeighbourCache<float>::Value BlurUnsharpMaskInput(
+    const std::vector<c_View<const IImageBuffer>>& input,
+    float sigma,
+    bool useBlurPyramid,
+    const c_CancellationToken* cancellation
+)
+{
+    // width and height of all channels are the same
+    const int width = input.at(0).GetWidth();
+    const int height = input.at(0).GetHeight();
+
+    auto blurred = std::make_shared<std::vector<c_Image>>();
+    std::vector<c_PaddedArrayPtr<const float>> inputs;
+    std::vector<c_PaddedArrayPtr<float>> outputs;
+
+    for (auto channel: input)
+    {
+        auto& img = blurred->emplace_back(width, height, PixelFormat::PIX_MONO32F);
+        inputs.emplace_back(channel.GetRowAs<const float>(0), width, height, channel.GetBytesPerRow());
+        outputs.emplace_back(img.GetRowAs<float>(0), width, height, img.GetBuffer().GetBytesPerRow());
+    }
+
+    if (useBlurPyramid)
+    {
+        for (std::size_t ch = 0; ch < inputs.size(); ++ch)
+        {
+            ConvolveSeparablePyramid(inputs[ch], outputs[ch], sigma, cancellation);
+        }
+    }
+    else
+    {
+        // all channels are blurred in a single sweep
+        ConvolveSeparable(inputs, outputs, sigma, cancellation);
+    }
+
+    return blurred;
+}
+
 c_UnsharpMaskingThread::c_UnsharpMaskingThread(
     WorkerParameters&& params,
     std::optional<c_View<const IImageBuffer>>&& blurredRawInput,
-    UnsharpMask unsharpMask
+    UnsharpMask unsharpMask,
+    bool useBlurPyramid,
+    c_NeighbourCache<float>* blurCache
 )
 : IWorkerThread(std::move(params)),
   m_BlurredRawInput(std::move(blurredRawInput)),
-  m_UnsharpMask(unsharpMask)
+  m_UnsharpMask(unsharpMask),
+  m_UseBlurPyramid(useBlurPyramid),
+  m_BlurCache(blurCache)
 {
     if (m_BlurredRawInput.has_value())
     {
@@ -43,97 +86,54 @@ c_UnsharpMaskingThread::c_UnsharpMaskingThread(
 
 void c_UnsharpMaskingThread::DoWork()
 {
-    // width and height of all images (input, raw input, output) are the same
-    const unsigned width = m_Params.input.at(0).GetWidth();
-    const unsigned height = m_Params.input.at(0).GetHeight();
-
-    std::vector<std::unique_ptr<float[]>> gaussianImg;
-
-    for (std::size_t ch = 0; ch < m_Params.input.size(); ++ch)
+    auto blurred = m_BlurCache ? m_BlurCache->Find(m_UnsharpMask.sigma) : nullptr;
+    if (blurred)
     {
-        gaussianImg.emplace_back(std::make_unique<float[]>(width * height));
-        ConvolveSeparable(
-            c_PaddedArrayPtr(m_Params.input.at(ch).GetRowAs<const float>(0), width, height, m_Params.input.at(ch).GetBytesPerRow()),
-            c_PaddedArrayPtr(gaussianImg.at(ch).get(), width, height), m_UnsharpMask.sigma
-        );
-    }
-
-    if (!m_UnsharpMask.adaptive)
-    {
-        // Standard unsharp masking - the amount (taken from `m_AmountMax`) is constant for the whole image.
-
-        for (std::size_t ch = 0; ch < m_Params.input.size(); ++ch)
-        {
-            for (unsigned row = 0; row < height; row++)
-            {
-                const float* srcRow = m_Params.input.at(ch).GetRowAs<const float>(row);
-                const float* gaussianRow = &gaussianImg.at(ch)[row * width];
-                float* destRow = m_Params.output.at(ch).GetRowAs<float>(row);
-
-                for (unsigned col = 0; col < width; col++)
-                {
-                    destRow[col] = m_UnsharpMask.amountMax * srcRow[col] + (1.0f - m_UnsharpMask.amountMax) * gaussianRow[col];
-                }
-            }
-        }
+        Log::Print("Using cached blurred input for unsharp masking\n");
     }
     else
     {
-        // Adaptive unsharp masking - the amount depends on input image's local brightness. It is taken from the raw,
-        // unprocessed image smoothed by Gaussian with sigma = RAW_IMAGE_BLUR_SIGMA_FOR_ADAPTIVE_UNSHARP_MASK
-        // to alleviate noise (`m_BlurredRawInput`). See the declaration of `GetAdaptiveUnshMaskTransitionCurve`
-        // for further details.
-
-        const auto [a, b, c, d] = GetAdaptiveUnshMaskTransitionCurve(m_UnsharpMask);
+        blurred = BlurUnsharpMaskInput(m_Params.input, m_UnsharpMask.sigma, m_UseBlurPyramid, GetCancellationToken());
+        if (IsAbortRequested())
+            return;
 
-        const float amountMin = m_UnsharpMask.amountMin;
-        const float amountMax = m_UnsharpMask.amountMax;
-        const float threshold = m_UnsharpMask.threshold;
-        const float transitionWidth = m_UnsharpMask.width;
+        if (m_BlurCache) { m_BlurCache->Store(m_UnsharpMask.sigma, blurred); }
+    }
 
-        for (std::size_t channel = 0; channel < m_Params.input.size(); ++channel)
+    for (std::size_t ch = 0; ch < m_Params.input.size(); ++ch)
+    {
+        if (!m_UnsharpMask.adaptive)
         {
-            for (unsigned row = 0; row < height; row++)
-            {
-                const float* srcRow = m_Params.input.at(channel).GetRowAs<const float>(row);
-                const float* lumRow = m_BlurredRawInput.value().GetRowAs<const float>(row);
-                const float* gaussianRow = &gaussianImg[channel][row * m_Params.input.at(0).GetWidth()];
-                float* destRow = m_Params.output.at(channel).GetRowAs<float>(row);
-
-                for (unsigned col = 0; col < width; col++)
-                {
-                    const float amount = [&, a = a, b = b, c = c, d = d]() {
-                        const float lum = lumRow[col];
-                        if (lum < threshold - transitionWidth)
-                        {
-                            return amountMin;
-                        }
-                        else if (lum > threshold + transitionWidth)
-                        {
-                            return amountMax;
-                        }
-                        else
-                        {
-                            return lum * (lum * (a * lum + b) + c) + d;
-                        }
-                    }();
-
-                    destRow[col] = amount * srcRow[col] + (1.0f - amount) * gaussianRow[col];
-                }
-
-                if (row % 256 == 0)
-                {
-                    if (IsAbortRequested())
-                        break;
-                }
-            }
+            // Standard unsharp masking - the amount (taken from `amountMax`) is constant for the whole image.
+            UnsharpMaskBlend(
+                m_Params.input.at(ch),
+                blurred->at(ch).GetRowAs<const float>(0),
+                m_Params.output.at(ch),
+                m_UnsharpMask.amountMax,
+                [this]() { return IsAbortRequested(); }
+            );
+        }
+        else
+        {
+            // Adaptive unsharp masking - the amount depends on input image's local brightness. It is taken from the raw,
+            // unprocessed image smoothed by Gaussian with sigma = RAW_IMAGE_BLUR_SIGMA_FOR_ADAPTIVE_UNSHARP_MASK
+            // to alleviate noise (`m_BlurredRawInput`). See the declaration of `GetAdaptiveUnshMaskTransitionCurve`
+            // for further details.
+            AdaptiveUnsharpMaskBlend(
+                m_Params.input.at(ch),
+                blurred->at(ch).GetRowAs<const float>(0),
+                m_BlurredRawInput.value(),
+                m_Params.output.at(ch),
+                m_UnsharpMask,
+                [this]() { return IsAbortRequested(); }
+            );
         }
-    }
 
-    for (auto& channel: m_Params.output)
-    {
-        Clamp(channel);
+        if (IsAbortRequested())
+            break;
     }
+
+    // the output has been clamped to [0.0, 1.0] by the blending functions
 }
 
 } // namespace imppg::backend
@@ -24,24 +24,41 @@ File description:
 #ifndef IMPPG_UNSHARP_MASKING_WORKER_THREAD_H
 #define IMPPG_UNSHARP_MASKING_WORKER_THREAD_H
 
+#include "cpu_bmp/speculation.h"
 #include "cpu_bmp/worker.h"
 
 #include <optional>
 
 namespace imppg::backend {
 
+/// Returns Gaussian blurs of `input` channels, as used by unsharp masking; they are incomplete if cancelled.
+/** If `useBlurPyramid` is true, the blurs are computed on decimated levels (see ConvolveSeparablePyramid()). */
+c_NeighbourCache<float>::Value BlurUnsharpMaskInput(
+    const std::vector<c_View<const IImageBuffer>>& input,
+    float sigma,
+    bool useBlurPyramid,
+    const c_CancellationToken* cancellation
+);
+
 class c_UnsharpMaskingThread: public IWorkerThread
 {
-    virtual void DoWork();
+    void DoWork() override;
+
+    const char* GetStageName() const override { return "Unsharp masking"; }
 
     std::optional<c_View<const IImageBuffer>> m_BlurredRawInput; ///< Raw/original image fragment smoothed to alleviate noise.
     UnsharpMask m_UnsharpMask;
+    bool m_UseBlurPyramid; ///< If true, large-sigma blurs are computed on decimated levels (see ConvolveSeparablePyramid()).
+    /// If set, the blurred input is taken from it (if present) or stored in it (key: sigma).
+    c_NeighbourCache<float>* m_BlurCache;
 
 public:
     c_UnsharpMaskingThread(
         WorkerParameters&& params,
         std::optional<c_View<const IImageBuffer>>&& m_BlurredRawInput,
-        UnsharpMask unsharpMask
+        UnsharpMask unsharpMask,
+        bool useBlurPyramid,
+        c_NeighbourCache<float>* blurCache
     );
 };
 
@@ -21,24 +21,69 @@ File description:
     Worker thread implementation.
 */
 
+#include <algorithm>
+#include <chrono>
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
 #include <wx/event.h>
 #include "cpu_bmp/worker.h"
 #include "cpu_bmp/message_ids.h"
+#include "logging/instrumentation.h"
 #include "logging/logging.h"
 
 namespace imppg::backend {
 
-wxThread::ExitCode IWorkerThread::Entry()
+IWorkerThread::~IWorkerThread()
 {
-    Log::Print(wxString::Format("Worker thread (id = %d): started work\n", m_Params.threadId));
-    DoWork();
-    Log::Print(wxString::Format("Worker thread (id = %d): work finished\n", m_Params.threadId));
+    // the derived class' members are already destroyed, so the processing must have finished
+    IMPPG_ASSERT(!IsRunning());
+}
+
+void IWorkerThread::Run()
+{
+    IMPPG_ASSERT(!m_Completion.valid());
+    m_Completion = c_TaskScheduler::Get().Submit([this] { Execute(); });
+}
+
+void IWorkerThread::Wait()
+{
+    if (m_Completion.valid()) { m_Completion.wait(); }
+}
+
+bool IWorkerThread::IsRunning() const
+{
+    return m_Completion.valid() && m_Completion.wait_for(std::chrono::seconds{0}) != std::future_status::ready;
+}
+
+void IWorkerThread::Execute()
+{
+    Log::PrintF("Worker thread (id = %d): started work\n", m_Params.threadId);
+#if defined(_OPENMP)
+    // the task scheduler restores the thread's budget after the task
+    if (m_Params.maxThreads > 0)
+    {
+        omp_set_num_threads(std::min(omp_get_max_threads(), m_Params.maxThreads));
+    }
+#endif
+    {
+        double megapixels = 0.0;
+        for (const auto& input: m_Params.input)
+        {
+            megapixels += static_cast<double>(input.GetWidth()) * input.GetHeight() / 1.0e6;
+        }
+        Log::c_StageTimer timer(GetStageName(), megapixels);
+        DoWork();
+        // a kernel stopped by the cancellation token may have returned without calling `IsAbortRequested`;
+        // its output must not be taken as complete
+        if (m_Cancellation.IsCancellationRequested()) { m_ThreadAborted = true; }
+        if (m_ThreadAborted) { timer.SetDetails("aborted"); }
+    }
+    Log::PrintF("Worker thread (id = %d): work finished\n", m_Params.threadId);
 
     WorkerEventPayload payload;
     payload.completionStatus = m_ThreadAborted ? CompletionStatus::ABORTED : CompletionStatus::COMPLETED;
     SendMessageToParent(ID_FINISHED_PROCESSING, payload);
-
-    return 0;
 }
 
 void IWorkerThread::SendMessageToParent(int messageId, WorkerEventPayload& payload)
@@ -54,7 +99,7 @@ void IWorkerThread::SendMessageToParent(int messageId, WorkerEventPayload& paylo
 
 bool IWorkerThread::IsAbortRequested()
 {
-    if (TestDestroy())
+    if (m_Cancellation.IsCancellationRequested())
     {
         m_ThreadAborted = true;
         return true;
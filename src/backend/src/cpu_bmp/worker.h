@@ -24,12 +24,13 @@ File description:
 #ifndef IMPPG_WORKER_H
 #define IMPPG_WORKER_H
 
+#include <future>
 #include <vector>
 #include <wx/frame.h>
-#include <wx/thread.h>
 #include <wx/gdicmn.h>
 
 #include "backend/backend.h"
+#include "common/scheduler.h"
 #include "image/image.h"
 
 namespace imppg::backend {
@@ -55,15 +56,22 @@ struct WorkerParameters
     std::vector<c_View<const IImageBuffer>> input; ///< Image fragment to process (luminance or R, G, B channels).
     std::vector<c_View<IImageBuffer>> output; ///< Output image (luminance or R, G, B channels).
     int threadId; ///< Unique thread id (not reused by new threads).
+    int maxThreads{0}; ///< If positive, limits the number of OpenMP threads used for the processing.
 };
 
-/// Base class representing a worker thread performing processing in the background.
-/** Only one instance can be launched at a time. It may spawn more threads
-    (not of IWorkerThread class) internally (e.g. via OpenMP) for faster processing. */
-class IWorkerThread: public wxThread
+/// Base class representing a processing step performed in the background.
+/** Only one instance can be launched at a time. The work is executed by a thread of the application-wide
+    `c_TaskScheduler` (no thread is created per step); it may use more threads internally (e.g. via OpenMP). */
+class IWorkerThread
 {
     bool m_ThreadAborted{false};
 
+    c_CancellationToken m_Cancellation;
+
+    std::future<void> m_Completion;
+
+    void Execute();
+
 protected:
     WorkerParameters m_Params;
 
@@ -71,11 +79,18 @@ protected:
     /** The method should call IsAbortRequested() frequently. */
     virtual void DoWork() = 0;
 
+    /// Returns the name under which the processing is reported by instrumentation (see `Log::c_StageTimer`).
+    virtual const char* GetStageName() const = 0;
+
     bool IsAbortRequested();
+
+    /// Can be passed to the processing kernels (e.g. convolution), which check it from their parallel loops.
+    const c_CancellationToken* GetCancellationToken() const { return &m_Cancellation; }
+
     void SendMessageToParent(int messageId, WorkerEventPayload &payload);
 
 public:
-    IWorkerThread(WorkerParameters&& params): wxThread(wxTHREAD_JOINABLE), m_Params(std::move(params))
+    IWorkerThread(WorkerParameters&& params): m_Params(std::move(params))
     {
         for (std::size_t ch = 0; ch < m_Params.input.size(); ++ch)
         {
@@ -90,7 +105,22 @@ public:
         }
     }
 
-    ExitCode Entry() override;
+    IWorkerThread(const IWorkerThread&) = delete;
+    IWorkerThread& operator=(const IWorkerThread&) = delete;
+
+    /// The processing must not be running (see `Abort` and `Wait`).
+    virtual ~IWorkerThread();
+
+    /// Submits the processing to the task scheduler.
+    void Run();
+
+    /// Signals the processing to finish ASAP; does not wait.
+    void Abort() { m_Cancellation.Cancel(); }
+
+    /// Waits until the processing finishes (does nothing if it has not been started).
+    void Wait();
+
+    bool IsRunning() const;
 };
 
 } // namespace imppg::backend
@@ -27,6 +27,7 @@ File description:
 #include "opengl/uniforms.h"
 #include "math_utils/gauss.h"
 #include "cpu_bmp/lrdeconv.h" //TODO: move BlurThresholdVicinity elsewhere
+#include "logging/logging.h"
 #include "../../imppg_assert.h"
 
 namespace imppg::backend {
@@ -676,6 +677,11 @@ void c_OpenGLProcessing::SetProcessingSettings(ProcessingSettings settings)
 {
     m_LRSync.abortRequested = true;
 
+    if (settings.color.luminanceOnly && !m_ProcessingSettings.color.luminanceOnly)
+    {
+        Log::Print("Luminance-only processing is not supported by the OpenGL back end; processing all channels.\n");
+    }
+
     if (m_ProcessingSettings.LucyRichardson.sigma != settings.LucyRichardson.sigma)
     {
         m_LRGaussian = GetGaussianKernel(settings.LucyRichardson.sigma);
@@ -0,0 +1,262 @@
+#include "cpu_bmp/lrdeconv.h"
+#include "cpu_bmp/w_lrdeconv.h"
+#include "image/image.h"
+#include "math_utils/cancellation.h"
+
+#include <algorithm>
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+constexpr unsigned WIDTH = 64;
+constexpr unsigned HEIGHT = 48;
+
+/// Returns an image with a bright square on a dark background.
+c_Image CreateTestImage()
+{
+    c_Image img(WIDTH, HEIGHT, PixelFormat::PIX_MONO32F);
+    for (unsigned y = 0; y < HEIGHT; ++y)
+    {
+        float* row = img.GetRowAs<float>(y);
+        for (unsigned x = 0; x < WIDTH; ++x)
+        {
+            row[x] = (x >= 16 && x < 32 && y >= 16 && y < 32) ? 0.8f : 0.2f;
+        }
+    }
+    return img;
+}
+
+/// Returns the result of `numIterations` L-R iterations performed on `input` by `RunLucyRichardson`.
+c_Image RunLR(const c_Image& input, int numIterations, const imppg::backend::LRIterates& iterates)
+{
+    c_Image output(WIDTH, HEIGHT, PixelFormat::PIX_MONO32F);
+    std::vector<c_View<const IImageBuffer>> inputs{c_View<const IImageBuffer>(input.GetBuffer())};
+    std::vector<c_View<IImageBuffer>> outputs{c_View<IImageBuffer>(output.GetBuffer())};
+    std::vector<std::uint8_t> workBuf(WIDTH * HEIGHT);
+
+    imppg::backend::RunLucyRichardson(
+        inputs, outputs, 1.5f, numIterations, imppg::backend::LRDeringing{false, 0.0f, 0.0f, workBuf}, iterates,
+        [](int, int) {}, []() { return false; }, nullptr
+    );
+    return output;
+}
+
+/// Reference implementation of `FillTresholdVicinityMask`: collects the border pixels and paints a square
+/// around each of them (the implementation used before the separable dilation was introduced).
+std::vector<uint8_t> GetThresholdVicinityMaskReference(const c_Image& input, float threshold, float sigma)
+{
+    const int width = static_cast<int>(input.GetWidth());
+    const int height = static_cast<int>(input.GetHeight());
+    std::vector<uint8_t> mask(width * height, 0);
+
+    std::vector<std::pair<int, int>> borderPixels;
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            if (input.GetRowAs<float>(y)[x] < threshold)
+            {
+                for (int j = -1; j <= 1; j++)
+                {
+                    for (int i = -1; i <= 1; i++)
+                    {
+                        if (i != 0 && j != 0 && x + i >= 0 && x + i < width && y + j >= 0 && y + j < height &&
+                            input.GetRowAs<float>(y + j)[x + i] >= threshold)
+                        {
+                            borderPixels.emplace_back(x + i, y + j);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    const int influenceDist = static_cast<int>(std::ceil(sigma * 2.0f));
+    for (const auto& [x, y]: borderPixels)
+    {
+        for (int i = -(influenceDist - 1); i <= influenceDist - 1; i++)
+        {
+            for (int j = -(influenceDist - 1); j <= influenceDist - 1; j++)
+            {
+                if (x + i >= 0 && x + i < width && y + j >= 0 && y + j < height)
+                {
+                    mask[(y + j) * width + (x + i)] = 1;
+                }
+            }
+        }
+    }
+
+    return mask;
+}
+
+/// Returns a random image with a few bright blobs (some of them crossing the image borders) and bright pixels
+/// at the corners and edges.
+c_Image CreateRandomBlobs(unsigned width, unsigned height, std::mt19937& rng)
+{
+    c_Image img(width, height, PixelFormat::PIX_MONO32F);
+    std::uniform_real_distribution<float> background(0.0f, 0.4f);
+    for (unsigned y = 0; y < height; ++y)
+    {
+        for (unsigned x = 0; x < width; ++x) { img.GetRowAs<float>(y)[x] = background(rng); }
+    }
+
+    std::uniform_int_distribution<int> xDist(-3, width + 2);
+    std::uniform_int_distribution<int> yDist(-3, height + 2);
+    std::uniform_int_distribution<int> radiusDist(0, 6);
+    for (int blob = 0; blob < 6; ++blob)
+    {
+        const int xc = xDist(rng), yc = yDist(rng), radius = radiusDist(rng);
+        for (int y = std::max(0, yc - radius); y <= std::min<int>(height - 1, yc + radius); ++y)
+        {
+            for (int x = std::max(0, xc - radius); x <= std::min<int>(width - 1, xc + radius); ++x)
+            {
+                if ((x - xc) * (x - xc) + (y - yc) * (y - yc) <= radius * radius) { img.GetRowAs<float>(y)[x] = 0.9f; }
+            }
+        }
+    }
+
+    // isolated bright pixels touching all four borders
+    for (const auto [x, y]: { std::pair{0u, 0u}, {width - 1, height - 1}, {width / 2, 0u}, {0u, height / 2},
+                              {width - 1, height / 3}, {width / 3, height - 1} })
+    {
+        img.GetRowAs<float>(y)[x] = 0.8f;
+    }
+
+    return img;
+}
+
+float GetMaxDifference(const c_Image& img1, const c_Image& img2)
+{
+    float maxDiff = 0.0f;
+    for (unsigned y = 0; y < HEIGHT; ++y)
+    {
+        for (unsigned x = 0; x < WIDTH; ++x)
+        {
+            maxDiff = std::max(maxDiff, std::abs(img1.GetRowAs<float>(y)[x] - img2.GetRowAs<float>(y)[x]));
+        }
+    }
+    return maxDiff;
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(CancelledDeconvolutionCallsCheckAbort)
+{
+    const c_Image input = CreateTestImage();
+    c_Image output(WIDTH, HEIGHT, PixelFormat::PIX_MONO32F);
+
+    std::vector<c_View<const IImageBuffer>> inputs{c_View<const IImageBuffer>(input.GetBuffer())};
+    std::vector<c_View<IImageBuffer>> outputs{c_View<IImageBuffer>(output.GetBuffer())};
+
+    c_CancellationToken cancellation;
+    cancellation.Cancel();
+
+    int numAbortChecks = 0;
+    int numIterations = 0;
+    LucyRichardsonGaussian(
+        inputs, outputs, 10, 1.5f, ConvolutionMethod::AUTO,
+        [&](int, int) { ++numIterations; },
+        [&]() { ++numAbortChecks; return cancellation.IsCancellationRequested(); },
+        &cancellation
+    );
+
+    // the caller (e.g. a worker thread) learns about the incomplete output only via `checkAbort`
+    BOOST_CHECK(numAbortChecks > 0);
+    BOOST_CHECK_EQUAL(0, numIterations);
+}
+
+BOOST_AUTO_TEST_CASE(AdaptiveUnsharpMaskingWithZeroWidthIsStepAtThreshold)
+{
+    c_Image input(WIDTH, HEIGHT, PixelFormat::PIX_MONO32F);
+    c_Image lum = CreateTestImage(); // 0.8 inside the square, 0.2 elsewhere
+    c_Image output(WIDTH, HEIGHT, PixelFormat::PIX_MONO32F);
+    std::vector<float> blurred(WIDTH * HEIGHT, 0.4f);
+    for (unsigned y = 0; y < HEIGHT; ++y)
+    {
+        float* row = input.GetRowAs<float>(y);
+        for (unsigned x = 0; x < WIDTH; ++x) { row[x] = 0.5f; }
+    }
+
+    const UnsharpMask um{true, 1.5, 0.5, 2.0, 0.5, 0.0};
+    AdaptiveUnsharpMaskBlend(
+        c_View<const IImageBuffer>(input.GetBuffer()),
+        blurred.data(),
+        c_View<const IImageBuffer>(lum.GetBuffer()),
+        c_View<IImageBuffer>(output.GetBuffer()),
+        um,
+        []() { return false; }
+    );
+
+    // blurred + amount * (input - blurred)
+    BOOST_CHECK_CLOSE(0.4f + 2.0f * 0.1f, output.GetRowAs<float>(20)[20], 1.0e-3);
+    BOOST_CHECK_CLOSE(0.4f + 0.5f * 0.1f, output.GetRowAs<float>(0)[0], 1.0e-3);
+}
+
+BOOST_AUTO_TEST_CASE(ContinuedDeconvolutionEqualsDeconvolutionFromScratch)
+{
+    constexpr int NUM_ITERATIONS = 12;
+    constexpr int INTERMEDIATE = 5;
+
+    const c_Image input = CreateTestImage();
+
+    imppg::backend::c_NeighbourCache<int> cache;
+    imppg::backend::LRIterates keepIterates;
+    keepIterates.cache = &cache;
+    keepIterates.toKeep = { INTERMEDIATE, NUM_ITERATIONS };
+    const c_Image fromScratch = RunLR(input, NUM_ITERATIONS, keepIterates);
+
+    const auto intermediate = cache.Find(INTERMEDIATE);
+    BOOST_REQUIRE(intermediate != nullptr);
+    BOOST_REQUIRE_EQUAL(1, intermediate->size());
+
+    // the result of `NUM_ITERATIONS` iterations is also kept (unclamped, like the output)
+    const auto kept = cache.Find(NUM_ITERATIONS);
+    BOOST_REQUIRE(kept != nullptr);
+    BOOST_CHECK_SMALL(GetMaxDifference(fromScratch, kept->at(0)), 1.0e-6f);
+
+    imppg::backend::LRIterates continueIterates;
+    continueIterates.initialEstimate = intermediate;
+    continueIterates.initialIteration = INTERMEDIATE;
+    const c_Image continued = RunLR(input, NUM_ITERATIONS, continueIterates);
+    BOOST_CHECK_SMALL(GetMaxDifference(fromScratch, continued), 1.0e-5f);
+
+    // continuing from the estimate of the requested number of iterations only copies it
+    imppg::backend::LRIterates noOpIterates;
+    noOpIterates.initialEstimate = intermediate;
+    noOpIterates.initialIteration = INTERMEDIATE;
+    const c_Image sameAsIntermediate = RunLR(input, INTERMEDIATE, noOpIterates);
+    BOOST_CHECK_SMALL(GetMaxDifference(sameAsIntermediate, intermediate->at(0)), 1.0e-6f);
+}
+
+BOOST_AUTO_TEST_CASE(ThresholdVicinityMaskMatchesReference)
+{
+    constexpr float THRESHOLD = 0.5f;
+
+    std::mt19937 rng(1234);
+    for (const auto& size: { std::pair{64u, 48u}, {131u, 67u}, {3u, 70u}, {70u, 3u}, {1u, 1u}, {2u, 9u} })
+    {
+        for (const float sigma: { 0.2f, 0.5f, 1.0f, 1.3f, 2.5f, 7.0f, 40.0f })
+        {
+            for (int trial = 0; trial < 5; ++trial)
+            {
+                BOOST_TEST_CONTEXT(size.first << "x" << size.second << ", sigma = " << sigma << ", trial " << trial)
+                {
+                    const c_Image input = CreateRandomBlobs(size.first, size.second, rng);
+
+                    std::vector<uint8_t> mask(size.first * size.second, 0xAA);
+                    FillTresholdVicinityMask(
+                        c_View<const IImageBuffer>(input.GetBuffer()), mask, THRESHOLD, sigma
+                    );
+
+                    const std::vector<uint8_t> expected = GetThresholdVicinityMaskReference(input, THRESHOLD, sigma);
+                    BOOST_CHECK(mask == expected);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,102 @@
+#include "cpu_bmp/speculation.h"
+
+#include <boost/test/unit_test.hpp>
+#include <memory>
+#include <vector>
+
+using imppg::backend::c_NeighbourCache;
+
+namespace
+{
+
+template<typename Key>
+typename c_NeighbourCache<Key>::Value CreateEntry()
+{
+    auto entry = std::make_shared<std::vector<c_Image>>();
+    entry->emplace_back(4, 4, PixelFormat::PIX_MONO32F);
+    return entry;
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(FloatKeysWithinToleranceAreEqual)
+{
+    c_NeighbourCache<float> cache;
+    const auto entry = CreateEntry<float>();
+    cache.Store(1.0f, entry);
+
+    BOOST_CHECK(cache.Find(1.0f) == entry);
+    BOOST_CHECK(cache.Find(1.00005f) == entry);
+    BOOST_CHECK(cache.Find(0.99995f) == entry);
+    BOOST_CHECK(cache.Find(1.001f) == nullptr);
+    BOOST_CHECK(cache.Find(0.999f) == nullptr);
+
+    // replaces the existing entry instead of adding a second one
+    const auto replacement = CreateEntry<float>();
+    cache.Store(1.00005f, replacement);
+    BOOST_CHECK(cache.Find(1.0f) == replacement);
+    cache.Trim(1.0f, 1);
+    BOOST_CHECK(cache.Find(1.0f) == replacement);
+}
+
+BOOST_AUTO_TEST_CASE(IntKeysMustMatchExactly)
+{
+    c_NeighbourCache<int> cache;
+    const auto entry = CreateEntry<int>();
+    cache.Store(10, entry);
+
+    BOOST_CHECK(cache.Find(10) == entry);
+    BOOST_CHECK(cache.Find(9) == nullptr);
+    BOOST_CHECK(cache.Find(11) == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(TrimKeepsEntriesNearestToCurrent)
+{
+    c_NeighbourCache<int> cache;
+    for (const int key: { 1, 5, 9, 10, 12, 20 }) { cache.Store(key, CreateEntry<int>()); }
+
+    cache.Trim(10, 3);
+    BOOST_CHECK(cache.Find(9) != nullptr);
+    BOOST_CHECK(cache.Find(10) != nullptr);
+    BOOST_CHECK(cache.Find(12) != nullptr);
+    BOOST_CHECK(cache.Find(1) == nullptr);
+    BOOST_CHECK(cache.Find(5) == nullptr);
+    BOOST_CHECK(cache.Find(20) == nullptr);
+
+    // nothing to remove
+    cache.Trim(10, 3);
+    BOOST_CHECK(cache.Find(9) != nullptr && cache.Find(10) != nullptr && cache.Find(12) != nullptr);
+
+    cache.Trim(10, 0);
+    BOOST_CHECK(cache.Find(10) == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(FindPrecedingReturnsGreatestKeyNotExceeding)
+{
+    c_NeighbourCache<int> cache;
+    BOOST_CHECK(!cache.FindPreceding(10).has_value());
+
+    const auto entry5 = CreateEntry<int>();
+    const auto entry8 = CreateEntry<int>();
+    cache.Store(5, entry5);
+    cache.Store(8, entry8);
+
+    BOOST_CHECK(!cache.FindPreceding(4).has_value());
+
+    const auto atKey = cache.FindPreceding(8);
+    BOOST_REQUIRE(atKey.has_value());
+    BOOST_CHECK_EQUAL(8, atKey->first);
+    BOOST_CHECK(atKey->second == entry8);
+
+    const auto between = cache.FindPreceding(7);
+    BOOST_REQUIRE(between.has_value());
+    BOOST_CHECK_EQUAL(5, between->first);
+    BOOST_CHECK(between->second == entry5);
+
+    const auto above = cache.FindPreceding(100);
+    BOOST_REQUIRE(above.has_value());
+    BOOST_CHECK_EQUAL(8, above->first);
+
+    cache.Clear();
+    BOOST_CHECK(!cache.FindPreceding(100).has_value());
+}
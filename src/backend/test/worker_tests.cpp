@@ -0,0 +1,57 @@
+#include "cpu_bmp/message_ids.h"
+#include "cpu_bmp/worker.h"
+#include "image/image.h"
+
+#include <boost/test/unit_test.hpp>
+#include <optional>
+
+using namespace imppg::backend;
+
+namespace
+{
+
+/// Stops like a processing kernel given the cancellation token: returns without calling `IsAbortRequested`.
+class c_CancellableWorker: public IWorkerThread
+{
+    void DoWork() override
+    {
+        while (!GetCancellationToken()->IsCancellationRequested()) {}
+    }
+
+    const char* GetStageName() const override { return "Test"; }
+
+public:
+    using IWorkerThread::IWorkerThread;
+};
+
+}
+
+BOOST_AUTO_TEST_CASE(WorkerStoppedByCancellationTokenReportsAbort)
+{
+    const c_Image input(8, 8, PixelFormat::PIX_MONO32F);
+    c_Image output(8, 8, PixelFormat::PIX_MONO32F);
+
+    wxEvtHandler parent;
+    std::optional<CompletionStatus> status;
+    parent.Bind(wxEVT_THREAD, [&](wxThreadEvent& event) {
+        if (event.GetId() == ID_FINISHED_PROCESSING)
+        {
+            status = event.GetPayload<WorkerEventPayload>().completionStatus;
+        }
+    });
+
+    c_CancellableWorker worker(WorkerParameters{
+        parent,
+        0,
+        {c_View<const IImageBuffer>(input.GetBuffer())},
+        {c_View<IImageBuffer>(output.GetBuffer())},
+        1
+    });
+    worker.Run();
+    worker.Abort();
+    worker.Wait();
+    parent.ProcessPendingEvents();
+
+    BOOST_REQUIRE(status.has_value());
+    BOOST_CHECK(CompletionStatus::ABORTED == *status);
+}
@@ -21,7 +21,9 @@ File description:
     Batch progress dialog implementation.
 */
 
+#include <future>
 #include <limits.h>
+#include <memory>
 #include <optional>
 #include <string>
 #include <wx/button.h>
@@ -38,10 +40,11 @@ File description:
 #include "backend/backend.h"
 #include "batch_params.h"
 #include "batch.h"
+#include "common/scheduler.h"
 #include "ctrl_ids.h"
 #include "image/image.h"
 #include "imppg_assert.h"
-#include "logging.h"
+#include "logging/logging.h"
 #include "common/proc_settings.h"
 
 using namespace imppg::backend;
@@ -77,6 +80,23 @@ class c_BatchDialog: public wxDialog
 
     bool m_ProcessNextFile{false};
 
+    struct LoadedFile
+    {
+        std::optional<c_Image> image;
+        std::string errorMsg;
+    };
+
+    /// Input file loaded by the task scheduler while the previous one is being processed.
+    struct
+    {
+        std::size_t fileIdx{0};
+        std::shared_ptr<LoadedFile> result;
+        std::future<void> completion;
+    } m_Prefetch;
+
+    /// Starts loading of the specified file in the background
+    void PrefetchFile(std::size_t fileIdx);
+
     /// Starts processing of the next file
     void ProcessNextFile();
 
@@ -230,20 +250,22 @@ void c_BatchDialog::ProcessNextFile()
         m_CurrentFileIdx = 0;
     }
 
-    m_ProgressCtrl->SetValue(m_CurrentFileIdx.value());
+    const std::size_t fileIdx = m_CurrentFileIdx.value();
+    m_ProgressCtrl->SetValue(fileIdx);
 
-    wxFileName path = wxFileName(m_FileNames[m_CurrentFileIdx.value()]);
-    wxString ext = path.GetExt().Lower();
-    std::string errorMsg;
+    wxFileName path = wxFileName(m_FileNames[fileIdx]);
 
-    auto img = LoadImageFileAs32f(
-        path.GetFullPath().ToStdString(),
-        Configuration::NormalizeFITSValues,
-        &errorMsg
-    );
+    if (!m_Prefetch.completion.valid() || m_Prefetch.fileIdx != fileIdx)
+    {
+        PrefetchFile(fileIdx);
+    }
+    m_Prefetch.completion.wait();
+    m_Prefetch.completion = {};
+    LoadedFile loaded = std::move(*m_Prefetch.result);
+    auto& img = loaded.image;
     if (!img.has_value())
     {
-        wxMessageBox(wxString::Format(_("Could not open file: %s."), path.GetFullPath()) + (errorMsg != "" ? "\n" + errorMsg : ""),
+        wxMessageBox(wxString::Format(_("Could not open file: %s."), path.GetFullPath()) + (loaded.errorMsg != "" ? "\n" + loaded.errorMsg : ""),
             _("Error"), wxICON_ERROR, this);
         m_FileOperationFailure = true;
         return;
@@ -256,6 +278,25 @@ void c_BatchDialog::ProcessNextFile()
     }
 
     m_Processor->StartProcessing(std::move(img.value()), proc);
+
+    if (fileIdx + 1 < m_FileNames.Count())
+    {
+        PrefetchFile(fileIdx + 1);
+    }
+}
+
+void c_BatchDialog::PrefetchFile(std::size_t fileIdx)
+{
+    const std::string path = wxFileName(m_FileNames[fileIdx]).GetFullPath().ToStdString();
+    const bool normalizeFitsValues = Configuration::NormalizeFITSValues;
+    auto result = std::make_shared<LoadedFile>();
+
+    m_Prefetch.fileIdx = fileIdx;
+    m_Prefetch.result = result;
+    // the task does not refer to the dialog, which may be closed before the loading finishes
+    m_Prefetch.completion = c_TaskScheduler::Get().Submit([result, path, normalizeFitsValues] {
+        result->image = LoadImageFileAs32f(path, normalizeFitsValues, &result->errorMsg);
+    });
 }
 
 void c_BatchDialog::OnCommandEvent(wxCommandEvent& event)
@@ -278,7 +319,7 @@ c_BatchDialog::c_BatchDialog(wxWindow* parent, wxArrayString fileNames,
 {
     switch (Configuration::ProcessingBackEnd)
     {
-    case BackEnd::CPU_AND_BITMAPS: m_Processor = imppg::backend::CreateCpuBmpProcessingBackend(); break;
+    case BackEnd::CPU_AND_BITMAPS: m_Processor = imppg::backend::CreateCpuBmpProcessingBackend(Configuration::UnsharpMaskBlurPyramid); break;
 #if USE_OPENGL_BACKEND
     case BackEnd::GPU_OPENGL: m_Processor = imppg::backend::CreateOpenGLProcessingBackend(Configuration::LRCmdBatchSizeMpixIters); break;
 #endif
@@ -0,0 +1,620 @@
+/*
+ImPPG (Image Post-Processor) - common operations for astronomical stacks and other images
+Copyright (C) 2016-2023 Filip Szczerek <ga.software@yahoo.com>
+
+This file is part of ImPPG.
+
+ImPPG is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ImPPG is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with ImPPG.  If not, see <http://www.gnu.org/licenses/>.
+
+File description:
+    Benchmark suite; times the processing steps and file operations on synthetic images
+    and writes the results as JSON.
+
+    Usage:
+        imppg_bench [--width N] [--height N] [--content disk|noise|gradient] [--repeat N]
+                    [--batch-files N] [--only NAME[,NAME...]] [--label TEXT] [--output FILE]
+*/
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <locale>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <wx/app.h>
+#include <wx/init.h>
+
+#include "backend/backend.h"
+#include "common/formats.h"
+#include "common/proc_settings.h"
+#include "common/tcrv.h"
+#include "cpu_bmp/lrdeconv.h"
+#include "fft.h"
+#include "image/image.h"
+#include "math_utils/convolution.h"
+
+#if !defined(_OPENMP)
+int omp_get_max_threads() { return 1; }
+#endif
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+struct Options
+{
+    unsigned width{2048};
+    unsigned height{2048};
+    std::string content{"disk"};
+    int repeat{5};
+    int batchFiles{4};
+    std::vector<std::string> only; ///< If not empty, only the benchmarks with these names are run.
+    std::string label; ///< Copied to the output (e.g. a commit hash).
+    std::string outputFile; ///< If empty, results are written to stdout.
+};
+
+struct BenchmarkResult
+{
+    std::string name;
+    std::vector<std::pair<std::string, double>> parameters;
+    std::vector<double> timesMs;
+    double megapixels; ///< Number of processed pixels (in millions) per run.
+};
+
+/// `setup` (if any) is called once and is not timed; `run` is called repeatedly and each call is timed.
+/** Only the benchmarks which are selected to run have their `setup` called. */
+struct Benchmark
+{
+    std::string name;
+    std::vector<std::pair<std::string, double>> parameters;
+    std::function<void()> run;
+    double megapixels;
+    std::function<void()> setup{};
+};
+
+std::optional<Options> ParseCommandLine(int argc, char* argv[])
+{
+    Options options;
+    try
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string arg = argv[i];
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing value for " << arg << "\n";
+                return std::nullopt;
+            }
+            const std::string value = argv[++i];
+
+            if (arg == "--width") { options.width = std::stoul(value); }
+            else if (arg == "--height") { options.height = std::stoul(value); }
+            else if (arg == "--content") { options.content = value; }
+            else if (arg == "--repeat") { options.repeat = std::max(1, std::stoi(value)); }
+            else if (arg == "--batch-files") { options.batchFiles = std::max(1, std::stoi(value)); }
+            else if (arg == "--label") { options.label = value; }
+            else if (arg == "--output") { options.outputFile = value; }
+            else if (arg == "--only")
+            {
+                std::istringstream names(value);
+                std::string name;
+                while (std::getline(names, name, ',')) { options.only.push_back(name); }
+            }
+            else
+            {
+                std::cerr << "Unknown option: " << arg << "\n";
+                return std::nullopt;
+            }
+        }
+    }
+    catch (const std::logic_error&) // thrown by `std::stoi` etc. for invalid values
+    {
+        std::cerr << "Invalid numerical value.\n";
+        return std::nullopt;
+    }
+
+    if (options.content != "disk" && options.content != "noise" && options.content != "gradient")
+    {
+        std::cerr << "Unknown image content: " << options.content << "\n";
+        return std::nullopt;
+    }
+    if (options.width < 16 || options.height < 16)
+    {
+        std::cerr << "Image size must be at least 16x16.\n";
+        return std::nullopt;
+    }
+
+    return options;
+}
+
+/// Creates a PIX_MONO32F image with values from [0; 1]; the contents are the same for the same parameters.
+///
+/// "disk" resembles a solar image: a limb-darkened disk with fine-grained texture and noise.
+///
+c_Image CreateSyntheticImage(unsigned width, unsigned height, const std::string& content)
+{
+    c_Image img(width, height, PixelFormat::PIX_MONO32F);
+    std::mt19937 generator(1);
+    std::normal_distribution<float> noise(0.0f, 0.01f);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+    const float cx = 0.5f * width;
+    const float cy = 0.5f * height;
+    const float radius = 0.4f * std::min(width, height);
+
+    for (unsigned y = 0; y < height; ++y)
+    {
+        float* row = img.GetRowAs<float>(y);
+        for (unsigned x = 0; x < width; ++x)
+        {
+            float value{};
+            if (content == "noise")
+            {
+                value = uniform(generator);
+            }
+            else if (content == "gradient")
+            {
+                value = 0.5f * (static_cast<float>(x) / width + static_cast<float>(y) / height);
+            }
+            else
+            {
+                const float r = std::hypot(x - cx, y - cy) / radius;
+                if (r < 1.0f)
+                {
+                    const float limbDarkening = 0.4f + 0.6f * std::sqrt(1.0f - r * r);
+                    const float texture = 0.05f * std::sin(0.7f * x) * std::sin(0.9f * y);
+                    value = 0.8f * limbDarkening + texture;
+                }
+                else
+                {
+                    value = 0.05f * std::exp(-10.0f * (r - 1.0f));
+                }
+                value += noise(generator);
+            }
+            row[x] = std::clamp(value, 0.0f, 1.0f);
+        }
+    }
+
+    return img;
+}
+
+c_PaddedArrayPtr<const float> ConstArrayOf(const c_Image& img)
+{
+    return c_PaddedArrayPtr<const float>(
+        img.GetRowAs<float>(0), img.GetWidth(), img.GetHeight(), img.GetBuffer().GetBytesPerRow()
+    );
+}
+
+c_PaddedArrayPtr<float> ArrayOf(c_Image& img)
+{
+    return c_PaddedArrayPtr<float>(
+        img.GetRowAs<float>(0), img.GetWidth(), img.GetHeight(), img.GetBuffer().GetBytesPerRow()
+    );
+}
+
+unsigned NextPowerOfTwo(unsigned value)
+{
+    unsigned result = 1;
+    while (result < value) { result *= 2; }
+    return result;
+}
+
+ProcessingSettings GetBatchProcessingSettings()
+{
+    ProcessingSettings settings;
+    settings.LucyRichardson.sigma = 1.3f;
+    settings.LucyRichardson.iterations = 50;
+    settings.unsharpMask.at(0).sigma = 5.0f;
+    settings.unsharpMask.at(0).amountMax = 2.0f;
+    settings.toneCurve = c_ToneCurve{{0.0f, 0.0f}, {0.5f, 0.7f}, {1.0f, 1.0f}};
+    return settings;
+}
+
+/// Loads, processes (with the CPU processing back end) and saves all `inputFiles`, like the batch processing dialog.
+class c_BatchRunner
+{
+public:
+    c_BatchRunner(wxAppConsole& app, std::vector<std::string> inputFiles, std::string outputDir)
+    : m_App(app), m_InputFiles(std::move(inputFiles)), m_OutputDir(std::move(outputDir))
+    {
+        m_Processor = imppg::backend::CreateCpuBmpProcessingBackend(false);
+        m_Processor->SetProcessingCompletedHandler([this](imppg::backend::CompletionStatus status) {
+            if (status != imppg::backend::CompletionStatus::COMPLETED)
+            {
+                Fail("processing aborted");
+                return;
+            }
+
+            const std::string outputFile = (fs::path(m_OutputDir) / ("out_" + std::to_string(m_FileIdx) + ".tif")).string();
+            if (!m_Processor->GetProcessedOutput().SaveToFile(outputFile, OutputFormat::TIFF_16))
+            {
+                Fail("could not save " + outputFile);
+                return;
+            }
+
+            m_FileIdx += 1;
+            if (m_FileIdx == m_InputFiles.size())
+            {
+                m_App.ExitMainLoop();
+            }
+            else
+            {
+                ProcessNextFile();
+            }
+        });
+    }
+
+    void Run()
+    {
+        m_FileIdx = 0;
+        ProcessNextFile();
+        if (!m_Failed)
+        {
+            m_App.MainLoop();
+        }
+        if (m_Failed)
+        {
+            std::cerr << "Batch processing failed.\n";
+            std::exit(1);
+        }
+    }
+
+private:
+    wxAppConsole& m_App;
+    std::vector<std::string> m_InputFiles;
+    std::string m_OutputDir;
+    std::unique_ptr<imppg::backend::IProcessingBackEnd> m_Processor;
+    std::size_t m_FileIdx{0};
+    bool m_Failed{false};
+
+    void Fail(const std::string& message)
+    {
+        std::cerr << "Batch processing error: " << message << "\n";
+        m_Failed = true;
+        m_App.ExitMainLoop();
+    }
+
+    void ProcessNextFile()
+    {
+        std::string errorMsg;
+        auto img = LoadImageFileAs32f(m_InputFiles[m_FileIdx], false, &errorMsg);
+        if (!img.has_value())
+        {
+            Fail("could not load " + m_InputFiles[m_FileIdx] + ": " + errorMsg);
+            return;
+        }
+        m_Processor->StartProcessing(std::move(*img), GetBatchProcessingSettings());
+    }
+};
+
+std::vector<Benchmark> CreateBenchmarks(
+    const Options& options,
+    const c_Image& input,
+    wxAppConsole& app,
+    const fs::path& tempDir
+)
+{
+    const double megapixels = input.GetWidth() * static_cast<double>(input.GetHeight()) / 1.0e6;
+    const unsigned width = input.GetWidth();
+    const unsigned height = input.GetHeight();
+
+    std::vector<Benchmark> benchmarks;
+
+    for (const float sigma: {1.5f, 5.0f})
+    {
+        auto output = std::make_shared<c_Image>(width, height, PixelFormat::PIX_MONO32F);
+        benchmarks.push_back({"ConvolveSeparable", {{"sigma", sigma}}, [&input, output, sigma]() {
+            ConvolveSeparable(ConstArrayOf(input), ArrayOf(*output), sigma);
+        }, megapixels});
+    }
+
+    {
+        const float sigma = 5.0f;
+        auto output = std::make_shared<c_Image>(height, width, PixelFormat::PIX_MONO32F);
+        auto tempBuf1 = std::make_shared<std::vector<float>>(input.GetNumPixels());
+        auto tempBuf2 = std::make_shared<std::vector<float>>(input.GetNumPixels());
+        benchmarks.push_back({"ConvolveGaussianRecursiveTranspose", {{"sigma", sigma}}, [=, &input]() {
+            ConvolveGaussianRecursiveTranspose(ConstArrayOf(input), ArrayOf(*output), sigma, tempBuf1->data(), tempBuf2->data());
+        }, megapixels});
+    }
+
+    {
+        const float sigma = 1.3f;
+        const int iterations = 50;
+        auto output = std::make_shared<c_Image>(width, height, PixelFormat::PIX_MONO32F);
+        benchmarks.push_back({"LucyRichardsonGaussian", {{"sigma", sigma}, {"iterations", iterations}}, [=, &input]() {
+            std::vector<c_View<const IImageBuffer>> inputs{c_View<const IImageBuffer>(input.GetBuffer())};
+            std::vector<c_View<IImageBuffer>> outputs{c_View<IImageBuffer>(output->GetBuffer())};
+            LucyRichardsonGaussian(inputs, outputs, iterations, sigma, ConvolutionMethod::AUTO, [](int, int) {}, []() { return false; });
+        }, megapixels});
+    }
+
+    {
+        const float sigma = 5.0f;
+        const float amount = 2.0f;
+        auto blurred = std::make_shared<c_Image>(width, height, PixelFormat::PIX_MONO32F);
+        auto output = std::make_shared<c_Image>(width, height, PixelFormat::PIX_MONO32F);
+        benchmarks.push_back({"UnsharpMask", {{"sigma", sigma}, {"amount", amount}}, [=, &input]() {
+            ConvolveSeparable(ConstArrayOf(input), ArrayOf(*blurred), sigma);
+            UnsharpMaskBlend(
+                c_View<const IImageBuffer>(input.GetBuffer()),
+                blurred->GetRowAs<float>(0),
+                c_View<IImageBuffer>(output->GetBuffer()),
+                amount,
+                []() { return false; }
+            );
+        }, megapixels});
+    }
+
+    {
+        auto toneCurve = std::make_shared<c_ToneCurve>(GetBatchProcessingSettings().toneCurve);
+        toneCurve->RefreshLut();
+        auto output = std::make_shared<c_Image>(width, height, PixelFormat::PIX_MONO32F);
+        benchmarks.push_back({"ToneCurve", {}, [=, &input]() {
+            #pragma omp parallel for
+            for (int y = 0; y < static_cast<int>(height); ++y)
+            {
+                toneCurve->ApplyApproximatedToneCurve(input.GetRowAs<float>(y), output->GetRowAs<float>(y), width);
+            }
+        }, megapixels});
+    }
+
+    {
+        const unsigned fftWidth = NextPowerOfTwo(width);
+        const unsigned fftHeight = NextPowerOfTwo(height);
+        auto fftInput = std::make_shared<std::vector<float>>();
+        auto fftOutput = std::make_shared<std::vector<std::complex<float>>>();
+        benchmarks.push_back({"CalcFFT2D", {{"fft_width", static_cast<double>(fftWidth)}, {"fft_height", static_cast<double>(fftHeight)}}, [=]() {
+            CalcFFT2D(fftInput->data(), fftHeight, fftWidth, static_cast<int>(fftWidth * sizeof(float)), fftOutput->data());
+        }, fftWidth * static_cast<double>(fftHeight) / 1.0e6, [=, &input]() {
+            fftInput->assign(fftWidth * fftHeight, 0.0f);
+            for (unsigned y = 0; y < height; ++y)
+            {
+                std::copy(input.GetRowAs<float>(y), input.GetRowAs<float>(y) + width, fftInput->data() + y * fftWidth);
+            }
+            fftOutput->resize(fftWidth * fftHeight);
+        }});
+    }
+
+    const auto saveInput = [&input](const std::string& fileName, OutputFormat format) {
+        if (!input.SaveToFile(fileName, format))
+        {
+            std::cerr << "Could not save " << fileName << ".\n";
+            std::exit(1);
+        }
+    };
+
+    const auto addFileBenchmarks = [&](const std::string& formatName, OutputFormat format, const std::string& extension) {
+        const std::string fileName = (tempDir / ("bench_input" + extension)).string();
+        benchmarks.push_back({"Save" + formatName, {}, [=]() { saveInput(fileName, format); }, megapixels});
+        benchmarks.push_back({"Load" + formatName, {}, [=]() {
+            if (!LoadImageFileAs32f(fileName, false).has_value())
+            {
+                std::cerr << "Could not load " << fileName << ".\n";
+                std::exit(1);
+            }
+        }, megapixels, [=]() { saveInput(fileName, format); }});
+    };
+    addFileBenchmarks("TIFF16", OutputFormat::TIFF_16, ".tif");
+#if USE_CFITSIO
+    addFileBenchmarks("FITS32F", OutputFormat::FITS_32F, ".fit");
+#endif
+
+    {
+        std::vector<std::string> inputFiles;
+        for (int i = 0; i < options.batchFiles; ++i)
+        {
+            inputFiles.push_back((tempDir / ("batch_input_" + std::to_string(i) + ".tif")).string());
+        }
+        // The input files have just been written, so they are most likely read from the OS cache;
+        // the benchmark measures loading (decoding), processing and saving rather than disk reads.
+        benchmarks.push_back({"Batch", {{"files", static_cast<double>(inputFiles.size())}}, [=, &app]() {
+            c_BatchRunner(app, inputFiles, tempDir.string()).Run();
+        }, inputFiles.size() * megapixels, [=]() {
+            for (const auto& inputFile: inputFiles) { saveInput(inputFile, OutputFormat::TIFF_16); }
+        }});
+    }
+
+    return benchmarks;
+}
+
+BenchmarkResult RunBenchmark(const Benchmark& benchmark, int repeat)
+{
+    std::cerr << "Running " << benchmark.name << "..." << std::endl;
+
+    BenchmarkResult result{benchmark.name, benchmark.parameters, {}, benchmark.megapixels};
+
+    if (benchmark.setup) { benchmark.setup(); }
+
+    benchmark.run(); // warm-up (caches, lazily allocated buffers, thread pool)
+
+    for (int i = 0; i < repeat; ++i)
+    {
+        const auto tStart = std::chrono::steady_clock::now();
+        benchmark.run();
+        const auto tEnd = std::chrono::steady_clock::now();
+        result.timesMs.push_back(std::chrono::duration<double, std::milli>(tEnd - tStart).count());
+    }
+
+    return result;
+}
+
+std::string JsonString(const std::string& s)
+{
+    std::string result = "\"";
+    for (const char c: s)
+    {
+        switch (c)
+        {
+        case '"': result += "\\\""; break;
+        case '\\': result += "\\\\"; break;
+        case '\n': result += "\\n"; break;
+        case '\t': result += "\\t"; break;
+        default: result += c;
+        }
+    }
+    return result + "\"";
+}
+
+void WriteJson(std::ostream& out, const Options& options, const std::vector<BenchmarkResult>& results)
+{
+    out.imbue(std::locale::classic());
+    out.precision(6);
+
+    out << "{\n";
+    out << "  \"label\": " << JsonString(options.label) << ",\n";
+    out << "  \"image\": {\"width\": " << options.width << ", \"height\": " << options.height
+        << ", \"content\": " << JsonString(options.content) << "},\n";
+    out << "  \"threads\": " << omp_get_max_threads() << ",\n";
+    out << "  \"repeat\": " << options.repeat << ",\n";
+    out << "  \"results\": [";
+
+    for (std::size_t i = 0; i < results.size(); ++i)
+    {
+        const auto& result = results[i];
+        std::vector<double> times = result.timesMs;
+        std::sort(times.begin(), times.end());
+        const double median = (times.size() % 2 == 1)
+            ? times[times.size() / 2]
+            : 0.5 * (times[times.size() / 2 - 1] + times[times.size() / 2]);
+        const double mean = std::accumulate(times.begin(), times.end(), 0.0) / times.size();
+
+        out << (i > 0 ? "," : "") << "\n    {\n";
+        out << "      \"name\": " << JsonString(result.name) << ",\n";
+        out << "      \"parameters\": {";
+        for (std::size_t p = 0; p < result.parameters.size(); ++p)
+        {
+            out << (p > 0 ? ", " : "") << JsonString(result.parameters[p].first) << ": " << result.parameters[p].second;
+        }
+        out << "},\n";
+        out << "      \"min_ms\": " << times.front() << ",\n";
+        out << "      \"median_ms\": " << median << ",\n";
+        out << "      \"mean_ms\": " << mean << ",\n";
+        out << "      \"max_ms\": " << times.back() << ",\n";
+        out << "      \"megapixels_per_second\": " << result.megapixels / (median / 1000.0) << ",\n";
+        out << "      \"times_ms\": [";
+        for (std::size_t t = 0; t < result.timesMs.size(); ++t)
+        {
+            out << (t > 0 ? ", " : "") << result.timesMs[t];
+        }
+        out << "]\n    }";
+    }
+
+    out << "\n  ]\n}\n";
+}
+
+} // anonymous namespace
+
+int main(int argc, char* argv[])
+{
+    const auto options = ParseCommandLine(argc, argv);
+    if (!options.has_value())
+    {
+        std::cerr << "Usage: imppg_bench [--width N] [--height N] [--content disk|noise|gradient] [--repeat N]\n"
+                     "                   [--batch-files N] [--only NAME[,NAME...]] [--label TEXT] [--output FILE]\n";
+        return 1;
+    }
+
+    wxInitialize();
+    int exitCode = 0;
+    {
+        // needed for the event loop of the processing back end (used by the "Batch" benchmark)
+        wxAppConsole app;
+
+        std::error_code ec;
+        const fs::path tempDir = fs::temp_directory_path() / ("imppg_bench_" + std::to_string(std::random_device{}()));
+        fs::create_directories(tempDir, ec);
+        if (ec)
+        {
+            std::cerr << "Could not create temporary folder " << tempDir << ".\n";
+            wxUninitialize();
+            return 1;
+        }
+
+        const c_Image input = CreateSyntheticImage(options->width, options->height, options->content);
+
+        const auto benchmarks = CreateBenchmarks(*options, input, app, tempDir);
+        const auto isSelected = [&](const std::string& name) {
+            return options->only.empty() || std::find(options->only.begin(), options->only.end(), name) != options->only.end();
+        };
+
+        for (const auto& name: options->only)
+        {
+            if (std::none_of(benchmarks.begin(), benchmarks.end(), [&](const Benchmark& b) { return b.name == name; }))
+            {
+                std::cerr << "Unknown benchmark: " << name << "\n";
+                exitCode = 1;
+            }
+        }
+
+        if (exitCode != 0)
+        {
+            std::vector<std::string> names;
+            for (const auto& benchmark: benchmarks)
+            {
+                if (std::find(names.begin(), names.end(), benchmark.name) == names.end()) { names.push_back(benchmark.name); }
+            }
+            std::cerr << "Available benchmarks:";
+            for (const auto& name: names) { std::cerr << " " << name; }
+            std::cerr << "\n";
+        }
+        else
+        {
+            std::vector<BenchmarkResult> results;
+            for (const auto& benchmark: benchmarks)
+            {
+                if (isSelected(benchmark.name))
+                {
+                    results.push_back(RunBenchmark(benchmark, options->repeat));
+                }
+            }
+
+            if (options->outputFile.empty())
+            {
+                WriteJson(std::cout, *options, results);
+            }
+            else
+            {
+                std::ofstream file(options->outputFile);
+                WriteJson(file, *options, results);
+                if (!file)
+                {
+                    std::cerr << "Could not write " << options->outputFile << ".\n";
+                    exitCode = 1;
+                }
+            }
+        }
+
+        fs::remove_all(tempDir, ec);
+    }
+    wxUninitialize();
+
+    return exitCode;
+}
@@ -37,6 +37,8 @@ namespace Default
     constexpr float UNSHMASK_AMOUNT = 1.0f;
     constexpr float UNSHMASK_THRESHOLD = 0.01f;
     constexpr float UNSHMASK_WIDTH = 0.1f;
+    /// Gaussian sigma used for smoothing of chrominance (see `ProcessingSettings::color`).
+    constexpr float CHROMA_DENOISE_SIGMA = 1.5f;
 }
 
 /// Default-constructed value does not have any effect on image.
@@ -91,6 +93,15 @@ struct ProcessingSettings
 
     c_ToneCurve toneCurve;
 
+    /// Applies only to RGB images.
+    struct
+    {
+        /// If true, sharpening and unsharp masking are applied only to luminance; the chrominance is preserved
+        /// (see `c_Image::SplitLumaChroma`). The tone curve is applied to R, G, B after recombining.
+        bool luminanceOnly{false};
+        bool chromaDenoise{false}; ///< If true (and `luminanceOnly` is true), the chrominance is lightly smoothed.
+    } color;
+
     bool operator==(const ProcessingSettings& other) const
     {
         return normalization.enabled == other.normalization.enabled
@@ -100,7 +111,9 @@ struct ProcessingSettings
             && LucyRichardson.iterations == other.LucyRichardson.iterations
             && LucyRichardson.deringing.enabled == other.LucyRichardson.deringing.enabled
             && unsharpMask == other.unsharpMask
-            && toneCurve == other.toneCurve;
+            && toneCurve == other.toneCurve
+            && color.luminanceOnly == other.color.luminanceOnly
+            && color.chromaDenoise == other.color.chromaDenoise;
     }
 
     bool AdaptiveUnshMaskEnabled() const
@@ -137,6 +150,9 @@ std::optional<ProcessingSettings> LoadSettings(const std::string& filePath);
 ///  such that its derivatives are zero at (threshold - width) and (threshold + width)
 ///  and there is an inflection point at the threshold.
 ///
+///  If width <= 0, amount is a step at the threshold (amountMax at and above it); the returned
+///  curve is then the constant amountMax.
+///
 std::array<float, 4> GetAdaptiveUnshMaskTransitionCurve(const UnsharpMask& um);
 
 #endif // IMPGG_PROCESSING_SETTINGS_HEADER
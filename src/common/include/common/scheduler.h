@@ -0,0 +1,104 @@
+/*
+ImPPG (Image Post-Processor) - common operations for astronomical stacks and other images
+Copyright (C) 2016-2022 Filip Szczerek <ga.software@yahoo.com>
+
+This file is part of ImPPG.
+
+ImPPG is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ImPPG is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with ImPPG.  If not, see <http://www.gnu.org/licenses/>.
+
+File description:
+    Task scheduler header.
+*/
+
+#ifndef IMPPG_TASK_SCHEDULER_H
+#define IMPPG_TASK_SCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "math_utils/cancellation.h"
+
+/// Persistent pool of threads executing tasks; idle threads steal tasks queued for other threads.
+///
+/// When a task starts, its OpenMP thread budget is set to (number of pool threads) / (number of running tasks),
+/// so that several concurrently running tasks which use OpenMP internally do not oversubscribe the CPUs as badly.
+/// The budget is not adjusted afterwards: a task keeps it when other tasks start or finish, so short periods
+/// of oversubscription (or of idle CPUs) are possible.
+///
+class c_TaskScheduler
+{
+public:
+    /// Returns the application-wide scheduler with one thread per logical CPU.
+    static c_TaskScheduler& Get();
+
+    explicit c_TaskScheduler(unsigned numThreads);
+
+    c_TaskScheduler(const c_TaskScheduler&) = delete;
+    c_TaskScheduler& operator=(const c_TaskScheduler&) = delete;
+
+    /// Calls `Shutdown`.
+    ~c_TaskScheduler();
+
+    /// Executes the remaining queued tasks and stops the threads; subsequent calls have no effect.
+    /** Must not be called from a pool thread. Tasks submitted afterwards are executed synchronously by `Submit`.
+        The application-wide scheduler should be shut down explicitly before exiting, so that the threads
+        are not joined during destruction of static objects. */
+    void Shutdown();
+
+    /// Queues a task for execution.
+    /** A task submitted from a pool thread is queued for the same thread (and executed before older tasks),
+        other tasks are distributed among the threads in turn. */
+    std::future<void> Submit(std::function<void()> task);
+
+    /// Calls `func(i)` for `i` from `begin` to `end` - 1 in parallel and waits for completion.
+    /** The calling thread participates, so it may be a pool thread; once there are no iterations left to start,
+        a pool thread executes other queued tasks until all iterations are finished.
+        Rethrows the first exception thrown by `func`. */
+    void ParallelFor(int begin, int end, const std::function<void(int)>& func);
+
+    unsigned GetNumThreads() const { return static_cast<unsigned>(m_Threads.size()); }
+
+private:
+    struct TaskQueue
+    {
+        std::mutex mutex;
+        std::deque<std::packaged_task<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<TaskQueue>> m_Queues; ///< One per thread.
+    std::vector<std::thread> m_Threads;
+
+    std::mutex m_WakeMutex;
+    std::condition_variable m_WakeCondition;
+    bool m_Stop{false}; ///< Guarded by `m_WakeMutex`.
+
+    std::atomic<int> m_NumQueued{0};
+    std::atomic<int> m_NumRunning{0};
+    std::atomic<unsigned> m_NextQueue{0};
+
+    void ThreadLoop(unsigned queueIdx);
+
+    /// Executes a task from the specified queue or (if there is none) one stolen from another queue.
+    /** Returns false if all queues are empty. */
+    bool RunQueuedTask(unsigned queueIdx);
+};
+
+#endif // IMPPG_TASK_SCHEDULER_H
@@ -63,6 +63,10 @@ namespace XmlName
     const char* normEnabled = "enabled";
     const char* normMin = "min";
     const char* normMax = "max";
+
+    const char* color = "color";
+    const char* colorLuminanceOnly = "luminance_only";
+    const char* colorChromaDenoise = "chroma_denoise";
 }
 
 const char* trueStr = "true";
@@ -130,6 +134,14 @@ wxXmlNode* CreateNormalizationSettingsNode(bool normalizationEnabled, float norm
     return result;
 }
 
+wxXmlNode* CreateColorSettingsNode(bool luminanceOnly, bool chromaDenoise)
+{
+    wxXmlNode* result = new wxXmlNode(wxXML_ELEMENT_NODE, XmlName::color);
+    result->AddAttribute(XmlName::colorLuminanceOnly, luminanceOnly ? trueStr : falseStr);
+    result->AddAttribute(XmlName::colorChromaDenoise, chromaDenoise ? trueStr : falseStr);
+    return result;
+}
+
 bool ParseLucyRichardsonSettings(const wxXmlNode* node, float& sigma, int& iterations, bool& deringing)
 {
     if (!NumFormatter::Parse(node->GetAttribute(XmlName::lrSigma), sigma))
@@ -226,6 +238,22 @@ bool ParseNormalizationSetings(const wxXmlNode* node, bool& normalizationEnabled
     return true;
 }
 
+bool ParseColorSettings(const wxXmlNode* node, bool& luminanceOnly, bool& chromaDenoise)
+{
+    for (auto [name, value]: { std::make_pair(XmlName::colorLuminanceOnly, &luminanceOnly),
+                               std::make_pair(XmlName::colorChromaDenoise, &chromaDenoise) })
+    {
+        if (node->GetAttribute(name) == trueStr)
+            *value = true;
+        else if (node->GetAttribute(name) == falseStr)
+            *value = false;
+        else
+            return false;
+    }
+
+    return true;
+}
+
 bool ParseToneCurveSettings(const wxXmlNode* node, c_ToneCurve& tcurve)
 {
     wxString boolStr = node->GetAttribute(XmlName::tcSmooth);
@@ -302,6 +330,12 @@ std::optional<ProcessingSettings> LoadSettings(const std::string& filePath)
 
 std::array<float, 4> GetAdaptiveUnshMaskTransitionCurve(const UnsharpMask& um)
 {
+    if (um.width <= 0.0f)
+    {
+        // a step at the threshold; the curve is only evaluated at the threshold itself
+        return {0.0f, 0.0f, 0.0f, um.amountMax};
+    }
+
     const float divisor = 4 * um.width * um.width * um.width;
     const float a = (um.amountMin - um.amountMax) / divisor;
     const float b = 3 * (um.amountMax - um.amountMin) * um.threshold / divisor;
@@ -333,6 +367,8 @@ void SerializeSettings(const ProcessingSettings& settings, wxOutputStream& strea
         settings.normalization.max
     ));
 
+    root->AddChild(CreateColorSettingsNode(settings.color.luminanceOnly, settings.color.chromaDenoise));
+
     wxXmlDocument xdoc;
     xdoc.SetVersion("1.0");
     xdoc.SetFileEncoding("UTF-8");
@@ -404,6 +440,13 @@ std::optional<ProcessingSettings> DeserializeSettings(wxInputStream& stream)
             settings.normalization.min = nmin;
             settings.normalization.max = nmax;
         }
+        else if (child->GetName() == XmlName::color)
+        {
+            bool luminanceOnly, chromaDenoise;
+            if (!ParseColorSettings(child, luminanceOnly, chromaDenoise)) { return std::nullopt; }
+            settings.color.luminanceOnly = luminanceOnly;
+            settings.color.chromaDenoise = chromaDenoise;
+        }
 
         child = child->GetNext();
     }
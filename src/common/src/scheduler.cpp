@@ -0,0 +1,260 @@
+/*
+ImPPG (Image Post-Processor) - common operations for astronomical stacks and other images
+Copyright (C) 2016-2022 Filip Szczerek <ga.software@yahoo.com>
+
+This file is part of ImPPG.
+
+ImPPG is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ImPPG is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with ImPPG.  If not, see <http://www.gnu.org/licenses/>.
+
+File description:
+    Task scheduler implementation.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#include "common/scheduler.h"
+
+// private definitions
+namespace
+{
+
+/// Scheduler owning the current thread (if it is a pool thread).
+thread_local const c_TaskScheduler* currentScheduler = nullptr;
+
+/// Index of the current pool thread's queue.
+thread_local unsigned currentQueueIdx = 0;
+
+/// How long a pool thread waiting in `ParallelFor` sleeps before checking for new queued tasks.
+constexpr std::chrono::milliseconds IDLE_WAIT_INTERVAL{1};
+
+}
+
+c_TaskScheduler& c_TaskScheduler::Get()
+{
+    static c_TaskScheduler scheduler{std::max(1u, std::thread::hardware_concurrency())};
+    return scheduler;
+}
+
+c_TaskScheduler::c_TaskScheduler(unsigned numThreads)
+{
+    for (unsigned i = 0; i < numThreads; ++i)
+    {
+        m_Queues.push_back(std::make_unique<TaskQueue>());
+    }
+    for (unsigned i = 0; i < numThreads; ++i)
+    {
+        m_Threads.emplace_back([this, i] { ThreadLoop(i); });
+    }
+}
+
+c_TaskScheduler::~c_TaskScheduler()
+{
+    Shutdown();
+}
+
+void c_TaskScheduler::Shutdown()
+{
+    {
+        std::lock_guard lock(m_WakeMutex);
+        if (m_Stop) { return; }
+        m_Stop = true;
+    }
+    m_WakeCondition.notify_all();
+
+    for (auto& thread: m_Threads)
+    {
+        thread.join();
+    }
+}
+
+std::future<void> c_TaskScheduler::Submit(std::function<void()> task)
+{
+    std::packaged_task<void()> packagedTask{std::move(task)};
+    auto result = packagedTask.get_future();
+
+    bool stopped = false;
+    {
+        std::lock_guard lock(m_WakeMutex);
+        if (m_Stop)
+        {
+            stopped = true;
+        }
+        else
+        {
+            // counted before being queued, so that the threads do not exit before executing it
+            ++m_NumQueued;
+        }
+    }
+    if (stopped)
+    {
+        packagedTask();
+        return result;
+    }
+
+    const unsigned queueIdx = (currentScheduler == this)
+        ? currentQueueIdx
+        : m_NextQueue.fetch_add(1, std::memory_order_relaxed) % m_Queues.size();
+    {
+        std::lock_guard lock(m_Queues[queueIdx]->mutex);
+        m_Queues[queueIdx]->tasks.push_back(std::move(packagedTask));
+    }
+    m_WakeCondition.notify_one();
+
+    return result;
+}
+
+bool c_TaskScheduler::RunQueuedTask(unsigned queueIdx)
+{
+    std::packaged_task<void()> task;
+
+    // own queue is used as a stack (the most recent task has the warmest cache), other queues are stolen from the front
+    {
+        std::lock_guard lock(m_Queues[queueIdx]->mutex);
+        auto& tasks = m_Queues[queueIdx]->tasks;
+        if (!tasks.empty())
+        {
+            task = std::move(tasks.back());
+            tasks.pop_back();
+        }
+    }
+    for (std::size_t i = 1; !task.valid() && i < m_Queues.size(); ++i)
+    {
+        auto& victim = *m_Queues[(queueIdx + i) % m_Queues.size()];
+        std::lock_guard lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+        }
+    }
+    if (!task.valid()) { return false; }
+
+    --m_NumQueued;
+    const int numRunning = ++m_NumRunning;
+#if defined(_OPENMP)
+    // affects only the parallel regions started by this thread; restored afterwards, as the thread
+    // may be waiting in `ParallelFor` on behalf of another task
+    const int prevNumOmpThreads = omp_get_max_threads();
+    omp_set_num_threads(std::max(1, static_cast<int>(m_Threads.size()) / numRunning));
+#else
+    static_cast<void>(numRunning);
+#endif
+
+    task(); // exceptions are stored in the task's future
+
+#if defined(_OPENMP)
+    omp_set_num_threads(prevNumOmpThreads);
+#endif
+    --m_NumRunning;
+    return true;
+}
+
+void c_TaskScheduler::ThreadLoop(unsigned queueIdx)
+{
+    currentScheduler = this;
+    currentQueueIdx = queueIdx;
+
+    while (true)
+    {
+        if (RunQueuedTask(queueIdx)) { continue; }
+
+        std::unique_lock lock(m_WakeMutex);
+        m_WakeCondition.wait(lock, [this] { return m_Stop || m_NumQueued > 0; });
+        if (m_Stop && m_NumQueued == 0) { break; }
+    }
+}
+
+void c_TaskScheduler::ParallelFor(int begin, int end, const std::function<void(int)>& func)
+{
+    if (begin >= end) { return; }
+
+    // Helper tasks may start after all iterations are done (and after this function returns),
+    // so the state is shared and `func` is only accessed by those which obtain an iteration.
+    struct State
+    {
+        const std::function<void(int)>* func;
+        int end;
+        std::atomic<int> next;
+        std::atomic<int> numRemaining;
+        std::mutex mutex;
+        std::condition_variable finished;
+        std::exception_ptr exception;
+    };
+    auto state = std::make_shared<State>();
+    state->func = &func;
+    state->end = end;
+    state->next = begin;
+    state->numRemaining = end - begin;
+
+    const auto runIterations = [](State& s) {
+        for (int i = s.next++; i < s.end; i = s.next++)
+        {
+            try
+            {
+                (*s.func)(i);
+            }
+            catch (...)
+            {
+                std::lock_guard lock(s.mutex);
+                if (!s.exception) { s.exception = std::current_exception(); }
+            }
+
+            if (--s.numRemaining == 0)
+            {
+                std::lock_guard lock(s.mutex);
+                s.finished.notify_all();
+            }
+        }
+    };
+
+    const int numHelpers = std::min(end - begin, static_cast<int>(m_Threads.size())) - 1;
+    for (int i = 0; i < numHelpers; ++i)
+    {
+        Submit([state, runIterations] { runIterations(*state); });
+    }
+
+#if defined(_OPENMP)
+    // the calling thread may not be a pool thread, so its OpenMP thread budget is set here
+    const int prevNumOmpThreads = omp_get_max_threads();
+    omp_set_num_threads(std::max(1, prevNumOmpThreads / (numHelpers + 1)));
+#endif
+
+    runIterations(*state);
+
+#if defined(_OPENMP)
+    omp_set_num_threads(prevNumOmpThreads);
+#endif
+
+    if (currentScheduler == this)
+    {
+        // instead of blocking a pool thread, keep it busy until the other threads finish their iterations
+        while (state->numRemaining > 0)
+        {
+            if (!RunQueuedTask(currentQueueIdx))
+            {
+                std::unique_lock lock(state->mutex);
+                state->finished.wait_for(lock, IDLE_WAIT_INTERVAL, [&] { return state->numRemaining == 0; });
+            }
+        }
+    }
+
+    std::unique_lock lock(state->mutex);
+    state->finished.wait(lock, [&] { return state->numRemaining == 0; });
+    if (state->exception) { std::rethrow_exception(state->exception); }
+}
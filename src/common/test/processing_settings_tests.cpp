@@ -1,6 +1,7 @@
 #include "common/proc_settings.h"
 
 #include <boost/test/unit_test.hpp>
+#include <cmath>
 #include <wx/sstream.h>
 
 BOOST_AUTO_TEST_CASE(SaveAndLoadSettings)
@@ -14,6 +15,9 @@ BOOST_AUTO_TEST_CASE(SaveAndLoadSettings)
     s.normalization.min = 0.25;
     s.normalization.max = 0.75;
 
+    s.color.luminanceOnly = true;
+    s.color.chromaDenoise = true;
+
     auto& um = s.unsharpMask.at(0);
     um.adaptive = true;
     um.amountMax = 1.5;
@@ -67,3 +71,25 @@ R"(<?xml version="1.0" encoding="UTF-8"?>
     BOOST_REQUIRE(parsed.has_value());
     BOOST_REQUIRE(*parsed == expected);
 }
+
+BOOST_AUTO_TEST_CASE(AdaptiveUnshMaskTransitionCurveReachesAmountsAtIntervalEnds)
+{
+    const UnsharpMask um{true, 1.5, 0.5, 2.0, 0.5, 0.25};
+    const auto [a, b, c, d] = GetAdaptiveUnshMaskTransitionCurve(um);
+    const auto amount = [&](float l) { return l * (l * (a * l + b) + c) + d; };
+
+    BOOST_CHECK_CLOSE(0.5f, amount(0.25f), 1.0e-3);
+    BOOST_CHECK_CLOSE(2.0f, amount(0.75f), 1.0e-3);
+    BOOST_CHECK_CLOSE(1.25f, amount(0.5f), 1.0e-3);
+}
+
+BOOST_AUTO_TEST_CASE(AdaptiveUnshMaskTransitionCurveWithZeroWidthIsFinite)
+{
+    const UnsharpMask um{true, 1.5, 0.5, 2.0, 0.5, 0.0};
+    for (const float coeff: GetAdaptiveUnshMaskTransitionCurve(um))
+    {
+        BOOST_CHECK(std::isfinite(coeff));
+    }
+    // the curve is evaluated only at the threshold, where the step reaches the max amount
+    BOOST_CHECK_EQUAL(2.0f, GetAdaptiveUnshMaskTransitionCurve(um)[3]);
+}
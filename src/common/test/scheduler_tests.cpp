@@ -0,0 +1,82 @@
+#include "common/scheduler.h"
+
+#include <atomic>
+#include <boost/test/unit_test.hpp>
+#include <future>
+#include <stdexcept>
+#include <vector>
+
+BOOST_AUTO_TEST_CASE(SubmittedTasksAreExecuted)
+{
+    c_TaskScheduler scheduler{4};
+    std::atomic<int> sum{0};
+    std::vector<std::future<void>> results;
+    for (int i = 1; i <= 100; ++i)
+    {
+        results.push_back(scheduler.Submit([&sum, i] { sum += i; }));
+    }
+    for (auto& result: results) { result.get(); }
+
+    BOOST_CHECK_EQUAL(5050, sum.load());
+}
+
+BOOST_AUTO_TEST_CASE(ParallelForVisitsEachIndexOnce)
+{
+    c_TaskScheduler scheduler{4};
+    std::vector<std::atomic<int>> visits(1000);
+    scheduler.ParallelFor(0, 1000, [&](int i) { ++visits[i]; });
+
+    for (const auto& v: visits) { BOOST_CHECK_EQUAL(1, v.load()); }
+}
+
+BOOST_AUTO_TEST_CASE(NestedParallelForDoesNotDeadlock)
+{
+    c_TaskScheduler scheduler{2};
+    std::atomic<int> count{0};
+    std::vector<std::future<void>> results;
+    for (int task = 0; task < 4; ++task)
+    {
+        results.push_back(scheduler.Submit([&] {
+            scheduler.ParallelFor(0, 100, [&](int) { ++count; });
+        }));
+    }
+    for (auto& result: results) { result.get(); }
+
+    BOOST_CHECK_EQUAL(400, count.load());
+}
+
+BOOST_AUTO_TEST_CASE(ExceptionsArePropagated)
+{
+    c_TaskScheduler scheduler{2};
+    BOOST_CHECK_THROW(scheduler.Submit([] { throw std::runtime_error("error"); }).get(), std::runtime_error);
+    BOOST_CHECK_THROW(
+        scheduler.ParallelFor(0, 10, [](int i) { if (i == 5) { throw std::runtime_error("error"); } }),
+        std::runtime_error
+    );
+}
+
+BOOST_AUTO_TEST_CASE(ShutdownExecutesQueuedTasks)
+{
+    c_TaskScheduler scheduler{2};
+    std::atomic<int> count{0};
+    for (int i = 0; i < 100; ++i)
+    {
+        scheduler.Submit([&] { ++count; });
+    }
+    scheduler.Shutdown();
+    BOOST_CHECK_EQUAL(100, count.load());
+
+    // executed synchronously after shutdown
+    scheduler.Submit([&] { ++count; }).get();
+    BOOST_CHECK_EQUAL(101, count.load());
+    scheduler.Shutdown();
+}
+
+BOOST_AUTO_TEST_CASE(CancellationIsSharedByCopies)
+{
+    c_CancellationToken token;
+    const c_CancellationToken copy = token;
+    BOOST_CHECK(!copy.IsCancellationRequested());
+    token.Cancel();
+    BOOST_CHECK(copy.IsCancellationRequested());
+}
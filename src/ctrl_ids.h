@@ -48,6 +48,8 @@ enum
     ID_LucyRichardsonReset,
     ID_LucyRichardsonDeringing,
     ID_LucyRichardsonOff,
+    ID_LuminanceOnly,
+    ID_ChromaDenoise,
 
     ID_ToneCurveEditor,
 
@@ -92,6 +94,7 @@ enum
     ID_SelectAndProcessAll,
     ID_FitInWindow,
     ID_AlignImages,
+    ID_StageTimings,
 
 //----------------------------------------------------------------------
 // Normalization dialog
@@ -30,6 +30,7 @@ File description:
 #include <optional>
 #include <string>
 #include <tuple>
+#include <vector>
 #include <type_traits>
 #include <wx/gdicmn.h>
 
@@ -101,6 +102,13 @@ constexpr bool IsMono(PixelFormat pixFmt)
     return 1 == NumChannels[static_cast<std::size_t>(pixFmt)];
 }
 
+/// Interpolation used for sub-pixel translation (see `c_Image::ResizeAndTranslate`).
+enum class ShiftInterpolation
+{
+    CUBIC,   ///< Cubic Hermite (Catmull-Rom), 4 taps
+    LANCZOS3 ///< Lanczos, 6 taps; sharper, but may produce slight ringing around high-contrast edges
+};
+
 class IImageBuffer
 {
 public:
@@ -205,7 +213,8 @@ public:
     ) const;
 
     /// Resizes and translates image (or its fragment) by cropping and/or padding (with zeros) to the destination size and offset (there is no scaling).
-    /** Subpixel translation (i.e. if `xOfs` or `yOfs` have a fractional part) of palettised images is not supported. */
+    /** Subpixel translation (i.e. if `xOfs` or `yOfs` have a fractional part) of palettised images is not supported.
+        For subpixel translation, a separable kernel is used, with weights determined once for the whole image. */
     static void ResizeAndTranslate(
         const IImageBuffer& srcImg,
         IImageBuffer& destImg,
@@ -215,12 +224,29 @@ public:
         int srcYmax,     ///< Y max of input data in source image
         float xOfs,      ///< X offset of input data in output image
         float yOfs,      ///< Y offset of input data in output image
-        bool clearToZero ///< If 'true', 'destImg' areas not copied on will be cleared to zero
+        bool clearToZero, ///< If 'true', 'destImg' areas not copied on will be cleared to zero
+        ShiftInterpolation interpolation = ShiftInterpolation::CUBIC
         );
 
-    /// Multiply by another image; both images have to be PIX_MONO32F and have the same dimensions
+    // In-place pixel arithmetic. The image has to be PIX_MONO32F or PIX_RGB32F; the other image (if any)
+    // has to have the same pixel format and dimensions.
+
+    void Add(const c_Image& other);
+
+    void Subtract(const c_Image& other);
+
     void Multiply(const c_Image& mult);
 
+    /// Pixels where `divisor` is zero are set to zero.
+    void Divide(const c_Image& divisor);
+
+    void Scale(float factor);
+
+    void Clamp(float minValue, float maxValue);
+
+    /// Returns per-pixel median of images (PIX_MONO32F or PIX_RGB32F, with the same pixel format and dimensions).
+    static c_Image Median(const std::vector<const c_Image*>& images);
+
     bool SaveToFile(
         const std::string& fname, ///< Full destination path
         OutputBitDepth outpBitDepth,
@@ -237,6 +263,13 @@ public:
 
     static c_Image CombineRGB(const c_Image& red, const c_Image& green, const c_Image& blue);
 
+    /// Splits PIX_RGB32F image into PIX_MONO32F images: luminance (mean of R, G, B; as in `ConvertPixelFormat`)
+    /// and chrominance (blue minus luminance, red minus luminance).
+    std::tuple<c_Image, c_Image, c_Image> SplitLumaChroma() const;
+
+    /// Reverses `SplitLumaChroma`; the result is clamped to [0; 1].
+    static c_Image CombineLumaChroma(const c_Image& luma, const c_Image& chromaBlue, const c_Image& chromaRed);
+
     //TESTING ####
     static c_Image Blend(const c_Image& img1, double weight1, const c_Image& img2, double weight2);
 };
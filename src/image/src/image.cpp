@@ -34,6 +34,7 @@ File description:
 #include "../../imppg_assert.h"
 
 #include "image/image.h"
+#include "logging/instrumentation.h"
 #if (USE_FREEIMAGE)
   #include "FreeImage.h"
   #ifdef __APPLE__
@@ -46,6 +47,11 @@ File description:
 
 #if USE_CFITSIO
 #include <fitsio.h>
+#include <mutex>
+
+/// Serializes all calls to cfitsio, which is thread-safe only if built with the reentrant option
+/// (e.g. aligned images are loaded and saved concurrently).
+static std::mutex fitsMutex;
 #endif
 
 /// Conditionally swaps a 32-bit value
@@ -109,6 +115,7 @@ static bool SaveAsFits(const IImageBuffer& buf, const std::string& fname)
     row_filler(buf.GetBytesPerPixel());
 
     int status = 0;
+    std::lock_guard lock{fitsMutex};
     fits_create_file(&fptr, (std::string("!") + fname).c_str(), &status); // a leading "!" overwrites an existing file
 
     int bitPix, datatype;
@@ -402,6 +409,7 @@ public:
       m_BytesPerPixel(BytesPerPixel[static_cast<size_t>(pixFmt)])
     {
         m_Pixels.reset(new uint8_t[m_Width * m_Height * m_BytesPerPixel]);
+        Log::CountAllocation(m_Width * m_Height * m_BytesPerPixel);
     }
 
     c_SimpleBuffer(const IImageBuffer& src)
@@ -411,6 +419,7 @@ public:
       m_BytesPerPixel(src.GetBytesPerPixel())
     {
         m_Pixels.reset(new uint8_t[m_Width * m_Height * m_BytesPerPixel]);
+        Log::CountAllocation(m_Width * m_Height * m_BytesPerPixel);
         for (unsigned row = 0; row < m_Height; ++row)
             memcpy(m_Pixels.get() + row * GetBytesPerRow(), src.GetRow(row), GetBytesPerRow());
 
@@ -998,6 +1007,134 @@ inline float InterpolateCubic(float t, T fm1, T f0, T f1, T f2)
     return t*(t*(a3*t + a2)+a1)+a0;
 }
 
+/// Lanczos kernel with a = 3.
+inline float Lanczos3(float x)
+{
+    constexpr float PI = 3.14159265f;
+
+    if (x == 0.0f)
+        return 1.0f;
+    else if (std::fabs(x) >= 3.0f)
+        return 0.0f;
+    else
+        return 3.0f * std::sin(PI * x) * std::sin(PI * x / 3.0f) / (PI * PI * x * x);
+}
+
+/// Weights of a 1D interpolation kernel used for a sub-pixel translation; as the translation is the same
+/// for all pixels, so are the weights.
+struct ShiftKernel
+{
+    int firstTap; ///< Offset (relative to the corresponding source pixel) of the source value multiplied by `weights[0]`.
+    std::array<float, 6> weights;
+};
+
+/// Returns the kernel which interpolates a value at the source position `-frac` (relative to a source pixel).
+ShiftKernel GetShiftKernel(float frac, ShiftInterpolation interpolation)
+{
+    // split the source position into integer and fractional (0 <= t < 1) parts
+    const float pos = -frac;
+    const int base = static_cast<int>(std::floor(pos));
+    const float t = pos - base;
+
+    ShiftKernel kernel{};
+    switch (interpolation)
+    {
+    case ShiftInterpolation::CUBIC:
+        // the interpolated value is a linear combination of the 4 source values; get its coefficients
+        // by interpolating unit vectors
+        kernel.firstTap = base - 1;
+        kernel.weights[0] = InterpolateCubic(t, 1.0f, 0.0f, 0.0f, 0.0f);
+        kernel.weights[1] = InterpolateCubic(t, 0.0f, 1.0f, 0.0f, 0.0f);
+        kernel.weights[2] = InterpolateCubic(t, 0.0f, 0.0f, 1.0f, 0.0f);
+        kernel.weights[3] = InterpolateCubic(t, 0.0f, 0.0f, 0.0f, 1.0f);
+        break;
+
+    case ShiftInterpolation::LANCZOS3: {
+        kernel.firstTap = base - 2;
+        float sum = 0.0f;
+        for (int i = 0; i < 6; i++)
+        {
+            kernel.weights[i] = Lanczos3(t - (i - 2));
+            sum += kernel.weights[i];
+        }
+        // normalize, so that flat areas keep their brightness
+        for (float& w: kernel.weights) { w /= sum; }
+        } break;
+
+    default: IMPPG_ABORT();
+    }
+
+    return kernel;
+}
+
+/// Fills the destination area with values interpolated (with separable kernels) from the source image.
+///
+/// Source pixel corresponding to the destination pixel (x, y) is (x + srcDX, y + srcDY). The area is processed
+/// in blocks of rows; for each block, the source rows are interpolated horizontally first, then the results
+/// are interpolated vertically. The inner loops run over contiguous values of a row (all channels),
+/// which lets the compiler vectorize them.
+///
+template<typename Lum_t, std::size_t NumTaps>
+void ApplyShiftKernels(
+    const IImageBuffer& srcImg,
+    IImageBuffer& destImg,
+    int destXstart, int destYstart, int destXend, int destYend, ///< Destination area (inclusive)
+    int srcDX, int srcDY,
+    const ShiftKernel& kernelX,
+    const ShiftKernel& kernelY,
+    float maxLum
+)
+{
+    constexpr int BLOCK_HEIGHT = 64;
+
+    const int numChannels = static_cast<int>(NumChannels[static_cast<size_t>(srcImg.GetPixelFormat())]);
+    const int valuesPerRow = (destXend - destXstart + 1) * numChannels;
+    const int numRows = destYend - destYstart + 1;
+    const int numBlocks = (numRows + BLOCK_HEIGHT - 1) / BLOCK_HEIGHT;
+
+    std::array<float, NumTaps> weightsX, weightsY;
+    std::copy_n(kernelX.weights.begin(), NumTaps, weightsX.begin());
+    std::copy_n(kernelY.weights.begin(), NumTaps, weightsY.begin());
+
+    #pragma omp parallel for
+    for (int block = 0; block < numBlocks; block++)
+    {
+        const int y0 = destYstart + block * BLOCK_HEIGHT;
+        const int y1 = std::min(y0 + BLOCK_HEIGHT - 1, destYend);
+        const int srcRowStart = y0 + srcDY + kernelY.firstTap;
+        const int numSrcRows = y1 - y0 + static_cast<int>(NumTaps);
+
+        // horizontally interpolated source rows
+        std::vector<float> rowValues(static_cast<std::size_t>(numSrcRows) * valuesPerRow);
+
+        for (int r = 0; r < numSrcRows; r++)
+        {
+            const Lum_t* src = srcImg.GetRowAs<Lum_t>(srcRowStart + r) + (destXstart + srcDX + kernelX.firstTap) * numChannels;
+            float* dest = rowValues.data() + r * valuesPerRow;
+            for (int i = 0; i < valuesPerRow; i++)
+            {
+                float sum = 0.0f;
+                for (std::size_t k = 0; k < NumTaps; k++)
+                    sum += weightsX[k] * src[i + static_cast<int>(k) * numChannels];
+                dest[i] = sum;
+            }
+        }
+
+        for (int y = y0; y <= y1; y++)
+        {
+            const float* src = rowValues.data() + (y - y0) * valuesPerRow;
+            Lum_t* dest = destImg.GetRowAs<Lum_t>(y) + destXstart * numChannels;
+            for (int i = 0; i < valuesPerRow; i++)
+            {
+                float sum = 0.0f;
+                for (std::size_t k = 0; k < NumTaps; k++)
+                    sum += weightsY[k] * src[i + static_cast<int>(k) * valuesPerRow];
+                dest[i] = static_cast<Lum_t>(ClampLuminance(sum, maxLum));
+            }
+        }
+    }
+}
+
 template<typename Lum_t>
 void ResizeAndTranslateImpl(
     const IImageBuffer& srcImg,
@@ -1008,7 +1145,8 @@ void ResizeAndTranslateImpl(
     int srcYmax,     ///< Y max of input data in source image
     float xOfs,      ///< X offset of input data in output image
     float yOfs,      ///< Y offset of input data in output image
-    bool clearToZero ///< If 'true', 'destImg' areas not copied on will be cleared to zero
+    bool clearToZero, ///< If 'true', 'destImg' areas not copied on will be cleared to zero
+    ShiftInterpolation interpolation
 )
 {
     int xOfsInt, yOfsInt;
@@ -1067,10 +1205,13 @@ void ResizeAndTranslateImpl(
         // Subpixel translation
         IMPPG_ASSERT(srcImg.GetPixelFormat() != PixelFormat::PIX_PAL8);
 
-        // First, copy the 2-border pixels of the target area without change.
+        // Interpolation needs `border` source pixels on each side; copy the border pixels of the target area without change.
+        const int border = (interpolation == ShiftInterpolation::LANCZOS3) ? 3 : 2;
+        const int borderRows = std::min(border, destYend - destYstart + 1);
+        const int borderCols = std::min(border, destXend - destXstart + 1);
 
-        // 2 top and 2 bottom rows
-        for (int i = 0; i < 2; i++)
+        // top and bottom rows
+        for (int i = 0; i < borderRows; i++)
         {
             memcpy(destImg.GetRowAs<uint8_t>(destYstart + i) + destXstart*bytesPP,
                    srcImg.GetRowAs<uint8_t>(destYstart + i - yOfsInt + srcYmin) + (destXstart - xOfsInt + srcXmin) * bytesPP,
@@ -1081,21 +1222,22 @@ void ResizeAndTranslateImpl(
                 (destXend - destXstart + 1) * bytesPP);
         }
 
-        // 2 leftmost and 2 rightmost columns
+        // leftmost and rightmost columns
         for (int y = destYstart; y <= destYend; y++)
         {
-            // 2 leftmost columns
             memcpy(destImg.GetRowAs<uint8_t>(y) + destXstart*bytesPP,
                    srcImg.GetRowAs<uint8_t>(y - yOfsInt + srcYmin) + (destXstart - xOfsInt + srcXmin)*bytesPP,
-                   2 * bytesPP); // copy 2 pixels
+                   borderCols * bytesPP);
 
-            // 2 rightmost columns
-            memcpy(destImg.GetRowAs<uint8_t>(y) + (destXend-1)*bytesPP,
-                   srcImg.GetRowAs<uint8_t>(y - yOfsInt + srcYmin) + (destXend - 1 - xOfsInt + srcXmin)*bytesPP,
-                   2 * bytesPP); // copy 2 pixels
+            memcpy(destImg.GetRowAs<uint8_t>(y) + (destXend - borderCols + 1)*bytesPP,
+                   srcImg.GetRowAs<uint8_t>(y - yOfsInt + srcYmin) + (destXend - borderCols + 1 - xOfsInt + srcXmin)*bytesPP,
+                   borderCols * bytesPP);
         }
 
-        // Second, perform cubic interpolation inside the target area.
+        if (destYend - destYstart < 2 * border || destXend - destXstart < 2 * border)
+            return;
+
+        // Second, interpolate inside the target area.
 
         float maxLum = 0.0f;
         switch (srcImg.GetPixelFormat())
@@ -1118,44 +1260,25 @@ void ResizeAndTranslateImpl(
         default: IMPPG_ABORT();
         }
 
-        int idx = xOfsFrac < 0.0f ? 1 : -1;
-        int idy = yOfsFrac < 0.0f ? 1 : -1;
-
-        xOfsFrac = std::fabs(xOfsFrac);
-        yOfsFrac = std::fabs(yOfsFrac);
+        const ShiftKernel kernelX = GetShiftKernel(xOfsFrac, interpolation);
+        const ShiftKernel kernelY = GetShiftKernel(yOfsFrac, interpolation);
 
-        int numChannels = NumChannels[static_cast<size_t>(srcImg.GetPixelFormat())];
+        const int srcDX = srcXmin - xOfsInt;
+        const int srcDY = srcYmin - yOfsInt;
 
-        // Skip 2-pixels borders on each side of the image
-        #pragma omp parallel for
-        for (int row = destYstart+2; row <= destYend-2; row++)
+        if (interpolation == ShiftInterpolation::LANCZOS3)
         {
-            for (int col = destXstart+2; col <= destXend-2; col++)
-            {
-                for (int ch = 0; ch < numChannels; ch++)
-                {
-                    float yvals[4];
-
-                    // Perform 4 interpolations at 4 adjacent rows, using X offsets -1, 0, 1, 2 (*idx)
-                    int y = row - idy;
-                    int srcY = y - yOfsInt + srcYmin;
-                    for (int relY = -1; relY <= 2; relY++)
-                    {
-                        int srcX = col - xOfsInt + srcXmin;
-                        yvals[relY+1] = InterpolateCubic(xOfsFrac,
-                            srcImg.GetRowAs<Lum_t>(srcY)[(srcX - idx)*numChannels + ch],
-                            srcImg.GetRowAs<Lum_t>(srcY)[(srcX      )*numChannels + ch],
-                            srcImg.GetRowAs<Lum_t>(srcY)[(srcX + idx)*numChannels + ch],
-                            srcImg.GetRowAs<Lum_t>(srcY)[(srcX + idx + idx)*numChannels + ch]);
-
-                        y += idy;
-                        srcY += idy;
-                    }
-
-                    // Perform the final vertical (column) interpolation of the 4 horizontal (row) values interpolated previously
-                    destImg.GetRowAs<Lum_t>(row)[col*numChannels + ch] = static_cast<Lum_t>(ClampLuminance(InterpolateCubic(yOfsFrac, yvals[0], yvals[1], yvals[2], yvals[3]), maxLum));
-                }
-            }
+            ApplyShiftKernels<Lum_t, 6>(
+                srcImg, destImg, destXstart + border, destYstart + border, destXend - border, destYend - border,
+                srcDX, srcDY, kernelX, kernelY, maxLum
+            );
+        }
+        else
+        {
+            ApplyShiftKernels<Lum_t, 4>(
+                srcImg, destImg, destXstart + border, destYstart + border, destXend - border, destYend - border,
+                srcDX, srcDY, kernelX, kernelY, maxLum
+            );
         }
     }
 }
@@ -1171,7 +1294,8 @@ void c_Image::ResizeAndTranslate(
     int srcYmax,     ///< Y max of input data in source image
     float xOfs,      ///< X offset of input data in output image
     float yOfs,      ///< Y offset of input data in output image
-    bool clearToZero ///< If 'true', 'destImg' areas not copied on will be cleared to zero
+    bool clearToZero, ///< If 'true', 'destImg' areas not copied on will be cleared to zero
+    ShiftInterpolation interpolation
     )
 {
     IMPPG_ASSERT(srcImg.GetPixelFormat() == destImg.GetPixelFormat());
@@ -1181,17 +1305,17 @@ void c_Image::ResizeAndTranslate(
     case PixelFormat::PIX_MONO8:
     case PixelFormat::PIX_RGB8:
     case PixelFormat::PIX_RGBA8:
-        ResizeAndTranslateImpl<uint8_t>(srcImg, destImg, srcXmin, srcYmin, srcXmax, srcYmax, xOfs, yOfs, clearToZero); break;
+        ResizeAndTranslateImpl<uint8_t>(srcImg, destImg, srcXmin, srcYmin, srcXmax, srcYmax, xOfs, yOfs, clearToZero, interpolation); break;
 
     case PixelFormat::PIX_MONO16:
     case PixelFormat::PIX_RGB16:
     case PixelFormat::PIX_RGBA16:
-        ResizeAndTranslateImpl<uint16_t>(srcImg, destImg, srcXmin, srcYmin, srcXmax, srcYmax, xOfs, yOfs, clearToZero); break;
+        ResizeAndTranslateImpl<uint16_t>(srcImg, destImg, srcXmin, srcYmin, srcXmax, srcYmax, xOfs, yOfs, clearToZero, interpolation); break;
 
     case PixelFormat::PIX_MONO32F:
     case PixelFormat::PIX_RGB32F:
     case PixelFormat::PIX_RGBA32F:
-        ResizeAndTranslateImpl<float>(srcImg, destImg, srcXmin, srcYmin, srcXmax, srcYmax, xOfs, yOfs, clearToZero); break;
+        ResizeAndTranslateImpl<float>(srcImg, destImg, srcXmin, srcYmin, srcXmax, srcYmax, xOfs, yOfs, clearToZero, interpolation); break;
 
     default: IMPPG_ABORT();
     }
@@ -1240,6 +1364,7 @@ void NormalizeFpImage(c_Image& img, float minLevel, float maxLevel)
 #if USE_CFITSIO
 std::optional<c_Image> LoadFitsImage(const std::string& fname, bool normalize)
 {
+    std::lock_guard lock{fitsMutex};
     fitsfile* fptr{nullptr};
     int status = 0;
     long dimensions[3] = { 0 };
@@ -1373,11 +1498,10 @@ std::optional<c_Image> LoadFitsImage(const std::string& fname, bool normalize)
 }
 #endif
 
-std::optional<c_Image> LoadImage(
+static std::optional<c_Image> LoadImageUninstrumented(
     const std::string& fname,
-    std::optional<PixelFormat> destFmt, ///< Pixel format to convert to; can be one of PIX_MONO8, PIX_MONO32F.
-    std::string* errorMsg, ///< If not null, may receive an error message (if any).
-    /// If true, floating-points values read from a FITS file are normalized, so that the highest becomes 1.0.
+    std::optional<PixelFormat> destFmt,
+    std::string* errorMsg,
     bool normalizeFITSvalues
 )
 {
@@ -1465,6 +1589,27 @@ std::optional<c_Image> LoadImage(
 #endif
 }
 
+std::optional<c_Image> LoadImage(
+    const std::string& fname,
+    std::optional<PixelFormat> destFmt, ///< Pixel format to convert to; can be one of PIX_MONO8, PIX_MONO32F.
+    std::string* errorMsg, ///< If not null, may receive an error message (if any).
+    /// If true, floating-points values read from a FITS file are normalized, so that the highest becomes 1.0.
+    bool normalizeFITSvalues
+)
+{
+    Log::c_StageTimer timer("Load image", 0.0, fname);
+    auto result = LoadImageUninstrumented(fname, destFmt, errorMsg, normalizeFITSvalues);
+    if (result.has_value())
+    {
+        timer.SetMegapixels(result->GetNumPixels() / 1.0e6);
+    }
+    else
+    {
+        timer.SetDetails(fname + " (failed)");
+    }
+    return result;
+}
+
 std::optional<c_Image> LoadImageFileAs32f(
     const std::string& fname,
     bool normalizeFITSvalues,
@@ -1502,19 +1647,132 @@ std::optional<c_Image> LoadImageFileAsMono8(
     return LoadImage(fname, PixelFormat::PIX_MONO8, errorMsg, normalizeFITSvalues);
 }
 
-/// Multiply by another image; both images have to be PIX_MONO32F and have the same dimensions
+/// Applies `op(value)` to all pixel values of a PIX_MONO32F or PIX_RGB32F image.
+template<typename Op>
+static void TransformPixelValues(c_Image& img, Op op)
+{
+    IMPPG_ASSERT(img.GetPixelFormat() == PixelFormat::PIX_MONO32F || img.GetPixelFormat() == PixelFormat::PIX_RGB32F);
+
+    const unsigned valuesPerRow = img.GetWidth() * NumChannels[static_cast<std::size_t>(img.GetPixelFormat())];
+
+    #pragma omp parallel for
+    for (int y = 0; y < static_cast<int>(img.GetHeight()); ++y)
+    {
+        float* row = img.GetRowAs<float>(y);
+        for (unsigned i = 0; i < valuesPerRow; ++i)
+        {
+            row[i] = op(row[i]);
+        }
+    }
+}
+
+/// Sets all pixel values of `dest` to `op(destValue, srcValue)`.
+template<typename Op>
+static void TransformPixelValues(c_Image& dest, const c_Image& src, Op op)
+{
+    IMPPG_ASSERT(dest.GetPixelFormat() == PixelFormat::PIX_MONO32F || dest.GetPixelFormat() == PixelFormat::PIX_RGB32F);
+    IMPPG_ASSERT(dest.GetPixelFormat() == src.GetPixelFormat());
+    IMPPG_ASSERT(dest.GetWidth() == src.GetWidth() && dest.GetHeight() == src.GetHeight());
+
+    const unsigned valuesPerRow = dest.GetWidth() * NumChannels[static_cast<std::size_t>(dest.GetPixelFormat())];
+
+    #pragma omp parallel for
+    for (int y = 0; y < static_cast<int>(dest.GetHeight()); ++y)
+    {
+        const float* srcRow = src.GetRowAs<float>(y);
+        float* destRow = dest.GetRowAs<float>(y);
+        for (unsigned i = 0; i < valuesPerRow; ++i)
+        {
+            destRow[i] = op(destRow[i], srcRow[i]);
+        }
+    }
+}
+
+void c_Image::Add(const c_Image& other)
+{
+    TransformPixelValues(*this, other, [](float a, float b) { return a + b; });
+}
+
+void c_Image::Subtract(const c_Image& other)
+{
+    TransformPixelValues(*this, other, [](float a, float b) { return a - b; });
+}
+
 void c_Image::Multiply(const c_Image& mult)
 {
-    IMPPG_ASSERT(GetPixelFormat() == PixelFormat::PIX_MONO32F && mult.GetPixelFormat() == PixelFormat::PIX_MONO32F);
-    IMPPG_ASSERT(GetWidth() == mult.GetWidth() && GetHeight() == mult.GetHeight());
+    TransformPixelValues(*this, mult, [](float a, float b) { return a * b; });
+}
+
+void c_Image::Divide(const c_Image& divisor)
+{
+    TransformPixelValues(*this, divisor, [](float a, float b) { return b != 0.0f ? a / b : 0.0f; });
+}
+
+void c_Image::Scale(float factor)
+{
+    TransformPixelValues(*this, [factor](float value) { return value * factor; });
+}
+
+void c_Image::Clamp(float minValue, float maxValue)
+{
+    IMPPG_ASSERT(minValue <= maxValue);
+    TransformPixelValues(*this, [minValue, maxValue](float value) { return std::clamp(value, minValue, maxValue); });
+}
 
-    for (unsigned row = 0; row < GetHeight(); row++)
+c_Image c_Image::Median(const std::vector<const c_Image*>& images)
+{
+    IMPPG_ASSERT(!images.empty());
+    const c_Image& first = *images.front();
+    IMPPG_ASSERT(first.GetPixelFormat() == PixelFormat::PIX_MONO32F || first.GetPixelFormat() == PixelFormat::PIX_RGB32F);
+    for (const c_Image* img: images)
     {
-        const float* src_row = mult.GetRowAs<float>(row);
-        float* dest_row = GetRowAs<float>(row);
-        for (unsigned col = 0; col < GetWidth(); col++)
-            dest_row[col] *= src_row[col];
+        IMPPG_ASSERT(img->GetPixelFormat() == first.GetPixelFormat());
+        IMPPG_ASSERT(img->GetWidth() == first.GetWidth() && img->GetHeight() == first.GetHeight());
     }
+
+    c_Image result(first.GetWidth(), first.GetHeight(), first.GetPixelFormat());
+
+    const std::size_t numImages = images.size();
+    const std::size_t middle = numImages / 2;
+    const unsigned valuesPerRow = first.GetWidth() * NumChannels[static_cast<std::size_t>(first.GetPixelFormat())];
+
+    #pragma omp parallel
+    {
+        std::vector<float> values(numImages);
+        std::vector<const float*> srcRows(numImages);
+
+        #pragma omp for
+        for (int y = 0; y < static_cast<int>(first.GetHeight()); ++y)
+        {
+            for (std::size_t n = 0; n < numImages; ++n)
+            {
+                srcRows[n] = images[n]->GetRowAs<float>(y);
+            }
+            float* destRow = result.GetRowAs<float>(y);
+
+            for (unsigned i = 0; i < valuesPerRow; ++i)
+            {
+                for (std::size_t n = 0; n < numImages; ++n)
+                {
+                    values[n] = srcRows[n][i];
+                }
+
+                std::nth_element(values.begin(), values.begin() + middle, values.end());
+                if (numImages % 2 == 1)
+                {
+                    destRow[i] = values[middle];
+                }
+                else
+                {
+                    // the lower middle value is the largest one in the first half
+                    const float lowerMiddle = *std::max_element(values.begin(), values.begin() + middle);
+                    destRow[i] = 0.5f * (lowerMiddle + values[middle]);
+                }
+            }
+        }
+    }
+
+    return result;
 }
 
 /// Returns 'true' if image's width and height were successfully read; returns 'false' on error
@@ -1524,6 +1782,7 @@ std::optional<std::tuple<unsigned, unsigned>> GetImageSize(const std::string& fn
 #if USE_CFITSIO
     if (extension == "fit" || extension == "fits")
     {
+        std::lock_guard lock{fitsMutex};
         fitsfile* fptr{nullptr};
         int status = 0;
         fits_open_file(&fptr, fname.c_str(), READONLY, &status);
@@ -1626,6 +1885,8 @@ bool c_Image::SaveToFile(const std::string& fname, OutputBitDepth outpBitDepth,
 {
     IMPPG_ASSERT(m_Buffer->GetPixelFormat() != PixelFormat::PIX_PAL8);
 
+    Log::c_StageTimer timer("Save image", GetNumPixels() / 1.0e6, fname);
+
     IImageBuffer* bufToSave = m_Buffer.get();
     std::unique_ptr<c_SimpleBuffer> converted;
 
@@ -1636,7 +1897,9 @@ bool c_Image::SaveToFile(const std::string& fname, OutputBitDepth outpBitDepth,
         bufToSave = converted.get();
     }
 
-    return bufToSave->SaveToFile(fname, outpFileType);
+    const bool result = bufToSave->SaveToFile(fname, outpFileType);
+    if (!result) { timer.SetDetails(fname + " (failed)"); }
+    return result;
 }
 
 static std::tuple<OutputBitDepth, OutputFileType> DecodeOutputFormat(OutputFormat outpFormat)
@@ -1805,6 +2068,69 @@ c_Image c_Image::CombineRGB(const c_Image& red, const c_Image& green, const c_Im
     return rgb;
 }
 
+std::tuple<c_Image, c_Image, c_Image> c_Image::SplitLumaChroma() const
+{
+    IMPPG_ASSERT(GetPixelFormat() == PixelFormat::PIX_RGB32F);
+
+    c_Image luma(GetWidth(), GetHeight(), PixelFormat::PIX_MONO32F);
+    c_Image chromaBlue(GetWidth(), GetHeight(), PixelFormat::PIX_MONO32F);
+    c_Image chromaRed(GetWidth(), GetHeight(), PixelFormat::PIX_MONO32F);
+
+    #pragma omp parallel for
+    for (int y = 0; y < static_cast<int>(GetHeight()); ++y)
+    {
+        const float* src = GetRowAs<float>(y);
+        float* destLuma = luma.GetRowAs<float>(y);
+        float* destBlue = chromaBlue.GetRowAs<float>(y);
+        float* destRed = chromaRed.GetRowAs<float>(y);
+
+        for (unsigned x = 0; x < GetWidth(); ++x)
+        {
+            const float red = src[3 * x + 0];
+            const float green = src[3 * x + 1];
+            const float blue = src[3 * x + 2];
+            const float lum = (red + green + blue) * (1.0f / 3);
+            destLuma[x] = lum;
+            destBlue[x] = blue - lum;
+            destRed[x] = red - lum;
+        }
+    }
+
+    return {std::move(luma), std::move(chromaBlue), std::move(chromaRed)};
+}
+
+c_Image c_Image::CombineLumaChroma(const c_Image& luma, const c_Image& chromaBlue, const c_Image& chromaRed)
+{
+    for (const auto* img: {&luma, &chromaBlue, &chromaRed})
+    {
+        IMPPG_ASSERT(img->GetPixelFormat() == PixelFormat::PIX_MONO32F);
+        IMPPG_ASSERT(img->GetWidth() == luma.GetWidth() && img->GetHeight() == luma.GetHeight());
+    }
+
+    c_Image rgb(luma.GetWidth(), luma.GetHeight(), PixelFormat::PIX_RGB32F);
+
+    #pragma omp parallel for
+    for (int y = 0; y < static_cast<int>(luma.GetHeight()); ++y)
+    {
+        const float* srcLuma = luma.GetRowAs<float>(y);
+        const float* srcBlue = chromaBlue.GetRowAs<float>(y);
+        const float* srcRed = chromaRed.GetRowAs<float>(y);
+        float* dest = rgb.GetRowAs<float>(y);
+
+        for (unsigned x = 0; x < luma.GetWidth(); ++x)
+        {
+            const float red = srcLuma[x] + srcRed[x];
+            const float blue = srcLuma[x] + srcBlue[x];
+            const float green = srcLuma[x] - srcRed[x] - srcBlue[x];
+            dest[3 * x + 0] = std::clamp(red, 0.0f, 1.0f);
+            dest[3 * x + 1] = std::clamp(green, 0.0f, 1.0f);
+            dest[3 * x + 2] = std::clamp(blue, 0.0f, 1.0f);
+        }
+    }
+
+    return rgb;
+}
+
 c_Image c_Image::Blend(const c_Image& img1, double weight1, const c_Image& img2, double weight2)
 {
     IMPPG_ASSERT(weight1 >= 0.0 && weight1 <= 1.0);
@@ -1,6 +1,6 @@
 /*
 ImPPG (Image Post-Processor) - common operations for astronomical stacks and other images
-Copyright (C) 2016-2021 Filip Szczerek <ga.software@yahoo.com>
+Copyright (C) 2016-2022 Filip Szczerek <ga.software@yahoo.com>
 
 This file is part of ImPPG.
 
@@ -27,6 +27,8 @@ File description:
 #include <cstdlib>
 #include <iostream>
 
+namespace Log { void Flush(); } // see `logging/logging.h`; avoids making every user of the macros include it
+
 #define IMPPG_ASSERT(condition)                                             \
 {                                                                           \
     if (!(condition))                                                       \
@@ -34,6 +36,7 @@ File description:
         std::cerr << "Assertion failed at " << __FILE__ << ":" << __LINE__  \
                   << " inside " << __FUNCTION__ << "\n"                     \
                   << "Condition: " << #condition << "\n";                   \
+        Log::Flush();                                                       \
         std::abort();                                                       \
     }                                                                       \
 }
@@ -43,6 +46,7 @@ File description:
     if (!(condition))                                     \
     {                                                     \
         std::cerr << "Assertion failed: " << msg << "\n"; \
+        Log::Flush();                                     \
         std::abort();                                     \
     }                                                     \
 }
@@ -52,6 +56,7 @@ File description:
 {                                                                                   \
     std::cerr << "Abnormal program state detected: " << __FILE__ << ":" << __LINE__ \
                 << " inside " << __FUNCTION__ << "\nExiting.\n";                    \
+    Log::Flush();                                                                   \
     std::abort();                                                                   \
 }
 
@@ -59,6 +64,7 @@ File description:
 {                                                                                   \
     std::cerr << __FILE__ << ":" << __LINE__ \
                 << " inside " << __FUNCTION__ << ": " << msg << "\n";               \
+    Log::Flush();                                                                   \
     std::abort();                                                                   \
 }
 
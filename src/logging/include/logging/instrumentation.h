@@ -0,0 +1,94 @@
+/*
+ImPPG (Image Post-Processor) - common operations for astronomical stacks and other images
+Copyright (C) 2016-2022 Filip Szczerek <ga.software@yahoo.com>
+
+This file is part of ImPPG.
+
+ImPPG is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ImPPG is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with ImPPG.  If not, see <http://www.gnu.org/licenses/>.
+
+File description:
+    Processing stage instrumentation header.
+*/
+
+#ifndef IMPPG_INSTRUMENTATION_H
+#define IMPPG_INSTRUMENTATION_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Log
+{
+
+/// Measurements of a single execution of a processing stage or I/O call.
+struct StageRecord
+{
+    std::string name; ///< Stage name, e.g. "Unsharp masking" or "Load image".
+    std::string details; ///< Optional; e.g. file name.
+    double startMs; ///< Start time, relative to the first use of instrumentation.
+    double wallTimeMs;
+    double cpuTimeMs; ///< Process CPU time (summed over all threads, including concurrently running stages).
+    double megapixels; ///< Number of pixels processed; 0 if not applicable.
+    std::uint64_t bytesAllocated; ///< Image buffers allocated by the stage's thread.
+    int numThreads; ///< Maximum number of threads the stage could use.
+    int threadId; ///< Small sequential identifier of the thread which ran the stage.
+
+    /// Returns 0 if not applicable.
+    double GetMegapixelsPerSecond() const
+    {
+        return (megapixels > 0 && wallTimeMs > 0) ? megapixels / (wallTimeMs / 1000.0) : 0.0;
+    }
+};
+
+/// Measures a processing stage from construction to destruction and stores the result (see `GetStageRecords`).
+/** Stages may be nested and run concurrently in different threads. */
+class c_StageTimer
+{
+public:
+    c_StageTimer(std::string name, double megapixels, std::string details = {});
+
+    c_StageTimer(const c_StageTimer&) = delete;
+    c_StageTimer& operator=(const c_StageTimer&) = delete;
+
+    ~c_StageTimer();
+
+    void SetDetails(std::string details) { m_Record.details = std::move(details); }
+
+    void SetMegapixels(double megapixels) { m_Record.megapixels = megapixels; }
+
+private:
+    StageRecord m_Record;
+    std::chrono::steady_clock::time_point m_Start;
+    double m_CpuStartMs;
+    std::uint64_t m_AllocatedAtStart;
+};
+
+/// Adds to the number of bytes allocated by the current thread (reported by `StageRecord::bytesAllocated`).
+void CountAllocation(std::size_t numBytes);
+
+/// Returns a copy of the stored stage records (at most the most recent several thousand).
+std::vector<StageRecord> GetStageRecords();
+
+/// Removes all stored stage records; the thread identifiers of subsequent records start from 1 again.
+void ClearStageRecords();
+
+/// Saves all stored stage records in Chrome trace event format (viewable in chrome://tracing or Perfetto).
+/** Returns false on failure. */
+bool ExportChromeTrace(const std::string& fileName);
+
+}
+
+#endif // IMPPG_INSTRUMENTATION_H
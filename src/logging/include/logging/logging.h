@@ -1,6 +1,6 @@
 /*
 ImPPG (Image Post-Processor) - common operations for astronomical stacks and other images
-Copyright (C) 2016-2019 Filip Szczerek <ga.software@yahoo.com>
+Copyright (C) 2016-2022 Filip Szczerek <ga.software@yahoo.com>
 
 This file is part of ImPPG.
 
@@ -24,19 +24,57 @@ File description:
 #ifndef IMPPG_LOGGING_H
 #define IMPPG_LOGGING_H
 
+#include <atomic>
 #include <iostream>
 #include <wx/string.h>
 
+/// Messages of a higher level are removed at compile time (0: quiet, 1: normal, 2: verbose).
+#ifndef IMPPG_MAX_LOG_LEVEL
+#define IMPPG_MAX_LOG_LEVEL 2
+#endif
+
 namespace Log
 {
 
 enum class LogLevel { QUIET = 0, NORMAL, VERBOSE };
 
+constexpr LogLevel MAX_LEVEL = static_cast<LogLevel>(IMPPG_MAX_LOG_LEVEL);
+
+namespace detail { extern std::atomic<LogLevel> currentLevel; }
+
+/// Starts a background thread which writes the messages to `outputStream`.
 void Initialize(LogLevel level, std::ostream& outputStream);
 
+/// Writes all pending messages and stops the background thread.
+/** Has to be called before the stream passed to `Initialize` is destroyed. */
+void Shutdown();
+
+/// Writes all pending messages from the calling thread; used before abnormal termination (see `imppg_assert.h`).
+void Flush();
+
+inline bool IsEnabled(LogLevel level)
+{
+    return level <= MAX_LEVEL && level <= detail::currentLevel.load(std::memory_order_relaxed);
+}
+
 /// Prints a message. Newline is NOT added by default.
+/** The message is queued without locking and written by a background thread. */
 void Print(const wxString& msg, bool prependTimestamp = true, LogLevel level = LogLevel::NORMAL);
 
+/// Prints a message (with a timestamp); formats it only if `level` is enabled.
+/** Use in frequently executed code instead of `Print(wxString::Format(...))`. */
+template<LogLevel level = LogLevel::NORMAL, typename... Args>
+void PrintF(const wxString& format, const Args&... args)
+{
+    if constexpr (level <= MAX_LEVEL)
+    {
+        if (IsEnabled(level))
+        {
+            Print(wxString::Format(format, args...), true, level);
+        }
+    }
+}
+
 }
 
 
@@ -0,0 +1,221 @@
+/*
+ImPPG (Image Post-Processor) - common operations for astronomical stacks and other images
+Copyright (C) 2016-2022 Filip Szczerek <ga.software@yahoo.com>
+
+This file is part of ImPPG.
+
+ImPPG is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ImPPG is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with ImPPG.  If not, see <http://www.gnu.org/licenses/>.
+
+File description:
+    Processing stage instrumentation implementation.
+*/
+
+#include <cstdio>
+#include <ctime>
+#include <deque>
+#include <fstream>
+#include <locale>
+#include <limits>
+#include <mutex>
+#include <sstream>
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+
+#include "logging/instrumentation.h"
+
+#if !defined(_OPENMP)
+static int omp_get_max_threads() { return 1; }
+#endif
+
+// private definitions
+namespace
+{
+
+/// Older records are discarded, so that a long batch run does not grow the memory use indefinitely.
+constexpr std::size_t MAX_NUM_RECORDS = 10000;
+
+std::mutex recordsMutex;
+std::deque<Log::StageRecord> records;
+/// Incremented when the records are cleared, so that thread identifiers are assigned anew.
+std::uint64_t threadIdGeneration = 0;
+int nextThreadId = 1;
+
+/// Sequential identifier of the current thread; valid if `generation` equals `threadIdGeneration`.
+thread_local struct
+{
+    std::uint64_t generation{std::numeric_limits<std::uint64_t>::max()};
+    int id{0};
+} currentThreadId;
+
+thread_local std::uint64_t allocatedBytes = 0;
+
+const std::chrono::steady_clock::time_point& GetEpoch()
+{
+    static const auto epoch = std::chrono::steady_clock::now();
+    return epoch;
+}
+
+double GetMsSinceEpoch(std::chrono::steady_clock::time_point t)
+{
+    return std::chrono::duration<double, std::milli>(t - GetEpoch()).count();
+}
+
+double GetProcessCpuTimeMs()
+{
+#if defined(_WIN32)
+    // `std::clock` measures wall time under MS Windows
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    if (!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime)) { return 0.0; }
+
+    const auto toMs = [](const FILETIME& ft) {
+        // units of 100 ns
+        return ((static_cast<std::uint64_t>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime) / 10000.0;
+    };
+    return toMs(kernelTime) + toMs(userTime);
+#else
+    return 1000.0 * std::clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+/// Must be called with `recordsMutex` locked.
+int GetSequentialThreadId()
+{
+    if (currentThreadId.generation != threadIdGeneration)
+    {
+        currentThreadId.generation = threadIdGeneration;
+        currentThreadId.id = nextThreadId++;
+    }
+    return currentThreadId.id;
+}
+
+std::string EscapeJson(const std::string& str)
+{
+    std::string result;
+    for (const char c: str)
+    {
+        switch (c)
+        {
+        case '"': result += "\\\""; break;
+        case '\\': result += "\\\\"; break;
+        case '\n': result += "\\n"; break;
+        case '\t': result += "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20)
+            {
+                char buf[8];
+                std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                result += buf;
+            }
+            else
+            {
+                result += c;
+            }
+        }
+    }
+    return result;
+}
+
+}
+
+namespace Log
+{
+
+c_StageTimer::c_StageTimer(std::string name, double megapixels, std::string details)
+: m_Start(std::chrono::steady_clock::now()),
+  m_CpuStartMs(GetProcessCpuTimeMs()),
+  m_AllocatedAtStart(allocatedBytes)
+{
+    m_Record.name = std::move(name);
+    m_Record.details = std::move(details);
+    m_Record.megapixels = megapixels;
+    m_Record.numThreads = omp_get_max_threads();
+}
+
+c_StageTimer::~c_StageTimer()
+{
+    const auto end = std::chrono::steady_clock::now();
+
+    m_Record.startMs = GetMsSinceEpoch(m_Start);
+    m_Record.wallTimeMs = std::chrono::duration<double, std::milli>(end - m_Start).count();
+    m_Record.cpuTimeMs = GetProcessCpuTimeMs() - m_CpuStartMs;
+    m_Record.bytesAllocated = allocatedBytes - m_AllocatedAtStart;
+
+    std::lock_guard lock(recordsMutex);
+    m_Record.threadId = GetSequentialThreadId();
+    records.push_back(std::move(m_Record));
+    if (records.size() > MAX_NUM_RECORDS)
+    {
+        records.pop_front();
+    }
+}
+
+void CountAllocation(std::size_t numBytes)
+{
+    allocatedBytes += numBytes;
+}
+
+std::vector<StageRecord> GetStageRecords()
+{
+    std::lock_guard lock(recordsMutex);
+    return std::vector<StageRecord>(records.begin(), records.end());
+}
+
+void ClearStageRecords()
+{
+    std::lock_guard lock(recordsMutex);
+    records.clear();
+    threadIdGeneration += 1;
+    nextThreadId = 1;
+}
+
+bool ExportChromeTrace(const std::string& fileName)
+{
+    const auto stageRecords = GetStageRecords();
+
+    std::ostringstream json;
+    json.imbue(std::locale::classic());
+    json.setf(std::ios::fixed);
+    json.precision(3);
+
+    json << "{\n\"displayTimeUnit\": \"ms\",\n\"traceEvents\": [";
+    for (std::size_t i = 0; i < stageRecords.size(); ++i)
+    {
+        const auto& r = stageRecords[i];
+        json << (i > 0 ? ",\n" : "\n")
+            << "{\"name\": \"" << EscapeJson(r.name) << "\", \"cat\": \"imppg\", \"ph\": \"X\", \"pid\": 1"
+            << ", \"tid\": " << r.threadId
+            << ", \"ts\": " << 1000.0 * r.startMs
+            << ", \"dur\": " << 1000.0 * r.wallTimeMs
+            << ", \"args\": {"
+            << "\"details\": \"" << EscapeJson(r.details) << "\""
+            << ", \"cpu_time_ms\": " << r.cpuTimeMs
+            << ", \"megapixels\": " << r.megapixels
+            << ", \"megapixels_per_second\": " << r.GetMegapixelsPerSecond()
+            << ", \"bytes_allocated\": " << r.bytesAllocated
+            << ", \"threads\": " << r.numThreads
+            << "}}";
+    }
+    json << "\n]\n}\n";
+
+    std::ofstream file(fileName, std::ios::binary);
+    if (!file) { return false; }
+    file << json.str();
+    return static_cast<bool>(file);
+}
+
+}
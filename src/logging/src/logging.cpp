@@ -1,6 +1,6 @@
 /*
 ImPPG (Image Post-Processor) - common operations for astronomical stacks and other images
-Copyright (C) 2016-2019 Filip Szczerek <ga.software@yahoo.com>
+Copyright (C) 2016-2022 Filip Szczerek <ga.software@yahoo.com>
 
 This file is part of ImPPG.
 
@@ -21,32 +21,247 @@ File description:
     Logging functions implementation.
 */
 
-#include <wx/thread.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <wx/datetime.h>
 
 #include "logging/logging.h"
 
-std::ostream* logStream = nullptr;
-auto logLevel = Log::LogLevel::QUIET;
-wxMutex logMutex;
+namespace Log::detail
+{
+std::atomic<LogLevel> currentLevel{LogLevel::QUIET};
+}
 
-void Log::Initialize(LogLevel level, std::ostream& outputStream)
+// private definitions
+namespace
 {
-    logStream = &outputStream;
-    logLevel = level;
+
+/// Number of messages which can wait for being written; must be a power of 2.
+constexpr std::size_t RING_SIZE = 4096;
+
+/// Maximum time `Log::Flush` waits for the writer thread to finish writing.
+constexpr std::chrono::milliseconds FLUSH_LOCK_TIMEOUT{500};
+
+struct Message
+{
+    /// Equals `pos` when the slot is free for a message at queue position `pos`, and `pos` + 1 once the message is stored.
+    std::atomic<std::size_t> sequence;
+    std::string text;
+    std::chrono::system_clock::time_point time;
+    bool prependTimestamp;
+};
+
+/// Bounded multiple-producer, single-consumer queue (D. Vyukov's algorithm); written to without locking.
+std::unique_ptr<Message[]> ring;
+std::atomic<std::size_t> enqueuePos{0};
+
+/// Held by the consumer of the queue: the writer thread or (on abnormal termination) `Log::Flush`.
+std::mutex consumerMutex;
+std::size_t dequeuePos{0}; ///< Guarded by `consumerMutex`.
+std::ostream* logStream = nullptr; ///< Guarded by `consumerMutex`.
+
+std::atomic<bool> stopWriter{false};
+
+/// Set while the writer thread is about to wait for new messages; producers only notify it then,
+/// so that enqueueing does not need locking otherwise.
+std::atomic<bool> writerSleeping{false};
+std::mutex wakeMutex;
+std::condition_variable wakeCondition;
+bool wakeRequested{false}; ///< Guarded by `wakeMutex`.
+
+void StopWriter()
+{
+    {
+        std::lock_guard lock{wakeMutex};
+        stopWriter = true;
+    }
+    wakeCondition.notify_one();
 }
 
-void Log::Print(const wxString& msg, bool prependTimestamp, LogLevel level)
+/// Makes sure the writer thread is stopped at program exit even if `Log::Shutdown` has not been called.
+struct WriterThread
 {
-    if (level <= logLevel)
+    std::thread thread;
+
+    ~WriterThread()
     {
-        wxMutexLocker lock(logMutex);
+        if (thread.joinable())
+        {
+            StopWriter();
+            thread.join();
+        }
+    }
+} writer;
+
+void Enqueue(std::string&& text, bool prependTimestamp)
+{
+    const auto time = std::chrono::system_clock::now();
+
+    std::size_t pos = enqueuePos.load(std::memory_order_relaxed);
+    while (true)
+    {
+        Message& msg = ring[pos & (RING_SIZE - 1)];
+        const std::size_t sequence = msg.sequence.load(std::memory_order_acquire);
+        const auto diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(pos);
+        if (diff == 0)
+        {
+            if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                msg.text = std::move(text);
+                msg.time = time;
+                msg.prependTimestamp = prependTimestamp;
+                // sequentially consistent (like `writerSleeping`), so that either the writer thread sees the message
+                // before going to sleep, or we see it is sleeping
+                msg.sequence.store(pos + 1, std::memory_order_seq_cst);
+                if (writerSleeping.load(std::memory_order_seq_cst))
+                {
+                    {
+                        std::lock_guard lock{wakeMutex};
+                        wakeRequested = true;
+                    }
+                    wakeCondition.notify_one();
+                }
+                return;
+            }
+        }
+        else
+        {
+            if (diff < 0)
+            {
+                // the queue is full; once the writer thread has been told to stop, it will not free any slots
+                if (stopWriter.load(std::memory_order_relaxed)) { return; }
+
+                std::this_thread::yield();
+            }
+            pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+/// Must be called with `consumerMutex` locked.
+bool IsMessagePending()
+{
+    return ring[dequeuePos & (RING_SIZE - 1)].sequence.load(std::memory_order_seq_cst) == dequeuePos + 1;
+}
+
+/// Must be called with `consumerMutex` locked. Returns false if there were no messages to write.
+bool WritePendingMessages()
+{
+    if (!logStream) { return false; }
+
+    bool anyWritten = false;
+    while (true)
+    {
+        Message& msg = ring[dequeuePos & (RING_SIZE - 1)];
+        if (msg.sequence.load(std::memory_order_acquire) != dequeuePos + 1) { break; }
+
         //TODO: use something more precise for time source (microsecond precision or better)
-        if (prependTimestamp)
+        if (msg.prependTimestamp)
+        {
+            const auto msSinceEpoch = std::chrono::duration_cast<std::chrono::milliseconds>(msg.time.time_since_epoch()).count();
+            wxDateTime timestamp{static_cast<time_t>(msSinceEpoch / 1000)};
+            timestamp.SetMillisecond(static_cast<wxDateTime::wxDateTime_t>(msSinceEpoch % 1000));
+            *logStream << timestamp.Format("%H:%M:%S.%l").ToStdString() << " ";
+        }
+        *logStream << msg.text;
+        msg.text.clear();
+
+        msg.sequence.store(dequeuePos + RING_SIZE, std::memory_order_release);
+        ++dequeuePos;
+        anyWritten = true;
+    }
+
+    if (anyWritten) { logStream->flush(); }
+
+    return anyWritten;
+}
+
+}
+
+void Log::Initialize(LogLevel level, std::ostream& outputStream)
+{
+    if (writer.thread.joinable()) { Shutdown(); }
+
+    if (!ring)
+    {
+        ring.reset(new Message[RING_SIZE]);
+        for (std::size_t i = 0; i < RING_SIZE; ++i)
+        {
+            ring[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    {
+        std::lock_guard lock{consumerMutex};
+        logStream = &outputStream;
+    }
+    stopWriter = false;
+    writer.thread = std::thread([] {
+        while (!stopWriter.load(std::memory_order_relaxed))
         {
-            *logStream << wxDateTime::UNow().Format("%H:%M:%S.%l").ToStdString() << " ";
+            std::unique_lock consumerLock{consumerMutex};
+            WritePendingMessages();
+
+            writerSleeping.store(true, std::memory_order_seq_cst);
+            const bool messagePending = IsMessagePending();
+            consumerLock.unlock();
+
+            if (!messagePending)
+            {
+                std::unique_lock lock{wakeMutex};
+                wakeCondition.wait(lock, [] { return wakeRequested || stopWriter.load(std::memory_order_relaxed); });
+                wakeRequested = false;
+            }
+            writerSleeping.store(false, std::memory_order_relaxed);
         }
-        *logStream << msg.ToStdString();
-        logStream->flush();
+
+        std::lock_guard consumerLock{consumerMutex};
+        WritePendingMessages();
+    });
+
+    detail::currentLevel.store(level, std::memory_order_release);
+}
+
+void Log::Shutdown()
+{
+    if (!writer.thread.joinable()) { return; }
+
+    detail::currentLevel.store(LogLevel::QUIET, std::memory_order_release);
+    StopWriter();
+    writer.thread.join();
+
+    std::lock_guard lock{consumerMutex};
+    logStream = nullptr;
+}
+
+void Log::Flush()
+{
+    if (!ring || std::this_thread::get_id() == writer.thread.get_id()) { return; }
+
+    // the writer thread might have been interrupted while holding the lock; do not wait for it indefinitely
+    const auto deadline = std::chrono::steady_clock::now() + FLUSH_LOCK_TIMEOUT;
+    std::unique_lock lock{consumerMutex, std::try_to_lock};
+    while (!lock.owns_lock() && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::yield();
+        lock.try_lock();
+    }
+
+    if (lock.owns_lock())
+    {
+        WritePendingMessages();
+    }
+}
+
+void Log::Print(const wxString& msg, bool prependTimestamp, LogLevel level)
+{
+    if (IsEnabled(level))
+    {
+        Enqueue(msg.ToStdString(), prependTimestamp);
     }
 }
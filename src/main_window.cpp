@@ -68,13 +68,14 @@ File description:
 #include "ctrl_ids.h"
 #include "common/formats.h"
 #include "imppg_assert.h"
-#include "logging.h"
+#include "logging/logging.h"
 #include "main_window.h"
 #include "normalize.h"
 #if ENABLE_SCRIPTING
 #include "script_dialog.h"
 #endif
 #include "common/proc_settings.h"
+#include "stage_timings.h"
 #include "tcrv_wnd_settings.h"
 
 DECLARE_APP(c_MyApp)
@@ -130,11 +131,14 @@ BEGIN_EVENT_TABLE(c_MainWindow, wxFrame)
     EVT_MENU(ID_BatchProcessing, c_MainWindow::OnCommandEvent)
     EVT_MENU(ID_RunScript, c_MainWindow::OnCommandEvent)
     EVT_CHECKBOX(ID_LucyRichardsonDeringing, c_MainWindow::OnCommandEvent)
+    EVT_CHECKBOX(ID_LuminanceOnly, c_MainWindow::OnCommandEvent)
+    EVT_CHECKBOX(ID_ChromaDenoise, c_MainWindow::OnCommandEvent)
     EVT_MENU(ID_NormalizeImage, c_MainWindow::OnCommandEvent)
     EVT_MENU(ID_ChooseLanguage, c_MainWindow::OnCommandEvent)
     EVT_MENU(ID_ToneCurveWindowSettings, c_MainWindow::OnCommandEvent)
     EVT_MENU(ID_About, c_MainWindow::OnCommandEvent)
     EVT_MENU(ID_AlignImages, c_MainWindow::OnCommandEvent)
+    EVT_MENU(ID_StageTimings, c_MainWindow::OnCommandEvent)
     // The handler is bound to m_ImageView, but attach it also here to c_MainWindow
     // so that it works even if m_ImageView does not have focus
     EVT_MOUSEWHEEL(c_MainWindow::OnImageViewMouseWheel)
@@ -197,6 +201,9 @@ void c_MainWindow::LoadSettingsFromFile(wxString settingsFile, bool moveToMruLis
         m_Ctrls.lrSigma->SetValue(s.processing.LucyRichardson.sigma);
         m_Ctrls.lrIters->SetValue(s.processing.LucyRichardson.iterations);
         m_Ctrls.lrDeriging->SetValue(s.processing.LucyRichardson.deringing.enabled);
+        m_Ctrls.luminanceOnly->SetValue(s.processing.color.luminanceOnly);
+        m_Ctrls.chromaDenoise->SetValue(s.processing.color.chromaDenoise);
+        UpdateColorControls();
 
         CreateAnewControlsForAllUnsharpMasks();
 
@@ -563,6 +570,9 @@ c_MainWindow::c_MainWindow()
     s.processing.LucyRichardson.iterations = Default::LR_ITERATIONS;
     s.processing.LucyRichardson.deringing.enabled = false;
 
+    s.processing.color.luminanceOnly = false;
+    s.processing.color.chromaDenoise = false;
+
     s.processing.unsharpMask.at(0).adaptive = false;
     s.processing.unsharpMask.at(0).sigma = Default::UNSHMASK_SIGMA;
     s.processing.unsharpMask.at(0).amountMin = Default::UNSHMASK_AMOUNT;
@@ -601,7 +611,7 @@ c_MainWindow::c_MainWindow()
             switch (Configuration::ProcessingBackEnd)
             {
             case BackEnd::CPU_AND_BITMAPS:
-                InitializeBackEnd(imppg::backend::CreateCpuBmpDisplayBackend(*m_ImageView), std::nullopt);
+                InitializeBackEnd(imppg::backend::CreateCpuBmpDisplayBackend(*m_ImageView, Configuration::UnsharpMaskBlurPyramid), std::nullopt);
                 break;
 
 #if USE_OPENGL_BACKEND
@@ -614,7 +624,7 @@ c_MainWindow::c_MainWindow()
                 if (nullptr == gl_instance)
                 {
                     wxMessageBox(_("Failed to initialize OpenGL!\nReverting to CPU mode."), _("Error"), wxICON_ERROR);
-                    InitializeBackEnd(imppg::backend::CreateCpuBmpDisplayBackend(*m_ImageView), std::nullopt);
+                    InitializeBackEnd(imppg::backend::CreateCpuBmpDisplayBackend(*m_ImageView, Configuration::UnsharpMaskBlurPyramid), std::nullopt);
                     Configuration::ProcessingBackEnd = BackEnd::CPU_AND_BITMAPS;
                     GetMenuBar()->FindItem(ID_CpuBmpBackEnd)->Check();
                 }
@@ -633,6 +643,7 @@ c_MainWindow::c_MainWindow()
             }
 
             SetStatusText(GetBackEndStatusText(Configuration::ProcessingBackEnd), StatusBarField::BACK_END);
+            UpdateColorControls();
 
             firstCall = false;
         }
@@ -1029,10 +1040,21 @@ void c_MainWindow::OnUpdateLucyRichardsonSettings()
     proc.LucyRichardson.iterations = m_Ctrls.lrIters->GetValue();
     proc.LucyRichardson.sigma = m_Ctrls.lrSigma->GetValue();
     proc.LucyRichardson.deringing.enabled = m_Ctrls.lrDeriging->GetValue();
+    proc.color.luminanceOnly = m_Ctrls.luminanceOnly->GetValue();
+    proc.color.chromaDenoise = m_Ctrls.chromaDenoise->GetValue();
+    UpdateColorControls();
 
     m_BackEnd->LRSettingsChanged(proc);
 }
 
+void c_MainWindow::UpdateColorControls()
+{
+    // the OpenGL back end does not support luminance-only processing
+    const bool luminanceOnlySupported = (Configuration::ProcessingBackEnd == BackEnd::CPU_AND_BITMAPS);
+    m_Ctrls.luminanceOnly->Enable(luminanceOnlySupported);
+    m_Ctrls.chromaDenoise->Enable(luminanceOnlySupported && m_Ctrls.luminanceOnly->GetValue());
+}
+
 void c_MainWindow::OnUpdateUnsharpMaskingSettings(std::size_t maskIdx)
 {
     auto& proc = m_CurrentSettings.processing;
@@ -1136,6 +1158,8 @@ void c_MainWindow::OnCommandEvent(wxCommandEvent& event)
     case ID_LucyRichardsonIters: // happens only if Enter pressed in the text control
     case ID_LucyRichardsonSigma:
     case ID_LucyRichardsonDeringing:
+    case ID_LuminanceOnly:
+    case ID_ChromaDenoise:
         OnUpdateLucyRichardsonSettings();
         IndicateSettingsModified();
         break;
@@ -1262,6 +1286,8 @@ void c_MainWindow::OnCommandEvent(wxCommandEvent& event)
         }
         break;
 
+    case ID_StageTimings: ShowStageTimingsDialog(this); break;
+
     case ID_ZoomIn: ChangeZoom(CalcZoomIn(s.view.zoomFactor), imgViewMid); break;
 
     case ID_ZoomOut: ChangeZoom(CalcZoomOut(s.view.zoomFactor), imgViewMid); break;
@@ -1335,6 +1361,14 @@ wxPanel* c_MainWindow::CreateLucyRichardsonControlsPanel(wxWindow* parent)
     szTop->Add(m_Ctrls.lrDeriging = new wxCheckBox(result, ID_LucyRichardsonDeringing, _("Prevent ringing")), 0, wxALIGN_LEFT | wxALL, BORDER);
     m_Ctrls.lrDeriging->SetToolTip(_("Prevents ringing (halo) around overexposed areas, e.g. a solar disc in a prominence image (experimental feature)."));
 
+    szTop->Add(m_Ctrls.luminanceOnly = new wxCheckBox(result, ID_LuminanceOnly, _("Sharpen luminance only")), 0, wxALIGN_LEFT | wxALL, BORDER);
+    m_Ctrls.luminanceOnly->SetToolTip(_("Colour images: sharpening is applied only to luminance; chrominance is left unchanged. "
+        "Avoids colour fringes, and is faster. Supported only in the CPU mode."));
+
+    szTop->Add(m_Ctrls.chromaDenoise = new wxCheckBox(result, ID_ChromaDenoise, _("Smooth chrominance")), 0, wxALIGN_LEFT | wxALL, BORDER);
+    m_Ctrls.chromaDenoise->SetToolTip(_("Colour images: slightly blurs chrominance to reduce colour noise (requires \"Sharpen luminance only\")."));
+    m_Ctrls.chromaDenoise->Enable(false);
+
     wxSizer *szButtons = new wxBoxSizer(wxHORIZONTAL);
     szButtons->Add(new wxButton(result, ID_LucyRichardsonReset, _("reset"), wxDefaultPosition, wxDefaultSize, wxBU_EXACTFIT),
         0, wxALIGN_CENTER_VERTICAL | wxALL, BORDER);
@@ -1716,9 +1750,10 @@ void c_MainWindow::InitMenu()
         {
             std::optional<c_Image> img = m_BackEnd->GetImage();
 
-            InitializeBackEnd(imppg::backend::CreateCpuBmpDisplayBackend(*m_ImageView), img);
+            InitializeBackEnd(imppg::backend::CreateCpuBmpDisplayBackend(*m_ImageView, Configuration::UnsharpMaskBlurPyramid), img);
             Configuration::ProcessingBackEnd = BackEnd::CPU_AND_BITMAPS;
             SetStatusText(GetBackEndStatusText(Configuration::ProcessingBackEnd), StatusBarField::BACK_END);
+            UpdateColorControls();
         },
         ID_CpuBmpBackEnd
     );
@@ -1745,6 +1780,7 @@ void c_MainWindow::InitMenu()
                 Configuration::ProcessingBackEnd = BackEnd::GPU_OPENGL;
             }
             SetStatusText(GetBackEndStatusText(Configuration::ProcessingBackEnd), StatusBarField::BACK_END);
+            UpdateColorControls();
 
             Configuration::OpenGLInitIncomplete = false;
             Configuration::Flush();
@@ -1822,6 +1858,7 @@ void c_MainWindow::InitMenu()
 
     wxMenu* menuTools = new wxMenu();
     menuTools->Append(ID_AlignImages, _("Align image sequence..."));
+    menuTools->Append(ID_StageTimings, _("Processing stage timings..."));
 
     // In theory, we could use just an "About" menu without items and react to its "on menu open" event.
     // In practice, it turns out that displaying a modal dialog (even a standard MessageBox) from
@@ -76,6 +76,8 @@ class c_MainWindow: public wxFrame
             wxRect newSelection ///< Logical coordinates in the image
     );
     void OnUpdateLucyRichardsonSettings();
+    /// Enables the colour mode controls supported by the current back end and settings.
+    void UpdateColorControls();
     void InitToolbar();
     void InitStatusBar();
     void InitControls();
@@ -151,6 +153,8 @@ class c_MainWindow: public wxFrame
         c_NumericalCtrl* lrSigma{nullptr};
         wxSpinCtrl* lrIters{nullptr};
         wxCheckBox* lrDeriging{nullptr};
+        wxCheckBox* luminanceOnly{nullptr};
+        wxCheckBox* chromaDenoise{nullptr};
         wxStaticBoxSizer* unshMaskBox{nullptr};
         std::vector<UnsharpMaskControls> unshMask;
         c_ToneCurveEditor* tcrvEditor{nullptr};
@@ -0,0 +1,51 @@
+/*
+ImPPG (Image Post-Processor) - common operations for astronomical stacks and other images
+Copyright (C) 2016-2022 Filip Szczerek <ga.software@yahoo.com>
+
+This file is part of ImPPG.
+
+ImPPG is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ImPPG is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with ImPPG.  If not, see <http://www.gnu.org/licenses/>.
+
+File description:
+    Cancellation token header.
+*/
+
+#ifndef IMPPG_CANCELLATION_H
+#define IMPPG_CANCELLATION_H
+
+#include <atomic>
+#include <memory>
+
+/// Cooperative cancellation flag; copies share the flag.
+/** Can be checked concurrently from any number of threads (e.g. inside OpenMP loops). */
+class c_CancellationToken
+{
+public:
+    c_CancellationToken(): m_Cancelled(std::make_shared<std::atomic<bool>>(false)) {}
+
+    void Cancel() { m_Cancelled->store(true, std::memory_order_relaxed); }
+
+    bool IsCancellationRequested() const { return m_Cancelled->load(std::memory_order_relaxed); }
+
+private:
+    std::shared_ptr<std::atomic<bool>> m_Cancelled;
+};
+
+/// Returns true if `token` is not null and its cancellation has been requested.
+inline bool IsCancelled(const c_CancellationToken* token)
+{
+    return token != nullptr && token->IsCancellationRequested();
+}
+
+#endif // IMPPG_CANCELLATION_H
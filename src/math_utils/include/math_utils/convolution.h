@@ -24,6 +24,9 @@ File description:
 #pragma once
 
 #include <cstdint>
+#include <vector>
+
+#include "math_utils/cancellation.h"
 
 enum class ConvolutionMethod
 {
@@ -38,6 +41,10 @@ enum class ConvolutionMethod
     Core i5-3570K with DDR3 PC-10700 RAM, compiled with MS C++ 18.00, for 1-4 threads - Filip). */
 constexpr int YOUNG_VAN_VLIET_MIN_KERNEL_RADIUS = 8;
 
+/** Minimum Gaussian sigma (in pixels of the current level) for which ConvolveSeparablePyramid()
+    continues the convolution on a 2x decimated level. */
+constexpr float GAUSSIAN_PYRAMID_MIN_SIGMA = 4.0f;
+
 /// Wrapper for an array which may contain row padding. Stores only the pointer and dimensions; can be copied, deleted without influencing the allocated memory.
 template<typename T>
 class c_PaddedArrayPtr
@@ -71,7 +78,34 @@ public:
 void ConvolveSeparable(
     c_PaddedArrayPtr<const float> input, ///< Input array.
     c_PaddedArrayPtr<float> output,      ///< Output array having as much rows and columns as 'input' does.
-    float sigma                          ///< Gaussian sigma.
+    float sigma,                         ///< Gaussian sigma.
+    const c_CancellationToken* cancellation = nullptr ///< If set, checked before processing each row; the output is incomplete if cancelled.
+);
+
+/// Calculates convolutions of 'inputs' (all of the same size) with a Gaussian kernel.
+/** If the recursive convolution is used, all channels are processed in a single sweep
+    (see the multi-channel ConvolveGaussianRecursiveTranspose()). */
+void ConvolveSeparable(
+    const std::vector<c_PaddedArrayPtr<const float>>& inputs, ///< Input arrays.
+    const std::vector<c_PaddedArrayPtr<float>>& outputs,      ///< Output arrays; element [i] has as much rows and columns as 'inputs[i]' does.
+    float sigma,                                              ///< Gaussian sigma.
+    const c_CancellationToken* cancellation = nullptr         ///< If set, checked before processing each row; the outputs are incomplete if cancelled.
+);
+
+/// Calculates an approximate convolution of 'input' with a Gaussian kernel using a cascade of decimated levels.
+/** As a convolution of Gaussians with sigmas 'a' and 'b' is a Gaussian with sigma sqrt(a^2 + b^2),
+    a large-sigma blur is split into a sequence of cheap anti-aliasing filters, each followed by 2x decimation,
+    and a final Gaussian blur at the smallest level, which is then upsampled (bilinearly) to 'output'.
+    The variances contributed by the decimation and upsampling filters are subtracted from the requested one.
+    The cost is only a fraction of the full-resolution ConvolveSeparable(). The decimation stops early
+    if a level's width or height would become small compared to the remaining sigma (to limit border effects).
+    For sigma < GAUSSIAN_PYRAMID_MIN_SIGMA, or if even the first decimated level would be too small,
+    equivalent to ConvolveSeparable(). */
+void ConvolveSeparablePyramid(
+    c_PaddedArrayPtr<const float> input, ///< Input array.
+    c_PaddedArrayPtr<float> output,      ///< Output array having as much rows and columns as 'input' does.
+    float sigma,                         ///< Gaussian sigma.
+    const c_CancellationToken* cancellation = nullptr ///< If set, checked before processing each row; the output is incomplete if cancelled.
 );
 
 /// Calculates convolution of 'input' with a rotationally symmetric and separable (i.e. Gaussian) 'kernel' and writes it in transposed form to 'output'
@@ -81,7 +115,8 @@ void ConvolveSeparableTranspose(
     const float kernel[], ///< Contains convolution kernel's projection (horizontal/vertical); element [kernelRadius] is the middle
     int kernelRadius, ///< 'kernel' contains 2*kernelRadius-1 elements
     float tempBuf1[], ///< Temporary buffer 1, as many elements as 'input'
-    float tempBuf2[] ///< Temporary buffer 2, as many elements as 'input'
+    float tempBuf2[], ///< Temporary buffer 2, as many elements as 'input'
+    const c_CancellationToken* cancellation = nullptr ///< If set, checked before processing each row; the output is incomplete if cancelled
 );
 
 /// Calculates convolution of 'input' with an approximated Gaussian kernel (Young & van Vliet recursive method) and writes it in transposed form to 'output'
@@ -90,7 +125,20 @@ void ConvolveGaussianRecursiveTranspose(
     c_PaddedArrayPtr<float> output,       ///< Transposed output array; contains as many rows as 'input' does columns and as many columns as 'input' does rows
     float sigma,                          ///< Gaussian sigma
     float tempBuf1[],                     ///< width*height elements
-    float tempBuf2[]                      ///< width*height elements
+    float tempBuf2[],                     ///< width*height elements
+    const c_CancellationToken* cancellation = nullptr ///< If set, checked before processing each row; the output is incomplete if cancelled
+);
+
+/// Multi-channel version of ConvolveGaussianRecursiveTranspose().
+/** All channels (of the same size) are filtered in a single sweep: the same row of every channel is processed
+    by one thread, with the recursions of up to 3 channels interleaved. */
+void ConvolveGaussianRecursiveTranspose(
+    const std::vector<c_PaddedArrayPtr<const float>>& inputs,  ///< Input arrays
+    const std::vector<c_PaddedArrayPtr<float>>& outputs,       ///< Transposed output arrays
+    float sigma,                                               ///< Gaussian sigma
+    float tempBuf1[],                                          ///< numChannels*width*height elements
+    float tempBuf2[],                                          ///< numChannels*width*height elements
+    const c_CancellationToken* cancellation = nullptr          ///< If set, checked before processing each row; the outputs are incomplete if cancelled
 );
 
 /// Matrices are transposed in square blocks of this length to a side
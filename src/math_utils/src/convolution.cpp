@@ -24,9 +24,12 @@ File description:
 #include "math_utils/convolution.h"
 #include "math_utils/gauss.h"
 
+#include <algorithm>
 #include <cmath>
 #include <cstring>
 #include <memory>
+#include <optional>
+#include <vector>
 
 #include "../../imppg_assert.h"
 
@@ -53,10 +56,14 @@ inline void Convolve1Dstep_OfsNonZero(const float input[], float output[], int l
 
 
 /// Performs a Young & van Vliet approximated recursive Gaussian filtering of values in one direction
+/// in 'NumArrays' independent arrays at once.
+/** The recursions of different arrays are independent, so interleaving them lets the CPU overlap
+    the latencies of successive steps (which otherwise form a single dependency chain). */
+template<int NumArrays>
 inline void YvVFilterValues(
-    const float input[], ///< Input array
-    float output[], ///< Output array (may equal 'input')
-    int length, ///< Number of elements in 'input', 'output'
+    const float* const input[], ///< Input arrays
+    float* const output[], ///< Output arrays (may equal 'input')
+    int length, ///< Number of elements in each of 'input', 'output'
     int direction, ///< 1: filter forward, -1: filter backward; if -1, processing starts at the last element
     // YvV coefficients
     float b0inv, float b1, float b2, float b3, float B
@@ -79,22 +86,46 @@ inline void YvVFilterValues(
         IMPPG_ABORT_MSG("direction must be 1 or -1");
     }
 
-    float prev1, prev2, prev3; // Previously calculated values
+    float prev1[NumArrays], prev2[NumArrays], prev3[NumArrays]; // Previously calculated values
 
     // Assume that border values extend beyond the array
-    prev1 = prev2 = prev3 = input[startIdx];
+    for (int a = 0; a < NumArrays; a++)
+        prev1[a] = prev2[a] = prev3[a] = input[a][startIdx];
 
     for (int i = startIdx; i != endIdx; i += direction)
     {
-        float next = B * input[i] + (b1*prev1 + b2*prev2 + b3*prev3) * b0inv;
-        prev3 = prev2;
-        prev2 = prev1;
-        prev1 = next;
+        for (int a = 0; a < NumArrays; a++)
+        {
+            float next = B * input[a][i] + (b1*prev1[a] + b2*prev2[a] + b3*prev3[a]) * b0inv;
+            prev3[a] = prev2[a];
+            prev2[a] = prev1[a];
+            prev1[a] = next;
 
-        output[i] = next;
+            output[a][i] = next;
+        }
     }
 }
 
+/// Max. number of arrays filtered together by YvVFilterValues().
+constexpr int YVV_MAX_BATCH = 3;
+
+/// Performs YvVFilterValues() on 'numArrays' arrays, batching up to YVV_MAX_BATCH of them.
+inline void YvVFilterValuesBatched(
+    const float* const input[],
+    float* const output[],
+    int numArrays,
+    int length,
+    int direction,
+    float b0inv, float b1, float b2, float b3, float B
+)
+{
+    int a = 0;
+    for (; a + YVV_MAX_BATCH <= numArrays; a += YVV_MAX_BATCH)
+        YvVFilterValues<YVV_MAX_BATCH>(&input[a], &output[a], length, direction, b0inv, b1, b2, b3, B);
+    for (; a < numArrays; a++)
+        YvVFilterValues<1>(&input[a], &output[a], length, direction, b0inv, b1, b2, b3, B);
+}
+
 inline void CalculateYvVCoefficients(float sigma, float& b0inv, float& b1, float& b2, float& b3, float& B)
 {
     float q;
@@ -116,39 +147,97 @@ void ConvolveGaussianRecursiveTranspose(
     c_PaddedArrayPtr<float> output,
     float sigma,
     float tempBuf1[],
-    float tempBuf2[]
+    float tempBuf2[],
+    const c_CancellationToken* cancellation
 )
 {
-    int width = input.width(), height = input.height();
+    ConvolveGaussianRecursiveTranspose(
+        std::vector<c_PaddedArrayPtr<const float>>{ input },
+        std::vector<c_PaddedArrayPtr<float>>{ output },
+        sigma, tempBuf1, tempBuf2, cancellation
+    );
+}
+
+void ConvolveGaussianRecursiveTranspose(
+    const std::vector<c_PaddedArrayPtr<const float>>& inputs,
+    const std::vector<c_PaddedArrayPtr<float>>& outputs,
+    float sigma,
+    float tempBuf1[],
+    float tempBuf2[],
+    const c_CancellationToken* cancellation
+)
+{
+    IMPPG_ASSERT(!inputs.empty() && inputs.size() == outputs.size());
     IMPPG_ASSERT(sigma >= 0.5f);
 
+    const int numChannels = static_cast<int>(inputs.size());
+    const int width = inputs[0].width(), height = inputs[0].height();
+    const std::size_t numPixels = static_cast<std::size_t>(width) * height;
+
     float b0inv, b1, b2, b3, B;
     CalculateYvVCoefficients(sigma, b0inv, b1, b2, b3, B);
 
-    float* convRows = tempBuf1;
+    float* convRows = tempBuf1; // channel 'ch' starts at convRows + ch*numPixels
 
-    // Convolve rows
+    // Convolve rows; the same row of every channel is processed together
     #pragma omp parallel for
     for (int y = 0; y < height; y++)
     {
-        // Perform forward filtering
-        YvVFilterValues(input.row_const(y), &convRows[y*width], width, 1, b0inv, b1, b2, b3, B);
+        if (IsCancelled(cancellation)) { continue; }
+
+        for (int ch0 = 0; ch0 < numChannels; ch0 += YVV_MAX_BATCH)
+        {
+            const int batchSize = std::min(YVV_MAX_BATCH, numChannels - ch0);
+            const float* src[YVV_MAX_BATCH];
+            float* dest[YVV_MAX_BATCH];
+            for (int i = 0; i < batchSize; i++)
+            {
+                src[i] = inputs[ch0 + i].row_const(y);
+                dest[i] = &convRows[(ch0 + i) * numPixels + static_cast<std::size_t>(y) * width];
+            }
 
-        // Perform backward filtering
-        YvVFilterValues(&convRows[y*width], &convRows[y*width], width, -1, b0inv, b1, b2, b3, B);
+            // Perform forward filtering
+            YvVFilterValuesBatched(src, dest, batchSize, width, 1, b0inv, b1, b2, b3, B);
+
+            // Perform backward filtering
+            YvVFilterValuesBatched(dest, dest, batchSize, width, -1, b0inv, b1, b2, b3, B);
+        }
     }
 
-    float* convRowsT = tempBuf2;
-    Transpose<float>(convRows, convRowsT, width, height, width*sizeof(float), height*sizeof(float), TRANSPOSITION_BLOCK_SIZE);
+    if (IsCancelled(cancellation)) { return; }
+
+    float* convRowsT = tempBuf2; // channel 'ch' starts at convRowsT + ch*numPixels
+
+    #pragma omp parallel for
+    for (int ch = 0; ch < numChannels; ch++)
+    {
+        Transpose<float>(convRows + ch * numPixels, convRowsT + ch * numPixels, width, height,
+            width*sizeof(float), height*sizeof(float), TRANSPOSITION_BLOCK_SIZE);
+    }
 
     // Convolve columns (now: rows, since we are using 'convRowsT' as source)
     #pragma omp parallel for
     for (int y = 0; y < width; y++)
     {
-        // Perform forward filtering
-        YvVFilterValues(&convRowsT[y*height], output.row(y), height, 1, b0inv, b1, b2, b3, B);
-        // Perform backward filtering
-        YvVFilterValues(output.row(y), output.row(y), height, -1, b0inv, b1, b2, b3, B);
+        if (IsCancelled(cancellation)) { continue; }
+
+        for (int ch0 = 0; ch0 < numChannels; ch0 += YVV_MAX_BATCH)
+        {
+            const int batchSize = std::min(YVV_MAX_BATCH, numChannels - ch0);
+            const float* src[YVV_MAX_BATCH];
+            float* dest[YVV_MAX_BATCH];
+            for (int i = 0; i < batchSize; i++)
+            {
+                src[i] = &convRowsT[(ch0 + i) * numPixels + static_cast<std::size_t>(y) * height];
+                auto output = outputs[ch0 + i];
+                dest[i] = output.row(y);
+            }
+
+            // Perform forward filtering
+            YvVFilterValuesBatched(src, dest, batchSize, height, 1, b0inv, b1, b2, b3, B);
+            // Perform backward filtering
+            YvVFilterValuesBatched(dest, dest, batchSize, height, -1, b0inv, b1, b2, b3, B);
+        }
     }
 }
 
@@ -158,7 +247,8 @@ void ConvolveSeparableTranspose(
     const float kernel[],
     int kernelRadius,
     float tempBuf1[],
-    float tempBuf2[]
+    float tempBuf2[],
+    const c_CancellationToken* cancellation
 )
 {
     // NOTE: The function uses only half of 'kernel' (it is symmetrical), but passing the whole array may simplify vectorization in the future.
@@ -179,6 +269,8 @@ void ConvolveSeparableTranspose(
         #pragma omp parallel for
         for (int y = 0; y < height; y++)
         {
+            if (IsCancelled(cancellation)) { continue; }
+
             Convolve1Dstep_OfsZero(input.row_const(y) + kernelRadius - 1,
                     convRows + kernelRadius - 1 + y*width,
                     width - 2 * (kernelRadius - 1),
@@ -194,6 +286,8 @@ void ConvolveSeparableTranspose(
         }
     }
 
+    if (IsCancelled(cancellation)) { return; }
+
     // For near-border elements assume the border values are replicated outside of array
     for (int y = 0; y < height; y++)
     {
@@ -260,6 +354,8 @@ void ConvolveSeparableTranspose(
 
     // Before convolving rest of the columns, perform a transposition so we can convolve rows instead (faster due to sequential memory access)
 
+    if (IsCancelled(cancellation)) { return; }
+
     float* convRowsT = tempBuf2;
     Transpose<float>(convRows, convRowsT, width, height, width * sizeof(float), height * sizeof(float), TRANSPOSITION_BLOCK_SIZE);
 
@@ -269,6 +365,8 @@ void ConvolveSeparableTranspose(
         #pragma omp parallel for
         for (int y = 0; y < width; y++)
         {
+            if (IsCancelled(cancellation)) { continue; }
+
             Convolve1Dstep_OfsZero(convRowsT + kernelRadius - 1 + y*height,
                 output.row(y) + kernelRadius - 1,
                 height - 2 * (kernelRadius - 1),
@@ -288,20 +386,28 @@ void ConvolveSeparableTranspose(
 }
 
 
-void ConvolveSeparable(
+/// Calculates convolution of 'input' with a Gaussian kernel using the specified method.
+static void ConvolveSeparable(
     c_PaddedArrayPtr<const float> input,
     c_PaddedArrayPtr<float> output,
-    float sigma
+    float sigma,
+    ConvolutionMethod method,
+    const c_CancellationToken* cancellation
 )
 {
     int width = input.width(), height = input.height();
     int kernelRadius = static_cast<int>(ceil(sigma * 3.0f));
 
+    if (method == ConvolutionMethod::AUTO)
+    {
+        method = (kernelRadius < YOUNG_VAN_VLIET_MIN_KERNEL_RADIUS) ? ConvolutionMethod::STANDARD : ConvolutionMethod::YOUNG_VAN_VLIET;
+    }
+
     std::unique_ptr<float[]> outputT(new float[input.height() * input.width()]); // transposed output
     std::unique_ptr<float[]> temp1(new float[input.width() * input.height()]);
     std::unique_ptr<float[]> temp2(new float[input.width() * input.height()]);
 
-    if (kernelRadius < YOUNG_VAN_VLIET_MIN_KERNEL_RADIUS)
+    if (method == ConvolutionMethod::STANDARD)
     {
         std::unique_ptr<float[]> kernel(new float[2 * kernelRadius - 1]);
         CalculateGaussianKernelProjection(kernel.get(), kernelRadius, sigma, true);
@@ -309,15 +415,243 @@ void ConvolveSeparable(
         ConvolveSeparableTranspose(
                 input,
                 c_PaddedArrayPtr<float>(outputT.get(), height, width),
-                kernel.get(), kernelRadius, temp1.get(), temp2.get());
+                kernel.get(), kernelRadius, temp1.get(), temp2.get(), cancellation);
     }
     else
     {
         ConvolveGaussianRecursiveTranspose(
                 input,
                 c_PaddedArrayPtr<float>(outputT.get(), height, width),
-                sigma, temp1.get(), temp2.get());
+                sigma, temp1.get(), temp2.get(), cancellation);
     }
 
+    if (IsCancelled(cancellation)) { return; }
+
     Transpose(outputT.get(), output.row(0), height, width, height*sizeof(float), output.GetBytesPerRow(), TRANSPOSITION_BLOCK_SIZE);
 }
+
+void ConvolveSeparable(
+    c_PaddedArrayPtr<const float> input,
+    c_PaddedArrayPtr<float> output,
+    float sigma,
+    const c_CancellationToken* cancellation
+)
+{
+    ConvolveSeparable(input, output, sigma, ConvolutionMethod::AUTO, cancellation);
+}
+
+void ConvolveSeparable(
+    const std::vector<c_PaddedArrayPtr<const float>>& inputs,
+    const std::vector<c_PaddedArrayPtr<float>>& outputs,
+    float sigma,
+    const c_CancellationToken* cancellation
+)
+{
+    IMPPG_ASSERT(!inputs.empty() && inputs.size() == outputs.size());
+
+    const int numChannels = static_cast<int>(inputs.size());
+    const int width = inputs[0].width(), height = inputs[0].height();
+    const std::size_t numPixels = static_cast<std::size_t>(width) * height;
+    const int kernelRadius = static_cast<int>(ceil(sigma * 3.0f));
+
+    if (numChannels == 1 || kernelRadius < YOUNG_VAN_VLIET_MIN_KERNEL_RADIUS)
+    {
+        for (int ch = 0; ch < numChannels; ch++)
+            ConvolveSeparable(inputs[ch], outputs[ch], sigma, ConvolutionMethod::AUTO, cancellation);
+        return;
+    }
+
+    std::unique_ptr<float[]> outputT(new float[numChannels * numPixels]); // transposed outputs
+    std::unique_ptr<float[]> temp1(new float[numChannels * numPixels]);
+    std::unique_ptr<float[]> temp2(new float[numChannels * numPixels]);
+
+    std::vector<c_PaddedArrayPtr<float>> outputsT;
+    for (int ch = 0; ch < numChannels; ch++)
+        outputsT.emplace_back(outputT.get() + ch * numPixels, height, width);
+
+    ConvolveGaussianRecursiveTranspose(inputs, outputsT, sigma, temp1.get(), temp2.get(), cancellation);
+    if (IsCancelled(cancellation)) { return; }
+
+    #pragma omp parallel for
+    for (int ch = 0; ch < numChannels; ch++)
+    {
+        auto output = outputs[ch];
+        Transpose(outputT.get() + ch * numPixels, output.row(0), height, width, height*sizeof(float), output.GetBytesPerRow(), TRANSPOSITION_BLOCK_SIZE);
+    }
+}
+
+namespace
+{
+
+/// Weights of the anti-aliasing filter applied before 2x decimation.
+constexpr float DECIMATION_FILTER[4] = { 1.0f/8, 3.0f/8, 3.0f/8, 1.0f/8 };
+
+/// Variance of DECIMATION_FILTER (in pixels of the finer level).
+constexpr float DECIMATION_FILTER_VARIANCE = 0.75f;
+
+/// Mean variance introduced by bilinear upsampling (in pixels of the coarser level).
+constexpr float BILINEAR_UPSAMPLING_VARIANCE = 1.0f / 6;
+
+/// Minimum width and height of a decimated level.
+constexpr int PYRAMID_MIN_LEVEL_SIZE = 16;
+
+/// Minimum width and height of a decimated level, in multiples of the remaining sigma at that level.
+/** The border effects of a Gaussian blur reach about 3 sigma inwards from each side; the decimation stops
+    before they can cover more than half of the level, as the errors of border handling would then be magnified
+    by the upsampling to a large part of the output. */
+constexpr float PYRAMID_MIN_LEVEL_SIZE_IN_SIGMAS = 12.0f;
+
+struct PyramidLevel
+{
+    std::vector<float> pixels;
+    int width;
+    int height;
+};
+
+/// Filters 'input' with DECIMATION_FILTER and decimates it 2x in both directions.
+/** Element 'i' of the decimated level is centered between elements 2*i and 2*i+1 of 'input'.
+    Border values are assumed to be replicated outside of 'input'. */
+PyramidLevel Decimate(c_PaddedArrayPtr<const float> input)
+{
+    const int width = input.width();
+    const int height = input.height();
+    const int newWidth = (width + 1) / 2;
+    const int newHeight = (height + 1) / 2;
+
+    std::vector<float> decimatedRows(newWidth * height);
+    #pragma omp parallel for
+    for (int y = 0; y < height; y++)
+    {
+        const float* srcRow = input.row_const(y);
+        float* destRow = &decimatedRows[y * newWidth];
+        for (int x = 0; x < newWidth; x++)
+        {
+            float sum = 0.0f;
+            for (int i = 0; i < 4; i++)
+                sum += DECIMATION_FILTER[i] * srcRow[std::clamp(2 * x - 1 + i, 0, width - 1)];
+            destRow[x] = sum;
+        }
+    }
+
+    PyramidLevel result{std::vector<float>(newWidth * newHeight), newWidth, newHeight};
+    #pragma omp parallel for
+    for (int y = 0; y < newHeight; y++)
+    {
+        const float* srcRows[4];
+        for (int i = 0; i < 4; i++)
+            srcRows[i] = &decimatedRows[std::clamp(2 * y - 1 + i, 0, height - 1) * newWidth];
+
+        float* destRow = &result.pixels[y * newWidth];
+        for (int x = 0; x < newWidth; x++)
+        {
+            destRow[x] = DECIMATION_FILTER[0] * srcRows[0][x] + DECIMATION_FILTER[1] * srcRows[1][x] +
+                         DECIMATION_FILTER[2] * srcRows[2][x] + DECIMATION_FILTER[3] * srcRows[3][x];
+        }
+    }
+
+    return result;
+}
+
+/// Position of an output element within the decimated level used for bilinear interpolation.
+struct SamplePosition
+{
+    int idx0;
+    int idx1;
+    float weight1; ///< Weight of 'idx1'; weight of 'idx0' is 1 - weight1.
+};
+
+std::vector<SamplePosition> GetSamplePositions(int outputLength, int levelLength, int scale)
+{
+    std::vector<SamplePosition> positions(outputLength);
+    for (int i = 0; i < outputLength; i++)
+    {
+        const float pos = std::clamp((i + 0.5f) / scale - 0.5f, 0.0f, static_cast<float>(levelLength - 1));
+        const int idx0 = static_cast<int>(pos);
+        positions[i] = SamplePosition{idx0, std::min(idx0 + 1, levelLength - 1), pos - idx0};
+    }
+    return positions;
+}
+
+/// Bilinearly upsamples 'level' (decimated 'scale' times w.r.t. 'output') to 'output'.
+void Upsample(const PyramidLevel& level, int scale, c_PaddedArrayPtr<float> output)
+{
+    const std::vector<SamplePosition> colPositions = GetSamplePositions(output.width(), level.width, scale);
+    const std::vector<SamplePosition> rowPositions = GetSamplePositions(output.height(), level.height, scale);
+
+    #pragma omp parallel for
+    for (int y = 0; y < output.height(); y++)
+    {
+        const SamplePosition& rowPos = rowPositions[y];
+        const float* row0 = &level.pixels[rowPos.idx0 * level.width];
+        const float* row1 = &level.pixels[rowPos.idx1 * level.width];
+        float* destRow = output.row(y);
+
+        for (int x = 0; x < output.width(); x++)
+        {
+            const SamplePosition& colPos = colPositions[x];
+            const float top = row0[colPos.idx0] + colPos.weight1 * (row0[colPos.idx1] - row0[colPos.idx0]);
+            const float bottom = row1[colPos.idx0] + colPos.weight1 * (row1[colPos.idx1] - row1[colPos.idx0]);
+            destRow[x] = top + rowPos.weight1 * (bottom - top);
+        }
+    }
+}
+
+} // anonymous namespace
+
+void ConvolveSeparablePyramid(
+    c_PaddedArrayPtr<const float> input,
+    c_PaddedArrayPtr<float> output,
+    float sigma,
+    const c_CancellationToken* cancellation
+)
+{
+    // Remaining Gaussian variance to apply, in pixels of the current level.
+    float variance = sigma * sigma;
+    int scale = 1;
+
+    std::optional<PyramidLevel> level;
+    c_PaddedArrayPtr<const float> current = input;
+
+    // Decimate as long as the remaining sigma at the next level would not drop below GAUSSIAN_PYRAMID_MIN_SIGMA
+    // and the next level would not be too small (in absolute terms and relative to the remaining sigma).
+    while (true)
+    {
+        const float nextVariance = (variance - DECIMATION_FILTER_VARIANCE) / 4;
+        const int nextShortSide = (std::min(current.width(), current.height()) + 1) / 2;
+        if (nextVariance < GAUSSIAN_PYRAMID_MIN_SIGMA * GAUSSIAN_PYRAMID_MIN_SIGMA ||
+            nextShortSide < PYRAMID_MIN_LEVEL_SIZE ||
+            nextShortSide < PYRAMID_MIN_LEVEL_SIZE_IN_SIGMAS * std::sqrt(nextVariance))
+        {
+            break;
+        }
+
+        if (IsCancelled(cancellation)) { return; }
+
+        level = Decimate(current);
+        current = c_PaddedArrayPtr<const float>(level->pixels.data(), level->width, level->height);
+        variance = nextVariance;
+        scale *= 2;
+    }
+
+    if (!level.has_value())
+    {
+        ConvolveSeparable(input, output, sigma, cancellation);
+        return;
+    }
+
+    variance -= BILINEAR_UPSAMPLING_VARIANCE;
+
+    // Use the same method as ConvolveSeparable() would (the standard convolution's handling of borders is inaccurate
+    // for kernels comparable with the level's size, which is the case here), so that the borders are treated alike.
+    PyramidLevel blurred{std::vector<float>(level->width * level->height), level->width, level->height};
+    ConvolveSeparable(
+        current,
+        c_PaddedArrayPtr<float>(blurred.pixels.data(), blurred.width, blurred.height),
+        std::sqrt(variance),
+        ConvolutionMethod::AUTO,
+        cancellation
+    );
+    if (IsCancelled(cancellation)) { return; }
+
+    Upsample(blurred, scale, output);
+}
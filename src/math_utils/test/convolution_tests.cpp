@@ -0,0 +1,93 @@
+#include "math_utils/convolution.h"
+
+#include <algorithm>
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+namespace
+{
+
+/// Returns a `width` x `height` array with a bright disc (touching the borders of thin arrays) on a dark background.
+std::vector<float> CreateDisc(int width, int height)
+{
+    std::vector<float> values(width * height);
+    const float radius = std::min(width, height) / 3.0f;
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            values[y * width + x] = (std::hypot(x - width / 2.0f, y - height / 2.0f) < radius) ? 0.9f : 0.1f;
+        }
+    }
+    return values;
+}
+
+struct BlurDifference
+{
+    float whole;
+    float interior; ///< Excluding the 3 sigma wide border.
+};
+
+BlurDifference CompareWithConvolveSeparable(int width, int height, float sigma)
+{
+    const std::vector<float> input = CreateDisc(width, height);
+    std::vector<float> expected(input.size());
+    std::vector<float> actual(input.size());
+    ConvolveSeparable(
+        c_PaddedArrayPtr<const float>(input.data(), width, height),
+        c_PaddedArrayPtr<float>(expected.data(), width, height),
+        sigma
+    );
+    ConvolveSeparablePyramid(
+        c_PaddedArrayPtr<const float>(input.data(), width, height),
+        c_PaddedArrayPtr<float>(actual.data(), width, height),
+        sigma
+    );
+
+    const int margin = static_cast<int>(std::ceil(3 * sigma));
+    BlurDifference diff{0.0f, 0.0f};
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            const float d = std::abs(actual[y * width + x] - expected[y * width + x]);
+            diff.whole = std::max(diff.whole, d);
+            if (x >= margin && x < width - margin && y >= margin && y < height - margin)
+            {
+                diff.interior = std::max(diff.interior, d);
+            }
+        }
+    }
+    return diff;
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(PyramidBlurMatchesConvolveSeparable)
+{
+    // square, thin (in both directions) and odd sizes; the disc's amplitude is 0.8
+    for (const auto& size: { std::pair{400, 400}, {1000, 131}, {131, 1000}, {255, 97}, {1001, 67}, {301, 1999} })
+    {
+        for (const float sigma: { 10.0f, 20.0f, 40.0f })
+        {
+            BOOST_TEST_CONTEXT(size.first << "x" << size.second << ", sigma = " << sigma)
+            {
+                const BlurDifference diff = CompareWithConvolveSeparable(size.first, size.second, sigma);
+                BOOST_CHECK_SMALL(diff.interior, 0.03f);
+                BOOST_CHECK_SMALL(diff.whole, 0.06f);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(PyramidBlurWithSmallSigmaEqualsConvolveSeparable)
+{
+    constexpr int WIDTH = 257;
+    constexpr int HEIGHT = 130;
+    const float sigma = 0.9f * GAUSSIAN_PYRAMID_MIN_SIGMA;
+
+    const BlurDifference diff = CompareWithConvolveSeparable(WIDTH, HEIGHT, sigma);
+    BOOST_CHECK_EQUAL(0.0f, diff.whole);
+}
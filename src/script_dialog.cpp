@@ -76,15 +76,19 @@ c_ScriptDialog::c_ScriptDialog(wxWindow* parent)
     {
     case BackEnd::CPU_AND_BITMAPS:
         m_Processor = std::make_unique<scripting::ScriptImageProcessor>(
-            imppg::backend::CreateCpuBmpProcessingBackend(),
-            nfv
+            []() { return imppg::backend::CreateCpuBmpProcessingBackend(Configuration::UnsharpMaskBlurPyramid); },
+            Configuration::ScriptProcessingWorkers,
+            nfv,
+            static_cast<std::size_t>(Configuration::ScriptProcessingMemoryLimitMiB) << 20
         );
         break;
 
 #if USE_OPENGL_BACKEND
     case BackEnd::GPU_OPENGL:
+        // all OpenGL processing is serialized by the GPU anyway
         m_Processor = std::make_unique<scripting::ScriptImageProcessor>(
-            imppg::backend::CreateOpenGLProcessingBackend(Configuration::LRCmdBatchSizeMpixIters),
+            []() { return imppg::backend::CreateOpenGLProcessingBackend(Configuration::LRCmdBatchSizeMpixIters); },
+            1,
             nfv
         );
         break;
@@ -185,8 +189,8 @@ void c_ScriptDialog::OnRunScript(wxCommandEvent&)
     m_Console->AppendText(wxString::Format(_("Running script %s..."), scriptPath) + "\n");
 
     auto scriptStream = std::make_unique<std::ifstream>(scriptPath.ToStdString().c_str(), std::ios::binary);
-    m_StopScript = std::make_unique<std::promise<void>>();
-    m_Runner = std::make_unique<ScriptRunner>(std::move(scriptStream), *this, m_StopScript->get_future());
+    m_ScriptSignal = std::make_shared<scripting::ScriptSignal>();
+    m_Runner = std::make_unique<ScriptRunner>(std::move(scriptStream), *this, m_ScriptSignal);
     m_Runner->Run();
     m_BtnRun->Disable();
     m_BtnStop->Enable();
@@ -210,10 +214,16 @@ void c_ScriptDialog::OnStopScript(wxCommandEvent&)
 {
     m_BtnStop->Disable();
     m_BtnTogglePause->Disable();
-    try { m_StopScript->set_value(); } catch (...) {}
+    StopScript();
     m_Console->AppendText(_("Waiting for the script to stop...") + "\n");
 }
 
+void c_ScriptDialog::StopScript()
+{
+    m_ScriptSignal->RequestStop();
+    m_Processor->CancelPendingRequests(_("script interrupted by user").ToStdString());
+}
+
 void c_ScriptDialog::OnClose(wxCloseEvent& event)
 {
     if (IsRunnerActive() && event.CanVeto())
@@ -226,7 +236,7 @@ void c_ScriptDialog::OnClose(wxCloseEvent& event)
                 wxICON_QUESTION | wxYES_NO
             ) == wxYES)
             {
-                try { m_StopScript->set_value(); } catch (...) {}
+                StopScript();
                 m_CloseAfterRunnerEnds = true;
                 m_BtnStop->Disable();
             }
@@ -288,6 +298,13 @@ void c_ScriptDialog::OnRunnerMessage(wxThreadEvent& event)
         },
 
         [&](const auto& contents) {
+            if (m_ScriptSignal->IsStopRequested())
+            {
+                // the script has not noticed the stop request yet; do not start anything new for it
+                payload.SignalCompletion(scripting::call_result::Error{_("script interrupted by user").ToStdString()});
+                return;
+            }
+
             // we need to make a copy first, because in `StartProcessing` invocation we also move from `payload`,
             // and function argument evaluation order is unspecified
             scripting::MessageContents contentsCopy = contents;
@@ -28,7 +28,6 @@ File description:
 #include "scripting/script_runner.h"
 #include "scrollable_dlg.h"
 
-#include <future>
 #include <memory>
 
 #include <wx/dialog.h>
@@ -61,6 +60,8 @@ private:
     void OnStopScript(wxCommandEvent&);
     void OnRunnerMessage(wxThreadEvent& event);
     void OnTogglePause(wxCommandEvent&);
+    /// Requests the script runner to stop and drops its requests which have not been started yet.
+    void StopScript();
 
     wxFilePickerCtrl* m_ScriptFileCtrl{nullptr};
     wxStaticText* m_ScriptFilePath{nullptr};
@@ -73,7 +74,7 @@ private:
     wxTimer m_ProgressTimer;
 
     bool m_CloseAfterRunnerEnds{false};
-    std::unique_ptr<std::promise<void>> m_StopScript;
+    std::shared_ptr<scripting::ScriptSignal> m_ScriptSignal;
     std::unique_ptr<scripting::ScriptImageProcessor> m_Processor;
 };
 
@@ -24,16 +24,21 @@ File description:
 #pragma once
 
 #include "alignment/align_proc.h"
+#include "alignment/quality.h"
 #include "common/formats.h"
 #include "common/proc_settings.h"
 #include "image/image.h"
 #include "scripting/script_exceptions.h"
 
+#include <condition_variable>
+#include <cstddef>
 #include <filesystem>
 #include <future>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <variant>
+#include <vector>
 
 namespace scripting
 {
@@ -57,18 +62,35 @@ struct AlignRGB
     std::optional<c_Image> red, green, blue;
 };
 
+struct EstimateQuality
+{
+    AlignmentInputs inputs;
+    QualityMetric metric;
+};
+
 struct ProcessImageFile
 {
     std::string imagePath;
     std::string settingsPath;
     std::string outputImagePath;
     OutputFormat outputFormat;
+    int priority{0}; ///< Requests with higher priority are started first.
 };
 
 struct ProcessImage
 {
     std::shared_ptr<const c_Image> image;
     ProcessingSettings settings;
+    int priority{0}; ///< Requests with higher priority are started first.
+};
+
+struct AlignAndStack
+{
+    AlignmentInputs inputs;
+    AlignmentMethod alignMode;
+    CropMode cropMode;
+    bool subpixelAlignment;
+    StackingMode stackingMode;
 };
 
 struct AlignImages
@@ -85,9 +107,11 @@ struct AlignImages
 }
 
 using MessageContents = std::variant<
+    contents::AlignAndStack,
     contents::AlignImages,
     contents::AlignRGB,
     contents::Error,
+    contents::EstimateQuality,
     contents::None,
     contents::NotifyBoolean,
     contents::NotifyImage,
@@ -106,14 +130,86 @@ namespace call_result
 struct Success {};
 struct ImageProcessed { std::shared_ptr<c_Image> image; };
 struct Error { std::string message; };
+struct QualityEstimated { std::vector<float> qualities; };
 }
 
 using FunctionCallResult = std::variant<
     call_result::Success,
     call_result::ImageProcessed,
-    call_result::Error
+    call_result::Error,
+    call_result::QualityEstimated
 >;
 
+/// Shared by a script runner's worker thread and its parent.
+///
+/// Lets the parent request stopping the script, and the worker thread wait (without polling) until a function call
+/// completes or stopping is requested, whichever comes first.
+///
+class ScriptSignal
+{
+public:
+    void RequestStop()
+    {
+        {
+            std::lock_guard lock{m_Mutex};
+            m_StopRequested = true;
+        }
+        m_Condition.notify_all();
+    }
+
+    bool IsStopRequested() const
+    {
+        std::lock_guard lock{m_Mutex};
+        return m_StopRequested;
+    }
+
+    /// Called by the worker thread before sending a function call to the parent.
+    void OnCallStarted()
+    {
+        std::lock_guard lock{m_Mutex};
+        ++m_NumCallsInProgress;
+    }
+
+    /// Called after a function call's result has been provided (or the call has been dropped).
+    void OnCallCompleted()
+    {
+        {
+            std::lock_guard lock{m_Mutex};
+            --m_NumCallsInProgress;
+        }
+        m_Condition.notify_all();
+    }
+
+    /// Waits until `condition` returns true or stopping is requested; `condition` is checked after each completed call.
+    ///
+    /// @return `false` if stopping has been requested.
+    ///
+    template<typename Condition>
+    bool WaitUntil(Condition condition)
+    {
+        std::unique_lock lock{m_Mutex};
+        m_Condition.wait(lock, [&] { return m_StopRequested || condition(); });
+        return !m_StopRequested;
+    }
+
+    /// Waits until fewer than `maxCalls` function calls are in progress or stopping is requested.
+    ///
+    /// @return `false` if stopping has been requested.
+    ///
+    bool WaitForFreeCallSlot(std::size_t maxCalls)
+    {
+        std::unique_lock lock{m_Mutex};
+        m_Condition.wait(lock, [&] { return m_StopRequested || m_NumCallsInProgress < maxCalls; });
+        return !m_StopRequested;
+    }
+
+private:
+    mutable std::mutex m_Mutex;
+    std::condition_variable m_Condition;
+    bool m_StopRequested{false};
+    std::size_t m_NumCallsInProgress{0};
+};
+
 /// Payload of messages sent by script runner's worker thread to parent.
 ///
 /// The default constructor and fake copying - which in fact moves - are required due to `wxThreadEvent`'s needs.
@@ -125,10 +221,20 @@ public:
     : m_Contents(contents::None{})
     {}
 
-    ScriptMessagePayload(MessageContents&& contents, std::promise<FunctionCallResult>&& completion = {})
-    : m_Contents(std::move(contents)), m_Completion(std::move(completion))
+    ScriptMessagePayload(
+        MessageContents&& contents,
+        std::promise<FunctionCallResult>&& completion = {},
+        std::shared_ptr<ScriptSignal> signal = {} ///< If set, notified of completion.
+    )
+    : m_Contents(std::move(contents)), m_Completion(std::move(completion)), m_Signal(std::move(signal))
     {}
 
+    ~ScriptMessagePayload()
+    {
+        // the call has been dropped without completion (its future reports a broken promise)
+        if (m_Signal) { m_Signal->OnCallCompleted(); }
+    }
+
     ScriptMessagePayload(const ScriptMessagePayload& other)
     {
         if (&other != this)
@@ -151,13 +257,23 @@ public:
 
     const MessageContents& GetContents() const { return m_Contents; }
 
-    void SignalCompletion(FunctionCallResult&& result) { m_Completion.set_value(std::move(result)); }
+    void SignalCompletion(FunctionCallResult&& result)
+    {
+        m_Completion.set_value(std::move(result));
+        if (m_Signal)
+        {
+            m_Signal->OnCallCompleted();
+            m_Signal.reset();
+        }
+    }
 
 private:
     MessageContents m_Contents;
 
     /// Empty for certain kinds of `MessageContents`; the receiver must then not call `SignalCompletion`.
     std::promise<FunctionCallResult> m_Completion;
+
+    std::shared_ptr<ScriptSignal> m_Signal;
 };
 
 }
@@ -27,8 +27,11 @@ File description:
 #include "scripting/interop.h"
 
 #include <functional>
+#include <cstddef>
 #include <memory>
 #include <optional>
+#include <string>
+#include <vector>
 #include <wx/event.h>
 
 class c_ImageAlignmentWorkerThread;
@@ -37,35 +40,86 @@ namespace scripting
 {
 
 /// Handles script-made image processing requests; runs in the main thread.
+///
+/// Image processing requests are distributed over a pool of processing back ends, so that independent
+/// requests (e.g., from asynchronous script calls) run in parallel. Requests which cannot be started
+/// immediately are queued and dispatched by priority, then in order of submission. Alignment requests
+/// are executed one at a time.
+///
 class ScriptImageProcessor
 {
 public:
+    using ProcessorFactory = std::function<std::unique_ptr<imppg::backend::IProcessingBackEnd>()>;
+
     ScriptImageProcessor(
-        std::unique_ptr<imppg::backend::IProcessingBackEnd>&& processor,
-        bool normalizeFitsValues
+        ProcessorFactory processorFactory,
+        std::size_t numWorkers, ///< Number of back ends created (at least 1).
+        bool normalizeFitsValues,
+        /// Max estimated memory (in bytes) of requests being processed at the same time; 0 means no limit.
+        /// A request is always started if nothing else is being processed.
+        std::size_t memoryLimit = 0
     );
 
     ~ScriptImageProcessor();
 
+    /// Starts processing immediately or queues the request if no back end is available.
     void StartProcessing(
         MessageContents request,
         std::function<void(FunctionCallResult)> onCompletion ///< Receives error message on error.
     );
 
+    /// Completes all requests which have not been started yet with `errorMessage` (requests being processed
+    /// are allowed to finish).
+    void CancelPendingRequests(const std::string& errorMessage);
+
     void OnIdle(wxIdleEvent& event);
 
 private:
     using CompletionFunc = std::function<void(FunctionCallResult)>;
 
-    void OnProcessImageFile(const contents::ProcessImageFile& call, CompletionFunc onCompletion);
-    void OnProcessImage(const contents::ProcessImage& call, CompletionFunc onCompletion);
+    using ProcessorPtr = std::unique_ptr<imppg::backend::IProcessingBackEnd>;
+
+    struct PendingRequest
+    {
+        MessageContents request;
+        CompletionFunc onCompletion;
+        int priority;
+        std::size_t seqNumber; ///< Determines order of requests with equal priority.
+        std::size_t estimatedMemory; ///< In bytes.
+    };
+
+    struct Worker
+    {
+        ProcessorPtr processor;
+        bool busy{false};
+    };
+
+    static bool ComparePendingRequests(const PendingRequest& r1, const PendingRequest& r2);
+
+    /// Starts as many pending requests as there are available back ends (and memory).
+    void DispatchRequests();
+
+    void OnProcessImageFile(const contents::ProcessImageFile& call, CompletionFunc onCompletion, ProcessorPtr& processor);
+    void OnProcessImage(const contents::ProcessImage& call, CompletionFunc onCompletion, ProcessorPtr& processor);
     void OnAlignRGB(const contents::AlignRGB& call, CompletionFunc onCompletion);
     void OnAlignImages(const contents::AlignImages& call, CompletionFunc onCompletion);
+    void OnAlignAndStack(const contents::AlignAndStack& call, CompletionFunc onCompletion);
+    void OnEstimateQuality(const contents::EstimateQuality& call, CompletionFunc onCompletion);
 
-    std::unique_ptr<imppg::backend::IProcessingBackEnd> m_Processor;
+    std::vector<Worker> m_Workers;
     bool m_NormalizeFitsValues{false};
     std::unique_ptr<c_ImageAlignmentWorkerThread> m_AlignmentWorker;
     std::unique_ptr<wxEvtHandler> m_AlignmentEvtHandler;
+    std::unique_ptr<c_QualityEstimationWorkerThread> m_QualityWorker;
+    std::unique_ptr<wxEvtHandler> m_QualityEvtHandler;
+    bool m_AlignmentInProgress{false};
+
+    /// Heap ordered by `PendingRequest::priority`, then `seqNumber`.
+    std::vector<PendingRequest> m_PendingRequests;
+    std::size_t m_NextSeqNumber{0};
+
+    std::size_t m_MemoryLimit{0};
+    std::size_t m_MemoryInUse{0};
 };
 
 }
@@ -23,8 +23,9 @@ File description:
 
 #pragma once
 
+#include "scripting/interop.h"
+
 #include <istream>
-#include <future>
 #include <memory>
 #include <wx/event.h>
 #include <wx/string.h>
@@ -36,7 +37,8 @@ namespace scripting
 class ScriptRunner: public wxThread
 {
 public:
-    ScriptRunner(std::unique_ptr<std::istream> script, wxEvtHandler& parent, std::future<void>&& stopRequested);
+    /// @param signal Used by the parent to request stopping the script.
+    ScriptRunner(std::unique_ptr<std::istream> script, wxEvtHandler& parent, std::shared_ptr<ScriptSignal> signal);
     ~ScriptRunner();
 
 private:
@@ -44,7 +46,7 @@ private:
 
     std::unique_ptr<std::istream> m_Script;
     wxEvtHandler& m_Parent;
-    std::future<void> m_StopRequested;
+    std::shared_ptr<ScriptSignal> m_Signal;
 };
 
 }
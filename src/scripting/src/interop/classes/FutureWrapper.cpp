@@ -0,0 +1,45 @@
+#include "interop/classes/FutureWrapper.h"
+#include "interop/classes/ImageWrapper.h"
+#include "interop/state.h"
+#include "scripting/script_exceptions.h"
+
+#include <chrono>
+
+namespace scripting
+{
+
+FutureWrapper::FutureWrapper(std::future<FunctionCallResult>&& future)
+: m_Future(future.share())
+{}
+
+bool FutureWrapper::is_ready() const
+{
+    return m_Future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+const FunctionCallResult& FutureWrapper::GetResult() const
+{
+    return m_Future.get();
+}
+
+int FutureWrapper::wait(lua_State* lua)
+{
+    g_State->WaitUntil([this] { return is_ready(); });
+    const FunctionCallResult& result = GetResult();
+
+    if (const auto* error = std::get_if<call_result::Error>(&result))
+    {
+        throw ScriptExecutionError(error->message);
+    }
+    else if (const auto* processedImg = std::get_if<call_result::ImageProcessed>(&result))
+    {
+        new(PrepareObject<ImageWrapper>(lua)) ImageWrapper(processedImg->image);
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+}
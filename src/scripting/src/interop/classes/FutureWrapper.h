@@ -0,0 +1,51 @@
+#pragma once
+
+#include "interop/classes/method.h"
+#include "scripting/interop.h"
+
+#include <future>
+#include <lua.hpp>
+
+namespace scripting
+{
+
+/// Result of an asynchronous function call (e.g., `imppg.process_image_async`).
+class FutureWrapper
+{
+public:
+    FutureWrapper(std::future<FunctionCallResult>&& future);
+
+    static const luaL_Reg* GetMethods()
+    {
+        static const luaL_Reg methods[] = {
+            {"wait", [](lua_State* lua) -> int {
+                return GetObject<FutureWrapper>(lua)->wait(lua);
+            }},
+
+            {"is_ready", [](lua_State* lua) {
+                return ConstMethodBoolResult<FutureWrapper>(lua, &FutureWrapper::is_ready);
+            }},
+
+            {nullptr, nullptr} // end-of-data marker
+        };
+
+        return methods;
+    }
+
+    bool is_ready() const;
+
+    /// Waits for completion and pushes the call's result (if any) onto the Lua stack; throws on error
+    /// or if stopping the script is requested.
+    ///
+    /// @return Number of values pushed.
+    ///
+    int wait(lua_State* lua);
+
+    /// Waits for completion (regardless of stop requests); does not throw.
+    const FunctionCallResult& GetResult() const;
+
+private:
+    std::shared_future<FunctionCallResult> m_Future;
+};
+
+}
@@ -9,7 +9,7 @@
 namespace scripting
 {
 
-ImageWrapper::ImageWrapper(const std::shared_ptr<const c_Image>& image)
+ImageWrapper::ImageWrapper(const std::shared_ptr<c_Image>& image)
 : m_Image(image)
 {}
 
@@ -32,11 +32,33 @@ ImageWrapper::ImageWrapper(c_Image&& image)
     m_Image = std::make_shared<c_Image>(std::move(image));
 }
 
-const std::shared_ptr<const c_Image>& ImageWrapper::GetImage() const
+std::shared_ptr<const c_Image> ImageWrapper::GetImage() const
 {
     return m_Image;
 }
 
+c_Image& ImageWrapper::GetMutableImage()
+{
+    // Other owners can only release the image concurrently (never acquire it), so if we are the only owner
+    // now, we remain so.
+    if (m_Image.use_count() > 1)
+    {
+        m_Image = std::make_shared<c_Image>(*m_Image);
+    }
+
+    return *m_Image;
+}
+
+void ImageWrapper::CheckCompatible(const ImageWrapper& other, const char* operation) const
+{
+    if (other.m_Image->GetPixelFormat() != m_Image->GetPixelFormat() ||
+        other.m_Image->GetWidth() != m_Image->GetWidth() ||
+        other.m_Image->GetHeight() != m_Image->GetHeight())
+    {
+        throw ScriptExecutionError{std::string{operation} + ": images differ in size or number of channels"};
+    }
+}
+
 void ImageWrapper::save(const std::string& path, int outputFormat) const
 {
     if (outputFormat < 0 || outputFormat >= static_cast<int>(OutputFormat::LAST))
@@ -61,9 +83,61 @@ void ImageWrapper::align_rgb()
     auto* alignedImg = std::get_if<call_result::ImageProcessed>(&result);
     IMPPG_ASSERT(alignedImg != nullptr);
 
-    m_Image = std::make_shared<const c_Image>(alignedImg->image->GetConvertedPixelFormatSubImage(
+    m_Image = std::make_shared<c_Image>(alignedImg->image->GetConvertedPixelFormatSubImage(
         m_Image->GetPixelFormat(), 0, 0, m_Image->GetWidth(), m_Image->GetHeight()
     ));
 }
 
+void ImageWrapper::add(const ImageWrapper& other)
+{
+    CheckCompatible(other, "add");
+    GetMutableImage().Add(*other.m_Image);
+}
+
+void ImageWrapper::subtract(const ImageWrapper& other)
+{
+    CheckCompatible(other, "subtract");
+    GetMutableImage().Subtract(*other.m_Image);
+}
+
+void ImageWrapper::multiply(const ImageWrapper& other)
+{
+    CheckCompatible(other, "multiply");
+    GetMutableImage().Multiply(*other.m_Image);
+}
+
+void ImageWrapper::divide(const ImageWrapper& other)
+{
+    CheckCompatible(other, "divide");
+    GetMutableImage().Divide(*other.m_Image);
+}
+
+void ImageWrapper::scale(double factor)
+{
+    GetMutableImage().Scale(static_cast<float>(factor));
+}
+
+void ImageWrapper::clamp(double minValue, double maxValue)
+{
+    if (minValue > maxValue)
+    {
+        throw ScriptExecutionError{"clamp: minimum is greater than maximum"};
+    }
+    GetMutableImage().Clamp(static_cast<float>(minValue), static_cast<float>(maxValue));
+}
+
+void ImageWrapper::crop(int x, int y, int width, int height)
+{
+    if (x < 0 || y < 0 || width <= 0 || height <= 0 ||
+        x + width > static_cast<int>(m_Image->GetWidth()) ||
+        y + height > static_cast<int>(m_Image->GetHeight()))
+    {
+        throw ScriptExecutionError{"crop: invalid area"};
+    }
+
+    m_Image = std::make_shared<c_Image>(m_Image->GetConvertedPixelFormatSubImage(
+        m_Image->GetPixelFormat(), x, y, width, height
+    ));
+}
+
 }
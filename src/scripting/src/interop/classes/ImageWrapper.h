@@ -16,7 +16,7 @@ class ImageWrapper
 public:
     ImageWrapper(const std::string& imagePath);
 
-    ImageWrapper(const std::shared_ptr<const c_Image>& image);
+    ImageWrapper(const std::shared_ptr<c_Image>& image);
 
     ImageWrapper(c_Image&& image);
 
@@ -31,20 +31,69 @@ public:
                 return MethodNoResult<ImageWrapper>(lua, &ImageWrapper::align_rgb);
             }},
 
+            {"add", [](lua_State* lua) -> int {
+                return MethodObjectArg<ImageWrapper, ImageWrapper>(lua, &ImageWrapper::add);
+            }},
+
+            {"subtract", [](lua_State* lua) -> int {
+                return MethodObjectArg<ImageWrapper, ImageWrapper>(lua, &ImageWrapper::subtract);
+            }},
+
+            {"multiply", [](lua_State* lua) -> int {
+                return MethodObjectArg<ImageWrapper, ImageWrapper>(lua, &ImageWrapper::multiply);
+            }},
+
+            {"divide", [](lua_State* lua) -> int {
+                return MethodObjectArg<ImageWrapper, ImageWrapper>(lua, &ImageWrapper::divide);
+            }},
+
+            {"scale", [](lua_State* lua) -> int {
+                return MethodDoubleArg<ImageWrapper>(lua, &ImageWrapper::scale);
+            }},
+
+            {"clamp", [](lua_State* lua) -> int {
+                return MethodDoubleDoubleArg<ImageWrapper>(lua, &ImageWrapper::clamp);
+            }},
+
+            {"crop", [](lua_State* lua) -> int {
+                return MethodIntIntIntIntArg<ImageWrapper>(lua, &ImageWrapper::crop);
+            }},
+
             {nullptr, nullptr} // end-of-data marker
         };
 
         return methods;
     }
 
-    const std::shared_ptr<const c_Image>& GetImage() const;
+    std::shared_ptr<const c_Image> GetImage() const;
 
     void save(const std::string& path, int outputFormat) const;
 
     void align_rgb();
 
+    void add(const ImageWrapper& other);
+
+    void subtract(const ImageWrapper& other);
+
+    void multiply(const ImageWrapper& other);
+
+    void divide(const ImageWrapper& other);
+
+    void scale(double factor);
+
+    void clamp(double minValue, double maxValue);
+
+    void crop(int x, int y, int width, int height);
+
 private:
-    std::shared_ptr<const c_Image> m_Image;
+    /// May be shared with other wrappers and with image processing requests; modified only via `GetMutableImage`.
+    std::shared_ptr<c_Image> m_Image;
+
+    /// Returns the image for in-place modification; if it is shared, a private copy is made first.
+    c_Image& GetMutableImage();
+
+    /// Throws if `other` cannot be combined pixel-by-pixel with this image.
+    void CheckCompatible(const ImageWrapper& other, const char* operation) const;
 };
 
 }
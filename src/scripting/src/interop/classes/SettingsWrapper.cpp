@@ -1,5 +1,6 @@
 #include "interop/classes/SettingsWrapper.h"
 #include "scripting/script_exceptions.h"
+#include "settings_cache.h"
 
 #include <boost/lexical_cast.hpp>
 
@@ -17,7 +18,7 @@ std::string blc(const T& t) { return boost::lexical_cast<std::string>(t); }
 
 SettingsWrapper::SettingsWrapper(const std::string& path)
 {
-    const auto settings = LoadSettings(path);
+    const auto settings = GetSettingsCache().Load(path);
     if (!settings.has_value())
     {
         throw ScriptExecutionError(wxString::Format("failed to load settings from %s", path).ToStdString());
@@ -106,6 +107,26 @@ void SettingsWrapper::lr_deconv_deringing(bool enabled)
     m_Settings.LucyRichardson.deringing.enabled = enabled;
 }
 
+bool SettingsWrapper::get_luminance_only() const
+{
+    return m_Settings.color.luminanceOnly;
+}
+
+void SettingsWrapper::luminance_only(bool enabled)
+{
+    m_Settings.color.luminanceOnly = enabled;
+}
+
+bool SettingsWrapper::get_chroma_denoise() const
+{
+    return m_Settings.color.chromaDenoise;
+}
+
+void SettingsWrapper::chroma_denoise(bool enabled)
+{
+    m_Settings.color.chromaDenoise = enabled;
+}
+
 bool SettingsWrapper::get_unsh_mask_adaptive(int index) const
 {
     if (index < 0 || static_cast<std::size_t>(index) >= m_Settings.unsharpMask.size())
@@ -35,6 +35,12 @@ public:
     bool get_lr_deconv_deringing() const;
     void lr_deconv_deringing(bool enabled);
 
+    bool get_luminance_only() const;
+    void luminance_only(bool enabled);
+
+    bool get_chroma_denoise() const;
+    void chroma_denoise(bool enabled);
+
     bool get_unsh_mask_adaptive(int index) const;
     void unsh_mask_adaptive(int index, bool enabled);
 
@@ -110,6 +116,22 @@ public:
                 return MethodBoolArg<SettingsWrapper>(lua, &SettingsWrapper::lr_deconv_deringing);
             }},
 
+            {"get_luminance_only", [](lua_State* lua) {
+                return ConstMethodBoolResult<SettingsWrapper>(lua, &SettingsWrapper::get_luminance_only);
+            }},
+
+            {"luminance_only", [](lua_State* lua) {
+                return MethodBoolArg<SettingsWrapper>(lua, &SettingsWrapper::luminance_only);
+            }},
+
+            {"get_chroma_denoise", [](lua_State* lua) {
+                return ConstMethodBoolResult<SettingsWrapper>(lua, &SettingsWrapper::get_chroma_denoise);
+            }},
+
+            {"chroma_denoise", [](lua_State* lua) {
+                return MethodBoolArg<SettingsWrapper>(lua, &SettingsWrapper::chroma_denoise);
+            }},
+
             {"get_unsh_mask_adaptive", [](lua_State* lua) {
                 return ConstMethodIntArgBoolResult<SettingsWrapper>(lua, &SettingsWrapper::get_unsh_mask_adaptive);
             }},
@@ -144,6 +144,22 @@ int MethodIntDoubleDoubleArg(lua_State* lua, void (T::* method)(int, double, dou
     return 0;
 }
 
+template<typename T>
+int MethodIntIntIntIntArg(lua_State* lua, void (T::* method)(int, int, int, int))
+{
+    auto* object = GetObject<T>(lua);
+    (object->*method)(GetInteger(lua, 2), GetInteger(lua, 3), GetInteger(lua, 4), GetInteger(lua, 5));
+    return 0;
+}
+
+template<typename T, typename U>
+int MethodObjectArg(lua_State* lua, void (T::* method)(const U&))
+{
+    auto* object = GetObject<T>(lua);
+    (object->*method)(GetObject<U>(lua, 2));
+    return 0;
+}
+
 template<typename T>
 int ConstMethodStringIntArg(lua_State* lua, void (T::* method)(const std::string&, int) const)
 {
@@ -26,11 +26,13 @@ File description:
 #include "interop/classes/SettingsWrapper.h"
 #include "interop/classes/DummyObject1.h"
 #include "interop/classes/DummyObject2.h"
+#include "interop/classes/FutureWrapper.h"
 #include "interop/modules/imppg_filesystem.h"
 #include "interop/modules/imppg_test.h"
 #include "interop/modules/imppg.h"
 #include "interop/state.h"
 #include "scripting/interop.h"
+#include "settings_cache.h"
 
 #include <functional>
 #include <lua.hpp>
@@ -154,9 +156,10 @@ public:
 
 } // end of private definitions
 
-void Prepare(lua_State* lua, wxEvtHandler& parent, std::future<void>&& stopRequested)
+void Prepare(lua_State* lua, wxEvtHandler& parent, std::shared_ptr<ScriptSignal> signal)
 {
-    g_State = std::make_unique<State>(parent, std::move(stopRequested));
+    g_State = std::make_unique<State>(parent, std::move(signal));
+    GetSettingsCache().ResetCounters();
 
     BEGIN_MODULE("imppg", scripting::modules::imppg);
         BEGIN_SUBMODULE("filesystem", scripting::modules::imppg::filesystem);
@@ -170,6 +173,7 @@ void Prepare(lua_State* lua, wxEvtHandler& parent, std::future<void>&& stopReque
 
     RegisterClass<DummyObject1>(lua);
     RegisterClass<DummyObject2>(lua);
+    RegisterClass<FutureWrapper>(lua);
     RegisterClass<ImageWrapper>(lua);
     RegisterClass<SettingsWrapper>(lua);
 
@@ -1,12 +1,14 @@
-#include <future>
+#include "scripting/interop.h"
+
 #include <lua.hpp>
+#include <memory>
 #include <wx/event.h>
 
 namespace scripting
 {
 
 /// Prepares interop for script execution.
-void Prepare(lua_State* lua, wxEvtHandler& parent, std::future<void>&& stopRequested);
+void Prepare(lua_State* lua, wxEvtHandler& parent, std::shared_ptr<ScriptSignal> signal);
 
 /// Cleans up interop state.
 void Finish();
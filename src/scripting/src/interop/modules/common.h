@@ -36,6 +36,23 @@ bool GetBoolean(lua_State* lua, int stackPos);
 
 std::vector<std::string> GetStringTable(lua_State* lua, int stackPos);
 
+/// Returns pointers to objects stored in a table (array) at `stackPos`; they remain valid as long as the table does.
+template<typename T>
+std::vector<T*> GetObjectTable(lua_State* lua, int stackPos)
+{
+    luaL_checktype(lua, stackPos, LUA_TTABLE);
+    const std::size_t len = lua_rawlen(lua, stackPos);
+    std::vector<T*> result;
+    result.reserve(len);
+    for (std::size_t i = 1; i <= len; ++i)
+    {
+        lua_rawgeti(lua, stackPos, i);
+        result.push_back(&GetObject<T>(lua, lua_gettop(lua)));
+        lua_pop(lua, 1);
+    }
+    return result;
+}
+
 void CheckNumArgs(lua_State* lua, const char* functionName, int expectedNum);
 
 void CheckType(lua_State* lua, int stackPos, int type, bool allowNil = false);
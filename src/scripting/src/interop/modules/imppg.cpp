@@ -2,12 +2,16 @@
 #include "common/formats.h"
 #include "interop/classes/DummyObject1.h"
 #include "interop/classes/DummyObject2.h"
+#include "interop/classes/FutureWrapper.h"
 #include "interop/classes/ImageWrapper.h"
 #include "interop/classes/SettingsWrapper.h"
 #include "interop/modules/common.h"
 #include "interop/modules/imppg.h"
 #include "interop/state.h"
+#include "logging/instrumentation.h"
+#include "settings_cache.h"
 
+#include <algorithm>
 #include <boost/format.hpp>
 #include <filesystem>
 
@@ -16,6 +20,156 @@ namespace fs = std::filesystem;
 namespace scripting::modules::imppg
 {
 
+namespace
+{
+
+/// Checks the number of arguments; if `allowPriority` is true, accepts one more optional argument (request priority).
+///
+/// @return Request priority (0 if not specified).
+///
+int CheckNumArgsAndGetPriority(lua_State* lua, const char* functionName, int expectedNum, bool allowPriority)
+{
+    if (allowPriority && lua_gettop(lua) == expectedNum + 1)
+    {
+        return GetInteger(lua, expectedNum + 1);
+    }
+
+    CheckNumArgs(lua, functionName, expectedNum);
+    return 0;
+}
+
+contents::ProcessImageFile GetProcessImageFileArgs(lua_State* lua, const char* functionName, bool allowPriority)
+{
+    const int priority = CheckNumArgsAndGetPriority(lua, functionName, 4, allowPriority);
+    const std::string imagePath = GetString(lua, 1);
+    const std::string settingsPath = GetString(lua, 2);
+    const std::string outputImagePath = GetString(lua, 3);
+    const int ofVal = GetInteger(lua, 4);
+
+    if (ofVal < 0 || ofVal >= static_cast<int>(OutputFormat::LAST))
+    {
+        throw ScriptExecutionError{"invalid output format"};
+    }
+
+    return contents::ProcessImageFile{imagePath, settingsPath, outputImagePath, static_cast<OutputFormat>(ofVal), priority};
+}
+
+contents::ProcessImage GetProcessImageArgs(lua_State* lua, const char* functionName, bool allowPriority)
+{
+    const int priority = CheckNumArgsAndGetPriority(lua, functionName, 2, allowPriority);
+    const auto image = GetObject<ImageWrapper>(lua, 1);
+    const auto settings = GetObject<SettingsWrapper>(lua, 2);
+
+    return contents::ProcessImage{image.GetImage(), settings.GetSettings(), priority};
+}
+
+/// Parses the first 6 arguments of `align_images` (all except the progress callback, which is set to a no-op).
+contents::AlignImages GetAlignImagesArgs(lua_State* lua)
+{
+    std::vector<fs::path> inputFiles;
+    for (const auto& s: GetStringTable(lua, 1))
+    {
+        inputFiles.push_back(s);
+    }
+
+    const AlignmentMethod alignMode = [&]() {
+        const int value = GetInteger(lua, 2);
+        if (value < 0 || value >= static_cast<int>(AlignmentMethod::NUM))
+        {
+            throw ScriptExecutionError{"invalid alignment mode"};
+        }
+        return static_cast<AlignmentMethod>(value);
+    }();
+
+    const CropMode cropMode = [&]() {
+        const int value = GetInteger(lua, 3);
+        if (value < 0 || value >= static_cast<int>(CropMode::NUM))
+        {
+            throw ScriptExecutionError{"invalid crop mode"};
+        }
+        return static_cast<CropMode>(value);
+    }();
+
+    const bool subpixelAlignment = GetBoolean(lua, 4);
+
+    const fs::path outputDir = GetString(lua, 5);
+
+    CheckType(lua, 6, LUA_TSTRING, true);
+    const auto outputFNameSuffix = lua_isnil(lua, 6)
+        ? std::nullopt
+        : std::optional<std::string>{GetString(lua, 6)};
+
+    return contents::AlignImages{
+        std::move(inputFiles),
+        alignMode,
+        cropMode,
+        subpixelAlignment,
+        outputDir,
+        outputFNameSuffix,
+        [](double) {}
+    };
+}
+
+/// Returns the table of file paths or images at `stackPos`.
+AlignmentInputs GetAlignmentInputs(lua_State* lua, int stackPos, const char* functionName)
+{
+    luaL_checktype(lua, stackPos, LUA_TTABLE);
+    lua_rawgeti(lua, stackPos, 1);
+    const bool fileInputs = (lua_type(lua, -1) == LUA_TSTRING);
+    lua_pop(lua, 1);
+
+    AlignmentInputs inputs = [&]() -> AlignmentInputs {
+        if (fileInputs)
+        {
+            wxArrayString files;
+            for (const auto& path: GetStringTable(lua, stackPos)) { files.Add(path); }
+            return files;
+        }
+        else
+        {
+            InputImageList images;
+            for (const ImageWrapper* image: GetObjectTable<ImageWrapper>(lua, stackPos)) { images.push_back(image->GetImage()); }
+            return images;
+        }
+    }();
+
+    if (std::visit([](const auto& list) { return list.empty(); }, inputs))
+    {
+        throw ScriptExecutionError{std::string{functionName} + ": no inputs specified"};
+    }
+
+    return inputs;
+}
+
+QualityMetric GetQualityMetric(lua_State* lua, int stackPos)
+{
+    const int value = GetInteger(lua, stackPos);
+    if (value < 0 || value >= static_cast<int>(QualityMetric::NUM))
+    {
+        throw ScriptExecutionError{"invalid quality metric"};
+    }
+    return static_cast<QualityMetric>(value);
+}
+
+std::vector<float> EstimateQuality(lua_State* lua, int inputsStackPos, int metricStackPos, const char* functionName)
+{
+    const auto result = scripting::g_State->CallFunctionAndAwaitCompletion(contents::EstimateQuality{
+        GetAlignmentInputs(lua, inputsStackPos, functionName),
+        GetQualityMetric(lua, metricStackPos)
+    });
+    const auto* qualities = std::get_if<call_result::QualityEstimated>(&result);
+    IMPPG_ASSERT(qualities != nullptr);
+    return qualities->qualities;
+}
+
+int StartAsync(lua_State* lua, MessageContents&& functionCall)
+{
+    new(PrepareObject<FutureWrapper>(lua)) FutureWrapper(scripting::g_State->CallFunctionAsync(std::move(functionCall)));
+    return 1;
+}
+
+}
+
 const luaL_Reg functions[] = {
     {"create_dummy1", [](lua_State* lua) -> int {
         /*DummyObject1* object =*/ new(PrepareObject<DummyObject1>(lua)) DummyObject1();
@@ -45,6 +199,24 @@ const luaL_Reg functions[] = {
         return 1;
     }},
 
+    {"settings_cache_stats", [](lua_State* lua) -> int {
+        CheckNumArgs(lua, "settings_cache_stats", 0);
+        const auto& cache = GetSettingsCache();
+        lua_pushinteger(lua, cache.GetNumHits());
+        lua_pushinteger(lua, cache.GetNumMisses());
+        return 2;
+    }},
+
+    {"export_trace", [](lua_State* lua) -> int {
+        CheckNumArgs(lua, "export_trace", 1);
+        const std::string path = GetString(lua, 1);
+        if (!Log::ExportChromeTrace(path))
+        {
+            throw ScriptExecutionError(std::string{"failed to save trace to "} + path);
+        }
+        return 0;
+    }},
+
     {"load_image", [](lua_State* lua) -> int {
         if (scripting::g_State->CheckStopRequested(lua)) { return 0; }
 
@@ -79,7 +251,10 @@ const luaL_Reg functions[] = {
 
         for (c_Image* channel: {&red, &green, &blue})
         {
-            *channel = channel->ConvertPixelFormat(PixelFormat::PIX_MONO32F);
+            if (channel->GetPixelFormat() != PixelFormat::PIX_MONO32F)
+            {
+                *channel = channel->ConvertPixelFormat(PixelFormat::PIX_MONO32F);
+            }
         }
 
         new(PrepareObject<ImageWrapper>(lua)) ImageWrapper(std::move(red));
@@ -91,33 +266,21 @@ const luaL_Reg functions[] = {
     {"process_image_file", [](lua_State* lua) -> int {
         if (scripting::g_State->CheckStopRequested(lua)) { return 0; }
 
-        CheckNumArgs(lua, "process_image_file", 4);
-        const std::string imagePath = GetString(lua, 1);
-        const std::string settingsPath = GetString(lua, 2);
-        const std::string outputImagePath = GetString(lua, 3);
-        const int ofVal = GetInteger(lua, 4);
+        scripting::g_State->CallFunctionAndAwaitCompletion(GetProcessImageFileArgs(lua, "process_image_file", false));
 
-        if (ofVal < 0 || ofVal >= static_cast<int>(OutputFormat::LAST))
-        {
-            throw ScriptExecutionError{"invalid output format"};
-        }
+        return 0; //TODO: return processing result
+    }},
 
-        scripting::g_State->CallFunctionAndAwaitCompletion(scripting::contents::ProcessImageFile{imagePath, settingsPath,
-            outputImagePath, static_cast<OutputFormat>(ofVal)});
+    {"process_image_file_async", [](lua_State* lua) -> int {
+        if (scripting::g_State->CheckStopRequested(lua)) { return 0; }
 
-        return 0; //TODO: return processing result
+        return StartAsync(lua, GetProcessImageFileArgs(lua, "process_image_file_async", true));
     }},
 
     {"process_image", [](lua_State* lua) -> int {
         if (scripting::g_State->CheckStopRequested(lua)) { return 0; }
 
-        CheckNumArgs(lua, "process_image", 2);
-        const auto image = GetObject<ImageWrapper>(lua, 1);
-        const auto settings = GetObject<SettingsWrapper>(lua, 2);
-
-        const auto result = scripting::g_State->CallFunctionAndAwaitCompletion(
-            scripting::contents::ProcessImage{image.GetImage(), settings.GetSettings()}
-        );
+        const auto result = scripting::g_State->CallFunctionAndAwaitCompletion(GetProcessImageArgs(lua, "process_image", false));
         const auto* processedImg = std::get_if<call_result::ImageProcessed>(&result);
         IMPPG_ASSERT(processedImg != nullptr);
 
@@ -126,6 +289,59 @@ const luaL_Reg functions[] = {
         return 1;
     }},
 
+    {"process_image_async", [](lua_State* lua) -> int {
+        if (scripting::g_State->CheckStopRequested(lua)) { return 0; }
+
+        return StartAsync(lua, GetProcessImageArgs(lua, "process_image_async", true));
+    }},
+
+    {"wait_all", [](lua_State* lua) -> int {
+        if (scripting::g_State->CheckStopRequested(lua)) { return 0; }
+
+        CheckNumArgs(lua, "wait_all", 1);
+        const auto futures = GetObjectTable<FutureWrapper>(lua, 1);
+        scripting::g_State->WaitUntil([&] {
+            return std::all_of(futures.begin(), futures.end(), [](const FutureWrapper* f) { return f->is_ready(); });
+        });
+
+        std::optional<std::string> firstError;
+        for (const FutureWrapper* future: futures)
+        {
+            const auto* error = std::get_if<call_result::Error>(&future->GetResult());
+            if (error && !firstError.has_value())
+            {
+                firstError = error->message;
+            }
+        }
+        if (firstError.has_value())
+        {
+            throw ScriptExecutionError(firstError.value());
+        }
+
+        return 0;
+    }},
+
+    {"wait_any", [](lua_State* lua) -> int {
+        CheckNumArgs(lua, "wait_any", 1);
+        const auto futures = GetObjectTable<FutureWrapper>(lua, 1);
+        if (futures.empty())
+        {
+            throw ScriptExecutionError{"wait_any: no futures specified"};
+        }
+
+        if (scripting::g_State->CheckStopRequested(lua)) { return 0; }
+
+        std::size_t readyIdx{0};
+        scripting::g_State->WaitUntil([&] {
+            const auto ready = std::find_if(futures.begin(), futures.end(), [](const FutureWrapper* f) { return f->is_ready(); });
+            readyIdx = ready - futures.begin();
+            return ready != futures.end();
+        });
+
+        lua_pushinteger(lua, readyIdx + 1);
+        return 1;
+    }},
+
     {"progress", [](lua_State* lua) -> int {
         if (scripting::g_State->CheckStopRequested(lua)) { return 0; }
 
@@ -148,6 +364,36 @@ const luaL_Reg functions[] = {
         return 1;
     }},
 
+    {"median", [](lua_State* lua) -> int {
+        if (scripting::g_State->CheckStopRequested(lua)) { return 0; }
+
+        CheckNumArgs(lua, "median", 1);
+        std::vector<std::shared_ptr<const c_Image>> images;
+        for (const ImageWrapper* wrapper: GetObjectTable<ImageWrapper>(lua, 1))
+        {
+            images.push_back(wrapper->GetImage());
+        }
+        if (images.empty())
+        {
+            throw ScriptExecutionError{"median: no images specified"};
+        }
+
+        std::vector<const c_Image*> imagePtrs;
+        for (const auto& image: images)
+        {
+            if (image->GetPixelFormat() != images[0]->GetPixelFormat() ||
+                image->GetWidth() != images[0]->GetWidth() ||
+                image->GetHeight() != images[0]->GetHeight())
+            {
+                throw ScriptExecutionError{"median: images differ in size or number of channels"};
+            }
+            imagePtrs.push_back(image.get());
+        }
+
+        new(PrepareObject<ImageWrapper>(lua)) ImageWrapper(c_Image::Median(imagePtrs));
+        return 1;
+    }},
+
     //TODO: accept list of images and weights (tuples)
     {"blend", [](lua_State* lua) -> int {
         if (scripting::g_State->CheckStopRequested(lua)) { return 0; }
@@ -174,12 +420,31 @@ const luaL_Reg functions[] = {
         if (scripting::g_State->CheckStopRequested(lua)) { return 0; }
 
         CheckNumArgs(lua, "align_images", 7);
-        std::vector<fs::path> inputFiles;
-        for (const auto& s: GetStringTable(lua, 1))
+        auto call = GetAlignImagesArgs(lua);
+
+        CheckType(lua, 7, LUA_TFUNCTION, true);
+        if (!lua_isnil(lua, 7))
         {
-            inputFiles.push_back(s);
+            call.progressCallback = [lua](double value) {
+                lua_pushvalue(lua, 7);
+                lua_pushnumber(lua, value);
+                lua_call(lua, 1, 0);
+            };
         }
 
+        scripting::g_State->CallFunctionAndAwaitCompletion(std::move(call));
+
+        return 0;
+    }},
+
+    {"align_and_stack", [](lua_State* lua) -> int {
+        if (scripting::g_State->CheckStopRequested(lua)) { return 0; }
+
+        CheckNumArgs(lua, "align_and_stack", 5);
+
+        AlignmentInputs inputs = GetAlignmentInputs(lua, 1, "align_and_stack");
+        const bool fileInputs = std::holds_alternative<wxArrayString>(inputs);
+
         const AlignmentMethod alignMode = [&]() {
             const int value = GetInteger(lua, 2);
             if (value < 0 || value >= static_cast<int>(AlignmentMethod::NUM))
@@ -188,6 +453,10 @@ const luaL_Reg functions[] = {
             }
             return static_cast<AlignmentMethod>(value);
         }();
+        if (alignMode == AlignmentMethod::LIMB && !fileInputs)
+        {
+            throw ScriptExecutionError{"align_and_stack: solar limb alignment requires file inputs"};
+        }
 
         const CropMode cropMode = [&]() {
             const int value = GetInteger(lua, 3);
@@ -200,33 +469,72 @@ const luaL_Reg functions[] = {
 
         const bool subpixelAlignment = GetBoolean(lua, 4);
 
-        const fs::path outputDir = GetString(lua, 5);
-
-        CheckType(lua, 6, LUA_TSTRING, true);
-        const auto outputFNameSuffix = lua_isnil(lua, 6)
-            ? std::nullopt
-            : std::optional<std::string>{GetString(lua, 6)};
-
-        CheckType(lua, 7, LUA_TFUNCTION, true);
-        const auto progressCallback = lua_isnil(lua, 7)
-            ? std::function<void(double)>{}
-            : [lua](double value) {
-                lua_pushvalue(lua, 7);
-                lua_pushnumber(lua, value);
-                lua_call(lua, 1, 0);
-            };
+        const StackingMode stackingMode = [&]() {
+            const int value = GetInteger(lua, 5);
+            if (value <= static_cast<int>(StackingMode::NONE) || value >= static_cast<int>(StackingMode::NUM))
+            {
+                throw ScriptExecutionError{"invalid stacking mode"};
+            }
+            return static_cast<StackingMode>(value);
+        }();
 
-        scripting::g_State->CallFunctionAndAwaitCompletion(scripting::contents::AlignImages{
-            std::move(inputFiles),
+        const auto result = scripting::g_State->CallFunctionAndAwaitCompletion(contents::AlignAndStack{
+            std::move(inputs),
             alignMode,
             cropMode,
             subpixelAlignment,
-            outputDir,
-            outputFNameSuffix,
-            std::move(progressCallback)
+            stackingMode
         });
 
-        return 0;
+        const auto* stack = std::get_if<call_result::ImageProcessed>(&result);
+        IMPPG_ASSERT(stack != nullptr);
+        new(PrepareObject<ImageWrapper>(lua)) ImageWrapper(stack->image);
+        return 1;
+    }},
+
+    {"image_quality", [](lua_State* lua) -> int {
+        if (scripting::g_State->CheckStopRequested(lua)) { return 0; }
+
+        CheckNumArgs(lua, "image_quality", 2);
+        const auto qualities = EstimateQuality(lua, 1, 2, "image_quality");
+
+        lua_newtable(lua);
+        for (std::size_t i = 0; i < qualities.size(); ++i)
+        {
+            lua_pushnumber(lua, qualities[i]);
+            lua_rawseti(lua, -2, i + 1);
+        }
+        return 1;
+    }},
+
+    {"select_best", [](lua_State* lua) -> int {
+        if (scripting::g_State->CheckStopRequested(lua)) { return 0; }
+
+        CheckNumArgs(lua, "select_best", 3);
+        const double percentage = GetNumber(lua, 2);
+        if (percentage < 0.0 || percentage > 100.0)
+        {
+            throw ScriptExecutionError{"select_best: invalid percentage"};
+        }
+        const auto qualities = EstimateQuality(lua, 1, 3, "select_best");
+
+        // the selected elements of the input table (file paths or images) are returned in their original order
+        lua_newtable(lua);
+        std::size_t numSelected{0};
+        for (const std::size_t index: SelectBestImages(qualities, percentage / 100.0))
+        {
+            lua_rawgeti(lua, 1, index + 1);
+            lua_rawseti(lua, -2, ++numSelected);
+        }
+        return 1;
+    }},
+
+    {"align_images_async", [](lua_State* lua) -> int {
+        if (scripting::g_State->CheckStopRequested(lua)) { return 0; }
+
+        // no progress callback: the Lua state must not be accessed while the script keeps running
+        CheckNumArgs(lua, "align_images_async", 6);
+        return StartAsync(lua, GetAlignImagesArgs(lua));
     }},
 
     {nullptr, nullptr} // end-of-data marker
@@ -256,7 +564,14 @@ const std::vector<std::pair<std::string, int>> constants{
     {"SOLAR_LIMB", static_cast<int>(AlignmentMethod::LIMB)},
 
     {"CROP",         static_cast<int>(CropMode::CROP_TO_INTERSECTION)},
-    {"PAD",          static_cast<int>(CropMode::PAD_TO_BOUNDING_BOX)}
+    {"PAD",          static_cast<int>(CropMode::PAD_TO_BOUNDING_BOX)},
+
+    {"STACK_MEAN",               static_cast<int>(StackingMode::MEAN)},
+    {"STACK_SIGMA_CLIPPED_MEAN", static_cast<int>(StackingMode::SIGMA_CLIPPED_MEAN)},
+    {"STACK_MEDIAN",             static_cast<int>(StackingMode::MEDIAN)},
+
+    {"QUALITY_GRADIENT",           static_cast<int>(QualityMetric::GRADIENT)},
+    {"QUALITY_LAPLACIAN_VARIANCE", static_cast<int>(QualityMetric::LAPLACIAN_VARIANCE)}
 };
 
 }
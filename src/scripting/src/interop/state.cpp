@@ -8,11 +8,15 @@
 namespace scripting
 {
 
+/// Max. number of function calls sent to the parent and not completed yet; further asynchronous calls wait,
+/// so that a script cannot queue an unbounded number of requests (and images they refer to).
+constexpr std::size_t MAX_CALLS_IN_PROGRESS = 32;
+
 std::unique_ptr<State> g_State;
 
 bool State::CheckStopRequested(lua_State* lua)
 {
-    if (m_StopRequested.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+    if (m_Signal->IsStopRequested())
     {
         lua_getglobal(lua, "error");
         lua_pushstring(lua, _("script interrupted by user").ToStdString().c_str());
@@ -33,14 +37,29 @@ void State::SendMessage(MessageContents&& message)
     m_Parent.QueueEvent(event);
 }
 
-FunctionCallResult State::CallFunctionAndAwaitCompletion(MessageContents&& functionCall)
+void State::ThrowStopped() const
+{
+    throw ScriptExecutionError(_("script interrupted by user").ToStdString());
+}
+
+std::future<FunctionCallResult> State::CallFunctionAsync(MessageContents&& functionCall)
 {
+    if (!m_Signal->WaitForFreeCallSlot(MAX_CALLS_IN_PROGRESS)) { ThrowStopped(); }
+
     auto* event = new wxThreadEvent(wxEVT_THREAD);
     std::promise<FunctionCallResult> completionSend;
     std::future<FunctionCallResult> completionRecv = completionSend.get_future();
-    event->SetPayload(ScriptMessagePayload{std::move(functionCall), std::move(completionSend)});
+    m_Signal->OnCallStarted();
+    event->SetPayload(ScriptMessagePayload{std::move(functionCall), std::move(completionSend), m_Signal});
     m_Parent.QueueEvent(event);
-    const FunctionCallResult result = completionRecv.get();
+    return completionRecv;
+}
+
+FunctionCallResult State::CallFunctionAndAwaitCompletion(MessageContents&& functionCall)
+{
+    std::future<FunctionCallResult> completion = CallFunctionAsync(std::move(functionCall));
+    WaitUntil([&] { return completion.wait_for(std::chrono::seconds(0)) == std::future_status::ready; });
+    const FunctionCallResult result = completion.get();
     if (auto* error = std::get_if<call_result::Error>(&result))
     {
         throw ScriptExecutionError(error->message);
@@ -17,9 +17,9 @@ namespace scripting
 class State
 {
 public:
-    State(wxEvtHandler& parent, std::future<void>&& stopRequested)
+    State(wxEvtHandler& parent, std::shared_ptr<ScriptSignal> signal)
     : m_Parent(parent)
-    , m_StopRequested(std::move(stopRequested))
+    , m_Signal(std::move(signal))
     {}
 
     void SendMessage(MessageContents&& message);
@@ -27,6 +27,18 @@ public:
     /// If the result is `Error`, throws automatically.
     FunctionCallResult CallFunctionAndAwaitCompletion(MessageContents&& functionCall);
 
+    /// Returns immediately, unless too many calls are already in progress; the result (including `Error`)
+    /// becomes available via the returned future.
+    std::future<FunctionCallResult> CallFunctionAsync(MessageContents&& functionCall);
+
+    /// Waits until `condition` (checked after each completed function call) returns true;
+    /// throws if stopping the script has been requested in the meantime.
+    template<typename Condition>
+    void WaitUntil(Condition condition)
+    {
+        if (!m_Signal->WaitUntil(condition)) { ThrowStopped(); }
+    }
+
     template<typename T>
     void OnObjectCreated()
     {
@@ -48,9 +60,11 @@ private:
 
     void OnObjectDestroyedImpl(const char* typeName);
 
+    [[noreturn]] void ThrowStopped() const;
+
     wxEvtHandler& m_Parent;
 
-    std::future<void> m_StopRequested;
+    std::shared_ptr<ScriptSignal> m_Signal;
 
     // key: typeid name
     std::unordered_map<std::string, std::size_t> m_ObjectCounts;
@@ -24,8 +24,11 @@ File description:
 #include "../../imppg_assert.h"
 #include "alignment/align_proc.h"
 #include "common/proc_settings.h"
+#include "logging/logging.h"
 #include "scripting/script_image_processor.h"
+#include "settings_cache.h"
 
+#include <algorithm>
 #include <filesystem>
 #include <memory>
 #include <tuple>
@@ -35,43 +38,200 @@ namespace scripting
 {
 
 ScriptImageProcessor::ScriptImageProcessor(
-    std::unique_ptr<imppg::backend::IProcessingBackEnd>&& processor,
-    bool normalizeFitsValues
+    ProcessorFactory processorFactory,
+    std::size_t numWorkers,
+    bool normalizeFitsValues,
+    std::size_t memoryLimit
 )
-: m_Processor(std::move(processor))
-, m_NormalizeFitsValues(normalizeFitsValues)
+: m_NormalizeFitsValues(normalizeFitsValues)
+, m_MemoryLimit(memoryLimit)
 {
+    for (std::size_t i = 0; i < std::max<std::size_t>(numWorkers, 1); ++i)
+    {
+        m_Workers.push_back(Worker{processorFactory()});
+    }
 }
 
 ScriptImageProcessor::~ScriptImageProcessor()
 {}
 
+bool ScriptImageProcessor::ComparePendingRequests(const PendingRequest& r1, const PendingRequest& r2)
+{
+    // `std::push_heap` & co. put the greatest element first
+    return r1.priority < r2.priority || (r1.priority == r2.priority && r1.seqNumber > r2.seqNumber);
+}
+
+static bool IsAlignmentRequest(const MessageContents& request)
+{
+    return std::holds_alternative<contents::AlignRGB>(request) ||
+        std::holds_alternative<contents::AlignImages>(request) ||
+        std::holds_alternative<contents::AlignAndStack>(request) ||
+        std::holds_alternative<contents::EstimateQuality>(request);
+}
+
+/// Returns the estimated amount of memory (in bytes) used by a processing back end for an image.
+static std::size_t EstimateProcessingMemory(unsigned width, unsigned height, std::size_t numChannels, std::size_t numUnsharpMasks)
+{
+    // per channel: input, sharpening, unsharp masking and tone curve outputs; plus the combined output
+    const std::size_t numPlanes = numChannels * (3 + numUnsharpMasks) + (numChannels > 1 ? numChannels : 0);
+    return static_cast<std::size_t>(width) * height * sizeof(float) * numPlanes;
+}
+
+static std::size_t EstimateRequestMemory(const MessageContents& request)
+{
+    return std::visit(Overload{
+        [](const contents::ProcessImage& call) {
+            return EstimateProcessingMemory(
+                call.image->GetWidth(),
+                call.image->GetHeight(),
+                NumChannels[static_cast<int>(call.image->GetPixelFormat())],
+                call.settings.unsharpMask.size()
+            );
+        },
+
+        [](const contents::ProcessImageFile& call) -> std::size_t {
+            // the number of channels and unsharp masks is not known until the files are loaded; assume RGB and 1 mask
+            const auto size = GetImageSize(call.imagePath);
+            return size.has_value() ? EstimateProcessingMemory(std::get<0>(*size), std::get<1>(*size), 3, 1) : 0;
+        },
+
+        [](const auto&) -> std::size_t { return 0; }
+    }, request);
+}
+
+static int GetRequestPriority(const MessageContents& request)
+{
+    return std::visit(Overload{
+        [](const contents::ProcessImage& call) { return call.priority; },
+        [](const contents::ProcessImageFile& call) { return call.priority; },
+        [](const auto&) { return 0; }
+    }, request);
+}
+
 void ScriptImageProcessor::StartProcessing(
     MessageContents request,
     std::function<void(FunctionCallResult)> onCompletion
 )
 {
-    const auto handler = Overload{
-        [&](const contents::ProcessImageFile& call) { OnProcessImageFile(call, onCompletion); },
+    const int priority = GetRequestPriority(request);
+    const std::size_t estimatedMemory = EstimateRequestMemory(request);
+
+    m_PendingRequests.push_back(PendingRequest{
+        std::move(request),
+        std::move(onCompletion),
+        priority,
+        m_NextSeqNumber++,
+        estimatedMemory
+    });
+    std::push_heap(m_PendingRequests.begin(), m_PendingRequests.end(), ComparePendingRequests);
 
-        [&](const contents::ProcessImage& call) { OnProcessImage(call, onCompletion); },
+    DispatchRequests();
+}
 
-        [&](const contents::AlignRGB& call) { OnAlignRGB(call, onCompletion); },
+void ScriptImageProcessor::DispatchRequests()
+{
+    while (!m_PendingRequests.empty())
+    {
+        const PendingRequest& next = m_PendingRequests.front();
 
-        [&](const contents::AlignImages& call) { OnAlignImages(call, onCompletion); },
+        Worker* worker = nullptr;
+        if (IsAlignmentRequest(next.request))
+        {
+            if (m_AlignmentInProgress) { break; }
+        }
+        else
+        {
+            const auto freeWorker = std::find_if(m_Workers.begin(), m_Workers.end(), [](const Worker& w) { return !w.busy; });
+            if (freeWorker == m_Workers.end()) { break; }
 
-        [](auto) { IMPPG_ABORT_MSG("invalid message passed to ScriptImageProcessor"); },
-    };
+            if (m_MemoryLimit != 0 && m_MemoryInUse != 0 && m_MemoryInUse + next.estimatedMemory > m_MemoryLimit)
+            {
+                break;
+            }
+
+            worker = &*freeWorker;
+        }
 
-    std::visit(handler, request);
+        std::pop_heap(m_PendingRequests.begin(), m_PendingRequests.end(), ComparePendingRequests);
+        PendingRequest pending = std::move(m_PendingRequests.back());
+        m_PendingRequests.pop_back();
+
+        // Completion of a request does not start the next one directly, as it is usually signaled from within
+        // a back end's or worker's handler, which must not be replaced while it runs; `OnIdle` does it instead.
+        if (worker)
+        {
+            worker->busy = true;
+            m_MemoryInUse += pending.estimatedMemory;
+            Log::PrintF("Starting script request #%zu (est. memory %zu MiB, in use: %zu MiB)\n",
+                pending.seqNumber, pending.estimatedMemory >> 20, m_MemoryInUse >> 20);
+
+            CompletionFunc onCompletion = [
+                this,
+                worker,
+                estimatedMemory = pending.estimatedMemory,
+                requestOnCompletion = std::move(pending.onCompletion)
+            ](FunctionCallResult result) {
+                worker->busy = false;
+                m_MemoryInUse -= estimatedMemory;
+                requestOnCompletion(std::move(result));
+            };
+
+            std::visit(Overload{
+                [&](const contents::ProcessImageFile& call) { OnProcessImageFile(call, onCompletion, worker->processor); },
+                [&](const contents::ProcessImage& call) { OnProcessImage(call, onCompletion, worker->processor); },
+                [](const auto&) { IMPPG_ABORT_MSG("invalid message passed to ScriptImageProcessor"); },
+            }, pending.request);
+        }
+        else
+        {
+            m_AlignmentInProgress = true;
+
+            CompletionFunc onCompletion = [this, requestOnCompletion = std::move(pending.onCompletion)](FunctionCallResult result) {
+                m_AlignmentInProgress = false;
+                requestOnCompletion(std::move(result));
+            };
+
+            std::visit(Overload{
+                [&](const contents::AlignRGB& call) { OnAlignRGB(call, onCompletion); },
+                [&](const contents::AlignImages& call) { OnAlignImages(call, onCompletion); },
+                [&](const contents::AlignAndStack& call) { OnAlignAndStack(call, onCompletion); },
+                [&](const contents::EstimateQuality& call) { OnEstimateQuality(call, onCompletion); },
+                [](const auto&) { IMPPG_ABORT_MSG("invalid message passed to ScriptImageProcessor"); },
+            }, pending.request);
+        }
+    }
+}
+
+void ScriptImageProcessor::CancelPendingRequests(const std::string& errorMessage)
+{
+    // the completion handlers may submit new requests, so do not iterate over `m_PendingRequests` directly
+    std::vector<PendingRequest> cancelled;
+    cancelled.swap(m_PendingRequests);
+    if (!cancelled.empty())
+    {
+        Log::PrintF("Cancelling %zu pending script request(s)\n", cancelled.size());
+    }
+    for (auto& pending: cancelled)
+    {
+        pending.onCompletion(call_result::Error{errorMessage});
+    }
 }
 
 void ScriptImageProcessor::OnIdle(wxIdleEvent& event)
 {
-    m_Processor->OnIdle(event);
+    for (auto& worker: m_Workers)
+    {
+        worker.processor->OnIdle(event);
+    }
+
+    DispatchRequests();
 }
 
-void ScriptImageProcessor::OnProcessImageFile(const contents::ProcessImageFile& call, CompletionFunc onCompletion)
+void ScriptImageProcessor::OnProcessImageFile(
+    const contents::ProcessImageFile& call,
+    CompletionFunc onCompletion,
+    ProcessorPtr& processor
+)
 {
     std::string loadErrorMsg;
     auto loadResult = LoadImageFileAs32f(call.imagePath, m_NormalizeFitsValues, &loadErrorMsg);
@@ -84,7 +244,7 @@ void ScriptImageProcessor::OnProcessImageFile(const contents::ProcessImageFile&
     }
     c_Image image = std::move(loadResult.value());
 
-    const auto settings = LoadSettings(call.settingsPath);
+    const auto settings = GetSettingsCache().Load(call.settingsPath);
     if (!settings.has_value())
     {
         onCompletion(call_result::Error{
@@ -98,11 +258,11 @@ void ScriptImageProcessor::OnProcessImageFile(const contents::ProcessImageFile&
         NormalizeFpImage(image, settings->normalization.min, settings->normalization.max);
     }
 
-    m_Processor->SetProcessingCompletedHandler(
-        [this, onCompletion = std::move(onCompletion), outPath = call.outputImagePath, outFmt = call.outputFormat]
+    processor->SetProcessingCompletedHandler(
+        [&processor, onCompletion = std::move(onCompletion), outPath = call.outputImagePath, outFmt = call.outputFormat]
             (imppg::backend::CompletionStatus) {
 
-                if (!m_Processor->GetProcessedOutput().SaveToFile(outPath, outFmt))
+                if (!processor->GetProcessedOutput().SaveToFile(outPath, outFmt))
                 {
                     onCompletion(call_result::Error{
                         wxString::Format(_("failed to save output file %s"), outPath).ToStdString()
@@ -114,25 +274,34 @@ void ScriptImageProcessor::OnProcessImageFile(const contents::ProcessImageFile&
                 }
         }
     );
-    m_Processor->StartProcessing(std::move(image), *settings);
+    processor->StartProcessing(std::move(image), *settings);
 }
 
-void ScriptImageProcessor::OnProcessImage(const contents::ProcessImage& call, CompletionFunc onCompletion)
+void ScriptImageProcessor::OnProcessImage(
+    const contents::ProcessImage& call,
+    CompletionFunc onCompletion,
+    ProcessorPtr& processor
+)
 {
-    c_Image image = *call.image;
-    if (call.settings.normalization.enabled)
-    {
-        NormalizeFpImage(image, call.settings.normalization.min, call.settings.normalization.max);
-    }
-
-    m_Processor->SetProcessingCompletedHandler(
-        [onCompletion = std::move(onCompletion), this](imppg::backend::CompletionStatus) {
+    processor->SetProcessingCompletedHandler(
+        [onCompletion = std::move(onCompletion), &processor](imppg::backend::CompletionStatus) {
             onCompletion(call_result::ImageProcessed{
-                std::make_shared<c_Image>(m_Processor->GetProcessedOutput())
+                std::make_shared<c_Image>(processor->TakeProcessedOutput())
             });
         }
     );
-    m_Processor->StartProcessing(std::move(image), call.settings);
+
+    if (call.settings.normalization.enabled)
+    {
+        // normalization modifies the image, so the script's one cannot be shared
+        c_Image image = *call.image;
+        NormalizeFpImage(image, call.settings.normalization.min, call.settings.normalization.max);
+        processor->StartProcessing(std::move(image), call.settings);
+    }
+    else
+    {
+        processor->StartProcessing(call.image, call.settings);
+    }
 }
 
 static double CalculateProgress(
@@ -240,6 +409,85 @@ void ScriptImageProcessor::OnAlignImages(const contents::AlignImages& call, Comp
     m_AlignmentWorker->Run();
 }
 
+void ScriptImageProcessor::OnAlignAndStack(const contents::AlignAndStack& call, CompletionFunc onCompletion)
+{
+    if (m_AlignmentWorker)
+    {
+        m_AlignmentWorker->Wait();
+    }
+
+    m_AlignmentEvtHandler = std::make_unique<wxEvtHandler>();
+    m_AlignmentEvtHandler->Bind(wxEVT_THREAD,
+        [onCompletion = std::move(onCompletion), stack = std::shared_ptr<c_Image>{}](wxThreadEvent& event) mutable {
+            switch (event.GetId())
+            {
+            case EID_STACKED:
+                stack = event.GetPayload<std::shared_ptr<c_Image>>();
+                break;
+
+            case EID_COMPLETED:
+                if (!event.GetString().empty())
+                {
+                    onCompletion(call_result::Error{event.GetString().ToStdString()});
+                }
+                else
+                {
+                    IMPPG_ASSERT(stack != nullptr);
+                    onCompletion(call_result::ImageProcessed{std::move(stack)});
+                }
+                break;
+
+            case EID_ABORTED:
+                onCompletion(call_result::Error{event.GetString().ToStdString()});
+                break;
+
+            default: break;
+            }
+        }
+    );
+
+    AlignmentParameters_t alignParams{};
+    alignParams.inputs = call.inputs;
+    alignParams.alignmentMethod = call.alignMode;
+    alignParams.subpixelAlignment = call.subpixelAlignment;
+    alignParams.cropMode = call.cropMode;
+    alignParams.normalizeFitsValues = m_NormalizeFitsValues;
+    alignParams.stacking.mode = call.stackingMode;
+
+    m_AlignmentWorker = std::make_unique<c_ImageAlignmentWorkerThread>(*m_AlignmentEvtHandler, std::move(alignParams));
+    m_AlignmentWorker->Run();
+}
+
+void ScriptImageProcessor::OnEstimateQuality(const contents::EstimateQuality& call, CompletionFunc onCompletion)
+{
+    if (m_QualityWorker)
+    {
+        m_QualityWorker->Wait();
+    }
+
+    m_QualityEvtHandler = std::make_unique<wxEvtHandler>();
+    m_QualityEvtHandler->Bind(wxEVT_THREAD, [onCompletion = std::move(onCompletion)](wxThreadEvent& event) {
+        switch (event.GetId())
+        {
+        case EID_QUALITY_COMPLETED: {
+            const auto qualities = event.GetPayload<std::shared_ptr<std::vector<float>>>();
+            onCompletion(call_result::QualityEstimated{std::move(*qualities)});
+            } break;
+
+        case EID_QUALITY_ABORTED:
+            onCompletion(call_result::Error{event.GetString().ToStdString()});
+            break;
+
+        default: break;
+        }
+    });
+
+    m_QualityWorker = std::make_unique<c_QualityEstimationWorkerThread>(
+        *m_QualityEvtHandler, call.inputs, call.metric, m_NormalizeFitsValues
+    );
+    m_QualityWorker->Run();
+}
+
 void ScriptImageProcessor::OnAlignRGB(const contents::AlignRGB& call, CompletionFunc onCompletion)
 {
     if (m_AlignmentWorker)
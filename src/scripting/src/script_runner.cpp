@@ -22,6 +22,7 @@ File description:
 */
 
 #include "interop/interop_impl.h"
+#include "logging/instrumentation.h"
 #include "scripting/script_exceptions.h"
 #include "scripting/interop.h"
 #include "scripting/script_runner.h"
@@ -75,12 +76,12 @@ namespace scripting
 ScriptRunner::ScriptRunner(
     std::unique_ptr<std::istream> script,
     wxEvtHandler& parent,
-    std::future<void>&& stopRequested
+    std::shared_ptr<ScriptSignal> signal
 )
 : wxThread(wxTHREAD_JOINABLE)
 , m_Script(std::move(script))
 , m_Parent(parent)
-, m_StopRequested(std::move(stopRequested))
+, m_Signal(std::move(signal))
 {
 }
 
@@ -102,8 +103,9 @@ wxThread::ExitCode ScriptRunner::Entry()
             return 0;
         });
 
-        scripting::Prepare(lua, m_Parent, std::move(m_StopRequested));
+        scripting::Prepare(lua, m_Parent, m_Signal);
 
+        Log::c_StageTimer timer("Run script", 0.0);
         auto readerState = StreamReaderState{std::move(m_Script)};
         CHECKED_CALL(lua_load(lua, &StreamReader, &readerState, "script", nullptr));
         lua_call(lua, 0, 0);
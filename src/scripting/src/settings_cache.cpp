@@ -0,0 +1,88 @@
+/*
+ImPPG (Image Post-Processor) - common operations for astronomical stacks and other images
+Copyright (C) 2022 Filip Szczerek <ga.software@yahoo.com>
+
+This file is part of ImPPG.
+
+ImPPG is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ImPPG is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with ImPPG.  If not, see <http://www.gnu.org/licenses/>.
+
+File description:
+    Processing settings cache implementation.
+*/
+
+#include "settings_cache.h"
+
+#include <system_error>
+
+namespace scripting
+{
+
+std::optional<ProcessingSettings> SettingsCache::Load(const std::string& path)
+{
+    std::error_code error;
+    const auto modificationTime = std::filesystem::last_write_time(path, error);
+    if (error)
+    {
+        // let `LoadSettings` handle it (nothing is cached)
+        return LoadSettings(path);
+    }
+
+    {
+        std::lock_guard lock{m_Guard};
+        const auto entry = m_Entries.find(path);
+        if (entry != m_Entries.end() && entry->second.modificationTime == modificationTime)
+        {
+            m_NumHits += 1;
+            return entry->second.settings;
+        }
+        m_NumMisses += 1;
+    }
+
+    // parse outside the lock; concurrent misses of the same file result in identical entries
+    auto settings = LoadSettings(path);
+    if (settings.has_value())
+    {
+        std::lock_guard lock{m_Guard};
+        m_Entries.insert_or_assign(path, Entry{modificationTime, *settings});
+    }
+
+    return settings;
+}
+
+std::size_t SettingsCache::GetNumHits() const
+{
+    std::lock_guard lock{m_Guard};
+    return m_NumHits;
+}
+
+std::size_t SettingsCache::GetNumMisses() const
+{
+    std::lock_guard lock{m_Guard};
+    return m_NumMisses;
+}
+
+void SettingsCache::ResetCounters()
+{
+    std::lock_guard lock{m_Guard};
+    m_NumHits = 0;
+    m_NumMisses = 0;
+}
+
+SettingsCache& GetSettingsCache()
+{
+    static SettingsCache cache;
+    return cache;
+}
+
+}
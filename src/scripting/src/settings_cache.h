@@ -0,0 +1,73 @@
+/*
+ImPPG (Image Post-Processor) - common operations for astronomical stacks and other images
+Copyright (C) 2022 Filip Szczerek <ga.software@yahoo.com>
+
+This file is part of ImPPG.
+
+ImPPG is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ImPPG is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with ImPPG.  If not, see <http://www.gnu.org/licenses/>.
+
+File description:
+    Processing settings cache header.
+*/
+
+#pragma once
+
+#include "common/proc_settings.h"
+
+#include <cstddef>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+namespace scripting
+{
+
+/// Cache of processing settings loaded from files, keyed by path and modification time; thread-safe.
+///
+/// Used by both the script thread (`imppg.load_settings`) and the main thread (`imppg.process_image_file`),
+/// so that a settings file used for a long sequence of images is parsed once.
+///
+class SettingsCache
+{
+public:
+    /// Returns settings loaded from `path` or their cached copy, if the file has not been modified since.
+    std::optional<ProcessingSettings> Load(const std::string& path);
+
+    std::size_t GetNumHits() const;
+
+    std::size_t GetNumMisses() const;
+
+    void ResetCounters();
+
+private:
+    struct Entry
+    {
+        std::filesystem::file_time_type modificationTime;
+        ProcessingSettings settings; ///< Tone curve's splines are already calculated.
+    };
+
+    mutable std::mutex m_Guard;
+
+    std::unordered_map<std::string, Entry> m_Entries;
+
+    std::size_t m_NumHits{0};
+
+    std::size_t m_NumMisses{0};
+};
+
+SettingsCache& GetSettingsCache();
+
+}
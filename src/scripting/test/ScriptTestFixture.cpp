@@ -22,8 +22,11 @@ ScriptTestFixture::ScriptTestFixture()
 {
     wxInitialize();
 
-    m_Processor =
-        std::make_unique<scripting::ScriptImageProcessor>(imppg::backend::CreateCpuBmpProcessingBackend(), false);
+    m_Processor = std::make_unique<scripting::ScriptImageProcessor>(
+        []() { return imppg::backend::CreateCpuBmpProcessingBackend(false); },
+        2,
+        false
+    );
 
     m_App = std::make_unique<wxAppConsole>();
     m_App->Bind(wxEVT_THREAD, &ScriptTestFixture::OnRunnerMessage, this);
@@ -43,8 +46,11 @@ ScriptTestFixture::~ScriptTestFixture()
 
 bool ScriptTestFixture::RunScript(const char* scriptText)
 {
-    std::promise<void> stopScript;
-    scripting::ScriptRunner runner(std::make_unique<std::stringstream>(scriptText), *m_App, stopScript.get_future());
+    scripting::ScriptRunner runner(
+        std::make_unique<std::stringstream>(scriptText),
+        *m_App,
+        std::make_shared<scripting::ScriptSignal>()
+    );
     runner.Run();
     m_App->MainLoop();
     runner.Wait();
@@ -5,7 +5,6 @@
 #include "scripting/script_image_processor.h"
 
 #include <filesystem>
-#include <future>
 #include <initializer_list>
 #include <memory>
 #include <unordered_map>
@@ -53,7 +52,6 @@ private:
 
     std::unique_ptr<scripting::ScriptImageProcessor> m_Processor;
     std::unique_ptr<wxAppConsole> m_App;
-    std::promise<void> m_StopScript;
     std::vector<std::filesystem::path> m_TemporaryFiles;
     // value: occurrence count
     std::unordered_map<std::string, std::size_t> m_StringNotificationsUnordered;
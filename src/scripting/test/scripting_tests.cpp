@@ -4,8 +4,11 @@
 #include <boost/test/unit_test.hpp>
 #include <cstdint>
 #include <filesystem>
+#include <fstream>
 #include <future>
+#include <iterator>
 #include <memory>
+#include <string>
 
 namespace fs = std::filesystem;
 
@@ -103,6 +106,228 @@ processed_image:save("$ROOT/output.tif", imppg.TIFF_16)
     BOOST_CHECK(CheckAllPixelValues<std::uint16_t>(loadedProcessedImg.value(), 0xFFFF / 2));
 }
 
+BOOST_FIXTURE_TEST_CASE(ProcessImagesAsync, ScriptTestFixture)
+{
+    std::string script{R"(
+
+settings1 = imppg.new_settings()
+settings1:tc_set_point(0, 0.0, 0.5)
+settings1:tc_set_point(1, 1.0, 0.5)
+settings2 = imppg.new_settings()
+settings2:tc_set_point(0, 0.0, 0.25)
+settings2:tc_set_point(1, 1.0, 0.25)
+image = imppg.load_image("$ROOT/image.bmp")
+futures = { imppg.process_image_async(image, settings1), imppg.process_image_async(image, settings2) }
+imppg.wait_all(futures)
+imppg.test.notify_boolean(futures[1]:is_ready())
+imppg.test.notify_image(futures[2]:wait())
+
+    )"};
+    const auto root = GetTestRoot();
+    boost::algorithm::replace_all(script, "$ROOT", root.generic_string());
+
+    c_Image image{128, 64, PixelFormat::PIX_MONO8};
+    image.ClearToZero();
+    image.SaveToFile((root / "image.bmp").string(), OutputFormat::BMP_8);
+
+    BOOST_REQUIRE(RunScript(script.c_str()));
+
+    fs::remove(root / "image.bmp");
+
+    CheckBooleanNotifications({true});
+    const auto& processedImg = GetImageNotification();
+    BOOST_REQUIRE(PixelFormat::PIX_MONO32F == processedImg.GetPixelFormat());
+    BOOST_CHECK(CheckAllPixelValues(processedImg, 0.25f));
+}
+
+BOOST_FIXTURE_TEST_CASE(ManyAsyncCallsCompleteWhenThrottled, ScriptTestFixture)
+{
+    // more calls than may be in progress at the same time; the excess ones wait until earlier ones complete
+    std::string script{R"(
+
+settings = imppg.new_settings()
+settings:tc_set_point(0, 0.0, 0.5)
+settings:tc_set_point(1, 1.0, 0.5)
+image = imppg.load_image("$ROOT/image.bmp")
+futures = {}
+for i = 1, 100 do
+    futures[i] = imppg.process_image_async(image, settings)
+end
+imppg.test.notify_boolean(futures[imppg.wait_any(futures)]:is_ready())
+imppg.wait_all(futures)
+imppg.test.notify_boolean(futures[100]:is_ready())
+imppg.test.notify_image(futures[100]:wait())
+
+    )"};
+    const auto root = GetTestRoot();
+    boost::algorithm::replace_all(script, "$ROOT", root.generic_string());
+
+    c_Image image{32, 16, PixelFormat::PIX_MONO8};
+    image.ClearToZero();
+    image.SaveToFile((root / "image.bmp").string(), OutputFormat::BMP_8);
+
+    BOOST_REQUIRE(RunScript(script.c_str()));
+
+    fs::remove(root / "image.bmp");
+
+    CheckBooleanNotifications({true, true});
+    BOOST_CHECK(CheckAllPixelValues(GetImageNotification(), 0.5f));
+}
+
+BOOST_FIXTURE_TEST_CASE(ImageArithmetic, ScriptTestFixture)
+{
+    std::string script{R"(
+
+settings = imppg.new_settings()
+settings:tc_set_point(0, 0.0, 0.25)
+settings:tc_set_point(1, 1.0, 0.25)
+a = imppg.load_image("$ROOT/image.tif")
+future = imppg.process_image_async(a, settings)
+-- `a` is shared with the pending processing call and must be copied first
+a:scale(2.0)
+b = imppg.load_image("$ROOT/image.tif")
+b:add(a)
+b:subtract(future:wait())
+b:clamp(0.0, 0.4)
+c = imppg.median({a, b, b})
+c:divide(a)
+c:crop(8, 8, 16, 4)
+imppg.test.notify_image(c)
+
+    )"};
+    const auto root = GetTestRoot();
+    boost::algorithm::replace_all(script, "$ROOT", root.generic_string());
+
+    c_Image image{128, 64, PixelFormat::PIX_MONO32F};
+    for (unsigned y = 0; y < image.GetHeight(); ++y)
+    {
+        float* row = image.GetRowAs<float>(y);
+        for (unsigned x = 0; x < image.GetWidth(); ++x) { row[x] = 0.25f; }
+    }
+    image.SaveToFile((root / "image.tif").string(), OutputFormat::TIFF_32F);
+
+    BOOST_REQUIRE(RunScript(script.c_str()));
+
+    fs::remove(root / "image.tif");
+
+    const auto& result = GetImageNotification();
+    BOOST_REQUIRE(PixelFormat::PIX_MONO32F == result.GetPixelFormat());
+    BOOST_CHECK_EQUAL(16, result.GetWidth());
+    BOOST_CHECK_EQUAL(4, result.GetHeight());
+    BOOST_CHECK(CheckAllPixelValues(result, 0.4f / 0.5f));
+}
+
+BOOST_FIXTURE_TEST_CASE(AlignAndStackImages, ScriptTestFixture)
+{
+    std::string script{R"(
+
+images = {}
+for i = 1, 3 do
+    table.insert(images, imppg.load_image("$ROOT/image.tif"))
+end
+stack = imppg.align_and_stack(images, imppg.STANDARD, imppg.PAD, false, imppg.STACK_MEDIAN)
+imppg.test.notify_image(stack)
+
+    )"};
+    const auto root = GetTestRoot();
+    boost::algorithm::replace_all(script, "$ROOT", root.generic_string());
+
+    // a bright square on a dark background
+    c_Image image{64, 64, PixelFormat::PIX_MONO32F};
+    for (unsigned y = 0; y < image.GetHeight(); ++y)
+    {
+        float* row = image.GetRowAs<float>(y);
+        for (unsigned x = 0; x < image.GetWidth(); ++x)
+        {
+            row[x] = (x >= 24 && x < 40 && y >= 24 && y < 40) ? 1.0f : 0.1f;
+        }
+    }
+    image.SaveToFile((root / "image.tif").string(), OutputFormat::TIFF_32F);
+
+    BOOST_REQUIRE(RunScript(script.c_str()));
+
+    fs::remove(root / "image.tif");
+
+    // identical images are not translated, so the stack is the same as each of them
+    const auto& stack = GetImageNotification();
+    BOOST_REQUIRE(PixelFormat::PIX_MONO32F == stack.GetPixelFormat());
+    BOOST_REQUIRE_EQUAL(image.GetWidth(), stack.GetWidth());
+    BOOST_REQUIRE_EQUAL(image.GetHeight(), stack.GetHeight());
+    BOOST_CHECK_EQUAL(1.0f, stack.GetRowAs<float>(32)[32]);
+    BOOST_CHECK_EQUAL(0.1f, stack.GetRowAs<float>(8)[8]);
+}
+
+BOOST_FIXTURE_TEST_CASE(EstimateQualityAndSelectBest, ScriptTestFixture)
+{
+    std::string script{R"(
+
+images = {
+    imppg.load_image("$ROOT/flat.tif"),
+    imppg.load_image("$ROOT/detailed.tif"),
+    imppg.load_image("$ROOT/flat.tif")
+}
+qualities = imppg.image_quality(images, imppg.QUALITY_GRADIENT)
+imppg.test.notify_number(qualities[1])
+imppg.test.notify_boolean(qualities[2] > qualities[1])
+
+best = imppg.select_best(images, 30, imppg.QUALITY_LAPLACIAN_VARIANCE)
+imppg.test.notify_integer(#best)
+imppg.test.notify_image(best[1])
+
+    )"};
+    const auto root = GetTestRoot();
+    boost::algorithm::replace_all(script, "$ROOT", root.generic_string());
+
+    c_Image flat{64, 64, PixelFormat::PIX_MONO32F};
+    c_Image detailed{64, 64, PixelFormat::PIX_MONO32F};
+    for (unsigned y = 0; y < flat.GetHeight(); ++y)
+    {
+        for (unsigned x = 0; x < flat.GetWidth(); ++x)
+        {
+            flat.GetRowAs<float>(y)[x] = 0.5f;
+            detailed.GetRowAs<float>(y)[x] = ((x / 4 + y / 4) % 2 == 0) ? 1.0f : 0.0f;
+        }
+    }
+    flat.SaveToFile((root / "flat.tif").string(), OutputFormat::TIFF_32F);
+    detailed.SaveToFile((root / "detailed.tif").string(), OutputFormat::TIFF_32F);
+
+    BOOST_REQUIRE(RunScript(script.c_str()));
+
+    fs::remove(root / "flat.tif");
+    fs::remove(root / "detailed.tif");
+
+    CheckNumberNotifications({0.0});
+    CheckBooleanNotifications({true});
+    CheckIntegerNotifications({1});
+    BOOST_CHECK(!CheckAllPixelValues(GetImageNotification(), 0.5f));
+}
+
+BOOST_FIXTURE_TEST_CASE(LoadSettingsTwice_CacheHit, ScriptTestFixture)
+{
+    std::string script{R"(
+
+s1 = imppg.load_settings("$ROOT/cached_settings.xml")
+s2 = imppg.load_settings("$ROOT/cached_settings.xml")
+hits, misses = imppg.settings_cache_stats()
+imppg.test.notify_integer(hits)
+imppg.test.notify_integer(misses)
+imppg.test.notify_integer(s2:get_lr_deconv_num_iters())
+
+    )"};
+    const auto root = GetTestRoot();
+    boost::algorithm::replace_all(script, "$ROOT", root.generic_string());
+
+    ProcessingSettings settings{};
+    settings.LucyRichardson.iterations = 17;
+    SaveSettings((root / "cached_settings.xml").string(), settings);
+
+    BOOST_REQUIRE(RunScript(script.c_str()));
+
+    fs::remove(root / "cached_settings.xml");
+
+    CheckIntegerNotifications({1, 1, 17});
+}
+
 BOOST_FIXTURE_TEST_CASE(ProcessImageFile, ScriptTestFixture)
 {
     std::string script{R"(
@@ -133,3 +358,33 @@ imppg.process_image_file("$ROOT/image.bmp", "$ROOT/settings.xml", "$ROOT/output.
     BOOST_REQUIRE(PixelFormat::PIX_MONO16 == processedImg.GetPixelFormat());
     BOOST_CHECK(CheckAllPixelValues<std::uint16_t>(processedImg, 0xFFFF / 2));
 }
+
+BOOST_FIXTURE_TEST_CASE(ExportTrace, ScriptTestFixture)
+{
+    std::string script{R"(
+
+image = imppg.load_image("$ROOT/traced_image.tif")
+imppg.export_trace("$ROOT/trace.json")
+
+    )"};
+    const auto root = GetTestRoot();
+    boost::algorithm::replace_all(script, "$ROOT", root.generic_string());
+
+    c_Image image{32, 32, PixelFormat::PIX_MONO8};
+    image.ClearToZero();
+    image.SaveToFile((root / "traced_image.tif").string(), OutputFormat::TIFF_16);
+
+    BOOST_REQUIRE(RunScript(script.c_str()));
+
+    fs::remove(root / "traced_image.tif");
+
+    std::ifstream traceFile(root / "trace.json");
+    BOOST_REQUIRE(traceFile);
+    const std::string trace{std::istreambuf_iterator<char>(traceFile), std::istreambuf_iterator<char>()};
+    traceFile.close();
+    fs::remove(root / "trace.json");
+
+    BOOST_CHECK(trace.find("\"traceEvents\"") != std::string::npos);
+    BOOST_CHECK(trace.find("\"name\": \"Load image\"") != std::string::npos);
+    BOOST_CHECK(trace.find("traced_image.tif") != std::string::npos);
+}
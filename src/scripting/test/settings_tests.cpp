@@ -16,6 +16,8 @@ imppg.test.notify_settings(s)
     const ProcessingSettings& settings = GetSettingsNotification();
     BOOST_CHECK_EQUAL(0, settings.LucyRichardson.iterations);
     BOOST_CHECK_EQUAL(false, settings.LucyRichardson.deringing.enabled);
+    BOOST_CHECK_EQUAL(false, settings.color.luminanceOnly);
+    BOOST_CHECK_EQUAL(false, settings.color.chromaDenoise);
     BOOST_CHECK_EQUAL(false, settings.unsharpMask.at(0).adaptive);
     BOOST_CHECK_EQUAL(1.0, settings.unsharpMask.at(0).amountMax);
     BOOST_CHECK_EQUAL(2, settings.toneCurve.GetNumPoints());
@@ -39,6 +41,9 @@ s:lr_deconv_sigma(5.0)
 s:lr_deconv_num_iters(123)
 s:lr_deconv_deringing(true)
 
+s:luminance_only(true)
+s:chroma_denoise(true)
+
 s:unsh_mask_adaptive(0, true)
 s:unsh_mask_sigma(0, 5.0)
 s:unsh_mask_amount_min(0, 1.0)
@@ -56,6 +61,9 @@ imppg.test.notify_number(s:get_lr_deconv_sigma())
 imppg.test.notify_integer(s:get_lr_deconv_num_iters())
 imppg.test.notify_boolean(s:get_lr_deconv_deringing())
 
+imppg.test.notify_boolean(s:get_luminance_only())
+imppg.test.notify_boolean(s:get_chroma_denoise())
+
 imppg.test.notify_boolean(s:get_unsh_mask_adaptive(0))
 imppg.test.notify_number(s:get_unsh_mask_sigma(0))
 imppg.test.notify_number(s:get_unsh_mask_amount_min(0))
@@ -68,7 +76,7 @@ imppg.test.notify_number(s:get_unsh_mask_twidth(0))
 
     RunScript(script);
 
-    CheckBooleanNotifications({true, true, true});
+    CheckBooleanNotifications({true, true, true, true, true});
     CheckNumberNotifications({0.25, 0.75, 5.0, 5.0, 1.0, 2.0, 2.0, 0.125, 0.125});
     CheckIntegerNotifications({123});
 }
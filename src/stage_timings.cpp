@@ -0,0 +1,159 @@
+/*
+ImPPG (Image Post-Processor) - common operations for astronomical stacks and other images
+Copyright (C) 2016-2022 Filip Szczerek <ga.software@yahoo.com>
+
+This file is part of ImPPG.
+
+ImPPG is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ImPPG is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with ImPPG.  If not, see <http://www.gnu.org/licenses/>.
+
+File description:
+    Processing stage timings dialog implementation.
+*/
+
+#include <map>
+#include <string>
+#include <wx/button.h>
+#include <wx/dialog.h>
+#include <wx/filedlg.h>
+#include <wx/listctrl.h>
+#include <wx/msgdlg.h>
+#include <wx/sizer.h>
+#include <wx/stattext.h>
+
+#include "logging/instrumentation.h"
+#include "stage_timings.h"
+
+constexpr int BORDER = 5; ///< Border size (in pixels between) controls
+
+class c_StageTimingsDialog: public wxDialog
+{
+    void InitControls();
+
+    void RefreshRecords();
+
+    void OnExportTrace();
+
+    struct
+    {
+        wxListCtrl* records{nullptr};
+        wxStaticText* summary{nullptr};
+    } m_Ctrls;
+
+public:
+    c_StageTimingsDialog(wxWindow* parent);
+};
+
+c_StageTimingsDialog::c_StageTimingsDialog(wxWindow* parent)
+: wxDialog(
+    parent,
+    wxID_ANY,
+    _("Processing stage timings"),
+    wxDefaultPosition,
+    wxDefaultSize,
+    wxDEFAULT_DIALOG_STYLE | wxRESIZE_BORDER
+)
+{
+    InitControls();
+    RefreshRecords();
+}
+
+void c_StageTimingsDialog::InitControls()
+{
+    wxSizer* szTop = new wxBoxSizer(wxVERTICAL);
+
+    m_Ctrls.records = new wxListCtrl(this, wxID_ANY, wxDefaultPosition, wxSize(900, 400), wxLC_REPORT | wxLC_SINGLE_SEL);
+    m_Ctrls.records->AppendColumn(_("Stage"));
+    m_Ctrls.records->AppendColumn(_("Details"), wxLIST_FORMAT_LEFT, 200);
+    m_Ctrls.records->AppendColumn(_("Start (s)"), wxLIST_FORMAT_RIGHT);
+    m_Ctrls.records->AppendColumn(_("Wall time (ms)"), wxLIST_FORMAT_RIGHT);
+    m_Ctrls.records->AppendColumn(_("CPU time (ms)"), wxLIST_FORMAT_RIGHT);
+    m_Ctrls.records->AppendColumn(_("Mpix/s"), wxLIST_FORMAT_RIGHT);
+    m_Ctrls.records->AppendColumn(_("Allocated (MiB)"), wxLIST_FORMAT_RIGHT);
+    m_Ctrls.records->AppendColumn(_("Threads"), wxLIST_FORMAT_RIGHT);
+    m_Ctrls.records->AppendColumn(_("Thread id"), wxLIST_FORMAT_RIGHT);
+    szTop->Add(m_Ctrls.records, 1, wxGROW | wxALL, BORDER);
+
+    m_Ctrls.summary = new wxStaticText(this, wxID_ANY, wxEmptyString);
+    szTop->Add(m_Ctrls.summary, 0, wxALIGN_LEFT | wxALL, BORDER);
+
+    wxSizer* szButtons = new wxBoxSizer(wxHORIZONTAL);
+
+    auto* btnRefresh = new wxButton(this, wxID_REFRESH);
+    btnRefresh->Bind(wxEVT_BUTTON, [this](wxCommandEvent&) { RefreshRecords(); });
+    szButtons->Add(btnRefresh, 0, wxALIGN_CENTER_VERTICAL | wxALL, BORDER);
+
+    auto* btnClear = new wxButton(this, wxID_CLEAR);
+    btnClear->Bind(wxEVT_BUTTON, [this](wxCommandEvent&) { Log::ClearStageRecords(); RefreshRecords(); });
+    szButtons->Add(btnClear, 0, wxALIGN_CENTER_VERTICAL | wxALL, BORDER);
+
+    auto* btnExport = new wxButton(this, wxID_ANY, _("Export trace..."));
+    btnExport->Bind(wxEVT_BUTTON, [this](wxCommandEvent&) { OnExportTrace(); });
+    szButtons->Add(btnExport, 0, wxALIGN_CENTER_VERTICAL | wxALL, BORDER);
+
+    szButtons->AddStretchSpacer();
+    szButtons->Add(new wxButton(this, wxID_CLOSE), 0, wxALIGN_CENTER_VERTICAL | wxALL, BORDER);
+    SetEscapeId(wxID_CLOSE);
+
+    szTop->Add(szButtons, 0, wxGROW | wxALL, BORDER);
+
+    SetSizer(szTop);
+    Fit();
+}
+
+void c_StageTimingsDialog::RefreshRecords()
+{
+    const auto records = Log::GetStageRecords();
+
+    m_Ctrls.records->DeleteAllItems();
+    std::map<std::string, double> totalWallTimeMs;
+    for (const auto& r: records)
+    {
+        const long idx = m_Ctrls.records->InsertItem(m_Ctrls.records->GetItemCount(), wxString::FromUTF8(r.name));
+        m_Ctrls.records->SetItem(idx, 1, wxString::FromUTF8(r.details));
+        m_Ctrls.records->SetItem(idx, 2, wxString::Format("%.3f", r.startMs / 1000.0));
+        m_Ctrls.records->SetItem(idx, 3, wxString::Format("%.1f", r.wallTimeMs));
+        m_Ctrls.records->SetItem(idx, 4, wxString::Format("%.1f", r.cpuTimeMs));
+        m_Ctrls.records->SetItem(idx, 5, r.megapixels > 0 ? wxString::Format("%.1f", r.GetMegapixelsPerSecond()) : wxString{});
+        m_Ctrls.records->SetItem(idx, 6, wxString::Format("%.1f", r.bytesAllocated / (1024.0 * 1024.0)));
+        m_Ctrls.records->SetItem(idx, 7, wxString::Format("%d", r.numThreads));
+        m_Ctrls.records->SetItem(idx, 8, wxString::Format("%d", r.threadId));
+        totalWallTimeMs[r.name] += r.wallTimeMs;
+    }
+    m_Ctrls.records->SetColumnWidth(0, wxLIST_AUTOSIZE);
+
+    wxString summary = wxString::Format(_("Total wall time per stage (%zu record(s)):"), records.size());
+    for (const auto& [name, timeMs]: totalWallTimeMs)
+    {
+        summary += wxString::Format("\n    %s: %.2f s", wxString::FromUTF8(name), timeMs / 1000.0);
+    }
+    m_Ctrls.summary->SetLabel(summary);
+    Layout();
+}
+
+void c_StageTimingsDialog::OnExportTrace()
+{
+    wxFileDialog dlg(this, _("Export trace"), wxEmptyString, "imppg_trace.json",
+        _("Chrome trace files (*.json)") + "|*.json", wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
+
+    if (dlg.ShowModal() == wxID_OK && !Log::ExportChromeTrace(dlg.GetPath().ToStdString()))
+    {
+        wxMessageBox(wxString::Format(_("Could not save %s."), dlg.GetPath()), _("Error"), wxOK | wxCENTRE | wxICON_ERROR, this);
+    }
+}
+
+void ShowStageTimingsDialog(wxWindow* parent)
+{
+    c_StageTimingsDialog dlg{parent};
+    dlg.ShowModal();
+}
@@ -1,6 +1,6 @@
 /*
 ImPPG (Image Post-Processor) - common operations for astronomical stacks and other images
-Copyright (C) 2016-2019 Filip Szczerek <ga.software@yahoo.com>
+Copyright (C) 2016-2022 Filip Szczerek <ga.software@yahoo.com>
 
 This file is part of ImPPG.
 
@@ -18,26 +18,15 @@ You should have received a copy of the GNU General Public License
 along with ImPPG.  If not, see <http://www.gnu.org/licenses/>.
 
 File description:
-    Logging functions header.
+    Processing stage timings dialog header.
 */
 
-#ifndef IMPPG_LOGGING_H
-#define IMPPG_LOGGING_H
+#ifndef IMPPG_STAGE_TIMINGS_DIALOG_HEADER
+#define IMPPG_STAGE_TIMINGS_DIALOG_HEADER
 
-#include <iostream>
-#include <wx/string.h>
+#include <wx/window.h>
 
-namespace Log
-{
+/// Shows the measurements of processing stages and I/O calls (see `Log::c_StageTimer`).
+void ShowStageTimingsDialog(wxWindow* parent);
 
-enum class LogLevel { QUIET = 0, NORMAL, VERBOSE };
-
-void Initialize(LogLevel level, std::ostream& outputStream);
-
-/// Prints a message. Newline is NOT added by default.
-void Print(const wxString& msg, bool prependTimestamp = true, LogLevel level = LogLevel::NORMAL);
-
-}
-
-
-#endif
+#endif // IMPPG_STAGE_TIMINGS_DIALOG_HEADER
@@ -31,8 +31,9 @@ File description:
 
 #include "wxapp.h"
 #include "appconfig.h"
+#include "common/scheduler.h"
 #include "cursors.h"
-#include "logging.h"
+#include "logging/logging.h"
 #include "main_window.h"
 #if USE_FREEIMAGE
 #include "FreeImage.h" // on MSW it has to be the last include (to make sure no wxW header follows it)
@@ -120,9 +121,13 @@ bool c_MyApp::OnInit()
 
 int c_MyApp::OnExit()
 {
+    // before the logger is shut down, as the remaining tasks may still log
+    c_TaskScheduler::Get().Shutdown();
+
     if (m_LogStream)
     {
         Log::Print("Exiting\n");
+        Log::Shutdown();
         m_LogStream->close();
         delete m_LogStream;
     }